@@ -74,17 +74,82 @@ static const unsigned char temp_binary_data_0[] =
 
 const char* drone_fragment_glsl = (const char*) temp_binary_data_0;
 
-//================== drone_vertex.glsl ==================
+//================== drone_sprite_fragment.glsl ==================
 static const unsigned char temp_binary_data_1[] =
 "#version 330 core\n"
 "\n"
-"// Vertex shader for rendering drones\n"
+"// Fragment shader for point-sprite drones\n"
 "\n"
-"// Input vertex data\n"
+"// Input data from vertex shader\n"
+"in vec4 fragColor;\n"
+"\n"
+"// Output color\n"
+"out vec4 outColor;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    // Round the square point off into a disc\n"
+"    vec2 offset = gl_PointCoord * 2.0 - 1.0;\n"
+"    float distanceSquared = dot(offset, offset);\n"
+"    \n"
+"    if (distanceSquared > 1.0)\n"
+"        discard;\n"
+"    \n"
+"    // A little fake shading so distant drones still read as spheres\n"
+"    float shade = 0.7 + 0.3 * sqrt(1.0 - distanceSquared);\n"
+"    outColor = vec4(fragColor.rgb * shade, 0.85);\n"
+"    \n"
+"    // White outline for active notes, as in the 2D view\n"
+"    if (fragColor.a > 0.5 && distanceSquared > 0.6)\n"
+"        outColor = vec4(1.0);\n"
+"}\n";
+
+const char* drone_sprite_fragment_glsl = (const char*) temp_binary_data_1;
+
+//================== drone_sprite_vertex.glsl ==================
+static const unsigned char temp_binary_data_2[] =
+"#version 330 core\n"
+"\n"
+"// Vertex shader for far-away drones, drawn as point sprites\n"
+"\n"
+"// Instance data, one point per drone\n"
+"layout(location = 2) in vec4 instancePosition;  // world position, radius\n"
+"layout(location = 3) in vec4 instanceColor;     // rgb, a = 1 while a note plays\n"
+"\n"
+"// Output data to fragment shader\n"
+"out vec4 fragColor;\n"
+"\n"
+"// Uniforms\n"
+"uniform mat4 projectionMatrix;\n"
+"uniform mat4 viewMatrix;\n"
+"uniform float pixelsPerUnit;    // focal length in framebuffer pixels\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec4 eyePosition = viewMatrix * vec4(instancePosition.xyz, 1.0);\n"
+"    gl_Position = projectionMatrix * eyePosition;\n"
+"    \n"
+"    // Same on-screen size the drone's sphere would have\n"
+"    gl_PointSize = max(1.0, 2.0 * instancePosition.w * pixelsPerUnit / max(-eyePosition.z, 0.1));\n"
+"    \n"
+"    fragColor = instanceColor;\n"
+"}\n";
+
+const char* drone_sprite_vertex_glsl = (const char*) temp_binary_data_2;
+
+//================== drone_vertex.glsl ==================
+static const unsigned char temp_binary_data_3[] =
+"#version 330 core\n"
+"\n"
+"// Vertex shader for rendering drones, one instance per drone\n"
+"\n"
+"// Mesh vertex data (unit sphere or octahedron)\n"
 "layout(location = 0) in vec3 position;\n"
 "layout(location = 1) in vec3 normal;\n"
-"layout(location = 2) in vec2 texCoord;\n"
-"layout(location = 3) in vec4 color;\n"
+"\n"
+"// Instance data\n"
+"layout(location = 2) in vec4 instancePosition;  // world position, radius\n"
+"layout(location = 3) in vec4 instanceColor;     // rgb, a = 1 while a note plays\n"
 "\n"
 "// Output data to fragment shader\n"
 "out vec3 fragNormal;\n"
@@ -95,34 +160,275 @@ static const unsigned char temp_binary_data_1[] =
 "// Uniforms\n"
 "uniform mat4 projectionMatrix;\n"
 "uniform mat4 viewMatrix;\n"
-"uniform mat4 modelMatrix;\n"
-"uniform float droneSize;\n"
-"uniform vec4 droneColor;\n"
-"uniform bool noteActive;\n"
 "\n"
 "void main()\n"
 "{\n"
-"    // Calculate vertex position in clip space\n"
-"    vec4 worldPosition = modelMatrix * vec4(position * droneSize, 1.0);\n"
-"    gl_Position = projectionMatrix * viewMatrix * worldPosition;\n"
+"    // Scale the mesh to the drone and move it into place\n"
+"    vec3 worldPosition = instancePosition.xyz + position * instancePosition.w;\n"
+"    gl_Position = projectionMatrix * viewMatrix * vec4(worldPosition, 1.0);\n"
+"    \n"
+"    // The mesh is only scaled and translated, so normals stay as they are\n"
+"    fragNormal = normal;\n"
+"    fragTexCoord = vec2(0.0);\n"
+"    \n"
+"    // Active notes are brighter and fully opaque, which the fragment shader picks up\n"
+"    fragColor = instanceColor.a > 0.5 ? vec4(mix(instanceColor.rgb, vec3(1.0), 0.3), 1.0)\n"
+"                                      : vec4(instanceColor.rgb, 0.85);\n"
+"    \n"
+"    fragPosition = worldPosition;\n"
+"}\n";
+
+const char* drone_vertex_glsl = (const char*) temp_binary_data_3;
+
+//================== hud_fragment.glsl ==================
+static const unsigned char temp_binary_data_4[] =
+"#version 330 core\n"
+"\n"
+"// Fragment shader for HUD text\n"
+"\n"
+"// Input data from vertex shader\n"
+"in vec2 texCoord;\n"
+"\n"
+"// Output color\n"
+"out vec4 outColor;\n"
+"\n"
+"// Uniforms\n"
+"uniform sampler2D glyphAtlas;   // glyph coverage in the red channel\n"
+"uniform vec4 textColor;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    outColor = vec4(textColor.rgb, textColor.a * texture(glyphAtlas, texCoord).r);\n"
+"}\n";
+
+const char* hud_fragment_glsl = (const char*) temp_binary_data_4;
+
+//================== hud_vertex.glsl ==================
+static const unsigned char temp_binary_data_5[] =
+"#version 330 core\n"
+"\n"
+"// Vertex shader for HUD text: glyph quads from the atlas, in framebuffer pixels\n"
+"\n"
+"// Vertex data\n"
+"layout(location = 0) in vec4 position;     // xy in pixels from the top left, zw atlas coordinates\n"
+"\n"
+"// Output data to fragment shader\n"
+"out vec2 texCoord;\n"
+"\n"
+"// Uniforms\n"
+"uniform vec2 viewportSize;      // framebuffer pixels\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec2 normalised = position.xy / viewportSize;\n"
+"    gl_Position = vec4(normalised.x * 2.0 - 1.0, 1.0 - normalised.y * 2.0, 0.0, 1.0);\n"
+"    texCoord = position.zw;\n"
+"}\n";
+
+const char* hud_vertex_glsl = (const char*) temp_binary_data_5;
+
+//================== swarm_candidates_geometry.glsl ==================
+static const unsigned char temp_binary_data_6[] =
+"#version 330 core\n"
+"\n"
+"// Emits a point only for drones that left their note cell, so transform\n"
+"// feedback packs them into a compact list (one SwarmNoteCandidate each)\n"
+"\n"
+"layout(points) in;\n"
+"layout(points, max_vertices = 1) out;\n"
+"\n"
+"// Input data from the vertex shader\n"
+"in vec4 previousState[];\n"
+"in vec4 currentState[];\n"
+"in float droneSpeed[];\n"
+"in float droneIndex[];\n"
+"\n"
+"// Captured candidate\n"
+"out vec4 candidateCells;    // drone index, old cell, new cell, previous x\n"
+"out vec4 candidateMotion;   // position xyz, speed\n"
+"\n"
+"// Uniforms\n"
+"uniform bool reseatCells;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    float oldCell = previousState[0].w;\n"
+"    float newCell = currentState[0].w;\n"
 "    \n"
-"    // Calculate normal in world space\n"
-"    fragNormal = normalize(mat3(modelMatrix) * normal);\n"
+"    if (reseatCells || oldCell < 0.0 || newCell == oldCell)\n"
+"        return;\n"
 "    \n"
-"    // Pass through texture coordinates\n"
-"    fragTexCoord = texCoord;\n"
+"    candidateCells = vec4(droneIndex[0], oldCell, newCell, previousState[0].x);\n"
+"    candidateMotion = vec4(currentState[0].xyz, droneSpeed[0]);\n"
+"    gl_Position = vec4(0.0);\n"
+"    EmitVertex();\n"
+"    EndPrimitive();\n"
+"}\n";
+
+const char* swarm_candidates_geometry_glsl = (const char*) temp_binary_data_6;
+
+//================== swarm_candidates_vertex.glsl ==================
+static const unsigned char temp_binary_data_7[] =
+"#version 330 core\n"
+"\n"
+"// Pairs each drone's state before and after a physics step for the\n"
+"// note-candidate filter\n"
+"\n"
+"// Input vertex data\n"
+"layout(location = 0) in vec4 previousPositionAndCell;\n"
+"layout(location = 1) in vec4 positionAndCell;\n"
+"layout(location = 2) in vec4 velocity;\n"
+"\n"
+"// Output data to the geometry shader\n"
+"out vec4 previousState;\n"
+"out vec4 currentState;\n"
+"out float droneSpeed;\n"
+"out float droneIndex;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    previousState = previousPositionAndCell;\n"
+"    currentState = positionAndCell;\n"
+"    droneSpeed = length(velocity.xyz);\n"
+"    droneIndex = float(gl_VertexID);\n"
+"    gl_Position = vec4(0.0);\n"
+"}\n";
+
+const char* swarm_candidates_vertex_glsl = (const char*) temp_binary_data_7;
+
+//================== swarm_physics_vertex.glsl ==================
+static const unsigned char temp_binary_data_8[] =
+"#version 330 core\n"
+"\n"
+"// Transform-feedback physics for the GPU path: one vertex per drone, written\n"
+"// into the other buffer of a ping-pong pair. Mirrors SwarmDrone::update and\n"
+"// the cell tracking in SwarmSimulation::findNoteCandidates, which remain the\n"
+"// reference implementation\n"
+"\n"
+"// Drone state\n"
+"layout(location = 0) in vec4 positionAndCell;  // xyz, note cell (-1 = not seated yet)\n"
+"layout(location = 1) in vec4 velocity;\n"
+"\n"
+"// Captured state for the next step\n"
+"out vec4 nextPositionAndCell;\n"
+"out vec4 nextVelocity;\n"
+"\n"
+"// Uniforms\n"
+"uniform samplerBuffer targets;      // formation target per drone\n"
+"uniform float chaosLevel;\n"
+"uniform float formationStrength;\n"
+"uniform uint frame;\n"
+"uniform float stepSeconds;\n"
+"uniform int numSubSteps;\n"
+"uniform int numCells;\n"
+"uniform float cellHysteresis;       // fraction of a cell width\n"
+"uniform bool reseatCells;           // the scale changed: take new cells without triggering\n"
+"\n"
+"const float boundary = 15.0;\n"
+"const float bounceFactor = -0.7;\n"
+"\n"
+"// Per second, as in SwarmDrone\n"
+"const float targetAcceleration = 62.5;\n"
+"const float dampingPerSecond = 1.2823;\n"
+"const float maxSpeed = 12.5;\n"
+"const float noiseDensity = 6.25;\n"
+"\n"
+"// Integer hash to a uniform float in (0, 1]\n"
+"float uniformNoise(uint seed)\n"
+"{\n"
+"    seed ^= seed >> 16u;\n"
+"    seed *= 0x7feb352du;\n"
+"    seed ^= seed >> 15u;\n"
+"    seed *= 0x846ca68bu;\n"
+"    seed ^= seed >> 16u;\n"
+"    return (float(seed >> 8u) + 1.0) / 16777216.0;\n"
+"}\n"
+"\n"
+"// Three standard normal values (Box-Muller), different for every drone and frame\n"
+"vec3 gaussianNoise(uint drone, uint step)\n"
+"{\n"
+"    uint seed = (drone * 0x9e3779b9u) ^ (step * 0x85ebca6bu);\n"
+"    float r1 = sqrt(-2.0 * log(uniformNoise(seed)));\n"
+"    float r2 = sqrt(-2.0 * log(uniformNoise(seed + 1u)));\n"
+"    float a1 = 6.2831853 * uniformNoise(seed + 2u);\n"
+"    float a2 = 6.2831853 * uniformNoise(seed + 3u);\n"
+"    return vec3(r1 * cos(a1), r1 * sin(a1), r2 * cos(a2));\n"
+"}\n"
+"\n"
+"// Bounce off one pair of walls\n"
+"void bounce(inout float p, inout float v)\n"
+"{\n"
+"    if (p > boundary)\n"
+"    {\n"
+"        p = boundary - (p - boundary);\n"
+"        v *= bounceFactor;\n"
+"    }\n"
+"    else if (p < -boundary)\n"
+"    {\n"
+"        p = -boundary - (p + boundary);\n"
+"        v *= bounceFactor;\n"
+"    }\n"
+"}\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec3 position = positionAndCell.xyz;\n"
+"    vec3 newVelocity = velocity.xyz;\n"
+"    vec3 target = texelFetch(targets, gl_VertexID).xyz;\n"
+"    float dt = stepSeconds / float(numSubSteps);\n"
+"    \n"
+"    // Semi-implicit Euler, numSubSteps passes per step\n"
+"    for (int i = 0; i < numSubSteps; ++i)\n"
+"    {\n"
+"        // Force towards the target based on formation strength\n"
+"        vec3 toTarget = target - position;\n"
+"        float distanceToTarget = length(toTarget);\n"
+"        \n"
+"        if (distanceToTarget > 0.001)\n"
+"            toTarget /= distanceToTarget;\n"
+"        \n"
+"        newVelocity += toTarget * (targetAcceleration * formationStrength * dt);\n"
+"        \n"
+"        // Random movement (chaos), damping and the speed limit\n"
+"        uint noiseStep = frame * uint(numSubSteps) + uint(i);\n"
+"        newVelocity += gaussianNoise(uint(gl_VertexID), noiseStep) * (chaosLevel * noiseDensity * sqrt(dt));\n"
+"        newVelocity *= exp(-dampingPerSecond * dt);\n"
+"        \n"
+"        float speed = length(newVelocity);\n"
+"        \n"
+"        if (speed > maxSpeed)\n"
+"            newVelocity *= maxSpeed / speed;\n"
+"        \n"
+"        position += newVelocity * dt;\n"
+"        \n"
+"        bounce(position.x, newVelocity.x);\n"
+"        bounce(position.y, newVelocity.y);\n"
+"        bounce(position.z, newVelocity.z);\n"
+"    }\n"
+"    \n"
+"    // Note cell, kept while the drone stays inside it plus the hysteresis band\n"
+"    float cellWidth = 30.0 / float(numCells);\n"
+"    float cell = reseatCells ? -1.0 : positionAndCell.w;\n"
+"    float newCell = clamp(floor((position.x + 15.0) / cellWidth), 0.0, float(numCells - 1));\n"
 "    \n"
-"    // Pass through color (modified by noteActive)\n"
-"    fragColor = noteActive ? mix(droneColor, vec4(1.0, 1.0, 1.0, 1.0), 0.3) : droneColor;\n"
+"    if (cell >= 0.0)\n"
+"    {\n"
+"        float cellLow = -15.0 + cell * cellWidth;\n"
+"        float band = cellWidth * cellHysteresis;\n"
+"        \n"
+"        if (position.x >= cellLow - band && position.x < cellLow + cellWidth + band)\n"
+"            newCell = cell;\n"
+"    }\n"
 "    \n"
-"    // Pass world position to fragment shader\n"
-"    fragPosition = worldPosition.xyz;\n"
+"    nextPositionAndCell = vec4(position, newCell);\n"
+"    nextVelocity = vec4(newVelocity, 0.0);\n"
+"    gl_Position = vec4(0.0);\n"
 "}\n";
 
-const char* drone_vertex_glsl = (const char*) temp_binary_data_1;
+const char* swarm_physics_vertex_glsl = (const char*) temp_binary_data_8;
 
 //================== trail_fragment.glsl ==================
-static const unsigned char temp_binary_data_2[] =
+static const unsigned char temp_binary_data_9[] =
 "#version 330 core\n"
 "\n"
 "// Fragment shader for rendering trails\n"
@@ -139,38 +445,71 @@ static const unsigned char temp_binary_data_2[] =
 "    outColor = fragColor;\n"
 "}\n";
 
-const char* trail_fragment_glsl = (const char*) temp_binary_data_2;
+const char* trail_fragment_glsl = (const char*) temp_binary_data_9;
 
 //================== trail_vertex.glsl ==================
-static const unsigned char temp_binary_data_3[] =
+static const unsigned char temp_binary_data_10[] =
 "#version 330 core\n"
 "\n"
-"// Vertex shader for rendering trails\n"
-"\n"
-"// Input vertex data\n"
-"layout(location = 0) in vec3 position;\n"
-"layout(location = 1) in vec4 color;\n"
+"// Vertex shader for rendering trails as camera-facing ribbons, one instance per drone.\n"
+"// There is no vertex data: each vertex finds its trail point in the history ring\n"
+"// from gl_VertexID (two vertices per point, one each side) and gl_InstanceID (the drone).\n"
 "\n"
 "// Output data to fragment shader\n"
 "out vec4 fragColor;\n"
 "\n"
 "// Uniforms\n"
+"uniform samplerBuffer history;      // historyLength slots of numDrones positions\n"
+"uniform samplerBuffer colors;       // one color per drone\n"
+"uniform int numDrones;\n"
+"uniform int historyLength;\n"
+"uniform int newestSlot;\n"
+"uniform int numPoints;              // slots filled so far\n"
 "uniform mat4 projectionMatrix;\n"
 "uniform mat4 viewMatrix;\n"
-"uniform mat4 modelMatrix;\n"
-"uniform float fadeVal;\n"
+"uniform float ribbonWidth;          // world units, at the drone end\n"
+"uniform float fadeVal;              // alpha at the drone end, fading to 0 at the tail\n"
+"uniform float interpolation;        // how far the drones are from the previous slot to the newest\n"
+"\n"
+"// World position of a history point, 0 = newest; ages past the filled part repeat\n"
+"// the oldest point, which collapses the rest of the ribbon\n"
+"vec3 historyPoint(int age)\n"
+"{\n"
+"    int slot = (newestSlot - clamp(age, 0, numPoints - 1) + historyLength) % historyLength;\n"
+"    return texelFetch(history, slot * numDrones + gl_InstanceID).xyz;\n"
+"}\n"
+"\n"
+"// Eye-space position of a trail point; the whole trail slides along with the drones\n"
+"// as they are drawn between simulation frames, so its head stays on the drone\n"
+"vec3 trailPoint(int age)\n"
+"{\n"
+"    vec3 position = mix(historyPoint(age + 1), historyPoint(age), interpolation);\n"
+"    return (viewMatrix * vec4(position, 1.0)).xyz;\n"
+"}\n"
 "\n"
 "void main()\n"
 "{\n"
-"    // Calculate vertex position in clip space\n"
-"    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);\n"
+"    int age = gl_VertexID / 2;\n"
+"    float side = (gl_VertexID % 2 == 0) ? -0.5 : 0.5;\n"
+"    \n"
+"    // Widen across the trail's direction, in the plane facing the eye\n"
+"    vec3 point = trailPoint(age);\n"
+"    vec3 direction = trailPoint(age - 1) - trailPoint(age + 1);\n"
+"    vec3 across = cross(direction, point);\n"
+"    float acrossLength = length(across);\n"
+"    across = acrossLength > 1e-6 ? across / acrossLength : vec3(0.0);\n"
+"    \n"
+"    // Fade color based on trail position, narrowing towards the tail\n"
+"    float fade = 1.0 - float(age) / float(max(historyLength - 1, 1));\n"
+"    point += across * side * ribbonWidth * mix(0.2, 1.0, fade);\n"
+"    \n"
+"    gl_Position = projectionMatrix * vec4(point, 1.0);\n"
 "    \n"
-"    // Fade color based on trail position\n"
-"    fragColor = color;\n"
-"    fragColor.a *= fadeVal;\n"
+"    fragColor = texelFetch(colors, gl_InstanceID);\n"
+"    fragColor.a *= fadeVal * fade;\n"
 "}\n";
 
-const char* trail_vertex_glsl = (const char*) temp_binary_data_3;
+const char* trail_vertex_glsl = (const char*) temp_binary_data_10;
 
 
 const char* getNamedResource (const char* resourceNameUTF8, int& numBytes);
@@ -185,9 +524,16 @@ const char* getNamedResource (const char* resourceNameUTF8, int& numBytes)
     switch (hash)
     {
         case 0xd78175a6:  numBytes = 1710; return drone_fragment_glsl;
-        case 0xb9490d12:  numBytes = 1132; return drone_vertex_glsl;
+        case 0x6a8aa15a:  numBytes = 688; return drone_sprite_fragment_glsl;
+        case 0xec5195c6:  numBytes = 800; return drone_sprite_vertex_glsl;
+        case 0xb9490d12:  numBytes = 1226; return drone_vertex_glsl;
+        case 0x94792945:  numBytes = 345; return hud_fragment_glsl;
+        case 0x8d871c71:  numBytes = 517; return hud_vertex_glsl;
+        case 0x7c5c07e3:  numBytes = 937; return swarm_candidates_geometry_glsl;
+        case 0x1c5c7bf1:  numBytes = 606; return swarm_candidates_vertex_glsl;
+        case 0x270a387a:  numBytes = 4080; return swarm_physics_vertex_glsl;
         case 0x56040014:  numBytes = 232; return trail_fragment_glsl;
-        case 0xf6275b00:  numBytes = 574; return trail_vertex_glsl;
+        case 0xf6275b00:  numBytes = 2387; return trail_vertex_glsl;
         default: break;
     }
 
@@ -198,7 +544,14 @@ const char* getNamedResource (const char* resourceNameUTF8, int& numBytes)
 const char* namedResourceList[] =
 {
     "drone_fragment_glsl",
+    "drone_sprite_fragment_glsl",
+    "drone_sprite_vertex_glsl",
     "drone_vertex_glsl",
+    "hud_fragment_glsl",
+    "hud_vertex_glsl",
+    "swarm_candidates_geometry_glsl",
+    "swarm_candidates_vertex_glsl",
+    "swarm_physics_vertex_glsl",
     "trail_fragment_glsl",
     "trail_vertex_glsl"
 };
@@ -206,7 +559,14 @@ const char* namedResourceList[] =
 const char* originalFilenames[] =
 {
     "drone_fragment.glsl",
+    "drone_sprite_fragment.glsl",
+    "drone_sprite_vertex.glsl",
     "drone_vertex.glsl",
+    "hud_fragment.glsl",
+    "hud_vertex.glsl",
+    "swarm_candidates_geometry.glsl",
+    "swarm_candidates_vertex.glsl",
+    "swarm_physics_vertex.glsl",
     "trail_fragment.glsl",
     "trail_vertex.glsl"
 };
@@ -11,17 +11,38 @@ namespace BinaryData
     extern const char*   drone_fragment_glsl;
     const int            drone_fragment_glslSize = 1710;
 
+    extern const char*   drone_sprite_fragment_glsl;
+    const int            drone_sprite_fragment_glslSize = 688;
+
+    extern const char*   drone_sprite_vertex_glsl;
+    const int            drone_sprite_vertex_glslSize = 800;
+
     extern const char*   drone_vertex_glsl;
-    const int            drone_vertex_glslSize = 1132;
+    const int            drone_vertex_glslSize = 1226;
+
+    extern const char*   hud_fragment_glsl;
+    const int            hud_fragment_glslSize = 345;
+
+    extern const char*   hud_vertex_glsl;
+    const int            hud_vertex_glslSize = 517;
+
+    extern const char*   swarm_candidates_geometry_glsl;
+    const int            swarm_candidates_geometry_glslSize = 937;
+
+    extern const char*   swarm_candidates_vertex_glsl;
+    const int            swarm_candidates_vertex_glslSize = 606;
+
+    extern const char*   swarm_physics_vertex_glsl;
+    const int            swarm_physics_vertex_glslSize = 4080;
 
     extern const char*   trail_fragment_glsl;
     const int            trail_fragment_glslSize = 232;
 
     extern const char*   trail_vertex_glsl;
-    const int            trail_vertex_glslSize = 574;
+    const int            trail_vertex_glslSize = 2387;
 
     // Number of elements in the namedResourceList and originalFileNames arrays.
-    const int namedResourceListSize = 4;
+    const int namedResourceListSize = 11;
 
     // Points to the start of a list of resource names.
     extern const char* namedResourceList[];
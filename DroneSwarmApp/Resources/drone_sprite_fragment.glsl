@@ -0,0 +1,27 @@
+#version 330 core
+
+// Fragment shader for point-sprite drones
+
+// Input data from vertex shader
+in vec4 fragColor;
+
+// Output color
+out vec4 outColor;
+
+void main()
+{
+    // Round the square point off into a disc
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    float distanceSquared = dot(offset, offset);
+    
+    if (distanceSquared > 1.0)
+        discard;
+    
+    // A little fake shading so distant drones still read as spheres
+    float shade = 0.7 + 0.3 * sqrt(1.0 - distanceSquared);
+    outColor = vec4(fragColor.rgb * shade, 0.85);
+    
+    // White outline for active notes, as in the 2D view
+    if (fragColor.a > 0.5 && distanceSquared > 0.6)
+        outColor = vec4(1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+// Vertex shader for far-away drones, drawn as point sprites
+
+// Instance data, one point per drone
+layout(location = 2) in vec4 instancePosition;  // world position, radius
+layout(location = 3) in vec4 instanceColor;     // rgb, a = 1 while a note plays
+
+// Output data to fragment shader
+out vec4 fragColor;
+
+// Uniforms
+uniform mat4 projectionMatrix;
+uniform mat4 viewMatrix;
+uniform float pixelsPerUnit;    // focal length in framebuffer pixels
+
+void main()
+{
+    vec4 eyePosition = viewMatrix * vec4(instancePosition.xyz, 1.0);
+    gl_Position = projectionMatrix * eyePosition;
+    
+    // Same on-screen size the drone's sphere would have
+    gl_PointSize = max(1.0, 2.0 * instancePosition.w * pixelsPerUnit / max(-eyePosition.z, 0.1));
+    
+    fragColor = instanceColor;
+}
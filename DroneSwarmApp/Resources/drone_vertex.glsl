@@ -1,12 +1,14 @@
 #version 330 core
 
-// Vertex shader for rendering drones
+// Vertex shader for rendering drones, one instance per drone
 
-// Input vertex data
+// Mesh vertex data (unit sphere or octahedron)
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 texCoord;
-layout(location = 3) in vec4 color;
+
+// Instance data
+layout(location = 2) in vec4 instancePosition;  // world position, radius
+layout(location = 3) in vec4 instanceColor;     // rgb, a = 1 while a note plays
 
 // Output data to fragment shader
 out vec3 fragNormal;
@@ -17,26 +19,20 @@ out vec3 fragPosition;
 // Uniforms
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
-uniform float droneSize;
-uniform vec4 droneColor;
-uniform bool noteActive;
 
 void main()
 {
-    // Calculate vertex position in clip space
-    vec4 worldPosition = modelMatrix * vec4(position * droneSize, 1.0);
-    gl_Position = projectionMatrix * viewMatrix * worldPosition;
-    
-    // Calculate normal in world space
-    fragNormal = normalize(mat3(modelMatrix) * normal);
+    // Scale the mesh to the drone and move it into place
+    vec3 worldPosition = instancePosition.xyz + position * instancePosition.w;
+    gl_Position = projectionMatrix * viewMatrix * vec4(worldPosition, 1.0);
     
-    // Pass through texture coordinates
-    fragTexCoord = texCoord;
+    // The mesh is only scaled and translated, so normals stay as they are
+    fragNormal = normal;
+    fragTexCoord = vec2(0.0);
     
-    // Pass through color (modified by noteActive)
-    fragColor = noteActive ? mix(droneColor, vec4(1.0, 1.0, 1.0, 1.0), 0.3) : droneColor;
+    // Active notes are brighter and fully opaque, which the fragment shader picks up
+    fragColor = instanceColor.a > 0.5 ? vec4(mix(instanceColor.rgb, vec3(1.0), 0.3), 1.0)
+                                      : vec4(instanceColor.rgb, 0.85);
     
-    // Pass world position to fragment shader
-    fragPosition = worldPosition.xyz;
+    fragPosition = worldPosition;
 }
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Fragment shader for HUD text
+
+// Input data from vertex shader
+in vec2 texCoord;
+
+// Output color
+out vec4 outColor;
+
+// Uniforms
+uniform sampler2D glyphAtlas;   // glyph coverage in the red channel
+uniform vec4 textColor;
+
+void main()
+{
+    outColor = vec4(textColor.rgb, textColor.a * texture(glyphAtlas, texCoord).r);
+}
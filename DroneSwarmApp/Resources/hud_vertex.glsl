@@ -0,0 +1,19 @@
+#version 330 core
+
+// Vertex shader for HUD text: glyph quads from the atlas, in framebuffer pixels
+
+// Vertex data
+layout(location = 0) in vec4 position;     // xy in pixels from the top left, zw atlas coordinates
+
+// Output data to fragment shader
+out vec2 texCoord;
+
+// Uniforms
+uniform vec2 viewportSize;      // framebuffer pixels
+
+void main()
+{
+    vec2 normalised = position.xy / viewportSize;
+    gl_Position = vec4(normalised.x * 2.0 - 1.0, 1.0 - normalised.y * 2.0, 0.0, 1.0);
+    texCoord = position.zw;
+}
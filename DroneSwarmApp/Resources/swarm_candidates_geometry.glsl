@@ -0,0 +1,35 @@
+#version 330 core
+
+// Emits a point only for drones that left their note cell, so transform
+// feedback packs them into a compact list (one SwarmNoteCandidate each)
+
+layout(points) in;
+layout(points, max_vertices = 1) out;
+
+// Input data from the vertex shader
+in vec4 previousState[];
+in vec4 currentState[];
+in float droneSpeed[];
+in float droneIndex[];
+
+// Captured candidate
+out vec4 candidateCells;    // drone index, old cell, new cell, previous x
+out vec4 candidateMotion;   // position xyz, speed
+
+// Uniforms
+uniform bool reseatCells;
+
+void main()
+{
+    float oldCell = previousState[0].w;
+    float newCell = currentState[0].w;
+    
+    if (reseatCells || oldCell < 0.0 || newCell == oldCell)
+        return;
+    
+    candidateCells = vec4(droneIndex[0], oldCell, newCell, previousState[0].x);
+    candidateMotion = vec4(currentState[0].xyz, droneSpeed[0]);
+    gl_Position = vec4(0.0);
+    EmitVertex();
+    EndPrimitive();
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// Pairs each drone's state before and after a physics step for the
+// note-candidate filter
+
+// Input vertex data
+layout(location = 0) in vec4 previousPositionAndCell;
+layout(location = 1) in vec4 positionAndCell;
+layout(location = 2) in vec4 velocity;
+
+// Output data to the geometry shader
+out vec4 previousState;
+out vec4 currentState;
+out float droneSpeed;
+out float droneIndex;
+
+void main()
+{
+    previousState = previousPositionAndCell;
+    currentState = positionAndCell;
+    droneSpeed = length(velocity.xyz);
+    droneIndex = float(gl_VertexID);
+    gl_Position = vec4(0.0);
+}
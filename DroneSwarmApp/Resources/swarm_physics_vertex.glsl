@@ -0,0 +1,126 @@
+#version 330 core
+
+// Transform-feedback physics for the GPU path: one vertex per drone, written
+// into the other buffer of a ping-pong pair. Mirrors SwarmDrone::update and
+// the cell tracking in SwarmSimulation::findNoteCandidates, which remain the
+// reference implementation
+
+// Drone state
+layout(location = 0) in vec4 positionAndCell;  // xyz, note cell (-1 = not seated yet)
+layout(location = 1) in vec4 velocity;
+
+// Captured state for the next step
+out vec4 nextPositionAndCell;
+out vec4 nextVelocity;
+
+// Uniforms
+uniform samplerBuffer targets;      // formation target per drone
+uniform float chaosLevel;
+uniform float formationStrength;
+uniform uint frame;
+uniform float stepSeconds;
+uniform int numSubSteps;
+uniform int numCells;
+uniform float cellHysteresis;       // fraction of a cell width
+uniform bool reseatCells;           // the scale changed: take new cells without triggering
+
+const float boundary = 15.0;
+const float bounceFactor = -0.7;
+
+// Per second, as in SwarmDrone
+const float targetAcceleration = 62.5;
+const float dampingPerSecond = 1.2823;
+const float maxSpeed = 12.5;
+const float noiseDensity = 6.25;
+
+// Integer hash to a uniform float in (0, 1]
+float uniformNoise(uint seed)
+{
+    seed ^= seed >> 16u;
+    seed *= 0x7feb352du;
+    seed ^= seed >> 15u;
+    seed *= 0x846ca68bu;
+    seed ^= seed >> 16u;
+    return (float(seed >> 8u) + 1.0) / 16777216.0;
+}
+
+// Three standard normal values (Box-Muller), different for every drone and frame
+vec3 gaussianNoise(uint drone, uint step)
+{
+    uint seed = (drone * 0x9e3779b9u) ^ (step * 0x85ebca6bu);
+    float r1 = sqrt(-2.0 * log(uniformNoise(seed)));
+    float r2 = sqrt(-2.0 * log(uniformNoise(seed + 1u)));
+    float a1 = 6.2831853 * uniformNoise(seed + 2u);
+    float a2 = 6.2831853 * uniformNoise(seed + 3u);
+    return vec3(r1 * cos(a1), r1 * sin(a1), r2 * cos(a2));
+}
+
+// Bounce off one pair of walls
+void bounce(inout float p, inout float v)
+{
+    if (p > boundary)
+    {
+        p = boundary - (p - boundary);
+        v *= bounceFactor;
+    }
+    else if (p < -boundary)
+    {
+        p = -boundary - (p + boundary);
+        v *= bounceFactor;
+    }
+}
+
+void main()
+{
+    vec3 position = positionAndCell.xyz;
+    vec3 newVelocity = velocity.xyz;
+    vec3 target = texelFetch(targets, gl_VertexID).xyz;
+    float dt = stepSeconds / float(numSubSteps);
+    
+    // Semi-implicit Euler, numSubSteps passes per step
+    for (int i = 0; i < numSubSteps; ++i)
+    {
+        // Force towards the target based on formation strength
+        vec3 toTarget = target - position;
+        float distanceToTarget = length(toTarget);
+        
+        if (distanceToTarget > 0.001)
+            toTarget /= distanceToTarget;
+        
+        newVelocity += toTarget * (targetAcceleration * formationStrength * dt);
+        
+        // Random movement (chaos), damping and the speed limit
+        uint noiseStep = frame * uint(numSubSteps) + uint(i);
+        newVelocity += gaussianNoise(uint(gl_VertexID), noiseStep) * (chaosLevel * noiseDensity * sqrt(dt));
+        newVelocity *= exp(-dampingPerSecond * dt);
+        
+        float speed = length(newVelocity);
+        
+        if (speed > maxSpeed)
+            newVelocity *= maxSpeed / speed;
+        
+        position += newVelocity * dt;
+        
+        bounce(position.x, newVelocity.x);
+        bounce(position.y, newVelocity.y);
+        bounce(position.z, newVelocity.z);
+    }
+    
+    // Note cell, kept while the drone stays inside it plus the hysteresis band
+    float cellWidth = 30.0 / float(numCells);
+    float cell = reseatCells ? -1.0 : positionAndCell.w;
+    float newCell = clamp(floor((position.x + 15.0) / cellWidth), 0.0, float(numCells - 1));
+    
+    if (cell >= 0.0)
+    {
+        float cellLow = -15.0 + cell * cellWidth;
+        float band = cellWidth * cellHysteresis;
+        
+        if (position.x >= cellLow - band && position.x < cellLow + cellWidth + band)
+            newCell = cell;
+    }
+    
+    nextPositionAndCell = vec4(position, newCell);
+    nextVelocity = vec4(newVelocity, 0.0);
+    gl_Position = vec4(0.0);
+}
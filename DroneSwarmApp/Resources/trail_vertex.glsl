@@ -1,26 +1,59 @@
 #version 330 core
 
-// Vertex shader for rendering trails
-
-// Input vertex data
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec4 color;
+// Vertex shader for rendering trails as camera-facing ribbons, one instance per drone.
+// There is no vertex data: each vertex finds its trail point in the history ring
+// from gl_VertexID (two vertices per point, one each side) and gl_InstanceID (the drone).
 
 // Output data to fragment shader
 out vec4 fragColor;
 
 // Uniforms
+uniform samplerBuffer history;      // historyLength slots of numDrones positions
+uniform samplerBuffer colors;       // one color per drone
+uniform int numDrones;
+uniform int historyLength;
+uniform int newestSlot;
+uniform int numPoints;              // slots filled so far
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
-uniform float fadeVal;
+uniform float ribbonWidth;          // world units, at the drone end
+uniform float fadeVal;              // alpha at the drone end, fading to 0 at the tail
+uniform float interpolation;        // how far the drones are from the previous slot to the newest
+
+// World position of a history point, 0 = newest; ages past the filled part repeat
+// the oldest point, which collapses the rest of the ribbon
+vec3 historyPoint(int age)
+{
+    int slot = (newestSlot - clamp(age, 0, numPoints - 1) + historyLength) % historyLength;
+    return texelFetch(history, slot * numDrones + gl_InstanceID).xyz;
+}
+
+// Eye-space position of a trail point; the whole trail slides along with the drones
+// as they are drawn between simulation frames, so its head stays on the drone
+vec3 trailPoint(int age)
+{
+    vec3 position = mix(historyPoint(age + 1), historyPoint(age), interpolation);
+    return (viewMatrix * vec4(position, 1.0)).xyz;
+}
 
 void main()
 {
-    // Calculate vertex position in clip space
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+    int age = gl_VertexID / 2;
+    float side = (gl_VertexID % 2 == 0) ? -0.5 : 0.5;
+    
+    // Widen across the trail's direction, in the plane facing the eye
+    vec3 point = trailPoint(age);
+    vec3 direction = trailPoint(age - 1) - trailPoint(age + 1);
+    vec3 across = cross(direction, point);
+    float acrossLength = length(across);
+    across = acrossLength > 1e-6 ? across / acrossLength : vec3(0.0);
+    
+    // Fade color based on trail position, narrowing towards the tail
+    float fade = 1.0 - float(age) / float(max(historyLength - 1, 1));
+    point += across * side * ribbonWidth * mix(0.2, 1.0, fade);
+    
+    gl_Position = projectionMatrix * vec4(point, 1.0);
     
-    // Fade color based on trail position
-    fragColor = color;
-    fragColor.a *= fadeVal;
+    fragColor = texelFetch(colors, gl_InstanceID);
+    fragColor.a *= fadeVal * fade;
 }
@@ -1,6 +1,9 @@
 #include "DroneSwarmApp.h"
+#include "MidiLoopbackHarness.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <numeric>
 #ifdef __APPLE__
 #include <OpenGL/gl3.h>
@@ -46,6 +49,155 @@
 #endif
 
 
+//==============================================================================
+// SwarmLaunchOptions implementation
+
+SwarmLaunchOptions SwarmLaunchOptions::fromCommandLine(const juce::String& commandLine)
+{
+    juce::ArgumentList args("DroneSwarmApp", juce::StringArray::fromTokens(commandLine, true));
+    SwarmLaunchOptions options;
+    
+    options.useVirtualMidiOutput = args.containsOption("--virtual-midi");
+    
+    if (args.containsOption("--midi-out"))
+        options.midiOutputName = args.getValueForOption("--midi-out").unquoted();
+    
+    // --osc-out=[host:]port [--osc-blob] [--osc-packet-bytes=1472]
+    if (args.containsOption("--osc-out"))
+    {
+        auto target = args.getValueForOption("--osc-out");
+        
+        if (target.containsChar(':'))
+            options.oscOutHost = target.upToLastOccurrenceOf(":", false, false);
+        
+        options.oscOutPort = target.fromLastOccurrenceOf(":", false, false).getIntValue();
+    }
+    
+    options.oscUseBlobs = args.containsOption("--osc-blob");
+    
+    if (args.containsOption("--osc-packet-bytes"))
+        options.oscMaxPacketBytes = args.getValueForOption("--osc-packet-bytes").getIntValue();
+    
+    if (args.containsOption("--osc-in"))
+        options.oscInPort = args.getValueForOption("--osc-in").getIntValue();
+    
+    // --drones=8 for the app, or a list of sizes for the loopback harness
+    if (args.containsOption("--drones"))
+    {
+        juce::Array<int> sizes;
+        
+        for (auto& token : juce::StringArray::fromTokens(args.getValueForOption("--drones"), ",", ""))
+            if (token.getIntValue() > 0)
+                sizes.add(token.getIntValue());
+        
+        if (!sizes.isEmpty())
+        {
+            options.numDrones = sizes.getFirst();
+            options.loopbackSwarmSizes = sizes;
+        }
+    }
+    
+    if (args.containsOption("--trail-length"))
+        options.trailLength = juce::jlimit(0, SwarmTrailHistory::MAX_LENGTH,
+                                           args.getValueForOption("--trail-length").getIntValue());
+    
+    // --sim-rate=25..500 [--sub-steps=N]
+    if (args.containsOption("--sim-rate"))
+        options.stepRate = juce::jlimit(SwarmSimulation::MIN_STEP_RATE, SwarmSimulation::MAX_STEP_RATE,
+                                        args.getValueForOption("--sim-rate").getDoubleValue());
+    
+    if (args.containsOption("--sub-steps"))
+        options.numSubSteps = juce::jlimit(1, SwarmSimulation::MAX_SUB_STEPS,
+                                           args.getValueForOption("--sub-steps").getIntValue());
+    
+    options.enableSynth = !args.containsOption("--no-synth");
+    options.useAudioClock = args.containsOption("--audio-clock");
+    
+    // --pipeline: step physics while the previous step is sent and handed over, one step later
+    options.pipelineSteps = args.containsOption("--pipeline");
+    
+    // --record-automation=take.csv, --replay-automation=take.csv (also with --render-wav)
+    if (args.containsOption("--record-automation"))
+        options.recordAutomationFile = juce::File::getCurrentWorkingDirectory()
+                                           .getChildFile(args.getValueForOption("--record-automation").unquoted());
+    
+    if (args.containsOption("--replay-automation"))
+        options.replayAutomationFile = juce::File::getCurrentWorkingDirectory()
+                                           .getChildFile(args.getValueForOption("--replay-automation").unquoted());
+    
+    // --choreography="Group Waves" or --choreography=3 (also with --render-wav and --render-frames)
+    if (args.containsOption("--choreography"))
+    {
+        auto value = args.getValueForOption("--choreography").unquoted();
+        juce::StringArray names;
+        
+        for (auto& name : SwarmChoreography::getChoreographyTypes())
+            names.add(name);
+        
+        auto index = names.indexOf(value, true);
+        options.choreography = index >= 0 ? index : juce::jlimit(0, names.size() - 1, value.getIntValue());
+    }
+    
+    // --shader-cache=DIR or --no-shader-cache
+    if (args.containsOption("--shader-cache"))
+        options.shaderCacheDirectory = juce::File::getCurrentWorkingDirectory()
+                                           .getChildFile(args.getValueForOption("--shader-cache").unquoted());
+    
+    if (args.containsOption("--no-shader-cache"))
+        options.shaderCacheDirectory = juce::File();
+    
+    // --gpu-physics-check [--drones=4096] [--seconds=5]
+    options.runGpuPhysicsCheck = args.containsOption("--gpu-physics-check");
+    
+    // --software-render: skip OpenGL and rasterise the swarm on the CPU
+    options.useSoftwareRenderer = args.containsOption("--software-render");
+    
+    // --fixed-quality: always draw and simulate at full quality, however late frames run
+    options.adaptiveQuality = !args.containsOption("--fixed-quality");
+    
+    // --heap-report: every few seconds, log heap calls per step and per GL frame
+    options.reportHeapCalls = args.containsOption("--heap-report");
+    
+    // --rt-check[=locks]: record heap calls (and locks) made while stepping, sending or rendering audio
+    options.realtimeCheck = args.containsOption("--rt-check");
+    options.realtimeCheckLocks = args.getValueForOption("--rt-check") == "locks";
+    
+    // --automation-check: record a run with a mid-run change, replay it and compare ticks
+    options.runAutomationCheck = args.containsOption("--automation-check");
+    
+    // --midi-loopback [--drones=8,64,512] [--seconds=5]
+    options.runMidiLoopback = args.containsOption("--midi-loopback");
+    
+    // --render-wav=out.wav [--drones=64] [--seconds=5] [--sample-rate=48000]
+    if (args.containsOption("--render-wav"))
+        options.renderWavFile = juce::File::getCurrentWorkingDirectory()
+                                    .getChildFile(args.getValueForOption("--render-wav").unquoted());
+    
+    // --render-frames=DIR [--frame-size=1280x720] [--frame-format=png|raw] [--drones=64] [--seconds=5]
+    if (args.containsOption("--render-frames"))
+        options.renderFramesDirectory = juce::File::getCurrentWorkingDirectory()
+                                            .getChildFile(args.getValueForOption("--render-frames").unquoted());
+    
+    if (args.containsOption("--frame-size"))
+    {
+        auto size = args.getValueForOption("--frame-size");
+        options.frameWidth = juce::jlimit(16, 8192, size.upToFirstOccurrenceOf("x", false, true).getIntValue());
+        options.frameHeight = juce::jlimit(16, 8192, size.fromFirstOccurrenceOf("x", false, true).getIntValue());
+    }
+    
+    if (args.getValueForOption("--frame-format") == "raw")
+        options.frameFormat = SwarmFrameSequenceRenderer::Format::raw;
+    
+    if (args.containsOption("--sample-rate"))
+        options.renderSampleRate = juce::jlimit(8000.0, 192000.0,
+                                                args.getValueForOption("--sample-rate").getDoubleValue());
+    
+    if (args.containsOption("--seconds"))
+        options.durationSeconds = juce::jmax(0.5, args.getValueForOption("--seconds").getDoubleValue());
+    
+    return options;
+}
+
 //==============================================================================
 // DroneSwarmApp implementation
 
@@ -65,13 +217,128 @@ const juce::String DroneSwarmApp::getApplicationVersion()
 
 void DroneSwarmApp::initialise(const juce::String& commandLine)
 {
+    launchOptions = SwarmLaunchOptions::fromCommandLine(commandLine);
+    
+    // Without the allocator replacements there is nothing to count, and a check would pass on nothing
+    if ((launchOptions.reportHeapCalls || launchOptions.realtimeCheck) && ! SwarmHeapCounter::isCounting)
+    {
+        runHeadless([]
+        {
+            juce::Logger::writeToLog("--heap-report and --rt-check need a build with DRONESWARM_HEAP_CHECK=1");
+            return 1;
+        });
+        return;
+    }
+    
+    if (launchOptions.realtimeCheck)
+        SwarmRealtimeCheck::enable(launchOptions.realtimeCheckLocks);
+    
+    // Headless modes run without a window and quit when done
+    if (launchOptions.runAutomationCheck)
+    {
+        runHeadless([]
+        {
+            juce::String report;
+            auto passed = SwarmSimulation::runAutomationCheck(report);
+            juce::Logger::writeToLog(report);
+            return passed ? 0 : 1;
+        });
+        return;
+    }
+    
+    if (launchOptions.runMidiLoopback)
+    {
+        runHeadless([options = launchOptions]
+        {
+            MidiLoopbackHarness::Settings settings;
+            settings.swarmSizes = options.loopbackSwarmSizes;
+            settings.secondsPerRun = options.durationSeconds;
+            
+            MidiLoopbackHarness harness(settings);
+            juce::String report;
+            
+            if (!harness.run(report))
+                return 1;
+            
+            juce::Logger::writeToLog(report);
+            return SwarmRealtimeCheck::getNumViolations() > 0 ? 1 : 0;
+        });
+        return;
+    }
+    
+    if (launchOptions.renderWavFile != juce::File())
+    {
+        runHeadless([options = launchOptions]
+        {
+            SwarmOfflineRenderer::Settings settings;
+            settings.outputFile = options.renderWavFile;
+            settings.numDrones = options.numDrones;
+            settings.sampleRate = options.renderSampleRate;
+            settings.seconds = options.durationSeconds;
+            settings.stepRate = options.stepRate;
+            settings.numSubSteps = options.numSubSteps;
+            settings.automationFile = options.replayAutomationFile;
+            settings.choreography = options.choreography;
+            
+            SwarmOfflineRenderer renderer(settings);
+            juce::String report;
+            
+            auto ok = renderer.run(report);
+            juce::Logger::writeToLog(report);
+            return ok && SwarmRealtimeCheck::getNumViolations() == 0 ? 0 : 1;
+        });
+        return;
+    }
+    
+    if (launchOptions.renderFramesDirectory != juce::File())
+    {
+        SwarmFrameSequenceRenderer::Settings settings;
+        settings.outputDirectory = launchOptions.renderFramesDirectory;
+        settings.numDrones = launchOptions.numDrones;
+        settings.width = launchOptions.frameWidth;
+        settings.height = launchOptions.frameHeight;
+        settings.seconds = launchOptions.durationSeconds;
+        settings.trailLength = launchOptions.trailLength;
+        settings.format = launchOptions.frameFormat;
+        settings.automationFile = launchOptions.replayAutomationFile;
+        settings.choreography = launchOptions.choreography;
+        
+        // With no display there is no GL context to be had, so the CPU draws the frames
+        if (launchOptions.useSoftwareRenderer || juce::Desktop::getInstance().getDisplays().getPrimaryDisplay() == nullptr)
+        {
+            runHeadless([settings]
+            {
+                SwarmFrameSequenceRenderer renderer(settings);
+                juce::String report;
+                
+                auto ok = renderer.runSoftware(report);
+                juce::Logger::writeToLog(report);
+                return ok ? 0 : 1;
+            });
+            return;
+        }
+        
+        auto* host = new SwarmFrameSequenceHost(settings, launchOptions.shaderCacheDirectory, [this](bool ok)
+        {
+            setApplicationReturnValue(ok ? 0 : 1);
+            quit();
+        });
+        
+        // The GL context needs a window, but a tiny one will do
+        mainWindow.reset(new juce::DocumentWindow(getApplicationName(), juce::Colours::black, 0));
+        mainWindow->setUsingNativeTitleBar(true);
+        mainWindow->setContentOwned(host, true);
+        mainWindow->setVisible(true);
+        return;
+    }
+    
     // Create main window
     mainWindow.reset(new juce::DocumentWindow(getApplicationName(),
                                               juce::Colours::darkgrey,
                                               juce::DocumentWindow::allButtons));
     
     mainWindow->setUsingNativeTitleBar(true);
-    mainWindow->setContentOwned(new MainComponent(), true);
+    mainWindow->setContentOwned(new MainComponent(launchOptions), true);
     mainWindow->centreWithSize(900, 700);
     mainWindow->setVisible(true);
 }
@@ -91,16 +358,43 @@ void DroneSwarmApp::anotherInstanceStarted(const juce::String& commandLine)
     // Not handling multiple instances
 }
 
+void DroneSwarmApp::runHeadless(std::function<int()> task)
+{
+    // Keep the message loop free so MIDI and timer callbacks still get through
+    juce::Thread::launch([this, task = std::move(task)]
+    {
+        auto result = task();
+        
+        juce::MessageManager::callAsync([this, result]
+        {
+            setApplicationReturnValue(result);
+            quit();
+        });
+    });
+}
+
 //==============================================================================
 // MainComponent implementation
 
-MainComponent::MainComponent()
+MainComponent::MainComponent(const SwarmLaunchOptions& options)
+    : launchOptions(options)
 {
-    // Set up OpenGL rendering
+    // Set up OpenGL rendering. It only covers the scene, so the controls are painted
+    // normally instead of being composited over every GL frame, and frames are only
+    // drawn when there is something new to show.
+    addAndMakeVisible(sceneView);
+    sceneView.setInterceptsMouseClicks(false, false);
+    sceneView.onPaint = [this](juce::Graphics& g) { paintScene(g); };
+    
     openGLContext.setRenderer(this);
-    openGLContext.setComponentPaintingEnabled(true);
-    openGLContext.setContinuousRepainting(true);
-    openGLContext.attachTo(*this);
+    openGLContext.setOpenGLVersionRequired(juce::OpenGLContext::openGL3_2);
+    openGLContext.setComponentPaintingEnabled(false);
+    openGLContext.setContinuousRepainting(false);
+    
+    if (!launchOptions.useSoftwareRenderer)
+        openGLContext.attachTo(sceneView);
+    
+    openGLAttachTimeMs = juce::Time::getMillisecondCounter();
     
     // Make component visible and set size
     setSize(900, 700);
@@ -114,77 +408,135 @@ MainComponent::MainComponent()
     addAndMakeVisible(formationSelector);
     formationSelector.addItemList(juce::StringArray(Formation::getFormationTypes().data(),
                                                    Formation::getFormationTypes().size()), 1);
-    formationSelector.setSelectedItemIndex(1); // Circle by default
     formationSelector.onChange = [this]() {
-        currentFormation = Formation::create(formationSelector.getText());
+        simulation.getParameters().set(SwarmParameterStore::formation,
+                                       static_cast<float>(formationSelector.getSelectedItemIndex()));
     };
     
     addAndMakeVisible(rhythmSelector);
     rhythmSelector.addItemList(juce::StringArray(RhythmPattern::getRhythmTypes().data(),
                                                 RhythmPattern::getRhythmTypes().size()), 1);
-    rhythmSelector.setSelectedItemIndex(0); // Continuous by default
     rhythmSelector.onChange = [this]() {
-        currentRhythm = RhythmPattern::create(rhythmSelector.getText());
+        simulation.getParameters().set(SwarmParameterStore::rhythm,
+                                       static_cast<float>(rhythmSelector.getSelectedItemIndex()));
     };
     
     addAndMakeVisible(scaleSelector);
     scaleSelector.addItemList(juce::StringArray(MusicScales::getScaleTypes().data(),
                                                MusicScales::getScaleTypes().size()), 1);
-    scaleSelector.setSelectedItemIndex(1); // Major by default
+    scaleSelector.onChange = [this]() {
+        simulation.getParameters().set(SwarmParameterStore::scale,
+                                       static_cast<float>(scaleSelector.getSelectedItemIndex()));
+    };
     
     addAndMakeVisible(chaosSlider);
     chaosSlider.setRange(0.0, 1.0, 0.01);
-    chaosSlider.setValue(chaosLevel, juce::dontSendNotification);
     chaosSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
-    chaosSlider.onValueChange = [this]() { chaosLevel = static_cast<float>(chaosSlider.getValue()); };
+    chaosSlider.onValueChange = [this]() {
+        simulation.getParameters().set(SwarmParameterStore::chaos, static_cast<float>(chaosSlider.getValue()));
+    };
     
     addAndMakeVisible(formationStrengthSlider);
     formationStrengthSlider.setRange(0.0, 1.0, 0.01);
-    formationStrengthSlider.setValue(formationStrength, juce::dontSendNotification);
     formationStrengthSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
     formationStrengthSlider.onValueChange = [this]() {
-        formationStrength = static_cast<float>(formationStrengthSlider.getValue());
+        simulation.getParameters().set(SwarmParameterStore::formationStrength,
+                                       static_cast<float>(formationStrengthSlider.getValue()));
     };
     
     addAndMakeVisible(rootNoteSlider);
     rootNoteSlider.setRange(36, 84, 1);
-    rootNoteSlider.setValue(60, juce::dontSendNotification); // Middle C by default
     rootNoteSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+    rootNoteSlider.onValueChange = [this]() {
+        simulation.getParameters().set(SwarmParameterStore::rootNote, static_cast<float>(rootNoteSlider.getValue()));
+    };
     
     addAndMakeVisible(trailsToggle);
     trailsToggle.setButtonText("Enable Trails");
     trailsToggle.setToggleState(enableTrails, juce::dontSendNotification);
-    trailsToggle.onClick = [this]() { enableTrails = trailsToggle.getToggleState(); };
+    trailsToggle.onClick = [this]()
+    {
+        enableTrails = trailsToggle.getToggleState();
+        publishRenderState();
+    };
+    
+    addAndMakeVisible(synthToggle);
+    synthToggle.setButtonText("Synth");
+    synthToggle.onClick = [this]() { setSynthEnabled(synthToggle.getToggleState()); };
     
     addAndMakeVisible(pauseButton);
     pauseButton.setButtonText("Pause");
     pauseButton.onClick = [this]() {
         paused = !paused;
         pauseButton.setButtonText(paused ? "Resume" : "Pause");
+        publishRenderState();
     };
     
     // Set up MIDI
     setupMidi();
     
-    // Create drones
-    for (int i = 0; i < DEFAULT_NUM_DRONES; ++i)
+    // Optional OSC state stream for visual and lighting systems
+    if (launchOptions.oscOutPort > 0)
     {
-        auto colour = juce::Colour::fromHSV(static_cast<float>(i) / DEFAULT_NUM_DRONES, 1.0f, 1.0f, 1.0f);
-        drones.push_back(std::make_unique<SwarmDrone>(i, colour));
+        OscStateSender::Settings oscSettings;
+        oscSettings.host = launchOptions.oscOutHost;
+        oscSettings.port = launchOptions.oscOutPort;
+        oscSettings.maxPacketBytes = launchOptions.oscMaxPacketBytes;
+        oscSettings.mode = launchOptions.oscUseBlobs ? OscStateSender::Mode::quantisedBlob
+                                                     : OscStateSender::Mode::messages;
+        oscSender.start(oscSettings);
     }
     
-    // Initialize formation and rhythm patterns
-    currentFormation = Formation::create(formationSelector.getText());
-    currentRhythm = RhythmPattern::create(rhythmSelector.getText());
+    if (launchOptions.oscInPort > 0)
+        oscReceiver.start(launchOptions.oscInPort);
+    
+    simulation.setStepRate(launchOptions.stepRate);
+    simulation.setNumSubSteps(launchOptions.numSubSteps);
+    quality.setStepMilliseconds(1000.0 / simulation.getStepRate());
+    
+    // Trail history is allocated once, up front, and again only when the quality level changes it
+    simulation.setTrailLength(launchOptions.trailLength);
+    juce::Logger::writeToLog("Trail history: " + juce::String(launchOptions.numDrones) + " drones x "
+                             + juce::String(simulation.getTrails().getLength()) + " points, "
+                             + juce::String(simulation.getTrails().getMemoryBytes() / 1024.0, 1) + " KB");
+    
+    // Built-in synth, one voice per drone
+    setSynthEnabled(launchOptions.enableSynth);
+    
+    quality.setEnabled(launchOptions.adaptiveQuality);
+    
+    // Controls start from the simulation's settings (Circle, Continuous, C major)
+    syncControlsFromSimulation();
+    setupAutomation();
+    
+    // Nothing steps the simulation yet, so the choreography can start directly
+    if (launchOptions.choreography > 0)
+        simulation.getChoreography().play(launchOptions.choreography);
+    
+    snapshot.capture(simulation, enableTrails);
+    stepOutput.capture(simulation);
+    publishRenderState();
+    
+    if (launchOptions.useSoftwareRenderer)
+        fallBackToSoftware("Software rendering requested");
+    
+    buildStepGraph();
     
     // Start timer for animation updates
-    startTimerHz(1000 / UPDATE_INTERVAL_MS);
+    updateClockSource();
 }
 
 MainComponent::~MainComponent()
 {
     // Stop timer
     stopTimer();
+    oscSender.stop();
+    oscReceiver.stop();
+    setSynthEnabled(false);
+    saveRecordedAutomation();
+    
+    if (launchOptions.realtimeCheck)
+        juce::Logger::writeToLog(SwarmRealtimeCheck::createReport());
     
     // Clean up OpenGL
     openGLContext.detach();
@@ -192,6 +544,9 @@ MainComponent::~MainComponent()
     // Send all notes off
     if (midiOutput != nullptr)
     {
+        midiOutput->clearAllPendingMessages();
+        midiOutput->stopBackgroundThread();
+        
         for (int channel = 0; channel < 16; ++channel)
         {
             midiOutput->sendMessageNow(juce::MidiMessage::allNotesOff(channel + 1));
@@ -201,23 +556,79 @@ MainComponent::~MainComponent()
 
 void MainComponent::paint(juce::Graphics& g)
 {
-    // Fill the background
+    // Only the control strip shows through; the scene is sceneView's
     g.fillAll(juce::Colours::black);
+}
+
+void MainComponent::paintScene(juce::Graphics& g)
+{
+    // Rasterise at the display's own resolution, or less if the quality level says so,
+    // blended between steps as the GL view is
+    const auto startMs = juce::Time::getMillisecondCounterHiRes();
+    const auto bounds = sceneView.getLocalBounds();
+    const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor() * quality.getSettings().resolutionScale;
+    const int width = juce::roundToInt(static_cast<float>(bounds.getWidth()) * scale);
+    const int height = juce::roundToInt(static_cast<float>(bounds.getHeight()) * scale);
+    
+    if (softwareFrame.getWidth() != width || softwareFrame.getHeight() != height)
+        softwareFrame = juce::Image(juce::Image::ARGB, juce::jmax(1, width), juce::jmax(1, height), false,
+                                    juce::SoftwareImageType());
+    
+    SwarmScenePainter::View view;
+    auto alpha = softwareInterpolator.getAlpha(juce::Time::getMillisecondCounterHiRes());
+    softwareInterpolator.interpolate(alpha, softwareSnapshot, view);
+    softwareRenderer.render(softwareSnapshot, view, softwareSnapshot.newTrailPoint ? alpha : 1.0f, scale,
+                            softwareFrame);
+    softwareAnimating = alpha < 1.0f;
+    
+    g.drawImageTransformed(softwareFrame, juce::AffineTransform::scale(1.0f / scale));
+    quality.addPhaseTime(SwarmQualityController::render, juce::Time::getMillisecondCounterHiRes() - startMs);
     
     // Draw status information
     g.setColour(juce::Colours::white);
-    g.setFont(14.0f);
+    g.setFont(SwarmHudRenderer::FONT_HEIGHT);
+    g.drawText(juce::String::fromUTF8(statusText.data()), bounds.withHeight(SwarmHudRenderer::LINE_HEIGHT), juce::Justification::centred, true);
+}
+
+bool MainComponent::updateStatusText()
+{
+    StatusText text;
+    auto length = std::snprintf(text.data(), text.size(), "Formation: %s   Rhythm: %s   Frame: %d   %s",
+                                simulation.getFormationName().toRawUTF8(), simulation.getRhythmName().toRawUTF8(),
+                                simulation.getFrameCount(), paused ? "PAUSED" : "PLAYING");
+    
+    if (quality.getLevel() > 0 && juce::isPositiveAndBelow(length, static_cast<int>(text.size())))
+        std::snprintf(text.data() + length, text.size() - static_cast<size_t>(length),
+                      "   Quality: -%d", quality.getLevel());
+    
+    if (std::strcmp(text.data(), statusText.data()) == 0)
+        return false;
+    
+    statusText = text;
+    return true;
+}
+
+void MainComponent::fallBackToSoftware(const juce::String& reason)
+{
+    if (drawingInSoftware)
+        return;
     
-    juce::String statusText;
-    statusText << "Formation: " << currentFormation->getName() << "   "
-               << "Rhythm: " << currentRhythm->getName() << "   "
-               << "Frame: " << frameCount << "   "
-               << (paused ? "PAUSED" : "PLAYING");
+    juce::Logger::writeToLog(reason + ", drawing the swarm in software on "
+                             + juce::String(workers.getConcurrency()) + " threads");
+    openGLContext.detach();
+    drawingInSoftware = true;
+    quality.setRenderOnMessageThread(true);
     
-    g.drawText(statusText, getLocalBounds().removeFromTop(20), juce::Justification::centred, true);
+    // Repaint at display rate while there is still motion to interpolate
+    softwareVBlank = std::make_unique<juce::VBlankAttachment>(&sceneView, [this]
+    {
+        if (softwareAnimating)
+            sceneView.repaint();
+    });
     
-    // 3D rendering is handled by OpenGL
-    renderDrones(g);
+    // The rasteriser needs the trails the GPU would otherwise have kept
+    snapshot.capture(simulation, enableTrails);
+    publishRenderState();
 }
 
 void MainComponent::resized()
@@ -226,6 +637,7 @@ void MainComponent::resized()
     
     // Set up control panel at the bottom
     auto controlsArea = area.removeFromBottom(80).reduced(10);
+    sceneView.setBounds(area);
     
     auto row1 = controlsArea.removeFromTop(25);
     auto row2 = controlsArea.removeFromTop(25);
@@ -244,26 +656,338 @@ void MainComponent::resized()
     row2.removeFromLeft(10);
     trailsToggle.setBounds(row2.removeFromLeft(120));
     row2.removeFromLeft(10);
+    synthToggle.setBounds(row2.removeFromLeft(80));
+    row2.removeFromLeft(10);
     pauseButton.setBounds(row2.removeFromLeft(80));
 }
 
 void MainComponent::timerCallback()
 {
+    // Apply control changes that arrived since the last frame
+    simulation.processCommands();
+    
+    if (simulation.consumeExternalChanges())
+        syncControlsFromSimulation();
+    
+    // Settings can still change while paused, and the status line shows them
+    if (paused && updateStatusText())
+        publishRenderState();
+    
+    if (!openGLStarted && !drawingInSoftware
+        && juce::Time::getMillisecondCounter() - openGLAttachTimeMs > OPENGL_START_TIMEOUT_MS)
+        fallBackToSoftware("No OpenGL context");
+    
+    // Move captured automation out of the simulation's ring buffer before it fills
+    automationRecorder.drain([this](const SwarmAutomationEvent& event) { recordedAutomation.add(event); });
+    
+    if (audioClocked)
+    {
+        stepFromAudioClock();
+        return;
+    }
+    
     if (!paused)
     {
-        // Update animation
-        updateSwarm();
-        generateMidi();
-        frameCount++;
+        // The step just simulated is replayed over the next tick
+        auto now = juce::Time::getMillisecondCounterHiRes();
+        advanceSimulation(now, synthRunning ? synth.getSampleTimeForMillisecondCounter(now) : 0);
+    }
+}
+
+void MainComponent::updateClockSource()
+{
+    audioClocked = launchOptions.useAudioClock && synthRunning;
+    
+    if (audioClocked)
+    {
+        // Poll the audio clock often and step whenever it crosses a step boundary
+        audioClockGeneration = synth.getClockGeneration();
+        stepClock.reset(synth.getSampleRate(), simulation.getStepSeconds(),
+                        synth.getSampleTimeForMillisecondCounter(juce::Time::getMillisecondCounterHiRes()));
+        startTimerHz(juce::jmax(AUDIO_CLOCK_POLL_HZ, juce::roundToInt(simulation.getStepRate())));
+    }
+    else
+    {
+        if (launchOptions.useAudioClock)
+            juce::Logger::writeToLog("No audio clock without the synth, stepping on the UI timer");
+        
+        startTimerHz(juce::roundToInt(simulation.getStepRate()));
+    }
+}
+
+void MainComponent::stepFromAudioClock()
+{
+    // A device restart resets the sample counter, so start a new schedule from there
+    if (synth.getClockGeneration() != audioClockGeneration)
+    {
+        updateClockSource();
+        return;
+    }
+    
+    auto now = synth.getSampleTimeForMillisecondCounter(juce::Time::getMillisecondCounterHiRes());
+    
+    if (paused)
+    {
+        stepClock.resync(now);
+        return;
+    }
+    
+    int numSteps = 0;
+    
+    while (stepClock.isStepDue(now) && numSteps < MAX_CATCH_UP_STEPS)
+    {
+        auto playbackStart = stepClock.getPlaybackStart();
+        advanceSimulation(synth.getMillisecondCounterForSampleTime(playbackStart), playbackStart);
+        stepClock.advance();
+        ++numSteps;
+    }
+    
+    // After a long stall, skip ahead rather than play the backlog in a burst
+    if (stepClock.isStepDue(now))
+        stepClock.resync(now);
+}
+
+void MainComponent::advanceSimulation(double playbackStartMs, juce::int64 playbackStartSample)
+{
+    // Whatever step is sent and handed over this time plays from here
+    snapshotTimeMs = playbackStartMs;
+    outputStartSample = playbackStartSample;
+    stepJobHeapCalls = 0;
+    
+    // The message thread waits here, so the jobs may use its state while they run.
+    // Its share is that wait, not the sum of the jobs, which the pool may overlap.
+    const auto graphStartMs = juce::Time::getMillisecondCounterHiRes();
+    stepGraph.run(workers);
+    const auto outputStartMs = juce::Time::getMillisecondCounterHiRes();
+    
+    // The view, the status text and the renderers' copies are only touched here, on the message thread
+    const auto heapCallsBefore = SwarmHeapCounter::getThreadCount();
+    
+    if (launchOptions.pipelineSteps)
+    {
+        // The step just sent is still latched: hand it over before latching the next one
+        handOverRenderState();
+        latchStep();
+        advanceView();
+    }
+    else
+    {
+        advanceView();
+        handOverRenderState();
+    }
+    
+    requestRender();
+    stepJobHeapCalls += SwarmHeapCounter::getThreadCount() - heapCallsBefore;
+    
+    quality.addPhaseTime(SwarmQualityController::graphWait, outputStartMs - graphStartMs);
+    quality.addPhaseTime(SwarmQualityController::output, juce::Time::getMillisecondCounterHiRes() - outputStartMs);
+    
+    if (launchOptions.reportHeapCalls || launchOptions.realtimeCheck)
+        reportInstrumentation(stepJobHeapCalls.load());
+    
+    // Cuts take effect from the next step
+    if (quality.endStep())
+        applyQualitySettings();
+}
+
+void MainComponent::buildStepGraph()
+{
+    // Jobs run on whichever thread picks them up, so each counts its own heap calls
+    auto addJob = [this](const juce::String& name, std::function<void()> work)
+    {
+        return stepGraph.addJob(name, [this, work = std::move(work)]
+        {
+            const auto heapCallsBefore = SwarmHeapCounter::getThreadCount();
+            work();
+            stepJobHeapCalls += SwarmHeapCounter::getThreadCount() - heapCallsBefore;
+        });
+    };
+    
+    auto stepPhysics = [this]
+    {
+        const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::simulation);
+        simulation.step();
+    };
+    
+    stepGraph.clear();
+    
+    if (launchOptions.pipelineSteps)
+    {
+        // Step N's physics only needs step N-1 latched, which the last run finished with;
+        // sending that can go alongside. advanceSimulation() latches once both are done,
+        // so everything plays a step later.
+        outputJob = addJob("output", [this] { emitStepOutput(); });
+        physicsJob = addJob("physics", stepPhysics);
+        latchJob = -1;
+    }
+    else
+    {
+        physicsJob = addJob("physics", stepPhysics);
+        latchJob = addJob("latch", [this] { latchStep(); });
+        outputJob = addJob("output", [this] { emitStepOutput(); });
+        stepGraph.addDependency(latchJob, physicsJob);
+        stepGraph.addDependency(outputJob, latchJob);
+    }
+    
+    juce::Logger::writeToLog(juce::String("Step graph: ") + (launchOptions.pipelineSteps ? "pipelined" : "sequential")
+                             + ", " + juce::String(juce::jmin(workers.getConcurrency(), stepGraph.getWidth()))
+                             + " threads");
+}
+    
+void MainComponent::latchStep()
+{
+    // Writes snapshot and stepOutput, which the message thread owns: only from inside the step
+    // graph, while the message thread waits for it, or from the message thread itself
+    jassert(stepGraph.isRunning() || juce::MessageManager::existsAndIsCurrentThread());
+    
+    // Unless the scene is painted in software, the GPU keeps its own trail history
+    snapshot.capture(simulation, enableTrails && drawingInSoftware);
+    stepOutput.capture(simulation);
+}
+    
+void MainComponent::advanceView()
+{
+    updateStatusText();
+    
+    // Rotate view slightly (0.005 per 40 ms step)
+    rotationAngle += ROTATION_SPEED * static_cast<float>(simulation.getStepSeconds());
+    if (rotationAngle > juce::MathConstants<float>::twoPi)
+        rotationAngle -= juce::MathConstants<float>::twoPi;
+}
+    
+void MainComponent::emitStepOutput()
+{
+    // Uses the message thread's outputs; it only runs in the step graph, while that thread waits
+    jassert(stepGraph.isRunning());
+    
+    const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::output);
+    
+    if (midiOutput != nullptr)
+        sendNoteEvents(stepOutput, snapshotTimeMs);
+    
+    postSynthEvents(stepOutput, outputStartSample);
+    oscSender.pushFrame(stepOutput.getDrones(), stepOutput.getFrameNumber());
+}
+
+void MainComponent::applyQualitySettings()
+{
+    auto& settings = quality.getSettings();
+    
+    // A new trail length starts the trails over, so it is only set when it changes
+    auto trailLength = juce::roundToInt(static_cast<float>(launchOptions.trailLength) * settings.trailScale);
+    
+    if (trailLength != simulation.getTrails().getLength())
+        simulation.setTrailLength(trailLength);
+    
+    simulation.setNoteCheckInterval(settings.noteCheckInterval);
+    simulation.setNeighbourRadiusScale(settings.neighbourRadiusScale);
+    
+    // LOD distances and resolution go to the renderers with the next frame
+    publishRenderState();
+}
+
+void MainComponent::reportInstrumentation(juce::int64 heapCallsThisStep)
+{
+    stepHeapCalls += heapCallsThisStep;
+    
+    if (++heapReportSteps < juce::roundToInt(HEAP_REPORT_SECONDS / simulation.getStepSeconds()))
+        return;
+    
+    // Logging allocates too, but only after the counts for this period are in
+    auto frames = heapReportFrames.exchange(0);
+    auto frameCalls = frameHeapCalls.exchange(0);
+    auto& arena = simulation.getStepArena();
+    
+    if (launchOptions.reportHeapCalls)
+        juce::Logger::writeToLog("Heap calls: " + juce::String(static_cast<double>(stepHeapCalls) / heapReportSteps, 2)
+                             + " per step, " + (frames > 0 ? juce::String(static_cast<double>(frameCalls) / frames, 2)
+                                                           : juce::String("-"))
+                             + " per GL frame; step arena " + juce::String(static_cast<juce::int64>(arena.getHighWaterMark()))
+                             + " of " + juce::String(static_cast<juce::int64>(arena.getCapacity()))
+                             + " bytes, grown " + juce::String(arena.getNumGrowths()) + " times");
+    
+    // Violations are summed up here as they appear; their backtraces are logged on quit
+    if (launchOptions.realtimeCheck && SwarmRealtimeCheck::getNumViolations() != loggedViolations)
+    {
+        loggedViolations = SwarmRealtimeCheck::getNumViolations();
+        juce::Logger::writeToLog("Real-time check: " + juce::String(loggedViolations)
+                                 + " heap calls or locks on real-time threads so far");
+    }
+    
+    juce::Logger::writeToLog(measureMemory().toString());
+    stepHeapCalls = 0;
+    heapReportSteps = 0;
+}
+
+SwarmMemoryReport MainComponent::measureMemory()
+{
+    SwarmMemoryReport report;
+    report.add(SwarmMemoryReport::drones, simulation.getDroneBytes());
+    report.add(SwarmMemoryReport::trails, simulation.getTrails().getMemoryBytes());
+    report.add(SwarmMemoryReport::notes, simulation.getNoteBytes());
+    
+    // The GL thread's four copies (its incoming frame, its blend and the two it blends)
+    // are swapped with renderSnapshot, so they hold about as much as it does
+    size_t renderSnapshotBytes = 0;
+    
+    {
+        const juce::SpinLock::ScopedLockType lock(renderLock);
+        renderSnapshotBytes = renderSnapshot.getMemoryBytes();
+    }
+    
+    report.add(SwarmMemoryReport::snapshots, snapshot.getMemoryBytes() + 5 * renderSnapshotBytes
+                                               + softwareIncoming.getMemoryBytes() + softwareSnapshot.getMemoryBytes()
+                                               + softwareInterpolator.getMemoryBytes());
+    
+    report.add(SwarmMemoryReport::glBuffers, droneRenderer.getGpuBytes() + trailRenderer.getGpuBytes()
+                                               + hudRenderer.getGpuBytes() + sceneTarget.getGpuBytes());
+    report.add(SwarmMemoryReport::midiBuffers, static_cast<size_t>(frameMidi.data.size()) + synth.getQueueBytes());
+    return report;
+}
+
+void MainComponent::publishRenderState()
+{
+    updateStatusText();
+    handOverRenderState();
+    requestRender();
+}
+    
+void MainComponent::handOverRenderState()
+{
+    // Never from the step graph: the renderers' copies are only written here
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    if (drawingInSoftware)
+    {
+        SwarmScenePainter::View view;
+        view.rotationAngle = rotationAngle;
+        view.zoomLevel = zoomLevel;
+        view.showTrails = enableTrails;
         
-        // Rotate view slightly
-        rotationAngle += 0.005f;
-        if (rotationAngle > juce::MathConstants<float>::twoPi)
-            rotationAngle -= juce::MathConstants<float>::twoPi;
+        softwareIncoming = snapshot;
+        softwareInterpolator.push(softwareIncoming, view, snapshotTimeMs);
+        return;
     }
     
-    // Trigger a repaint
-    repaint();
+    // The GL thread only holds the lock for a swap, so copying under it is fine
+    const juce::SpinLock::ScopedLockType lock(renderLock);
+    renderSnapshot = snapshot;
+    renderSnapshotTimeMs = snapshotTimeMs;
+    renderStatusText = statusText;
+    renderSnapshotFresh = true;
+    renderView.rotationAngle = rotationAngle;
+    renderView.zoomLevel = zoomLevel;
+    renderView.showTrails = enableTrails;
+    renderQuality = quality.getSettings();
+}
+    
+void MainComponent::requestRender()
+{
+    // Message-thread only; GL frames are only drawn when something changed
+    if (drawingInSoftware)
+        sceneView.repaint();
+    else
+        openGLContext.triggerRepaint();
 }
 
 void MainComponent::handleIncomingMidiMessage(juce::MidiInput* source, const juce::MidiMessage& message)
@@ -292,6 +1016,7 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
     {
         paused = !paused;
         pauseButton.setButtonText(paused ? "Resume" : "Pause");
+        publishRenderState();
         return true;
     }
     
@@ -299,43 +1024,36 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
     if (key.isKeyCode('1'))
     {
         formationSelector.setSelectedItemIndex(0); // Free
-        currentFormation = Formation::create("Free");
         return true;
     }
     else if (key.isKeyCode('2'))
     {
         formationSelector.setSelectedItemIndex(1); // Circle
-        currentFormation = Formation::create("Circle");
         return true;
     }
     else if (key.isKeyCode('3'))
     {
         formationSelector.setSelectedItemIndex(2); // Spiral
-        currentFormation = Formation::create("Spiral");
         return true;
     }
     else if (key.isKeyCode('4'))
     {
         formationSelector.setSelectedItemIndex(3); // Grid
-        currentFormation = Formation::create("Grid");
         return true;
     }
     else if (key.isKeyCode('5'))
     {
         formationSelector.setSelectedItemIndex(4); // Wave
-        currentFormation = Formation::create("Wave");
         return true;
     }
     else if (key.isKeyCode('6'))
     {
         formationSelector.setSelectedItemIndex(5); // Flock
-        currentFormation = Formation::create("Flock");
         return true;
     }
     else if (key.isKeyCode('7'))
     {
         formationSelector.setSelectedItemIndex(6); // Custom
-        currentFormation = Formation::create("Custom");
         return true;
     }
     
@@ -343,37 +1061,31 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
     if (key.isKeyCode('q'))
     {
         rhythmSelector.setSelectedItemIndex(0); // Continuous
-        currentRhythm = RhythmPattern::create("Continuous");
         return true;
     }
     else if (key.isKeyCode('w'))
     {
         rhythmSelector.setSelectedItemIndex(1); // Alternating
-        currentRhythm = RhythmPattern::create("Alternating");
         return true;
     }
     else if (key.isKeyCode('e'))
     {
         rhythmSelector.setSelectedItemIndex(2); // Sequential
-        currentRhythm = RhythmPattern::create("Sequential");
         return true;
     }
     else if (key.isKeyCode('r'))
     {
         rhythmSelector.setSelectedItemIndex(3); // Wave
-        currentRhythm = RhythmPattern::create("Wave");
         return true;
     }
     else if (key.isKeyCode('t'))
     {
         rhythmSelector.setSelectedItemIndex(4); // Random
-        currentRhythm = RhythmPattern::create("Random");
         return true;
     }
     else if (key.isKeyCode('y'))
     {
         rhythmSelector.setSelectedItemIndex(5); // Polyrhythm
-        currentRhythm = RhythmPattern::create("Polyrhythm");
         return true;
     }
     
@@ -381,11 +1093,13 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
     if (key.isKeyCode(juce::KeyPress::upKey))
     {
         zoomLevel *= 1.1f;
+        publishRenderState();
         return true;
     }
     else if (key.isKeyCode(juce::KeyPress::downKey))
     {
         zoomLevel *= 0.9f;
+        publishRenderState();
         return true;
     }
     
@@ -407,114 +1121,128 @@ void MainComponent::mouseWheelMove(const juce::MouseEvent& e, const juce::MouseW
     // Zoom in/out with mouse wheel
     zoomLevel += wheel.deltaY;
     zoomLevel = juce::jlimit(0.1f, 5.0f, zoomLevel);
-    repaint();
+    publishRenderState();
 }
 
-void MainComponent::updateSwarm()
+void MainComponent::syncControlsFromSimulation()
 {
-    // Update formation targets
-    updateFormationTargets();
-    
-    // Update all drones
-    for (auto& drone : drones)
-    {
-        drone->update(chaosLevel, formationStrength);
+    // Commands from OSC, automation and other threads change settings behind the UI's back
+    auto& parameters = simulation.getParameters();
+    
+    chaosSlider.setValue(parameters.get(SwarmParameterStore::chaos), juce::dontSendNotification);
+    formationStrengthSlider.setValue(parameters.get(SwarmParameterStore::formationStrength), juce::dontSendNotification);
+    formationSelector.setSelectedItemIndex(parameters.getInt(SwarmParameterStore::formation), juce::dontSendNotification);
+    rhythmSelector.setSelectedItemIndex(parameters.getInt(SwarmParameterStore::rhythm), juce::dontSendNotification);
+    scaleSelector.setSelectedItemIndex(parameters.getInt(SwarmParameterStore::scale), juce::dontSendNotification);
+    rootNoteSlider.setValue(parameters.get(SwarmParameterStore::rootNote), juce::dontSendNotification);
+}
+
+void MainComponent::setupAutomation()
+{
+    if (launchOptions.replayAutomationFile != juce::File())
+    {
+        juce::String error;
+        
+        if (replayedAutomation.loadFromFile(launchOptions.replayAutomationFile, error))
+            simulation.setAutomationReplay(&replayedAutomation);
+        else
+            juce::Logger::writeToLog(error);
+    }
+    
+    if (launchOptions.recordAutomationFile != juce::File())
+    {
+        // Start the take from the full current state so it replays from any starting point
+        for (int i = 0; i < SwarmParameterStore::numParameters; ++i)
+        {
+            auto id = static_cast<SwarmParameterStore::Id>(i);
+            recordedAutomation.add({ simulation.getTick(), id, simulation.getParameters().get(id) });
+        }
+        
+        simulation.setAutomationRecorder(&automationRecorder);
     }
 }
 
-void MainComponent::generateMidi()
+void MainComponent::saveRecordedAutomation()
 {
-    if (midiOutput == nullptr)
+    if (launchOptions.recordAutomationFile == juce::File())
         return;
     
-    // Only process MIDI at intervals to reduce CPU load
-    if (frameCount % NOTE_CHECK_INTERVAL != 0)
+    simulation.setAutomationRecorder(nullptr);
+    automationRecorder.drain([this](const SwarmAutomationEvent& event) { recordedAutomation.add(event); });
+    
+    if (automationRecorder.getNumDroppedEvents() > 0)
+        juce::Logger::writeToLog("Automation capture dropped " + juce::String(automationRecorder.getNumDroppedEvents())
+                                 + " parameter changes");
+    
+    if (!recordedAutomation.saveToFile(launchOptions.recordAutomationFile))
+        juce::Logger::writeToLog("Could not write " + launchOptions.recordAutomationFile.getFullPathName());
+}
+
+void MainComponent::sendNoteEvents(const SwarmStepOutput& output, double playbackStartMs)
+{
+    auto& noteEvents = output.getNoteEvents();
+    
+    if (noteEvents.empty())
         return;
     
-    // Get the active rhythm pattern
-    auto activePattern = currentRhythm->calculateActiveNotes(static_cast<int>(drones.size()), frameCount);
+    // Positions are microseconds into the step
+    constexpr double positionsPerSecond = 1000000.0;
+    const double stepMicros = output.getStepSeconds() * 1000000.0;
     
-    // Get current musical scale notes
-    MusicScales musicScales;
-    int rootNote = static_cast<int>(rootNoteSlider.getValue());
-    auto scaleNotes = musicScales.getScaleNotes(scaleSelector.getText(), rootNote);
+    frameMidi.clear();
     
-    // Process each drone
-    for (size_t i = 0; i < drones.size(); ++i)
+    for (auto& event : noteEvents)
+        frameMidi.addEvent(event.toMidiMessage(), juce::roundToInt(event.stepFraction * stepMicros));
+    
+    // Replaying the step from playbackStartMs keeps each crossing's exact offset inside
+    // the step. On the audio clock that is the next step's slot, a constant step of
+    // latency; on the timer it is when the timer fired, so there is no added latency
+    // but the start moves with the timer's jitter
+    midiOutput->sendBlockOfMessages(frameMidi, playbackStartMs, positionsPerSecond);
+}
+
+void MainComponent::postSynthEvents(const SwarmStepOutput& output, juce::int64 playbackStartSample)
+{
+    if (!synthRunning || output.getNoteEvents().empty())
+        return;
+    
+    // Same start as the MIDI output, on the audio clock
+    auto stepSamples = synth.getSampleRate() * output.getStepSeconds();
+    
+    synth.postNoteEvents(output.getNoteEvents(), output.getDrones(), playbackStartSample, stepSamples);
+}
+
+void MainComponent::setSynthEnabled(bool shouldBeEnabled)
+{
+    if (shouldBeEnabled && !synthRunning)
     {
-        auto& drone = drones[i];
-        float speed = drone->velocity.length();
-        
-        // Only trigger notes if in the active pattern and moving fast enough
-        if (activePattern[i] && speed > 0.3f)
+        if (audioDeviceManager.getCurrentAudioDevice() == nullptr)
         {
-            // Map position to note
-            int noteIdx = static_cast<int>((drone->position.x + 15.0f) / 30.0f * scaleNotes.size());
-            noteIdx = juce::jlimit(0, static_cast<int>(scaleNotes.size()) - 1, noteIdx);
-            int note = scaleNotes[noteIdx];
-            
-            // Map Y position to velocity
-            int velocity = static_cast<int>(juce::jlimit(30, 100,
-                static_cast<int>((drone->position.y + 15.0f) / 30.0f * 70.0f + 30.0f)));
-            
-            // Map Z position to control parameters
-            int ccValue = static_cast<int>(juce::jlimit(0, 127,
-                static_cast<int>((drone->position.z + 15.0f) / 30.0f * 127.0f)));
-            
-            // MIDI channel for this drone
-            int channel = drone->midiChannel;
+            auto error = audioDeviceManager.initialiseWithDefaultDevices(0, 2);
             
-            // Only send new note if different from last
-            if (note != drone->currentNote)
+            if (error.isNotEmpty() || audioDeviceManager.getCurrentAudioDevice() == nullptr)
             {
-                // Send note off for previous note first
-                if (drone->noteActive && drone->currentNote > 0)
-                {
-                    midiOutput->sendMessageNow(juce::MidiMessage::noteOff(channel + 1, drone->currentNote, 0.0f));
-                    drone->noteActive = false;
-                }
-                
-                // Send new note
-                midiOutput->sendMessageNow(juce::MidiMessage::noteOn(channel + 1, note, static_cast<float>(velocity) / 127.0f));
-                drone->noteActive = true;
-                drone->currentNote = note;
-                
-                // Occasional controller messages
-                if (juce::Random::getSystemRandom().nextFloat() < 0.3f)
-                {
-                    midiOutput->sendMessageNow(juce::MidiMessage::controllerEvent(channel + 1, 1, ccValue));
-                }
-                
-                // Visual feedback - increase size when note triggers
-                drone->size = 150.0f;
-            }
-            else
-            {
-                drone->size = 100.0f;
+                juce::Logger::writeToLog("No audio output for the built-in synth: " + error);
+                shouldBeEnabled = false;
             }
         }
-        else
+        
+        if (shouldBeEnabled)
         {
-            // Turn off note when drone stops or rhythm pattern doesn't include it
-            if (drone->noteActive && drone->currentNote > 0)
-            {
-                midiOutput->sendMessageNow(juce::MidiMessage::noteOff(drone->midiChannel + 1, drone->currentNote, 0.0f));
-                drone->noteActive = false;
-                drone->currentNote = 0;
-            }
-            drone->size = 100.0f;
+            audioDeviceManager.addAudioCallback(&synth);
+            synthRunning = true;
         }
     }
-}
-
-void MainComponent::updateFormationTargets()
-{
-    // Update target positions based on current formation
-    if (currentFormation != nullptr)
+    else if (!shouldBeEnabled && synthRunning)
     {
-        float timeFactor = frameCount * 0.01f;
-        currentFormation->calculateTargets(drones, timeFactor);
+        audioDeviceManager.removeAudioCallback(&synth);
+        synthRunning = false;
     }
+    
+    synthToggle.setToggleState(synthRunning, juce::dontSendNotification);
+    
+    if (isTimerRunning())
+        updateClockSource();
 }
 
 void MainComponent::setupMidi()
@@ -522,21 +1250,43 @@ void MainComponent::setupMidi()
     // Set up MIDI output
     auto midiOutputs = juce::MidiOutput::getAvailableDevices();
     
-    if (midiOutputs.size() > 0)
+    // Headless boxes often have nothing to open, so publish our own port instead
+    if (launchOptions.useVirtualMidiOutput || midiOutputs.isEmpty())
+        midiOutput = createVirtualMidiOutput();
+    
+    if (midiOutput == nullptr && midiOutputs.size() > 0)
     {
-        // Use the first available MIDI output device
-        midiOutput = juce::MidiOutput::openDevice(midiOutputs[0].identifier);
+        // Use the requested device, or the first available one
+        auto device = midiOutputs[0];
+        
+        for (auto& candidate : midiOutputs)
+        {
+            if (launchOptions.midiOutputName.isNotEmpty()
+                && candidate.name.containsIgnoreCase(launchOptions.midiOutputName))
+            {
+                device = candidate;
+                break;
+            }
+        }
+        
+        midiOutput = juce::MidiOutput::openDevice(device.identifier);
         
         if (midiOutput)
         {
-            juce::Logger::writeToLog("Connected to MIDI output: " + midiOutputs[0].name);
+            juce::Logger::writeToLog("Connected to MIDI output: " + device.name);
         }
     }
-    else
+    
+    if (midiOutput == nullptr)
     {
         // No MIDI output devices available
         juce::Logger::writeToLog("No MIDI output devices available");
     }
+    else
+    {
+        // Note events are scheduled with sub-frame offsets
+        midiOutput->startBackgroundThread();
+    }
     
     // Optional: Set up MIDI input for future use
     auto midiInputs = juce::MidiInput::getAvailableDevices();
@@ -554,814 +1304,174 @@ void MainComponent::setupMidi()
     }
 }
 
-void MainComponent::renderDrones(juce::Graphics& g)
+std::unique_ptr<juce::MidiOutput> MainComponent::createVirtualMidiOutput()
 {
-    // In a real implementation, we would use OpenGL to render the 3D scene
-    // For simplicity, here we use a basic 2D approximation
+    std::unique_ptr<juce::MidiOutput> output;
     
-    // Center of the view
-    int centerX = getWidth() / 2;
-    int centerY = getHeight() / 2;
-    
-    // Render perspective
-    float fov = 500.0f * zoomLevel;
-    
-    // First render trails if enabled
-    if (enableTrails)
-        renderTrails(g);
-    
-    // Render drones as circles
-    for (auto& drone : drones)
-    {
-        // Apply rotation
-        float rotatedX = drone->position.x * std::cos(rotationAngle) - drone->position.z * std::sin(rotationAngle);
-        float rotatedZ = drone->position.x * std::sin(rotationAngle) + drone->position.z * std::cos(rotationAngle);
-        
-        // Perspective projection
-        float depth = 30.0f + rotatedZ;
-        if (depth <= 0.0f) depth = 0.1f;
-        
-        float screenX = centerX + (rotatedX * fov) / depth;
-        float screenY = centerY + (drone->position.y * fov) / depth;
-        
-        // Size based on depth
-        float size = (drone->size / depth) * zoomLevel;
-        
-        // Draw the drone
-        g.setColour(drone->colour);
-        g.fillEllipse(screenX - size/2, screenY - size/2, size, size);
-        
-        // Draw outline if note is active
-        if (drone->noteActive)
-        {
-            g.setColour(juce::Colours::white);
-            g.drawEllipse(screenX - size/2, screenY - size/2, size, size, 2.0f);
-        }
-    }
-}
-
-void MainComponent::renderTrails(juce::Graphics& g)
-{
-    // Center of the view
-    int centerX = getWidth() / 2;
-    int centerY = getHeight() / 2;
+   #if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+    // Shows up as an ALSA sequencer / CoreMIDI source other apps can subscribe to
+    output = juce::MidiOutput::createNewDevice("DroneSwarm Out");
+   #endif
     
-    // Render perspective
-    float fov = 500.0f * zoomLevel;
+    if (output != nullptr)
+        juce::Logger::writeToLog("Created virtual MIDI output: " + output->getName());
+    else
+        juce::Logger::writeToLog("Virtual MIDI outputs are not supported on this platform");
     
-    // Render each drone's trail
-    for (auto& drone : drones)
-    {
-        if (drone->trail.size() < 2)
-            continue;
-        
-        // Set trail color (semi-transparent version of drone color)
-        g.setColour(drone->colour.withAlpha(0.3f));
-        
-        // Create path for the trail
-        juce::Path trailPath;
-        bool firstPoint = true;
-        
-        for (const auto& pos : drone->trail)
-        {
-            // Apply rotation
-            float rotatedX = pos.x * std::cos(rotationAngle) - pos.z * std::sin(rotationAngle);
-            float rotatedZ = pos.x * std::sin(rotationAngle) + pos.z * std::cos(rotationAngle);
-            
-            // Perspective projection
-            float depth = 30.0f + rotatedZ;
-            if (depth <= 0.0f) depth = 0.1f;
-            
-            float screenX = centerX + (rotatedX * fov) / depth;
-            float screenY = centerY + (pos.y * fov) / depth;
-            
-            if (firstPoint)
-            {
-                trailPath.startNewSubPath(screenX, screenY);
-                firstPoint = false;
-            }
-            else
-            {
-                trailPath.lineTo(screenX, screenY);
-            }
-        }
-        
-        // Draw the trail
-        g.strokePath(trailPath, juce::PathStrokeType(1.0f));
-    }
+    return output;
 }
 
 //=====START=== modification 2025-05-15 >
 
 void MainComponent::newOpenGLContextCreated() 
 {
-    // Create geometry first
-    createGeometry();
-    
-    // Now create buffers
-    openGLContext.extensions.glGenBuffers(1, &vertexBuffer);
-    openGLContext.extensions.glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    openGLContext.extensions.glBufferData(GL_ARRAY_BUFFER,
-                                         vertices.size() * sizeof(Vertex),
-                                         vertices.data(),
-                                         GL_STATIC_DRAW);
-    
-    openGLContext.extensions.glGenBuffers(1, &indexBuffer);
-    openGLContext.extensions.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    openGLContext.extensions.glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                                         indices.size() * sizeof(GLuint),
-                                         indices.data(),
-                                         GL_STATIC_DRAW);
-}
-void MainComponent::renderOpenGL()
-{
-    // Clear background
-    juce::OpenGLHelpers::clear(juce::Colours::black);
+    // Start the GLSL programs first: from the binary cache they are ready at once,
+    // otherwise they may finish compiling in the background over the next frames
+    SwarmDroneRenderer::addPrograms(shaders);
+    SwarmTrailRenderer::addPrograms(shaders);
+    SwarmHudRenderer::addPrograms(shaders);
     
-    // Direct OpenGL calls juce::gl::GL_ARRAY_BUFFER
-    juce::gl::glViewport(0, 0, getWidth(), getHeight());
-    juce::gl::glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    juce::gl::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    juce::gl::glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, nullptr);
-    juce::gl::glBindBuffer(GL_ARRAY_BUFFER, 0);
-    juce::gl::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-}
-
-
-void MainComponent::openGLContextClosing()
-{
-    // Clean up buffers - use extensions
-    openGLContext.extensions.glDeleteBuffers(1, &vertexBuffer);
-    openGLContext.extensions.glDeleteBuffers(1, &indexBuffer);
-    vertexBuffer = 0;
-    indexBuffer = 0;
-}
-
-START_JUCE_APPLICATION( DroneSwarmApp);
-
-//=====START=== modification 2025-05-17 >
-//==============================================================================
-// SwarmDrone Implementation
-//==============================================================================
-
-SwarmDrone::SwarmDrone(int id, const juce::Colour& colour)
-    : droneId(id), colour(colour), rng(rd())
-{
-    // Initialize with random position
-    std::uniform_real_distribution<float> posDist(-10.0f, 10.0f);
-    position = juce::Vector3D<float>(posDist(rng), posDist(rng), posDist(rng));
+    if (launchOptions.runGpuPhysicsCheck)
+        SwarmGpuPhysics::addPrograms(shaders);
     
-    // Initialize with zero velocity
-    velocity = juce::Vector3D<float>(0.0f, 0.0f, 0.0f);
-    
-    // Set initial target to current position
-    targetPosition = position;
-    
-    // Assign MIDI channel (distribute across 1-16)
-    midiChannel = id % 16;
+    openGLStarted = true;
 }
-
-SwarmDrone::~SwarmDrone() = default;
-
-void SwarmDrone::update(float chaosLevel, float formationStrength)
-{
-    // Add current position to trail
-    trail.push_front(position);
-    if (trail.size() > MAX_TRAIL_LENGTH)
-        trail.pop_back();
-    
-    // Calculate vector to target
-    juce::Vector3D<float> toTarget = targetPosition - position;
-    float distanceToTarget = toTarget.length();
-    
-    // Normalize the direction if not zero
-    if (distanceToTarget > 0.001f)
-        toTarget = toTarget / distanceToTarget;
-    
-    // Apply force towards target based on formation strength
-    velocity += toTarget * (0.1f * formationStrength);
-    
-    // Add random movement (chaos)
-    std::normal_distribution<float> noiseDist(0.0f, chaosLevel * 0.05f);
-    velocity.x += noiseDist(rng);
-    velocity.y += noiseDist(rng);
-    velocity.z += noiseDist(rng);
-    
-    // Apply damping to prevent excessive speeds
-    velocity *= 0.95f;
-    
-    // Limit maximum velocity
-    float maxSpeed = 0.5f;
-    float currentSpeed = velocity.length();
-    if (currentSpeed > maxSpeed)
-        velocity = velocity * (maxSpeed / currentSpeed);
-    
-    // Update position
-    position += velocity;
-    
-    // Enforce boundaries
-    enforceBoundaries();
-}
-
-//==============================================================================
-// Formation Implementation
-//==============================================================================
-
-// Define concrete formation classes
-
-// Free formation - drones move randomly
-class FreeFormation : public Formation
+void MainComponent::renderOpenGL()
 {
-public:
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
-    {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<float> dist(-15.0f, 15.0f);
-        
-        for (auto& drone : drones)
-        {
-            // Occasionally change target to a new random position
-            if (std::rand() % 100 < 5)
-            {
-                drone->targetPosition = juce::Vector3D<float>(
-                    dist(gen), dist(gen), dist(gen)
-                );
-            }
-        }
-    }
+    const auto heapCallsBefore = SwarmHeapCounter::getThreadCount();
+    const auto startMs = juce::Time::getMillisecondCounterHiRes();
+    shaders.update();
     
-    juce::String getName() const override { return "Free"; }
-};
-
-// Circle formation
-class CircleFormation : public Formation
-{
-public:
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
-    {
-        int numDrones = static_cast<int>(drones.size());
-        float radius = 10.0f;
-        
-        for (int i = 0; i < numDrones; ++i)
-        {
-            float angle = (static_cast<float>(i) / numDrones) * juce::MathConstants<float>::twoPi;
-            
-            // Calculate position on the circle
-            float x = std::cos(angle) * radius;
-            float z = std::sin(angle) * radius;
-            
-            // Set the target with a slight Y offset based on index
-            drones[i]->targetPosition = juce::Vector3D<float>(
-                x,
-                (i % 2 == 0) ? 2.0f : -2.0f, // Alternate up/down
-                z
-            );
-        }
-    }
+    if (launchOptions.runGpuPhysicsCheck && !gpuPhysicsChecked && shaders.isFinished())
+        runGpuPhysicsCheck();
     
-    juce::String getName() const override { return "Circle"; }
-};
-
-// Spiral formation
-class SpiralFormation : public Formation
-{
-public:
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
-    {
-        int numDrones = static_cast<int>(drones.size());
-        float baseRadius = 5.0f;
-        float height = 12.0f;
-        
-        for (int i = 0; i < numDrones; ++i)
-        {
-            float t = static_cast<float>(i) / numDrones;
-            float angle = t * 4.0f * juce::MathConstants<float>::twoPi + timeFactor;
-            
-            // Calculate position on the spiral
-            float radius = baseRadius + t * 5.0f;
-            float x = std::cos(angle) * radius;
-            float y = height * (0.5f - t);
-            float z = std::sin(angle) * radius;
-            
-            drones[i]->targetPosition = juce::Vector3D<float>(x, y, z);
-        }
-    }
+    // Clear background
+    juce::OpenGLHelpers::clear(juce::Colours::black);
     
-    juce::String getName() const override { return "Spiral"; }
-};
-
-// Grid formation
-class GridFormation : public Formation
-{
-public:
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
+    const auto scale = static_cast<float>(openGLContext.getRenderingScale());
+    const auto bounds = sceneView.getLocalBounds();
+    const int width = juce::roundToInt(scale * bounds.getWidth());
+    const int height = juce::roundToInt(scale * bounds.getHeight());
+    juce::gl::glViewport(0, 0, width, height);
+    
+    // Take the newest frame if the message thread published one since the last render
     {
-        int numDrones = static_cast<int>(drones.size());
-        
-        // Calculate grid dimensions
-        int gridSize = static_cast<int>(std::ceil(std::sqrt(numDrones)));
-        float spacing = 5.0f;
-        float offset = spacing * (gridSize - 1) * 0.5f;
+        const juce::SpinLock::ScopedLockType lock(renderLock);
         
-        for (int i = 0; i < numDrones; ++i)
+        if (renderSnapshotFresh)
         {
-            int row = i / gridSize;
-            int col = i % gridSize;
-            
-            // Calculate grid position
-            float x = spacing * col - offset;
-            float z = spacing * row - offset;
-            
-            // Add some sinusoidal vertical movement
-            float y = 2.0f * std::sin(timeFactor + static_cast<float>(i) * 0.2f);
-            
-            drones[i]->targetPosition = juce::Vector3D<float>(x, y, z);
+            std::swap(glIncoming, renderSnapshot);
+            glInterpolator.push(glIncoming, renderView, renderSnapshotTimeMs);
+            glStatusText = renderStatusText;
+            glQuality = renderQuality;
+            renderSnapshotFresh = false;
         }
     }
     
-    juce::String getName() const override { return "Grid"; }
-};
-
-// Wave formation
-class WaveFormation : public Formation
-{
-public:
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
+    if (!droneRenderer.isReady())
     {
-        int numDrones = static_cast<int>(drones.size());
-        float width = 15.0f;
-        float depth = 10.0f;
+        // Keep polling the programs while they build; if they can't, paint in software instead
+        if (!shaders.isFinished())
+            openGLContext.triggerRepaint();
+        else if (!dronesDrawnByOpenGL)
+            juce::MessageManager::callAsync([safeThis = juce::Component::SafePointer<MainComponent>(this)]
+            {
+                if (safeThis != nullptr)
+                    safeThis->fallBackToSoftware("The drone shaders failed to build");
+            });
         
-        for (int i = 0; i < numDrones; ++i)
-        {
-            // Distribute drones evenly across the width
-            float t = static_cast<float>(i) / std::max(1, numDrones - 1);
-            float x = width * (t - 0.5f);
-            
-            // Create a wave pattern
-            float phase = timeFactor * 0.5f + t * juce::MathConstants<float>::twoPi;
-            float y = 3.0f * std::sin(phase);
-            float z = depth * (0.5f - t) * std::cos(phase * 0.5f);
-            
-            drones[i]->targetPosition = juce::Vector3D<float>(x, y, z);
-        }
+        return;
     }
     
-    juce::String getName() const override { return "Wave"; }
-};
-
-// Flock formation with boids-like behavior
-class FlockFormation : public Formation
-{
-    std::vector<juce::Vector3D<float>> velocities;
+    // Draw the swarm as it is now, between the two newest simulation frames
+    SwarmScenePainter::View view;
+    auto alpha = glInterpolator.getAlpha(juce::Time::getMillisecondCounterHiRes());
+    glInterpolator.interpolate(alpha, glSnapshot, view);
     
-public:
-    FlockFormation() = default;
+    quality.addPhaseTime(SwarmQualityController::gpu, gpuTimer.collect());
+    gpuTimer.begin();
     
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
-    {
-        int numDrones = static_cast<int>(drones.size());
-        
-        // Initialize velocities if needed
-        if (velocities.size() != numDrones)
-        {
-            velocities.clear();
-            velocities.reserve(numDrones);
-            
-            for (int i = 0; i < numDrones; ++i)
-            {
-                velocities.push_back(juce::Vector3D<float>(
-                    std::sin(i * 0.1f) * 0.1f,
-                    std::cos(i * 0.2f) * 0.1f,
-                    std::sin(i * 0.3f + 0.5f) * 0.1f
-                ));
-            }
-        }
-        
-        // Update flock behavior
-        for (int i = 0; i < numDrones; ++i)
-        {
-            // Calculate cohesion, separation, and alignment
-            juce::Vector3D<float> cohesion(0, 0, 0);
-            juce::Vector3D<float> separation(0, 0, 0);
-            juce::Vector3D<float> alignment(0, 0, 0);
-            
-            int cohesionCount = 0;
-            int separationCount = 0;
-            int alignmentCount = 0;
-            
-            for (int j = 0; j < numDrones; ++j)
-            {
-                if (i == j) continue;
-                
-                float distance = (drones[i]->position - drones[j]->position).length();
-                
-                // Cohesion: steer towards center of neighbors
-                if (distance < 10.0f)
-                {
-                    cohesion += drones[j]->position;
-                    cohesionCount++;
-                }
-                
-                // Separation: avoid crowding neighbors
-                if (distance < 5.0f)
-                {
-                    separation += (drones[i]->position - drones[j]->position) / std::max(0.1f, distance);
-                    separationCount++;
-                }
-                
-                // Alignment: match velocity of neighbors
-                if (distance < 7.0f)
-                {
-                    alignment += velocities[j];
-                    alignmentCount++;
-                }
-            }
-            
-            // Combine all forces
-            juce::Vector3D<float> force(0, 0, 0);
-            
-            // Apply cohesion
-            if (cohesionCount > 0)
-            {
-                cohesion = cohesion / static_cast<float>(cohesionCount) - drones[i]->position;
-                force += cohesion * 0.01f;
-            }
-            
-            // Apply separation
-            if (separationCount > 0)
-            {
-                separation = separation / static_cast<float>(separationCount);
-                force += separation * 0.04f;
-            }
-            
-            // Apply alignment
-            if (alignmentCount > 0)
-            {
-                alignment = alignment / static_cast<float>(alignmentCount);
-                force += alignment * 0.02f;
-            }
-            
-            // Add some wandering behavior
-            float t = timeFactor + i * 0.1f;
-            juce::Vector3D<float> wander(
-                std::sin(t) * 0.02f,
-                std::cos(t * 1.3f) * 0.01f,
-                std::sin(t * 0.7f) * 0.02f
-            );
-            force += wander;
-            
-            // Add boundary avoidance
-            const float boundary = 14.0f;
-            const float avoidStrength = 0.1f;
-            
-            if (drones[i]->position.x > boundary)
-                force.x -= avoidStrength;
-            else if (drones[i]->position.x < -boundary)
-                force.x += avoidStrength;
-                
-            if (drones[i]->position.y > boundary)
-                force.y -= avoidStrength;
-            else if (drones[i]->position.y < -boundary)
-                force.y += avoidStrength;
-                
-            if (drones[i]->position.z > boundary)
-                force.z -= avoidStrength;
-            else if (drones[i]->position.z < -boundary)
-                force.z += avoidStrength;
-            
-            // Update velocity
-            velocities[i] += force;
-            
-            // Limit velocity
-            float maxSpeed = 0.3f;
-            float speed = velocities[i].length();
-            if (speed > maxSpeed)
-                velocities[i] = velocities[i] * (maxSpeed / speed);
-            
-            // Set target just ahead of current position
-            drones[i]->targetPosition = drones[i]->position + velocities[i] * 5.0f;
-        }
-    }
+    // At reduced resolution the scene is drawn offscreen and stretched; the status line isn't
+    const auto resolution = glQuality.resolutionScale;
+    const bool reduced = resolution < 1.0f
+                      && sceneTarget.begin(juce::jmax(1, juce::roundToInt(static_cast<float>(width) * resolution)),
+                                           juce::jmax(1, juce::roundToInt(static_cast<float>(height) * resolution)));
     
-    juce::String getName() const override { return "Flock"; }
-};
-
-// Custom formation (can be modified for special patterns)
-class CustomFormation : public Formation
-{
-public:
-    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
-    {
-        int numDrones = static_cast<int>(drones.size());
-        
-        // Create a double helix pattern
-        for (int i = 0; i < numDrones; ++i)
-        {
-            float t = static_cast<float>(i) / numDrones;
-            float height = 15.0f * (0.5f - t);
-            
-            // First half for one helix, second half for the other
-            bool firstHelix = (i < numDrones / 2);
-            float offset = firstHelix ? 0.0f : juce::MathConstants<float>::pi;
-            int index = firstHelix ? i : (i - numDrones / 2);
-            float normalizedIndex = firstHelix ?
-                static_cast<float>(index) / (numDrones / 2) :
-                static_cast<float>(index) / (numDrones - numDrones / 2);
-            
-            // Calculate position on helix
-            float angle = normalizedIndex * 4.0f * juce::MathConstants<float>::twoPi + timeFactor + offset;
-            float radius = 8.0f;
-            float x = std::cos(angle) * radius;
-            float z = std::sin(angle) * radius;
-            
-            drones[i]->targetPosition = juce::Vector3D<float>(x, height, z);
-        }
-    }
+    droneRenderer.setLodDistances(SwarmDroneRenderer::DEFAULT_ICOSPHERE_DISTANCE * glQuality.lodScale,
+                                  SwarmDroneRenderer::DEFAULT_OCTAHEDRON_DISTANCE * glQuality.lodScale);
+    droneRenderer.cull(glSnapshot, view, bounds);
+    droneRenderer.render(reduced ? scale * resolution : scale);
     
-    juce::String getName() const override { return "Custom"; }
-};
-
-// Factory method to create formations
-std::unique_ptr<Formation> Formation::create(const juce::String& name)
-{
-    if (name == "Free")
-        return std::make_unique<FreeFormation>();
-    else if (name == "Circle")
-        return std::make_unique<CircleFormation>();
-    else if (name == "Spiral")
-        return std::make_unique<SpiralFormation>();
-    else if (name == "Grid")
-        return std::make_unique<GridFormation>();
-    else if (name == "Wave")
-        return std::make_unique<WaveFormation>();
-    else if (name == "Flock")
-        return std::make_unique<FlockFormation>();
-    else if (name == "Custom")
-        return std::make_unique<CustomFormation>();
-    
-    // Default to circle if not found
-    return std::make_unique<CircleFormation>();
-}
-
-// Available formation types
-std::vector<juce::String> Formation::getFormationTypes()
-{
-    return {
-        "Free",
-        "Circle",
-        "Spiral",
-        "Grid",
-        "Wave",
-        "Flock",
-        "Custom"
-    };
-}
-
-//==============================================================================
-// RhythmPattern Implementation
-//==============================================================================
-
-// Define concrete rhythm pattern classes
-
-// Continuous rhythm - all drones active
-class ContinuousRhythm : public RhythmPattern
-{
-public:
-    std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) override
-    {
-        // All drones are active
-        return std::vector<bool>(numDrones, true);
-    }
+    // Trails go last so drones hide them, and keep their history while switched off
+    trailRenderer.update(glInterpolator.getNewest());
     
-    juce::String getName() const override { return "Continuous"; }
-};
-
-// Alternating rhythm - every other drone
-class AlternatingRhythm : public RhythmPattern
-{
-public:
-    std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) override
-    {
-        std::vector<bool> active(numDrones, false);
-        
-        // Switch pattern every 30 frames
-        bool evenActive = (frameCount / 30) % 2 == 0;
-        
-        for (int i = 0; i < numDrones; ++i)
-        {
-            active[i] = (i % 2 == 0) ? evenActive : !evenActive;
-        }
-        
-        return active;
-    }
+    // Within a tick the newest trail point already sits under the drones
+    if (view.showTrails)
+        trailRenderer.render(droneRenderer.getCamera(), glSnapshot.newTrailPoint ? alpha : 1.0f);
     
-    juce::String getName() const override { return "Alternating"; }
-};
-
-// Sequential rhythm - one drone at a time
-class SequentialRhythm : public RhythmPattern
-{
-public:
-    std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) override
-    {
-        std::vector<bool> active(numDrones, false);
-        
-        // Activate one drone at a time, cycling through
-        int activeIndex = (frameCount / 10) % numDrones;
-        active[activeIndex] = true;
-        
-        return active;
-    }
+    if (reduced)
+        sceneTarget.end(width, height);
     
-    juce::String getName() const override { return "Sequential"; }
-};
-
-// Wave rhythm - activation moves like a wave
-class WaveRhythm : public RhythmPattern
-{
-public:
-    std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) override
-    {
-        std::vector<bool> active(numDrones, false);
-        
-        // Create a wave of activation
-        for (int i = 0; i < numDrones; ++i)
-        {
-            float phase = static_cast<float>(frameCount) * 0.05f +
-                          static_cast<float>(i) / numDrones * juce::MathConstants<float>::twoPi;
-            
-            active[i] = std::sin(phase) > 0.0f;
-        }
-        
-        return active;
-    }
+    // The status line goes on top, straight from the glyph atlas
+    std::array<char, SwarmHudRenderer::MAX_TEXT_LENGTH> hudText;
+    std::snprintf(hudText.data(), hudText.size(), "%s   Drawn: %d / %d / %d", glStatusText.data(),
+                  droneRenderer.getNumDrawn(SwarmDroneRenderer::icosphere),
+                  droneRenderer.getNumDrawn(SwarmDroneRenderer::octahedron),
+                  droneRenderer.getNumDrawn(SwarmDroneRenderer::pointSprite));
+    hudRenderer.render(hudText.data(), bounds, scale);
+    gpuTimer.end();
     
-    juce::String getName() const override { return "Wave"; }
-};
-
-// Random rhythm - random activation
-class RandomRhythm : public RhythmPattern
-{
-public:
-    std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) override
-    {
-        std::vector<bool> active(numDrones, false);
-        
-        // Update pattern every 20 frames
-        static int lastUpdateFrame = -1;
-        static std::vector<bool> pattern;
-        
-        if (frameCount / 20 != lastUpdateFrame / 20 || pattern.size() != active.size())
-        {
-            lastUpdateFrame = frameCount;
-            pattern.resize(numDrones);
-            
-            // Generate new random pattern
-            for (int i = 0; i < numDrones; ++i)
-            {
-                pattern[i] = (std::rand() % 100) < 30; // 30% chance of being active
-            }
-        }
-        
-        return pattern;
-    }
+    dronesDrawnByOpenGL = true;
+    quality.addPhaseTime(SwarmQualityController::render, juce::Time::getMillisecondCounterHiRes() - startMs);
     
-    juce::String getName() const override { return "Random"; }
-};
-
-// Polyrhythm - different patterns for different drones
-class PolyrhythmRhythm : public RhythmPattern
-{
-public:
-    std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) override
+    if (launchOptions.reportHeapCalls)
     {
-        std::vector<bool> active(numDrones, false);
-        
-        // Divide drones into groups with different rhythms
-        for (int i = 0; i < numDrones; ++i)
-        {
-            int group = i % 3; // Three different groups
-            
-            switch (group)
-            {
-                case 0: // Group 1: Every 8 frames
-                    active[i] = (frameCount % 8) == 0;
-                    break;
-                    
-                case 1: // Group 2: Every 12 frames
-                    active[i] = (frameCount % 12) == 0;
-                    break;
-                    
-                case 2: // Group 3: Every 16 frames
-                    active[i] = (frameCount % 16) == 0;
-                    break;
-            }
-        }
-        
-        return active;
+        frameHeapCalls += SwarmHeapCounter::getThreadCount() - heapCallsBefore;
+        ++heapReportFrames;
     }
     
-    juce::String getName() const override { return "Polyrhythm"; }
-};
-
-// Factory method to create rhythm patterns
-std::unique_ptr<RhythmPattern> RhythmPattern::create(const juce::String& name)
-{
-    if (name == "Continuous")
-        return std::make_unique<ContinuousRhythm>();
-    else if (name == "Alternating")
-        return std::make_unique<AlternatingRhythm>();
-    else if (name == "Sequential")
-        return std::make_unique<SequentialRhythm>();
-    else if (name == "Wave")
-        return std::make_unique<WaveRhythm>();
-    else if (name == "Random")
-        return std::make_unique<RandomRhythm>();
-    else if (name == "Polyrhythm")
-        return std::make_unique<PolyrhythmRhythm>();
-    
-    // Default to continuous if not found
-    return std::make_unique<ContinuousRhythm>();
+    // Keep drawing while the drones are still moving between the two newest frames
+    if (alpha < 1.0f)
+        openGLContext.triggerRepaint();
 }
 
-// Available rhythm types
-std::vector<juce::String> RhythmPattern::getRhythmTypes()
-{
-    return {
-        "Continuous",
-        "Alternating",
-        "Sequential",
-        "Wave",
-        "Random",
-        "Polyrhythm"
-    };
-}
 
-//==============================================================================
-// MusicScales Implementation
-//==============================================================================
-
-MusicScales::MusicScales()
+void MainComponent::openGLContextClosing()
 {
-    // Define common scales by their intervals
-    scales["Chromatic"] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
-    scales["Major"] = {0, 2, 4, 5, 7, 9, 11};
-    scales["Minor"] = {0, 2, 3, 5, 7, 8, 10};
-    scales["Pentatonic"] = {0, 2, 4, 7, 9};
-    scales["Blues"] = {0, 3, 5, 6, 7, 10};
-    scales["Dorian"] = {0, 2, 3, 5, 7, 9, 10};
-    scales["Phrygian"] = {0, 1, 3, 5, 7, 8, 10};
-    scales["Mixolydian"] = {0, 2, 4, 5, 7, 9, 10};
-    scales["Lydian"] = {0, 2, 4, 6, 7, 9, 11};
-    scales["Locrian"] = {0, 1, 3, 5, 6, 8, 10};
+    dronesDrawnByOpenGL = false;
+    droneRenderer.release();
+    trailRenderer.release();
+    hudRenderer.release();
+    sceneTarget.release();
+    gpuTimer.release();
+    shaders.release();
 }
 
-std::vector<int> MusicScales::getScaleNotes(const juce::String& scaleName, int rootNote) const
+void MainComponent::runGpuPhysicsCheck()
 {
-    std::vector<int> result;
+    gpuPhysicsChecked = true;
     
-    // Find the scale
-    auto scaleIt = scales.find(scaleName);
-    if (scaleIt == scales.end())
-    {
-        // Default to chromatic if scale not found
-        scaleIt = scales.find("Chromatic");
-    }
+    // Same step count the UI timer would run in --seconds
+    const int numSteps = juce::roundToInt(launchOptions.durationSeconds * 1000.0
+                                          / SwarmSimulation::UPDATE_INTERVAL_MS);
+    juce::String report;
     
-    const auto& intervals = scaleIt->second;
+    auto passed = SwarmGpuPhysics::runParityCheck(shaders, launchOptions.numDrones, numSteps, report);
+    juce::Logger::writeToLog(report);
     
-    // Generate 3 octaves worth of notes
-    for (int octave = 0; octave < 3; ++octave)
+    juce::MessageManager::callAsync([passed]
     {
-        for (int interval : intervals)
+        if (auto* app = juce::JUCEApplicationBase::getInstance())
         {
-            int note = rootNote + octave * 12 + interval;
-            if (note >= 0 && note < 128) // Stay within MIDI note range
-                result.push_back(note);
+            app->setApplicationReturnValue(passed ? 0 : 1);
+            app->quit();
         }
-    }
-    
-    return result;
+    });
 }
 
-std::vector<juce::String> MusicScales::getScaleTypes()
-{
-    return {
-        "Chromatic",
-        "Major",
-        "Minor",
-        "Pentatonic",
-        "Blues",
-        "Dorian",
-        "Phrygian",
-        "Mixolydian",
-        "Lydian",
-        "Locrian"
-    };
-}
+START_JUCE_APPLICATION( DroneSwarmApp);
 
+//=====START=== modification 2025-05-17 >
 //==============================================================================
 // DroneSwarmRenderer Implementation
 //==============================================================================
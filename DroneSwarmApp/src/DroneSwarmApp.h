@@ -4,10 +4,26 @@
 #include <JuceHeader.h>
 #include <vector>
 #include <array>
+#include <atomic>
 #include <memory>
 #include <random>
 #include <functional>
 #include <deque>
+#include <utility>
+#include <cmath>
+
+#include "SwarmSimulation.h"
+#include "SwarmOsc.h"
+#include "SwarmSynth.h"
+#include "SwarmScene.h"
+#include "SwarmShaders.h"
+#include "SwarmGpuPhysics.h"
+#include "SwarmRenderer.h"
+#include "SwarmSoftwareRenderer.h"
+#include "SwarmFrameSequence.h"
+#include "SwarmQuality.h"
+#include "SwarmHeapCounter.h"
+#include "SwarmInstrumentation.h"
 
 
 #if JUCE_MAC
@@ -15,10 +31,93 @@
     #include <OpenGL/gl3.h>
 #endif
 //==============================================================================
-// Forward declarations
-class SwarmDrone;
-class Formation;
-class RhythmPattern;
+/**
+ * Options parsed from the command line at startup
+ */
+struct SwarmLaunchOptions
+{
+    // Create our own virtual MIDI output instead of opening an existing device
+    bool useVirtualMidiOutput = false;
+    
+    // Open the first MIDI output whose name contains this (empty = first device)
+    juce::String midiOutputName;
+    
+    // OSC drone state streaming (disabled while oscOutPort is 0)
+    juce::String oscOutHost = "127.0.0.1";
+    int oscOutPort = 0;
+    bool oscUseBlobs = false;
+    int oscMaxPacketBytes = 1472;
+    
+    // OSC control input (disabled while oscInPort is 0)
+    int oscInPort = 0;
+    
+    // Swarm size (first value of --drones)
+    int numDrones = 8;
+    
+    // Trail points kept per drone
+    int trailLength = SwarmSimulation::DEFAULT_TRAIL_LENGTH;
+    
+    // Simulation steps per second and physics passes per step
+    double stepRate = 1000.0 / SwarmSimulation::UPDATE_INTERVAL_MS;
+    int numSubSteps = 1;
+    
+    // Built-in synth on the default audio device
+    bool enableSynth = true;
+    
+    // Schedule simulation steps on the synth's sample clock instead of the UI timer
+    bool useAudioClock = false;
+    
+    // Overlap each step's physics with the previous step's output and render hand-over
+    bool pipelineSteps = false;
+    
+    // Parameter automation: capture what the simulation applied, or play a capture back
+    juce::File recordAutomationFile;
+    juce::File replayAutomationFile;
+    
+    // Built-in choreography to play from the start (index into SwarmChoreography::getChoreographyTypes())
+    int choreography = 0;
+    
+    // Where linked shader binaries are kept between runs (none = always compile from source)
+    juce::File shaderCacheDirectory = SwarmShaderManager::getDefaultCacheDirectory();
+    
+    // Step the GPU physics prototype next to the CPU simulation and compare (needs a GL 3.3 context)
+    bool runGpuPhysicsCheck = false;
+    
+    // Draw with SwarmSoftwareRenderer even when OpenGL is available
+    bool useSoftwareRenderer = false;
+    
+    // Lower trail length, LOD, note checks, flock radius and resolution when frames run late
+    bool adaptiveQuality = true;
+    
+    // Log how often simulation steps and GL frames call the global heap
+    bool reportHeapCalls = false;
+    
+    // Record heap calls, and optionally mutex locks, made on the real-time paths
+    bool realtimeCheck = false;
+    bool realtimeCheckLocks = false;
+    
+    // Headless record-then-replay check of automation timing
+    bool runAutomationCheck = false;
+    
+    // Headless MIDI loopback latency/jitter measurement
+    bool runMidiLoopback = false;
+    juce::Array<int> loopbackSwarmSizes { 8, 64, 512 };
+    
+    // Headless offline render of the built-in synth to a WAV file
+    juce::File renderWavFile;
+    double renderSampleRate = 48000.0;
+    
+    // Offline render of the visuals to an image sequence (needs a GL 3.3 context)
+    juce::File renderFramesDirectory;
+    int frameWidth = 1280;
+    int frameHeight = 720;
+    SwarmFrameSequenceRenderer::Format frameFormat = SwarmFrameSequenceRenderer::Format::png;
+    
+    // Length of each headless run
+    double durationSeconds = 5.0;
+    
+    static SwarmLaunchOptions fromCommandLine(const juce::String& commandLine);
+};
 
 //==============================================================================
 /**
@@ -40,10 +139,31 @@ public:
     void anotherInstanceStarted(const juce::String& commandLine) override;
     
 private:
+    // Runs a task without opening a window, then quits with its return value
+    void runHeadless(std::function<int()> task);
+    
+    SwarmLaunchOptions launchOptions;
     std::unique_ptr<juce::DocumentWindow> mainWindow;
 };
 
 
+//==============================================================================
+/**
+ * The 3D area of the window. OpenGL draws straight into it with no component
+ * painting composited on top; only if OpenGL can't draw is it painted here.
+ */
+class SwarmSceneView : public juce::Component
+{
+public:
+    std::function<void(juce::Graphics&)> onPaint;
+    
+    void paint(juce::Graphics& g) override
+    {
+        if (onPaint != nullptr)
+            onPaint(g);
+    }
+};
+
 //==============================================================================
 /**
  * Main component that contains the 3D visualization and controls
@@ -55,7 +175,7 @@ class MainComponent : public juce::Component,
                         public juce::OpenGLRenderer
 {
 public:
-    MainComponent();
+    explicit MainComponent(const SwarmLaunchOptions& options = {});
     ~MainComponent() override;
     
     void paint(juce::Graphics& g) override;
@@ -78,31 +198,6 @@ public:
         void newOpenGLContextCreated() override;
         void renderOpenGL() override;
         void openGLContextClosing() override;
-    struct Vertex {
-        float x, y, z;
-        float r, g, b, a;
-    };
-
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-    GLuint vertexBuffer = 0;
-    GLuint indexBuffer = 0;
-  
-
-    // In your initialization code:
-    void createGeometry()
-    {
-        // Define your geometry data
-        vertices = {
-            // Example: positions and colors for a simple shape
-            {-0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f}, // red
-            { 0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f}, // green
-            { 0.0f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f}  // blue
-        };
-        
-        indices = {0, 1, 2}; // Simple triangle
-        numIndices = static_cast<int>(indices.size());
-    }
     
 private:
     // OpenGL context
@@ -121,6 +216,7 @@ private:
     juce::ComboBox scaleSelector;
     juce::Slider rootNoteSlider;
     juce::ToggleButton trailsToggle;
+    juce::ToggleButton synthToggle;
     juce::TextButton pauseButton;
     
     // MIDI handling
@@ -128,36 +224,149 @@ private:
     std::unique_ptr<juce::MidiOutput> midiOutput;
     std::unique_ptr<juce::MidiInput> midiInput;
     
+    // Swarm state
+    SwarmLaunchOptions launchOptions;
+    SwarmSimulation simulation { launchOptions.numDrones };
+    
+    // GLSL programs, built whenever the GL context is (re)created
+    SwarmShaderManager shaders { launchOptions.shaderCacheDirectory };
+    bool gpuPhysicsChecked = false;
+    void runGpuPhysicsCheck();
+    
+    // Instanced drones, GPU trails and the status line, all drawn into sceneView
+    SwarmSceneView sceneView;
+    SwarmDroneRenderer droneRenderer { shaders };
+    SwarmTrailRenderer trailRenderer { shaders };
+    SwarmHudRenderer hudRenderer { shaders };
+    SwarmRenderTarget sceneTarget;
+    SwarmGpuTimer gpuTimer;
+    std::atomic<bool> openGLStarted { false };
+    std::atomic<bool> dronesDrawnByOpenGL { false };
+    
+    // Without a working GL context the scene is rasterised on the CPU instead
+    bool drawingInSoftware = false;
+    juce::uint32 openGLAttachTimeMs = 0;
+    void fallBackToSoftware(const juce::String& reason);
+    void paintScene(juce::Graphics& g);
+    static constexpr juce::uint32 OPENGL_START_TIMEOUT_MS = 3000;
+    
+    // Worker threads for frame work that splits into independent tasks
+    SwarmWorkerPool workers;
+    SwarmSoftwareRenderer softwareRenderer { workers };
+    SwarmSnapshotInterpolator softwareInterpolator;
+    SwarmSnapshot softwareIncoming;
+    SwarmSnapshot softwareSnapshot;
+    juce::Image softwareFrame;
+    bool softwareAnimating = false;
+    std::unique_ptr<juce::VBlankAttachment> softwareVBlank;
+    
+    // Parameter automation capture and playback
+    SwarmAutomationRecorder automationRecorder;
+    SwarmAutomationTrack recordedAutomation;
+    SwarmAutomationTrack replayedAutomation;
+    void setupAutomation();
+    void saveRecordedAutomation();
+    
+    // OSC output and control input
+    OscStateSender oscSender;
+    OscControlReceiver oscReceiver { simulation.getCommandQueue(), simulation.getTargetOverrides() };
+    
+    // Built-in synth
+    juce::AudioDeviceManager audioDeviceManager;
+    SwarmSynth synth { launchOptions.numDrones };
+    bool synthRunning = false;
+    void setSynthEnabled(bool shouldBeEnabled);
+    
+    // Simulation clock: the UI timer, or the synth's sample counter with --audio-clock
+    SwarmStepClock stepClock;
+    bool audioClocked = false;
+    int audioClockGeneration = -1;
+    void updateClockSource();
+    void stepFromAudioClock();
+    void advanceSimulation(double playbackStartMs, juce::int64 playbackStartSample);
+    
+    // A step's work as a job graph on the worker pool: physics, latching the result, then
+    // sending it (MIDI, synth, OSC). With --pipeline, step N's physics runs next to step
+    // N-1's output and the latch follows the graph. The jobs use message-thread state, which
+    // is safe only because that thread waits in stepGraph.run(); the view and the render
+    // hand-over stay on the message thread, after the wait
+    SwarmJobGraph stepGraph;
+    int physicsJob = -1, latchJob = -1, outputJob = -1;
+    SwarmStepOutput stepOutput;
+    juce::int64 outputStartSample = 0;
+    std::atomic<juce::int64> stepJobHeapCalls { 0 };
+    void buildStepGraph();
+    void latchStep();
+    void advanceView();
+    void emitStepOutput();
+    
+    // Timer rate while polling the audio clock, and how far it may fall behind before skipping
+    static constexpr int AUDIO_CLOCK_POLL_HZ = 250;
+    static constexpr int MAX_CATCH_UP_STEPS = 4;
+    
     // Swarm management
-    void updateSwarm();
-    void generateMidi();
-    void updateFormationTargets();
+    void syncControlsFromSimulation();
+    void sendNoteEvents(const SwarmStepOutput& output, double playbackStartMs);
+    void postSynthEvents(const SwarmStepOutput& output, juce::int64 playbackStartSample);
     void setupMidi();
-    void renderDrones(juce::Graphics& g);
-    void renderTrails(juce::Graphics& g);
-    void updateStatusText();
+    std::unique_ptr<juce::MidiOutput> createVirtualMidiOutput();
+    
+    // Rebuilds statusText from the current state; true if it changed. The text lives in
+    // fixed buffers all the way to the GL thread, so a step's new line allocates nothing
+    bool updateStatusText();
+    using StatusText = std::array<char, 160>;
+    StatusText statusText {};
+    
+    juce::MidiBuffer frameMidi;
+    
+    // What paint() draws, captured after each step
+    SwarmSnapshot snapshot;
+    
+    // When the step being sent and handed over is heard, which is when the GL view shows it
+    double snapshotTimeMs = 0.0;
+    
+    // The latest snapshot and view handed over to the GL thread, which blends the two
+    // newest ones it has seen so motion stays smooth between simulation steps
+    juce::SpinLock renderLock;
+    SwarmSnapshot renderSnapshot;
+    SwarmScenePainter::View renderView;
+    double renderSnapshotTimeMs = 0.0;
+    StatusText renderStatusText {};
+    bool renderSnapshotFresh = false;
+    SwarmSnapshot glIncoming;
+    SwarmSnapshotInterpolator glInterpolator;
+    SwarmSnapshot glSnapshot;
+    StatusText glStatusText {};
+    SwarmQualitySettings renderQuality;
+    SwarmQualitySettings glQuality;
+    void publishRenderState();
+    void handOverRenderState();
+    void requestRender();
+    
+    // Trades quality for time when a step's work outgrows its budget
+    SwarmQualityController quality;
+    void applyQualitySettings();
+    
+    // --heap-report and --rt-check: heap calls made by steps and GL frames since the last
+    // report, real-time violations and memory, logged every HEAP_REPORT_SECONDS
+    void reportInstrumentation(juce::int64 heapCallsThisStep);
+    SwarmMemoryReport measureMemory();
+    juce::int64 stepHeapCalls = 0;
+    int heapReportSteps = 0;
+    std::atomic<juce::int64> frameHeapCalls { 0 };
+    std::atomic<int> heapReportFrames { 0 };
+    juce::int64 loggedViolations = 0;
+    static constexpr double HEAP_REPORT_SECONDS = 5.0;
     
-    // Swarm state
-    std::vector<std::unique_ptr<SwarmDrone>> drones;
-    std::unique_ptr<Formation> currentFormation;
-    std::unique_ptr<RhythmPattern> currentRhythm;
-    int numIndices =0;
     // Animation state
-    int frameCount = 0;
     bool paused = false;
     float rotationAngle = 0.0f;
     float zoomLevel = 1.0f;
+    static constexpr float ROTATION_SPEED = 0.125f;    // radians per simulated second
     
     // Settings
-    float chaosLevel = 0.3f;
-    float formationStrength = 0.7f;
     bool enableTrails = true;
     
-    // Swarm parameters
-    static constexpr int DEFAULT_NUM_DRONES = 8;
-    static constexpr int UPDATE_INTERVAL_MS = 40; // 25 fps
-    static constexpr int NOTE_CHECK_INTERVAL = 3; // frames
-    
     // 3D visualization
     juce::Vector3D<float> cameraPosition;
     juce::Vector3D<float> cameraTarget;
@@ -166,154 +375,6 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
 
-//==============================================================================
-/**
- * Represents a single drone in the swarm
- */
-class SwarmDrone
-{
-public:
-    SwarmDrone(int id, const juce::Colour& colour);
-    ~SwarmDrone();
-    
-    // Position and movement
-    juce::Vector3D<float> position;
-    juce::Vector3D<float> velocity;
-    juce::Vector3D<float> targetPosition;
-    
-    // State
-    int droneId;
-    juce::Colour colour;
-    float size = 100.0f;
-    bool noteActive = false;
-    int currentNote = 0;
-    int midiChannel = 0;
-    
-    // Trail for visualization
-    std::deque<juce::Vector3D<float>> trail;
-    static constexpr size_t MAX_TRAIL_LENGTH = 20;
-    
-    // Update drone physics
-    void update(float chaosLevel, float formationStrength);
-    
-    // Keep drone within bounds
-    void enforceBoundaries()
-    {
-        // Boundary checking - bounce off edges of the space
-        constexpr float boundary = 15.0f;
-        constexpr float bounceFactor = -0.7f;
-        
-        // X boundaries
-        if (position.x > boundary)
-        {
-            position.x = boundary - (position.x - boundary);
-            velocity.x *= bounceFactor;
-        }
-        else if (position.x < -boundary)
-        {
-            position.x = -boundary - (position.x + boundary);
-            velocity.x *= bounceFactor;
-        }
-        
-        // Y boundaries
-        if (position.y > boundary)
-        {
-            position.y = boundary - (position.y - boundary);
-            velocity.y *= bounceFactor;
-        }
-        else if (position.y < -boundary)
-        {
-            position.y = -boundary - (position.y + boundary);
-            velocity.y *= bounceFactor;
-        }
-        
-        // Z boundaries
-        if (position.z > boundary)
-        {
-            position.z = boundary - (position.z - boundary);
-            velocity.z *= bounceFactor;
-        }
-        else if (position.z < -boundary)
-        {
-            position.z = -boundary - (position.z + boundary);
-            velocity.z *= bounceFactor;
-        }
-    };
-    
-private:
-    // Random number generation
-    std::random_device rd;
-    std::mt19937 rng;
-};
-
-//==============================================================================
-/**
- * Base class for different formation patterns
- */
-class Formation
-{
-public:
-    Formation() = default;
-    virtual ~Formation() = default;
-    
-    // Calculate target positions for all drones
-    virtual void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, 
-                                  float timeFactor) = 0;
-    
-    // Get name of the formation
-    virtual juce::String getName() const = 0;
-    
-    // Factory method to create formations
-    static std::unique_ptr<Formation> create(const juce::String& name);
-    
-    // Available formation types
-    static std::vector<juce::String> getFormationTypes();
-};
-
-//==============================================================================
-/**
- * Base class for different rhythm patterns
- */
-class RhythmPattern
-{
-public:
-    RhythmPattern() = default;
-    virtual ~RhythmPattern() = default;
-    
-    // Calculate which drones should be active for a given frame
-    virtual std::vector<bool> calculateActiveNotes(int numDrones, int frameCount) = 0;
-    
-    // Get name of the rhythm pattern
-    virtual juce::String getName() const = 0;
-    
-    // Factory method to create rhythm patterns
-    static std::unique_ptr<RhythmPattern> create(const juce::String& name);
-    
-    // Available rhythm types
-    static std::vector<juce::String> getRhythmTypes();
-};
-
-//==============================================================================
-/**
- * Handles musical scales and note mapping
- */
-class MusicScales
-{
-public:
-    MusicScales();
-    ~MusicScales() = default;
-    
-    // Get notes for a particular scale
-    std::vector<int> getScaleNotes(const juce::String& scaleName, int rootNote = 60) const;
-    
-    // Available scale types
-    static std::vector<juce::String> getScaleTypes();
-    
-private:
-    // Scale definitions (intervals)
-    std::map<juce::String, std::vector<int>> scales;
-};
-
 //==============================================================================
 /**
  * OpenGL renderer for 3D visualization
@@ -0,0 +1,302 @@
+#include "DroneSwarmPlugin.h"
+
+namespace
+{
+    juce::StringArray toStringArray(const std::vector<juce::String>& strings)
+    {
+        return juce::StringArray(strings.data(), static_cast<int>(strings.size()));
+    }
+}
+
+//==============================================================================
+// DroneSwarmProcessor Implementation
+//==============================================================================
+
+DroneSwarmProcessor::DroneSwarmProcessor()
+    : AudioProcessor(BusesProperties()),
+      parameters(*this, nullptr, "DroneSwarm", createParameterLayout())
+{
+    chaosParameter = parameters.getRawParameterValue("chaos");
+    strengthParameter = parameters.getRawParameterValue("strength");
+    formationParameter = parameters.getRawParameterValue("formation");
+    rhythmParameter = parameters.getRawParameterValue("rhythm");
+    scaleParameter = parameters.getRawParameterValue("scale");
+    rootNoteParameter = parameters.getRawParameterValue("rootNote");
+}
+
+DroneSwarmProcessor::~DroneSwarmProcessor() = default;
+
+juce::AudioProcessorValueTreeState::ParameterLayout DroneSwarmProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "chaos", 1 }, "Chaos",
+                                                           0.0f, 1.0f, 0.3f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "strength", 1 }, "Formation Strength",
+                                                           0.0f, 1.0f, 0.7f));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "formation", 1 }, "Formation",
+                                                            toStringArray(Formation::getFormationTypes()), 1));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "rhythm", 1 }, "Rhythm",
+                                                            toStringArray(RhythmPattern::getRhythmTypes()), 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "scale", 1 }, "Scale",
+                                                            toStringArray(MusicScales::getScaleTypes()), 1));
+    layout.add(std::make_unique<juce::AudioParameterInt>(juce::ParameterID { "rootNote", 1 }, "Root Note",
+                                                         36, 84, 60));
+    return layout;
+}
+
+void DroneSwarmProcessor::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    currentSampleRate = sampleRate;
+    
+    // Room for the busiest steps a block can hold, plus the one carried over, so adding
+    // events never reallocates on the audio thread. Each event is stored as its sample
+    // position, its size and three bytes of MIDI.
+    const auto numDrones = static_cast<int>(simulation.getDrones().size());
+    const auto bytesPerEvent = sizeof(juce::int32) + sizeof(juce::uint16) + 3;
+    const auto bytesPerStep = static_cast<size_t>(numDrones * SwarmSimulation::MAX_EVENTS_PER_DRONE) * bytesPerEvent;
+    const auto stepsPerBlock = static_cast<size_t>(std::ceil(maximumExpectedSamplesPerBlock
+                                                             / (sampleRate * simulation.getStepSeconds()))) + 1;
+    pendingMidi.ensureSize(bytesPerStep * stepsPerBlock);
+    carriedMidi.ensureSize(bytesPerStep * stepsPerBlock);
+    
+    // Likewise for the editor's frame, with every trail point the simulation keeps
+    {
+        const juce::SpinLock::ScopedLockType lock(snapshotLock);
+        publishedSnapshot.reserve(numDrones, simulation.getTrails().getLength());
+    }
+    
+    pendingMidi.clear();
+    nextBlockStart = 0;
+    stepClock.reset(sampleRate, simulation.getStepSeconds(), 0);
+    
+    applyParameters();
+    publishSnapshot();
+}
+
+void DroneSwarmProcessor::releaseResources()
+{
+    pendingMidi.clear();
+}
+
+void DroneSwarmProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ScopedNoDenormals noDenormals;
+    
+    const int numSamples = buffer.getNumSamples();
+    buffer.clear();
+    
+    // The swarm replaces whatever MIDI came in
+    midiMessages.clear();
+    
+    applyParameters();
+    
+    // Follow the host timeline while its transport runs, otherwise keep counting on our own
+    auto blockStart = nextBlockStart;
+    
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            if (position->getIsPlaying())
+                if (auto hostTime = position->getTimeInSamples())
+                    blockStart = *hostTime;
+    
+    if (blockStart != nextBlockStart)
+        relocate(blockStart, midiMessages);
+    
+    nextBlockStart = blockStart + numSamples;
+    
+    // Advance by exactly this block: every step starting before its end is simulated now
+    bool stepped = false;
+    
+    while (stepClock.isStepDue(nextBlockStart))
+    {
+        simulation.step();
+        scheduleStepEvents(stepClock.getPlaybackStart(), blockStart);
+        stepClock.advance();
+        stepped = true;
+    }
+    
+    // Emit what falls inside this block and carry the rest over, re-based to the next block
+    carriedMidi.clear();
+    
+    for (const auto metadata : pendingMidi)
+    {
+        if (metadata.samplePosition < numSamples)
+            midiMessages.addEvent(metadata.data, metadata.numBytes, juce::jmax(0, metadata.samplePosition));
+        else
+            carriedMidi.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition - numSamples);
+    }
+    
+    pendingMidi.swapWith(carriedMidi);
+    
+    if (stepped)
+        publishSnapshot();
+}
+
+void DroneSwarmProcessor::applyParameters()
+{
+    // Host values go straight into the simulation's store; it smooths them and
+    // only rebuilds formations, rhythms and scales when a choice actually moves
+    auto& store = simulation.getParameters();
+    store.set(SwarmParameterStore::chaos, chaosParameter->load());
+    store.set(SwarmParameterStore::formationStrength, strengthParameter->load());
+    store.set(SwarmParameterStore::formation, formationParameter->load());
+    store.set(SwarmParameterStore::rhythm, rhythmParameter->load());
+    store.set(SwarmParameterStore::scale, scaleParameter->load());
+    store.set(SwarmParameterStore::rootNote, rootNoteParameter->load());
+}
+
+void DroneSwarmProcessor::relocate(juce::int64 newBlockStart, juce::MidiBuffer& midiMessages)
+{
+    // The host jumped (start, loop, scrub): silence what was sounding and restart the step grid there
+    pendingMidi.clear();
+    
+    for (int channel = 1; channel <= 16; ++channel)
+        midiMessages.addEvent(juce::MidiMessage::allNotesOff(channel), 0);
+    
+    stepClock.reset(currentSampleRate, simulation.getStepSeconds(), newBlockStart);
+}
+
+void DroneSwarmProcessor::scheduleStepEvents(juce::int64 playbackStart, juce::int64 blockStart)
+{
+    const double stepSamples = stepClock.getStepLength();
+    
+    for (auto& event : simulation.getNoteEvents())
+    {
+        auto sampleTime = playbackStart + static_cast<juce::int64>(event.stepFraction * stepSamples);
+        pendingMidi.addEvent(event.toMidiMessage(), static_cast<int>(sampleTime - blockStart));
+    }
+}
+
+void DroneSwarmProcessor::publishSnapshot()
+{
+    // Skip a frame rather than wait if the editor is copying
+    const juce::SpinLock::ScopedTryLockType lock(snapshotLock);
+    
+    if (lock.isLocked())
+        publishedSnapshot.capture(simulation, true);
+}
+
+void DroneSwarmProcessor::copySnapshot(SwarmSnapshot& destination) const
+{
+    const juce::SpinLock::ScopedLockType lock(snapshotLock);
+    destination = publishedSnapshot;
+}
+
+juce::AudioProcessorEditor* DroneSwarmProcessor::createEditor()
+{
+    return new DroneSwarmEditor(*this);
+}
+
+void DroneSwarmProcessor::getStateInformation(juce::MemoryBlock& destData)
+{
+    if (auto xml = parameters.copyState().createXml())
+        copyXmlToBinary(*xml, destData);
+}
+
+void DroneSwarmProcessor::setStateInformation(const void* data, int sizeInBytes)
+{
+    if (auto xml = getXmlFromBinary(data, sizeInBytes))
+        if (xml->hasTagName(parameters.state.getType()))
+            parameters.replaceState(juce::ValueTree::fromXml(*xml));
+}
+
+//==============================================================================
+// DroneSwarmEditor Implementation
+//==============================================================================
+
+DroneSwarmEditor::DroneSwarmEditor(DroneSwarmProcessor& processor)
+    : AudioProcessorEditor(processor), swarmProcessor(processor)
+{
+    addAndMakeVisible(formationSelector);
+    formationSelector.addItemList(toStringArray(Formation::getFormationTypes()), 1);
+    
+    addAndMakeVisible(rhythmSelector);
+    rhythmSelector.addItemList(toStringArray(RhythmPattern::getRhythmTypes()), 1);
+    
+    addAndMakeVisible(scaleSelector);
+    scaleSelector.addItemList(toStringArray(MusicScales::getScaleTypes()), 1);
+    
+    for (auto* slider : { &chaosSlider, &formationStrengthSlider, &rootNoteSlider })
+    {
+        addAndMakeVisible(*slider);
+        slider->setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+    }
+    
+    auto& parameters = swarmProcessor.parameters;
+    chaosAttachment = std::make_unique<SliderAttachment>(parameters, "chaos", chaosSlider);
+    strengthAttachment = std::make_unique<SliderAttachment>(parameters, "strength", formationStrengthSlider);
+    formationAttachment = std::make_unique<ComboBoxAttachment>(parameters, "formation", formationSelector);
+    rhythmAttachment = std::make_unique<ComboBoxAttachment>(parameters, "rhythm", rhythmSelector);
+    scaleAttachment = std::make_unique<ComboBoxAttachment>(parameters, "scale", scaleSelector);
+    rootNoteAttachment = std::make_unique<SliderAttachment>(parameters, "rootNote", rootNoteSlider);
+    
+    setSize(900, 700);
+    startTimerHz(30);
+}
+
+DroneSwarmEditor::~DroneSwarmEditor()
+{
+    stopTimer();
+}
+
+void DroneSwarmEditor::paint(juce::Graphics& g)
+{
+    // Fill the background
+    g.fillAll(juce::Colours::black);
+    
+    // Draw status information
+    g.setColour(juce::Colours::white);
+    g.setFont(14.0f);
+    
+    juce::String statusText;
+    statusText << "Formation: " << formationSelector.getText() << "   "
+               << "Rhythm: " << rhythmSelector.getText() << "   "
+               << "Frame: " << snapshot.frameNumber;
+    
+    g.drawText(statusText, getLocalBounds().removeFromTop(20), juce::Justification::centred, true);
+    
+    painter.paint(g, getLocalBounds(), snapshot, view);
+}
+
+void DroneSwarmEditor::resized()
+{
+    auto area = getLocalBounds();
+    
+    // Set up control panel at the bottom
+    auto controlsArea = area.removeFromBottom(80).reduced(10);
+    
+    auto row1 = controlsArea.removeFromTop(25);
+    auto row2 = controlsArea.removeFromTop(25);
+    
+    formationSelector.setBounds(row1.removeFromLeft(150));
+    row1.removeFromLeft(10);
+    rhythmSelector.setBounds(row1.removeFromLeft(150));
+    row1.removeFromLeft(10);
+    scaleSelector.setBounds(row1.removeFromLeft(150));
+    row1.removeFromLeft(10);
+    rootNoteSlider.setBounds(row1.removeFromLeft(150));
+    
+    formationStrengthSlider.setBounds(row2.removeFromLeft(200));
+    row2.removeFromLeft(10);
+    chaosSlider.setBounds(row2.removeFromLeft(200));
+}
+
+void DroneSwarmEditor::timerCallback()
+{
+    swarmProcessor.copySnapshot(snapshot);
+    
+    // Rotate view slightly
+    view.rotationAngle += 0.005f;
+    if (view.rotationAngle > juce::MathConstants<float>::twoPi)
+        view.rotationAngle -= juce::MathConstants<float>::twoPi;
+    
+    repaint();
+}
+
+//==============================================================================
+// This creates new instances of the plugin
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new DroneSwarmProcessor();
+}
@@ -0,0 +1,126 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SwarmSimulation.h"
+#include "SwarmScene.h"
+
+//==============================================================================
+/**
+ * The swarm as a MIDI effect plugin.
+ *
+ * processBlock advances the simulation by exactly the block's sample count,
+ * stepping it on the host timeline while the transport runs and on its own
+ * sample counter otherwise. Each step's notes are written into the MidiBuffer
+ * at their sample offsets, one step behind, exactly as the app schedules them.
+ * Parameters are read lock-free from the value tree state's atomics.
+ */
+class DroneSwarmProcessor : public juce::AudioProcessor
+{
+public:
+    DroneSwarmProcessor();
+    ~DroneSwarmProcessor() override;
+    
+    void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override;
+    using AudioProcessor::processBlock;
+    
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override { return true; }
+    
+    const juce::String getName() const override { return JucePlugin_Name; }
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return true; }
+    bool isMidiEffect() const override { return true; }
+    double getTailLengthSeconds() const override { return 0.0; }
+    
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String&) override {}
+    
+    void getStateInformation(juce::MemoryBlock& destData) override;
+    void setStateInformation(const void* data, int sizeInBytes) override;
+    
+    // Message thread: copies the latest published frame for drawing
+    void copySnapshot(SwarmSnapshot& destination) const;
+    
+    juce::AudioProcessorValueTreeState parameters;
+    
+private:
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    
+    void applyParameters();
+    void relocate(juce::int64 newBlockStart, juce::MidiBuffer& midiMessages);
+    void scheduleStepEvents(juce::int64 playbackStart, juce::int64 blockStart);
+    void publishSnapshot();
+    
+    SwarmSimulation simulation;
+    SwarmStepClock stepClock;
+    double currentSampleRate = 44100.0;
+    juce::int64 nextBlockStart = 0;
+    
+    // Step events waiting for their sample, positioned relative to the current block
+    juce::MidiBuffer pendingMidi;
+    juce::MidiBuffer carriedMidi;
+    
+    // Raw parameter values, safe to read from the audio thread
+    std::atomic<float>* chaosParameter = nullptr;
+    std::atomic<float>* strengthParameter = nullptr;
+    std::atomic<float>* formationParameter = nullptr;
+    std::atomic<float>* rhythmParameter = nullptr;
+    std::atomic<float>* scaleParameter = nullptr;
+    std::atomic<float>* rootNoteParameter = nullptr;
+    
+    // Frame for the editor; the audio thread only ever try-locks
+    SwarmSnapshot publishedSnapshot;
+    juce::SpinLock snapshotLock;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DroneSwarmProcessor)
+};
+
+//==============================================================================
+/**
+ * Plugin editor: the app's scene painter and controls, attached to the
+ * processor's parameters
+ */
+class DroneSwarmEditor : public juce::AudioProcessorEditor,
+                         private juce::Timer
+{
+public:
+    explicit DroneSwarmEditor(DroneSwarmProcessor& processor);
+    ~DroneSwarmEditor() override;
+    
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+    
+private:
+    void timerCallback() override;
+    
+    using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
+    using ComboBoxAttachment = juce::AudioProcessorValueTreeState::ComboBoxAttachment;
+    
+    DroneSwarmProcessor& swarmProcessor;
+    
+    juce::Slider chaosSlider;
+    juce::Slider formationStrengthSlider;
+    juce::ComboBox formationSelector;
+    juce::ComboBox rhythmSelector;
+    juce::ComboBox scaleSelector;
+    juce::Slider rootNoteSlider;
+    
+    std::unique_ptr<SliderAttachment> chaosAttachment;
+    std::unique_ptr<SliderAttachment> strengthAttachment;
+    std::unique_ptr<ComboBoxAttachment> formationAttachment;
+    std::unique_ptr<ComboBoxAttachment> rhythmAttachment;
+    std::unique_ptr<ComboBoxAttachment> scaleAttachment;
+    std::unique_ptr<SliderAttachment> rootNoteAttachment;
+    
+    SwarmSnapshot snapshot;
+    SwarmScenePainter painter;
+    SwarmScenePainter::View view;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DroneSwarmEditor)
+};
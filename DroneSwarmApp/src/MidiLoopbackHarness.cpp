@@ -0,0 +1,383 @@
+#include "MidiLoopbackHarness.h"
+#include "SwarmInstrumentation.h"
+#include <cmath>
+#include <algorithm>
+
+//==============================================================================
+// LatencyHistogram Implementation
+//==============================================================================
+
+LatencyHistogram::LatencyHistogram(juce::int64 highestTrackableMicros, int significantDigits)
+    : highestTrackable(juce::jmax((juce::int64) 2, highestTrackableMicros))
+{
+    significantDigits = juce::jlimit(1, 5, significantDigits);
+    
+    // Smallest power of two sub-bucket count that resolves the requested precision
+    auto largestSingleUnitResolution = (juce::int64) (2.0 * std::pow(10.0, significantDigits));
+    int subBucketCountMagnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largestSingleUnitResolution))));
+    
+    subBucketHalfCountMagnitude = juce::jmax(0, subBucketCountMagnitude - 1);
+    subBucketHalfCount = 1 << subBucketHalfCountMagnitude;
+    
+    auto subBucketCount = (juce::int64) 1 << subBucketCountMagnitude;
+    subBucketMask = subBucketCount - 1;
+    
+    // Each further bucket doubles the trackable range
+    int bucketCount = 1;
+    for (auto trackable = subBucketCount; trackable <= highestTrackable; trackable <<= 1)
+        ++bucketCount;
+    
+    counts.assign(static_cast<size_t>((bucketCount + 1) * subBucketHalfCount), 0);
+}
+
+void LatencyHistogram::record(juce::int64 micros)
+{
+    micros = juce::jlimit((juce::int64) 0, highestTrackable, micros);
+    
+    ++counts[static_cast<size_t>(getCountsIndex(micros))];
+    
+    minValue = (totalCount == 0) ? micros : juce::jmin(minValue, micros);
+    maxValue = juce::jmax(maxValue, micros);
+    ++totalCount;
+    
+    sum += static_cast<double>(micros);
+    sumOfSquares += static_cast<double>(micros) * static_cast<double>(micros);
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+    totalCount = 0;
+    minValue = 0;
+    maxValue = 0;
+    sum = 0.0;
+    sumOfSquares = 0.0;
+}
+
+double LatencyHistogram::getMean() const
+{
+    return totalCount > 0 ? sum / static_cast<double>(totalCount) : 0.0;
+}
+
+double LatencyHistogram::getStdDeviation() const
+{
+    if (totalCount < 2)
+        return 0.0;
+    
+    auto mean = getMean();
+    auto variance = sumOfSquares / static_cast<double>(totalCount) - mean * mean;
+    return std::sqrt(juce::jmax(0.0, variance));
+}
+
+juce::int64 LatencyHistogram::getValueAtPercentile(double percentile) const
+{
+    if (totalCount == 0)
+        return 0;
+    
+    percentile = juce::jlimit(0.0, 100.0, percentile);
+    auto countAtPercentile = juce::jmax((juce::int64) 1,
+                                        (juce::int64) (percentile / 100.0 * static_cast<double>(totalCount) + 0.5));
+    
+    juce::int64 runningCount = 0;
+    
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        runningCount += counts[i];
+        
+        if (runningCount >= countAtPercentile)
+            return juce::jmin(maxValue, getHighestEquivalentValue(static_cast<int>(i)));
+    }
+    
+    return maxValue;
+}
+
+int LatencyHistogram::getCountsIndex(juce::int64 value) const
+{
+    // Position of the highest set bit decides the bucket, the bits below it the sub-bucket
+    auto v = static_cast<juce::uint64>(value | subBucketMask);
+    int pow2Ceiling = 0;
+    
+    while (v != 0)
+    {
+        ++pow2Ceiling;
+        v >>= 1;
+    }
+    
+    int bucketIndex = pow2Ceiling - (subBucketHalfCountMagnitude + 1);
+    auto subBucketIndex = static_cast<int>(value >> bucketIndex);
+    
+    return ((bucketIndex + 1) << subBucketHalfCountMagnitude) + (subBucketIndex - subBucketHalfCount);
+}
+
+juce::int64 LatencyHistogram::getValueFromIndex(int index) const
+{
+    int bucketIndex = (index >> subBucketHalfCountMagnitude) - 1;
+    int subBucketIndex = (index & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    
+    if (bucketIndex < 0)
+    {
+        subBucketIndex -= subBucketHalfCount;
+        bucketIndex = 0;
+    }
+    
+    return (juce::int64) subBucketIndex << bucketIndex;
+}
+
+juce::int64 LatencyHistogram::getHighestEquivalentValue(int index) const
+{
+    int bucketIndex = juce::jmax(0, (index >> subBucketHalfCountMagnitude) - 1);
+    return getValueFromIndex(index) + ((juce::int64) 1 << bucketIndex) - 1;
+}
+
+juce::String LatencyHistogram::toReportString() const
+{
+    juce::String report;
+    
+    report << "  samples: " << totalCount
+           << "   min: " << getMin() << " us"
+           << "   mean: " << juce::String(getMean(), 1) << " us"
+           << "   jitter (stddev): " << juce::String(getStdDeviation(), 1) << " us"
+           << "   max: " << getMax() << " us" << juce::newLine;
+    
+    const std::pair<const char*, double> percentiles[] = {
+        { "p50", 50.0 }, { "p90", 90.0 }, { "p99", 99.0 }, { "p99.9", 99.9 }, { "p99.99", 99.99 }
+    };
+    
+    for (auto& p : percentiles)
+        report << "  " << juce::String(p.first).paddedRight(' ', 7) << getValueAtPercentile(p.second) << " us" << juce::newLine;
+    
+    if (totalCount == 0)
+        return report;
+    
+    // One row per power of two, so the plot stays short whatever the spread
+    constexpr int barWidth = 50;
+    juce::int64 largestRow = 0;
+    std::vector<std::pair<juce::int64, juce::int64>> rows; // upper bound, count
+    
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        auto upper = getHighestEquivalentValue(static_cast<int>(i));
+        auto rowLimit = juce::nextPowerOfTwo(static_cast<int>(juce::jmin((juce::int64) 0x3fffffff, upper + 1)));
+        
+        if (rows.empty() || rows.back().first != rowLimit)
+            rows.emplace_back(rowLimit, 0);
+        
+        rows.back().second += counts[i];
+    }
+    
+    // Trim empty rows on either side
+    while (!rows.empty() && rows.back().second == 0)  rows.pop_back();
+    while (!rows.empty() && rows.front().second == 0) rows.erase(rows.begin());
+    
+    for (auto& row : rows)
+        largestRow = juce::jmax(largestRow, row.second);
+    
+    for (auto& row : rows)
+    {
+        auto width = static_cast<int>(row.second * barWidth / juce::jmax((juce::int64) 1, largestRow));
+        report << "  < " << juce::String(row.first).paddedLeft(' ', 9) << " us | "
+               << juce::String::repeatedString("#", width).paddedRight(' ', barWidth)
+               << " " << row.second << juce::newLine;
+    }
+    
+    return report;
+}
+
+//==============================================================================
+// MidiLoopbackHarness Implementation
+//==============================================================================
+
+MidiLoopbackHarness::MidiLoopbackHarness(const Settings& s)
+    : settings(s), scheduledTimesMs(static_cast<size_t>(MAX_SEQUENCE), 0.0)
+{
+}
+
+MidiLoopbackHarness::~MidiLoopbackHarness()
+{
+    if (midiInput != nullptr)
+        midiInput->stop();
+    
+    if (midiOutput != nullptr)
+        midiOutput->stopBackgroundThread();
+}
+
+bool MidiLoopbackHarness::openLoopback()
+{
+   #if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+    midiOutput = juce::MidiOutput::createNewDevice(DEVICE_NAME);
+   #endif
+    
+    if (midiOutput == nullptr)
+    {
+        juce::Logger::writeToLog("MIDI loopback: could not create a virtual MIDI output on this platform");
+        return false;
+    }
+    
+    // The new port shows up as an input we can subscribe to
+    auto outputId = midiOutput->getIdentifier();
+    
+    for (auto& device : juce::MidiInput::getAvailableDevices())
+    {
+        if (device.identifier == outputId || device.name == DEVICE_NAME)
+        {
+            midiInput = juce::MidiInput::openDevice(device.identifier, this);
+            break;
+        }
+    }
+    
+    if (midiInput == nullptr)
+    {
+        juce::Logger::writeToLog("MIDI loopback: could not subscribe to " + juce::String(DEVICE_NAME));
+        return false;
+    }
+    
+    midiOutput->startBackgroundThread();
+    midiInput->start();
+    return true;
+}
+
+bool MidiLoopbackHarness::run(juce::String& report)
+{
+    if (!openLoopback())
+        return false;
+    
+    report << "MIDI loopback latency/jitter (" << settings.tickRateHz << " Hz ticks, "
+           << settings.scheduleAheadMs << " ms schedule-ahead)" << juce::newLine;
+    
+    for (auto numDrones : settings.swarmSizes)
+        runSwarmSize(numDrones, report);
+    
+    if (SwarmRealtimeCheck::isEnabled())
+        report << juce::newLine << SwarmRealtimeCheck::createReport();
+    
+    return true;
+}
+
+void MidiLoopbackHarness::runSwarmSize(int numDrones, juce::String& report)
+{
+    const double tickMs = 1000.0 / settings.tickRateHz;
+    const int numTicks = juce::jmax(1, static_cast<int>(settings.secondsPerRun * settings.tickRateHz));
+    const int eventsPerTick = juce::jmax(1, juce::roundToInt(numDrones * settings.noteDensity));
+    const int totalEvents = juce::jmin(MAX_SEQUENCE, numTicks * eventsPerTick);
+    
+    // Sample positions in the MidiBuffer are microseconds
+    constexpr double positionsPerSecond = 1000000.0;
+    
+    // The input is quiet between runs, so its counters can be reset here
+    jassert(activeGeneration.load() < 0);
+    latency.reset();
+    numReceived = 0;
+    numUnexpected = 0;
+    
+    const int generation = runNumber++ % NUM_GENERATIONS;
+    activeGeneration = generation;
+    
+    // Sized up front so that building a tick's block needn't allocate (see --rt-check)
+    juce::MidiBuffer tickBuffer;
+    tickBuffer.ensureSize(static_cast<size_t>(eventsPerTick) * 16);
+    juce::Random random(numDrones);
+    int sequence = 0;
+    
+    auto nextTickMs = juce::Time::getMillisecondCounterHiRes();
+    
+    for (int tick = 0; tick < numTicks && sequence < totalEvents; ++tick)
+    {
+        {
+            const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::output);
+            tickBuffer.clear();
+        
+            // Spread the tick's events across the tick as sub-frame crossings would be
+            auto blockStartMs = nextTickMs + settings.scheduleAheadMs;
+        
+            for (int i = 0; i < eventsPerTick && sequence < totalEvents; ++i, ++sequence)
+            {
+                auto offsetMicros = static_cast<int>(random.nextDouble() * tickMs * 1000.0);
+                scheduledTimesMs[static_cast<size_t>(sequence)] = blockStartMs + offsetMicros * 0.001;
+                tickBuffer.addEvent(encodeSequence(generation, sequence), offsetMicros);
+            }
+        
+            midiOutput->sendBlockOfMessages(tickBuffer, blockStartMs, positionsPerSecond);
+        }
+        
+        nextTickMs += tickMs;
+        auto waitMs = nextTickMs - juce::Time::getMillisecondCounterHiRes();
+        
+        if (waitMs > 0.0)
+            juce::Thread::sleep(static_cast<int>(waitMs));
+    }
+    
+    // Allow in-flight events to drain
+    auto deadline = juce::Time::getMillisecondCounterHiRes() + settings.scheduleAheadMs + tickMs + 500.0;
+    
+    while (numReceived.load() < sequence && juce::Time::getMillisecondCounterHiRes() < deadline)
+        juce::Thread::sleep(5);
+    
+    // Whatever is still in flight now counts as lost, and is dropped if it turns up later
+    quiesceInput();
+    
+    report << juce::newLine
+           << "Swarm size " << numDrones << ": " << sequence << " events sent, "
+           << numReceived.load() << " received, "
+           << (sequence - numReceived.load()) << " lost, "
+           << numUnexpected.load() << " unexpected" << juce::newLine
+           << latency.toReportString();
+}
+
+void MidiLoopbackHarness::handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage& message)
+{
+    // Take the timestamp first so the bookkeeping below isn't counted as latency
+    auto receivedMs = juce::Time::getMillisecondCounterHiRes();
+    
+    // Announced before the generation is read, so quiesceInput() either sees this
+    // callback inside or this callback sees the run has ended
+    ++numCallbacksInside;
+    
+    int generation = -1, sequence = -1;
+    const int active = activeGeneration.load();
+    
+    if (!decodeSequence(message, generation, sequence))
+        ++numUnexpected;
+    else if (generation == active)
+    {
+        auto latencyMicros = (receivedMs - scheduledTimesMs[static_cast<size_t>(sequence)]) * 1000.0;
+        latency.record(static_cast<juce::int64>(latencyMicros));
+        ++numReceived;
+    }
+    
+    --numCallbacksInside;
+}
+
+void MidiLoopbackHarness::quiesceInput()
+{
+    activeGeneration = -1;
+    
+    while (numCallbacksInside.load() > 0)
+        juce::Thread::yield();
+}
+
+juce::MidiMessage MidiLoopbackHarness::encodeSequence(int generation, int sequence)
+{
+    // Velocity 0 would read as a note-off, so it is offset by one
+    int channel  = generation * (16 / NUM_GENERATIONS) + sequence / (128 * 127);
+    int rest     = sequence % (128 * 127);
+    int note     = rest % 128;
+    int velocity = rest / 128 + 1;
+    
+    return juce::MidiMessage::noteOn(channel + 1, note, static_cast<juce::uint8>(velocity));
+}
+
+bool MidiLoopbackHarness::decodeSequence(const juce::MidiMessage& message, int& generation, int& sequence)
+{
+    if (!message.isNoteOn())
+        return false;
+    
+    constexpr int channelsPerGeneration = 16 / NUM_GENERATIONS;
+    const int channel = message.getChannel() - 1;
+    
+    generation = channel / channelsPerGeneration;
+    sequence = (channel % channelsPerGeneration) * (128 * 127)
+             + (message.getVelocity() - 1) * 128
+             + message.getNoteNumber();
+    
+    return juce::isPositiveAndBelow(sequence, MAX_SEQUENCE);
+}
@@ -0,0 +1,127 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <atomic>
+
+//==============================================================================
+/**
+ * Log-linear latency histogram in the style of HdrHistogram.
+ *
+ * Values are recorded in microseconds with a fixed number of significant
+ * digits, so the relative error is the same at 50 us and at 500 ms while the
+ * counts array stays small and is allocated once up front.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram(juce::int64 highestTrackableMicros = 10000000, int significantDigits = 2);
+    
+    // Record a single latency sample (negative values are clamped to zero)
+    void record(juce::int64 micros);
+    void reset();
+    
+    juce::int64 getTotalCount() const { return totalCount; }
+    juce::int64 getMin() const { return totalCount > 0 ? minValue : 0; }
+    juce::int64 getMax() const { return maxValue; }
+    double getMean() const;
+    double getStdDeviation() const;
+    
+    // Highest value (in the bucket's resolution) below which the given percentage of samples lie
+    juce::int64 getValueAtPercentile(double percentile) const;
+    
+    // Percentile summary followed by an ASCII plot of the populated buckets
+    juce::String toReportString() const;
+    
+private:
+    int getCountsIndex(juce::int64 value) const;
+    juce::int64 getValueFromIndex(int index) const;
+    juce::int64 getHighestEquivalentValue(int index) const;
+    
+    int subBucketHalfCountMagnitude = 0;
+    int subBucketHalfCount = 0;
+    juce::int64 subBucketMask = 0;
+    juce::int64 highestTrackable = 0;
+    
+    std::vector<juce::int64> counts;
+    juce::int64 totalCount = 0;
+    juce::int64 minValue = 0;
+    juce::int64 maxValue = 0;
+    double sum = 0.0;
+    double sumOfSquares = 0.0;
+};
+
+//==============================================================================
+/**
+ * Measures MIDI output timing without external hardware.
+ *
+ * Creates a virtual MIDI output, subscribes to it with a MidiInput and, for each
+ * swarm size, emits the note traffic the swarm would produce at that size. Every
+ * event is scheduled ahead through MidiOutput::sendBlockOfMessages and tagged with
+ * a sequence number so the receive time can be compared to its scheduled emission.
+ * Each run also tags its events with a generation, so stragglers from the run
+ * before are dropped instead of landing in the next run's histogram.
+ */
+class MidiLoopbackHarness : private juce::MidiInputCallback
+{
+public:
+    struct Settings
+    {
+        juce::Array<int> swarmSizes { 8, 64, 512 };
+        double secondsPerRun = 5.0;
+        double tickRateHz = 25.0;
+        
+        // Fraction of drones that emit a note on any given tick
+        float noteDensity = 0.25f;
+        
+        // How far ahead of real time each tick's events are scheduled
+        double scheduleAheadMs = 20.0;
+    };
+    
+    explicit MidiLoopbackHarness(const Settings& settings);
+    ~MidiLoopbackHarness() override;
+    
+    // Runs every configured swarm size, blocking the calling thread.
+    // Returns false if the loopback port could not be created or subscribed to.
+    bool run(juce::String& report);
+    
+    static constexpr const char* DEVICE_NAME = "DroneSwarm Loopback";
+    
+private:
+    bool openLoopback();
+    void runSwarmSize(int numDrones, juce::String& report);
+    
+    void handleIncomingMidiMessage(juce::MidiInput* source, const juce::MidiMessage& message) override;
+    
+    // Generation and sequence number are packed into channel/note/velocity of a note-on:
+    // the generation takes the top bits of the channel
+    static juce::MidiMessage encodeSequence(int generation, int sequence);
+    static bool decodeSequence(const juce::MidiMessage& message, int& generation, int& sequence);
+    
+    // Stops the input thread recording and waits for a callback that is still inside
+    void quiesceInput();
+    
+    static constexpr int NUM_GENERATIONS = 4;
+    static constexpr int MAX_SEQUENCE = 16 / NUM_GENERATIONS * 128 * 127;
+    
+    Settings settings;
+    std::unique_ptr<juce::MidiOutput> midiOutput;
+    std::unique_ptr<juce::MidiInput> midiInput;
+    
+    // Written by the sending thread before the events are handed to the output,
+    // read by the MIDI input thread. Sized once for MAX_SEQUENCE, never resized.
+    std::vector<double> scheduledTimesMs;
+    std::atomic<int> numReceived { 0 };
+    std::atomic<int> numUnexpected { 0 };
+    
+    // Generation the input thread records for, or -1 between runs; the histogram
+    // is only read or reset while it is -1 and no callback is inside
+    std::atomic<int> activeGeneration { -1 };
+    std::atomic<int> numCallbacksInside { 0 };
+    int runNumber = 0;
+    
+    LatencyHistogram latency;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiLoopbackHarness)
+};
@@ -0,0 +1,63 @@
+#include "SwarmArena.h"
+#include <cstdint>
+
+//==============================================================================
+// SwarmFrameArena implementation
+
+SwarmFrameArena::SwarmFrameArena(size_t initialBytes)
+{
+    addBlock(juce::jmax(static_cast<size_t>(1024), initialBytes));
+}
+
+SwarmFrameArena::~SwarmFrameArena() = default;
+
+void* SwarmFrameArena::allocate(size_t numBytes, size_t alignment)
+{
+    jassert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    auto alignedOffset = [&](const Block& block)
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(block.data.get()) + block.used;
+        return block.used + ((alignment - address % alignment) % alignment);
+    };
+
+    auto offset = alignedOffset(*current);
+
+    if (offset + numBytes > current->size)
+    {
+        addBlock(numBytes + alignment);
+        ++numGrowths;
+        offset = alignedOffset(*current);
+    }
+
+    bytesUsed += offset + numBytes - current->used;
+    current->used = offset + numBytes;
+    highWaterMark = juce::jmax(highWaterMark, bytesUsed);
+    return current->data.get() + offset;
+}
+
+void SwarmFrameArena::reset()
+{
+    // A frame that needed several blocks gets one that holds all of it from now on
+    if (current->previous != nullptr)
+    {
+        auto total = capacity;
+        current.reset();
+        capacity = 0;
+        addBlock(total);
+    }
+
+    current->used = 0;
+    bytesUsed = 0;
+}
+
+void SwarmFrameArena::addBlock(size_t minimumBytes)
+{
+    auto block = std::make_unique<Block>();
+    block->size = juce::jmax(minimumBytes, current != nullptr ? current->size : static_cast<size_t>(0));
+    block->data.malloc(block->size);
+    block->previous = std::move(current);
+
+    capacity += block->size;
+    current = std::move(block);
+}
@@ -0,0 +1,101 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/**
+ * Scratch memory for one frame: allocation bumps a pointer, freeing does
+ * nothing, and reset() gives everything back at once at the start of the next
+ * frame. Whatever was allocated from it is gone after a reset.
+ *
+ * Starts with one block. A frame that needs more chains extra blocks from the
+ * heap, and the next reset() swaps them all for a single block big enough for
+ * that frame, so once the busiest frame has been seen the arena never calls
+ * the heap again. Not thread safe: each thread that prepares frames has its own.
+ */
+class SwarmFrameArena
+{
+public:
+    explicit SwarmFrameArena(size_t initialBytes = DEFAULT_BYTES);
+    ~SwarmFrameArena();
+
+    // Memory for numBytes, aligned to alignment (a power of two)
+    void* allocate(size_t numBytes, size_t alignment = alignof(std::max_align_t));
+
+    // Frees everything allocated since the last reset
+    void reset();
+
+    size_t getBytesUsed() const { return bytesUsed; }
+    size_t getCapacity() const { return capacity; }
+
+    // Most used in any one frame, and how many times a frame outgrew the arena
+    size_t getHighWaterMark() const { return highWaterMark; }
+    int getNumGrowths() const { return numGrowths; }
+
+    static constexpr size_t DEFAULT_BYTES = 64 * 1024;
+
+private:
+    struct Block
+    {
+        juce::HeapBlock<char> data;
+        size_t size = 0;
+        size_t used = 0;
+        std::unique_ptr<Block> previous;
+    };
+
+    void addBlock(size_t minimumBytes);
+
+    std::unique_ptr<Block> current;
+    size_t capacity = 0;
+    size_t bytesUsed = 0;
+    size_t highWaterMark = 0;
+    int numGrowths = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmFrameArena)
+};
+
+//==============================================================================
+/**
+ * Standard allocator over a SwarmFrameArena, for containers that only live
+ * until the arena's next reset. deallocate() is a no-op, so a vector growing
+ * within a frame leaves its old storage behind until then.
+ */
+template <typename T>
+class SwarmArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit SwarmArenaAllocator(SwarmFrameArena& arenaToUse) noexcept : arena(&arenaToUse) {}
+
+    template <typename Other>
+    SwarmArenaAllocator(const SwarmArenaAllocator<Other>& other) noexcept : arena(other.getArena()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    SwarmFrameArena* getArena() const noexcept { return arena; }
+
+    template <typename Other>
+    bool operator== (const SwarmArenaAllocator<Other>& other) const noexcept { return arena == other.getArena(); }
+
+    template <typename Other>
+    bool operator!= (const SwarmArenaAllocator<Other>& other) const noexcept { return arena != other.getArena(); }
+
+private:
+    SwarmFrameArena* arena;
+};
+
+template <typename T>
+using SwarmArenaVector = std::vector<T, SwarmArenaAllocator<T>>;
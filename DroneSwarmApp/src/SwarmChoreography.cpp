@@ -0,0 +1,432 @@
+#include "SwarmChoreography.h"
+#include "SwarmSimulation.h"
+#include <algorithm>
+#include <cmath>
+#include <new>
+
+//==============================================================================
+// SwarmScriptFramePool implementation
+
+void* SwarmScriptFramePool::allocate(size_t numBytes)
+{
+    const auto totalBytes = numBytes + HEADER_BYTES;
+    const auto sizeIndex = (totalBytes + GRANULE - 1) / GRANULE - 1;
+    char* block = nullptr;
+
+    if (sizeIndex >= NUM_SIZES)
+    {
+        block = static_cast<char*>(::operator new (totalBytes));
+        new (block) Header { nullptr, sizeIndex };
+        return block + HEADER_BYTES;
+    }
+
+    if (auto* frame = freeFrames[sizeIndex])
+    {
+        freeFrames[sizeIndex] = frame->next;
+        block = reinterpret_cast<char*>(frame);
+    }
+    else
+    {
+        // What is left of the last chunk is too small for this size, so it stays unused
+        const auto blockBytes = (sizeIndex + 1) * GRANULE;
+
+        if (chunkRemaining < blockBytes)
+        {
+            chunks.push_back(std::make_unique<char[]>(CHUNK_BYTES));
+            chunkPosition = chunks.back().get();
+            chunkRemaining = CHUNK_BYTES;
+        }
+
+        block = chunkPosition;
+        chunkPosition += blockBytes;
+        chunkRemaining -= blockBytes;
+    }
+
+    new (block) Header { this, sizeIndex };
+    return block + HEADER_BYTES;
+}
+
+void SwarmScriptFramePool::deallocate(void* frame) noexcept
+{
+    auto* block = static_cast<char*>(frame) - HEADER_BYTES;
+    const auto header = *reinterpret_cast<Header*>(block);
+
+    if (header.pool == nullptr)
+    {
+        ::operator delete (block);
+        return;
+    }
+
+    auto& freeList = header.pool->freeFrames[header.sizeIndex];
+    freeList = new (block) FreeFrame { freeList };
+}
+
+//==============================================================================
+// Built-in choreographies
+
+namespace
+{
+    constexpr int WAVE_GROUP_SIZE = 4;
+    constexpr int WAVE_RIPPLE_FRAMES = 2;
+
+    // Circle for 8 bars, morph into the spiral over 4, scatter on the downbeat, gather again
+    SwarmScript circleSpiralScatter(SwarmChoreography& choreography)
+    {
+        for (;;)
+        {
+            choreography.setFormation("Circle");
+            choreography.setParameter(SwarmParameterStore::chaos, 0.05f);
+            choreography.setParameter(SwarmParameterStore::formationStrength, 0.8f);
+            co_await choreography.waitBars(8);
+
+            // Loosen the swarm and pull it into the new shape a beat at a time
+            choreography.setFormation("Spiral");
+            const int morphBeats = 4 * choreography.getBeatsPerBar();
+
+            for (int beat = 0; beat < morphBeats; ++beat)
+            {
+                auto progress = static_cast<float>(beat) / static_cast<float>(morphBeats - 1);
+                choreography.setParameter(SwarmParameterStore::formationStrength, 0.2f + 0.6f * progress);
+                co_await choreography.waitBeats(1);
+            }
+
+            choreography.setParameter(SwarmParameterStore::chaos, 1.0f);
+            choreography.setParameter(SwarmParameterStore::formationStrength, 0.05f);
+            co_await choreography.waitBars(2);
+        }
+    }
+
+    // Holds a circle until cue 0, scatters on the next downbeat and gathers two bars later
+    SwarmScript cuedScatter(SwarmChoreography& choreography)
+    {
+        for (;;)
+        {
+            choreography.setFormation("Circle");
+            choreography.setParameter(SwarmParameterStore::chaos, 0.05f);
+            choreography.setParameter(SwarmParameterStore::formationStrength, 0.8f);
+            co_await choreography.waitForCue(0);
+            co_await choreography.waitBars(1);
+
+            choreography.setParameter(SwarmParameterStore::chaos, 1.0f);
+            choreography.setParameter(SwarmParameterStore::formationStrength, 0.05f);
+            co_await choreography.waitBars(2);
+        }
+    }
+
+    // Lifts a few drones onto their slice of a ring for two beats, lets them fall back to
+    // the formation for two, and so on; each group starts a little after the one before
+    SwarmScript waveGroup(SwarmChoreography& choreography, int firstDrone, int numDrones, int group, int numGroups)
+    {
+        const int beatFrames = juce::jmax(1, juce::roundToInt(choreography.getTicksPerBeat()));
+        co_await choreography.waitFrames(1 + (group * WAVE_RIPPLE_FRAMES) % (4 * beatFrames));
+
+        for (;;)
+        {
+            for (int i = 0; i < numDrones; ++i)
+            {
+                auto angle = juce::MathConstants<float>::twoPi * (static_cast<float>(group) + static_cast<float>(i) / numDrones)
+                               / static_cast<float>(numGroups);
+                choreography.setTarget(firstDrone + i, { 12.0f * std::cos(angle), 8.0f, 12.0f * std::sin(angle) });
+            }
+
+            co_await choreography.waitFrames(2 * beatFrames);
+
+            for (int i = 0; i < numDrones; ++i)
+                choreography.clearTarget(firstDrone + i);
+
+            co_await choreography.waitFrames(2 * beatFrames);
+        }
+    }
+
+    // One waveGroup per WAVE_GROUP_SIZE drones over a slow circle
+    SwarmScript groupWaves(SwarmChoreography& choreography)
+    {
+        choreography.setFormation("Circle");
+        choreography.setParameter(SwarmParameterStore::chaos, 0.1f);
+        choreography.setParameter(SwarmParameterStore::formationStrength, 0.6f);
+
+        const int numDrones = choreography.getNumDrones();
+        const int numGroups = (numDrones + WAVE_GROUP_SIZE - 1) / WAVE_GROUP_SIZE;
+
+        for (int group = 0; group < numGroups; ++group)
+        {
+            const int firstDrone = group * WAVE_GROUP_SIZE;
+            choreography.start(waveGroup(choreography, firstDrone, juce::jmin(WAVE_GROUP_SIZE, numDrones - firstDrone),
+                                         group, numGroups));
+        }
+
+        co_return;
+    }
+}
+
+//==============================================================================
+// SwarmChoreography implementation
+
+SwarmChoreography::SwarmChoreography(SwarmSimulation& simulationToDrive)
+    : simulation(simulationToDrive), formationNames(Formation::getFormationTypes())
+{
+}
+
+SwarmChoreography::~SwarmChoreography()
+{
+    stopAll();
+}
+
+std::vector<juce::String> SwarmChoreography::getChoreographyTypes()
+{
+    return {
+        "None",
+        "Circle Spiral Scatter",
+        "Cued Scatter",
+        "Group Waves"
+    };
+}
+
+void SwarmChoreography::play(int index)
+{
+    stopAll();
+
+    // Every piece starts from a clean stage, on its own first beat
+    clearAttractor();
+
+    SwarmCommand clearTargets;
+    clearTargets.type = SwarmCommand::Type::clearTargetOverrides;
+    simulation.applyCommand(clearTargets);
+
+    beatOriginTick = getTick();
+    setTempo(DEFAULT_TEMPO, DEFAULT_BEATS_PER_BAR);
+
+    switch (index)
+    {
+        case 1:     start(circleSpiralScatter(*this)); break;
+        case 2:     start(cuedScatter(*this)); break;
+        case 3:     start(groupWaves(*this)); break;
+        default:    index = 0; break;
+    }
+
+    playing = index;
+}
+
+void SwarmChoreography::start(SwarmScript script)
+{
+    auto handle = std::exchange(script.handle, {});
+
+    if (!handle)
+        return;
+
+    auto& promise = handle.promise();
+    promise.owner = this;
+    promise.nextScript = scripts;
+
+    if (scripts != nullptr)
+        scripts->previousScript = &promise;
+
+    scripts = &promise;
+    ++numScripts;
+
+    handle.resume();
+}
+
+void SwarmChoreography::stopAll()
+{
+    // Destroying a script would pull it out from under advance()
+    jassert(!advancing);
+
+    // Each promise unlinks itself as its frame goes
+    while (scripts != nullptr)
+        SwarmScript::Handle::from_promise(*scripts).destroy();
+
+    sleepers.clear();
+    cueHeads.fill(nullptr);
+    cueTails.fill(nullptr);
+    readyHead = readyTail = nullptr;
+}
+
+void SwarmChoreography::advance()
+{
+    const int tick = getTick();
+    advancing = true;
+
+    // Cued scripts first, then those whose time has come; either may cue or start others
+    for (;;)
+    {
+        if (auto* script = readyHead)
+        {
+            readyHead = script->nextWaiting;
+            script->nextWaiting = nullptr;
+
+            if (readyHead == nullptr)
+                readyTail = nullptr;
+
+            resume(*script);
+        }
+        else if (!sleepers.empty() && sleepers.front().wakeTick <= tick)
+        {
+            std::pop_heap(sleepers.begin(), sleepers.end(), wakesLater);
+            auto* script = sleepers.back().script;
+            sleepers.pop_back();
+            resume(*script);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    advancing = false;
+}
+
+void SwarmChoreography::cue(int cueNumber)
+{
+    if (!juce::isPositiveAndBelow(cueNumber, MAX_CUES))
+        return;
+
+    auto index = static_cast<size_t>(cueNumber);
+
+    if (cueHeads[index] == nullptr)
+        return;
+
+    // The whole list moves to the back of the ready list at once
+    if (readyTail != nullptr)
+        readyTail->nextWaiting = cueHeads[index];
+    else
+        readyHead = cueHeads[index];
+
+    readyTail = cueTails[index];
+    cueHeads[index] = cueTails[index] = nullptr;
+}
+
+//==============================================================================
+SwarmChoreography::TickWait SwarmChoreography::waitFrames(int numFrames)
+{
+    return { *this, getTick() + juce::jmax(1, numFrames) };
+}
+
+SwarmChoreography::TickWait SwarmChoreography::waitBeats(int numBeats)
+{
+    return waitUntilBeat(std::floor(getBeat() + 1.0e-6) + juce::jmax(1, numBeats));
+}
+
+SwarmChoreography::TickWait SwarmChoreography::waitBars(int numBars)
+{
+    auto bar = std::floor(getBeat() / beatsPerBar + 1.0e-6) + juce::jmax(1, numBars);
+    return waitUntilBeat(bar * beatsPerBar);
+}
+
+SwarmChoreography::TickWait SwarmChoreography::waitUntilBeat(double beat)
+{
+    auto wakeTick = beatOriginTick + static_cast<int>(std::ceil(beat * getTicksPerBeat() - 1.0e-6));
+    return { *this, juce::jmax(getTick() + 1, wakeTick) };
+}
+
+void SwarmChoreography::sleepUntil(SwarmScript::promise_type& script, int wakeTick)
+{
+    sleepers.push_back({ wakeTick, nextOrder++, &script });
+    std::push_heap(sleepers.begin(), sleepers.end(), wakesLater);
+}
+
+bool SwarmChoreography::wakesLater(const Sleeper& a, const Sleeper& b)
+{
+    return a.wakeTick != b.wakeTick ? a.wakeTick > b.wakeTick : a.order > b.order;
+}
+
+void SwarmChoreography::waitForCue(SwarmScript::promise_type& script, int cueNumber)
+{
+    auto index = static_cast<size_t>(cueNumber);
+    script.nextWaiting = nullptr;
+
+    if (cueTails[index] != nullptr)
+        cueTails[index]->nextWaiting = &script;
+    else
+        cueHeads[index] = &script;
+
+    cueTails[index] = &script;
+}
+
+void SwarmChoreography::resume(SwarmScript::promise_type& script)
+{
+    SwarmScript::Handle::from_promise(script).resume();
+}
+
+void SwarmChoreography::forget(SwarmScript::promise_type& script)
+{
+    if (script.previousScript != nullptr)
+        script.previousScript->nextScript = script.nextScript;
+    else
+        scripts = script.nextScript;
+
+    if (script.nextScript != nullptr)
+        script.nextScript->previousScript = script.previousScript;
+
+    --numScripts;
+}
+
+//==============================================================================
+void SwarmChoreography::setParameter(SwarmParameterStore::Id id, float value)
+{
+    simulation.getParameters().set(id, value);
+}
+
+void SwarmChoreography::setFormation(juce::StringRef name)
+{
+    // Compared in place, so a script's literal never becomes a String
+    auto found = std::find_if(formationNames.begin(), formationNames.end(),
+                              [name](const juce::String& formationName) { return formationName == name; });
+
+    if (found != formationNames.end())
+        setParameter(SwarmParameterStore::formation, static_cast<float>(std::distance(formationNames.begin(), found)));
+}
+
+void SwarmChoreography::setAttractor(juce::Vector3D<float> position, float strength)
+{
+    SwarmCommand command;
+    command.type = SwarmCommand::Type::setAttractor;
+    command.values[0] = position.x;
+    command.values[1] = position.y;
+    command.values[2] = position.z;
+    command.values[3] = strength;
+    simulation.applyCommand(command);
+}
+
+void SwarmChoreography::clearAttractor()
+{
+    SwarmCommand command;
+    command.type = SwarmCommand::Type::clearAttractor;
+    simulation.applyCommand(command);
+}
+
+void SwarmChoreography::setTarget(int droneIndex, juce::Vector3D<float> position)
+{
+    simulation.setTargetOverride(droneIndex, position);
+}
+
+void SwarmChoreography::clearTarget(int droneIndex)
+{
+    simulation.clearTargetOverride(droneIndex);
+}
+
+int SwarmChoreography::getNumDrones() const
+{
+    return static_cast<int>(simulation.getDrones().size());
+}
+
+int SwarmChoreography::getTick() const
+{
+    return simulation.getTick();
+}
+
+double SwarmChoreography::getBeat() const
+{
+    return (getTick() - beatOriginTick) / getTicksPerBeat();
+}
+
+void SwarmChoreography::setTempo(double beatsPerMinute, int newBeatsPerBar)
+{
+    tempo = juce::jlimit(20.0, 300.0, beatsPerMinute);
+    beatsPerBar = juce::jmax(1, newBeatsPerBar);
+}
+
+double SwarmChoreography::getTicksPerBeat() const
+{
+    return 60.0 / tempo / SwarmSimulation::TICK_SECONDS;
+}
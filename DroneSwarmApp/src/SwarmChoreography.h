@@ -0,0 +1,294 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "SwarmParameters.h"
+
+class SwarmSimulation;
+class SwarmChoreography;
+
+//==============================================================================
+/**
+ * Memory for suspended script frames.
+ *
+ * Frames are rounded up to a multiple of GRANULE and kept on one free list
+ * per size, carved from CHUNK_BYTES chunks. Starting a script therefore only
+ * calls the heap when more scripts of its size are alive than ever before;
+ * frames too big for any list go to the heap directly. Not thread safe: it
+ * belongs to one choreography, on the simulation's thread.
+ */
+class SwarmScriptFramePool
+{
+public:
+    SwarmScriptFramePool() = default;
+
+    void* allocate(size_t numBytes);
+
+    // Finds the frame's pool from the header in front of it
+    static void deallocate(void* frame) noexcept;
+
+    size_t getCapacity() const { return chunks.size() * CHUNK_BYTES; }
+
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t NUM_SIZES = 32;            // pooled frames up to 2 KB
+    static constexpr size_t CHUNK_BYTES = 64 * 1024;
+
+private:
+    struct Header
+    {
+        SwarmScriptFramePool* pool;
+        size_t sizeIndex;
+    };
+
+    struct FreeFrame
+    {
+        FreeFrame* next;
+    };
+
+    // Keeps the frame behind the header aligned for anything
+    static constexpr size_t HEADER_BYTES = (sizeof(Header) + alignof(std::max_align_t) - 1)
+                                             / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    std::array<FreeFrame*, NUM_SIZES> freeFrames {};
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* chunkPosition = nullptr;
+    size_t chunkRemaining = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(SwarmScriptFramePool)
+};
+
+//==============================================================================
+/**
+ * A choreography script: a C++20 coroutine that moves the swarm and waits for
+ * frames, beats, bars or cues in between.
+ *
+ * A script is a free (or static) function returning SwarmScript whose first
+ * parameter is the SwarmChoreography running it; its frame comes from that
+ * choreography's pool. It does nothing until passed to
+ * SwarmChoreography::start(), which owns it from then on.
+ *
+ *     SwarmScript pulse(SwarmChoreography& choreography)
+ *     {
+ *         for (;;)
+ *         {
+ *             choreography.setParameter(SwarmParameterStore::chaos, 0.8f);
+ *             co_await choreography.waitBeats(1);
+ *             choreography.setParameter(SwarmParameterStore::chaos, 0.1f);
+ *             co_await choreography.waitBeats(3);
+ *         }
+ *     }
+ */
+class SwarmScript
+{
+public:
+    struct promise_type
+    {
+        template <typename... Args>
+        static void* operator new(size_t numBytes, SwarmChoreography& choreography, Args&&...);
+        static void operator delete(void* frame) noexcept { SwarmScriptFramePool::deallocate(frame); }
+
+        SwarmScript get_return_object() { return SwarmScript(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+
+        // A script that throws just ends
+        void unhandled_exception() noexcept { jassertfalse; }
+
+        ~promise_type();
+
+        // Set by SwarmChoreography::start(); all running scripts are linked together
+        SwarmChoreography* owner = nullptr;
+        promise_type* previousScript = nullptr;
+        promise_type* nextScript = nullptr;
+
+        // Next script waiting for the same cue, or ready to run this tick
+        promise_type* nextWaiting = nullptr;
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    SwarmScript(SwarmScript&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    SwarmScript& operator= (SwarmScript&&) = delete;
+
+    // Destroys a script that was never started
+    ~SwarmScript()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+private:
+    friend class SwarmChoreography;
+
+    explicit SwarmScript(Handle scriptHandle) : handle(scriptHandle) {}
+
+    Handle handle;
+
+    JUCE_DECLARE_NON_COPYABLE(SwarmScript)
+};
+
+//==============================================================================
+/**
+ * Runs choreography scripts against a simulation, one tick at a time.
+ *
+ * Scripts waiting for time sit in a heap ordered by the tick they wake on, and
+ * scripts waiting for a cue in a list per cue, so advance() touches only the
+ * scripts that are due: a thousand idle scripts cost nothing per tick. Scripts
+ * run on the simulation's thread, inside its step, after its commands and
+ * before the parameters are applied, so what they set takes effect in the
+ * same step. Beats are counted from when the running choreography was played,
+ * and land on the first tick at or after them.
+ */
+class SwarmChoreography
+{
+public:
+    explicit SwarmChoreography(SwarmSimulation& simulationToDrive);
+    ~SwarmChoreography();
+
+    // Stops whatever runs and starts built-in choreography index of getChoreographyTypes()
+    // (0 = none), with all target overrides and the attractor cleared
+    void play(int index);
+    int getPlaying() const { return playing; }
+
+    // Runs script up to its first wait and keeps it until it ends. Scripts may start others.
+    void start(SwarmScript script);
+
+    // Destroys every running script; not from inside a script
+    void stopAll();
+
+    // Resumes the scripts that are due this tick (SwarmSimulation::getTick())
+    void advance();
+
+    // Wakes the scripts waiting for cue (0 to MAX_CUES - 1) at the next advance()
+    void cue(int cueNumber);
+
+    int getNumScripts() const { return numScripts; }
+    const SwarmScriptFramePool& getFramePool() const { return framePool; }
+    SwarmScriptFramePool& getFramePool() { return framePool; }
+
+    //==============================================================================
+    // Waits, for co_await in a script. Each one waits at least until the next tick.
+    struct TickWait
+    {
+        SwarmChoreography& choreography;
+        int wakeTick;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(SwarmScript::Handle script) { choreography.sleepUntil(script.promise(), wakeTick); }
+        void await_resume() const noexcept {}
+    };
+
+    struct CueWait
+    {
+        SwarmChoreography& choreography;
+        int cueNumber;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(SwarmScript::Handle script) { choreography.waitForCue(script.promise(), cueNumber); }
+        void await_resume() const noexcept {}
+    };
+
+    // Simulation ticks (SwarmSimulation::TICK_SECONDS each)
+    TickWait waitFrames(int numFrames);
+
+    // Until the numBeats-th beat (or bar line) from now
+    TickWait waitBeats(int numBeats);
+    TickWait waitBars(int numBars);
+
+    CueWait waitForCue(int cueNumber) { return { *this, juce::jlimit(0, MAX_CUES - 1, cueNumber) }; }
+
+    //==============================================================================
+    // What scripts can do to the swarm
+
+    void setParameter(SwarmParameterStore::Id id, float value);
+
+    // By name from Formation::getFormationTypes(); unknown names are ignored
+    void setFormation(juce::StringRef name);
+
+    void setAttractor(juce::Vector3D<float> position, float strength);
+    void clearAttractor();
+
+    // One drone's target, instead of its formation's
+    void setTarget(int droneIndex, juce::Vector3D<float> position);
+    void clearTarget(int droneIndex);
+
+    int getNumDrones() const;
+    int getTick() const;
+
+    // Beats since play(), fractional
+    double getBeat() const;
+
+    void setTempo(double beatsPerMinute, int newBeatsPerBar);
+    double getTicksPerBeat() const;
+    int getBeatsPerBar() const { return beatsPerBar; }
+
+    //==============================================================================
+    // Built-in choreographies, by index for play()
+    static std::vector<juce::String> getChoreographyTypes();
+
+    static constexpr int MAX_CUES = 16;
+    static constexpr double DEFAULT_TEMPO = 120.0;
+    static constexpr int DEFAULT_BEATS_PER_BAR = 4;
+
+private:
+    friend struct SwarmScript::promise_type;
+
+    struct Sleeper
+    {
+        int wakeTick;
+        juce::uint32 order;     // scripts due on the same tick resume in the order they slept
+        SwarmScript::promise_type* script;
+    };
+
+    // Heap order for sleepers: the earliest wake tick on top
+    static bool wakesLater(const Sleeper& a, const Sleeper& b);
+
+    TickWait waitUntilBeat(double beat);
+    void sleepUntil(SwarmScript::promise_type& script, int wakeTick);
+    void waitForCue(SwarmScript::promise_type& script, int cueNumber);
+    void resume(SwarmScript::promise_type& script);
+    void forget(SwarmScript::promise_type& script);
+
+    SwarmSimulation& simulation;
+    SwarmScriptFramePool framePool;
+
+    SwarmScript::promise_type* scripts = nullptr;
+    int numScripts = 0;
+    bool advancing = false;
+
+    std::vector<Sleeper> sleepers;
+    juce::uint32 nextOrder = 0;
+
+    std::array<SwarmScript::promise_type*, MAX_CUES> cueHeads {}, cueTails {};
+    SwarmScript::promise_type* readyHead = nullptr;
+    SwarmScript::promise_type* readyTail = nullptr;
+
+    int playing = 0;
+    int beatOriginTick = 0;
+    double tempo = DEFAULT_TEMPO;
+    int beatsPerBar = DEFAULT_BEATS_PER_BAR;
+    std::vector<juce::String> formationNames;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmChoreography)
+};
+
+//==============================================================================
+template <typename... Args>
+void* SwarmScript::promise_type::operator new(size_t numBytes, SwarmChoreography& choreography, Args&&...)
+{
+    return choreography.getFramePool().allocate(numBytes);
+}
+
+inline SwarmScript::promise_type::~promise_type()
+{
+    if (owner != nullptr)
+        owner->forget(*this);
+}
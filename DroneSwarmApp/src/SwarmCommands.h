@@ -0,0 +1,152 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+#include <atomic>
+
+//==============================================================================
+/**
+ * A control change for the simulation, posted from another thread and applied
+ * at the start of the next frame
+ */
+struct SwarmCommand
+{
+    enum class Type
+    {
+        setChaos,               // values[0]
+        setFormationStrength,   // values[0]
+        setFormation,           // intValue = index into Formation::getFormationTypes()
+        setAttractor,           // values[0..2] = position, values[3] = strength
+        clearAttractor,
+        applyTargetOverrides,   // intValue = TargetOverridePool batch index
+        clearTargetOverrides,
+        playChoreography,       // intValue = index into SwarmChoreography::getChoreographyTypes()
+        cue                     // intValue = cue number for the running choreography
+    };
+    
+    Type type = Type::setChaos;
+    int intValue = 0;
+    float values[4] = {};
+};
+
+//==============================================================================
+/**
+ * Lock-free single-producer/single-consumer queue of SwarmCommands.
+ *
+ * The producer is a network or MIDI thread, the consumer is the simulation.
+ * Storage is fixed, so neither side ever allocates or blocks.
+ */
+class SwarmCommandQueue
+{
+public:
+    SwarmCommandQueue() = default;
+    
+    // Returns false if the queue is full and the command was dropped
+    bool push(const SwarmCommand& command)
+    {
+        auto scope = fifo.write(1);
+        
+        if (scope.blockSize1 == 0)
+            return false;
+        
+        commands[static_cast<size_t>(scope.startIndex1)] = command;
+        return true;
+    }
+    
+    // Calls handler for every queued command, oldest first
+    template <typename Handler>
+    void drain(Handler&& handler)
+    {
+        auto scope = fifo.read(fifo.getNumReady());
+        
+        for (int i = 0; i < scope.blockSize1; ++i)
+            handler(commands[static_cast<size_t>(scope.startIndex1 + i)]);
+        
+        for (int i = 0; i < scope.blockSize2; ++i)
+            handler(commands[static_cast<size_t>(scope.startIndex2 + i)]);
+    }
+    
+    static constexpr int CAPACITY = 1024;
+    
+private:
+    std::array<SwarmCommand, CAPACITY> commands;
+    juce::AbstractFifo fifo { CAPACITY };
+    
+    JUCE_DECLARE_NON_COPYABLE(SwarmCommandQueue)
+};
+
+//==============================================================================
+/**
+ * Preallocated batches of per-drone target overrides.
+ *
+ * A producer claims a free batch, fills it with as many overrides as arrive
+ * in one datagram and posts a single applyTargetOverrides command carrying the
+ * batch index. The simulation applies the whole batch in one pass and releases
+ * it. Thousands of overrides therefore cost one queue slot and no locks.
+ */
+class TargetOverridePool
+{
+public:
+    struct Batch
+    {
+        int count = 0;
+        std::vector<int> droneIndices;
+        std::vector<float> x, y, z;
+        
+        bool add(int droneIndex, float px, float py, float pz)
+        {
+            if (count >= static_cast<int>(droneIndices.size()))
+                return false;
+            
+            auto i = static_cast<size_t>(count++);
+            droneIndices[i] = droneIndex;
+            x[i] = px;
+            y[i] = py;
+            z[i] = pz;
+            return true;
+        }
+    };
+    
+    explicit TargetOverridePool(int maxOverridesPerBatch = 16384)
+    {
+        for (auto& batch : batches)
+        {
+            batch.droneIndices.resize(static_cast<size_t>(maxOverridesPerBatch));
+            batch.x.resize(static_cast<size_t>(maxOverridesPerBatch));
+            batch.y.resize(static_cast<size_t>(maxOverridesPerBatch));
+            batch.z.resize(static_cast<size_t>(maxOverridesPerBatch));
+        }
+    }
+    
+    // Producer side: returns a free batch index, or -1 if every batch is still in flight
+    int acquire()
+    {
+        for (int i = 0; i < NUM_BATCHES; ++i)
+        {
+            bool expected = false;
+            
+            if (inUse[static_cast<size_t>(i)].compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                batches[static_cast<size_t>(i)].count = 0;
+                return i;
+            }
+        }
+        
+        return -1;
+    }
+    
+    Batch& getBatch(int index) { return batches[static_cast<size_t>(index)]; }
+    
+    // Either side: hands the batch back once applied (or abandoned)
+    void release(int index) { inUse[static_cast<size_t>(index)].store(false, std::memory_order_release); }
+    
+    static constexpr int NUM_BATCHES = 4;
+    
+private:
+    std::array<Batch, NUM_BATCHES> batches;
+    std::array<std::atomic<bool>, NUM_BATCHES> inUse {};
+    
+    JUCE_DECLARE_NON_COPYABLE(TargetOverridePool)
+};
@@ -0,0 +1,433 @@
+#include "SwarmFrameSequence.h"
+#include "SwarmSimulation.h"
+#include "SwarmRenderer.h"
+#include "SwarmSoftwareRenderer.h"
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace juce::gl;
+
+namespace
+{
+    // Encodes finished frames on every core but one. Encoding takes longer than drawing,
+    // so the image pool bounds how far drawing can run ahead of it.
+    class FrameWriters
+    {
+    public:
+        FrameWriters(const juce::File& directory, SwarmFrameSequenceRenderer::Format formatToWrite, int width, int height)
+            : numWriters(juce::jmax(1, juce::SystemStats::getNumCpus() - 1)),
+              pool(juce::ThreadPoolOptions().withThreadName("Frame writer").withNumberOfThreads(numWriters)),
+              outputDirectory(directory),
+              format(formatToWrite)
+        {
+            for (int i = 0; i < numWriters * 2; ++i)
+                images.emplace_back(juce::Image::ARGB, width, height, false, juce::SoftwareImageType());
+        }
+        
+        // An image no queued write holds any more, waiting for one if need be
+        juce::Image& acquire()
+        {
+            auto waitStart = juce::Time::getMillisecondCounterHiRes();
+            
+            for (;;)
+            {
+                // An image is free again once only the pool holds it
+                for (auto& candidate : images)
+                {
+                    if (candidate.getReferenceCount() == 1)
+                    {
+                        waitMs += juce::Time::getMillisecondCounterHiRes() - waitStart;
+                        return candidate;
+                    }
+                }
+                
+                juce::Thread::sleep(1);
+            }
+        }
+        
+        void write(const juce::Image& image, int frame)
+        {
+            const auto extension = format == SwarmFrameSequenceRenderer::Format::png ? ".png" : ".raw";
+            auto file = outputDirectory.getChildFile("frame_" + juce::String(frame).paddedLeft('0', 5) + extension);
+            
+            pool.addJob([image, file, format = format, &failed = numFailedWrites]
+            {
+                // Blending leaves partial alpha behind; the frames are opaque
+                const juce::Image::BitmapData pixels(image, juce::Image::BitmapData::readWrite);
+                
+                for (int y = 0; y < pixels.height; ++y)
+                {
+                    auto* line = reinterpret_cast<juce::PixelARGB*>(pixels.getLinePointer(y));
+                    
+                    for (int x = 0; x < pixels.width; ++x)
+                        line[x].setAlpha(255);
+                }
+                
+                file.deleteFile();
+                juce::FileOutputStream stream(file);
+                bool written = stream.openedOk();
+                
+                if (written && format == SwarmFrameSequenceRenderer::Format::png)
+                    written = juce::PNGImageFormat().writeImageToStream(image, stream);
+                else if (written)
+                    for (int y = 0; y < pixels.height && written; ++y)
+                        written = stream.write(pixels.getLinePointer(y), static_cast<size_t>(pixels.width) * 4);
+                
+                if (!written)
+                    ++failed;
+            });
+        }
+        
+        void waitForAll()
+        {
+            while (pool.getNumJobs() > 0)
+                juce::Thread::sleep(2);
+        }
+        
+        int getNumWriters() const { return numWriters; }
+        int getNumFailedWrites() const { return numFailedWrites.load(); }
+        double getWaitMs() const { return waitMs; }
+        
+    private:
+        const int numWriters;
+        juce::ThreadPool pool;
+        juce::File outputDirectory;
+        SwarmFrameSequenceRenderer::Format format;
+        std::vector<juce::Image> images;
+        std::atomic<int> numFailedWrites { 0 };
+        double waitMs = 0.0;
+    };
+}
+
+//==============================================================================
+// SwarmFrameSequenceRenderer Implementation
+//==============================================================================
+
+SwarmFrameSequenceRenderer::SwarmFrameSequenceRenderer(const Settings& newSettings)
+    : settings(newSettings)
+{
+}
+
+void SwarmFrameSequenceRenderer::addPrograms(SwarmShaderManager& shaders)
+{
+    SwarmDroneRenderer::addPrograms(shaders);
+    SwarmTrailRenderer::addPrograms(shaders);
+}
+
+bool SwarmFrameSequenceRenderer::prepare(SwarmSimulation& simulation, SwarmAutomationTrack& automation,
+                                         juce::String& report) const
+{
+    if (!settings.outputDirectory.createDirectory())
+    {
+        report = "Could not create " + settings.outputDirectory.getFullPathName();
+        return false;
+    }
+    
+    if (settings.automationFile != juce::File())
+    {
+        juce::String error;
+        
+        if (!automation.loadFromFile(settings.automationFile, error))
+        {
+            report = error;
+            return false;
+        }
+        
+        simulation.setAutomationReplay(&automation);
+    }
+    
+    if (settings.choreography > 0)
+        simulation.getChoreography().play(settings.choreography);
+    
+    simulation.setTrailLength(settings.trailLength);
+    return true;
+}
+
+int SwarmFrameSequenceRenderer::getNumFrames() const
+{
+    return juce::roundToInt(settings.seconds * 1000.0 / SwarmSimulation::UPDATE_INTERVAL_MS);
+}
+
+void SwarmFrameSequenceRenderer::addTimings(juce::String& report, int numFrames, double elapsedSeconds,
+                                            double drawnMs, double waitMs, int numWriters) const
+{
+    const double videoSeconds = numFrames * SwarmSimulation::UPDATE_INTERVAL_MS / 1000.0;
+    
+    report << juce::newLine
+           << "Wall time " << juce::String(elapsedSeconds, 3) << " s ("
+           << juce::String(videoSeconds / juce::jmax(1.0e-6, elapsedSeconds), 1) << "x real time at "
+           << 1000 / SwarmSimulation::UPDATE_INTERVAL_MS << " fps), drawing done after "
+           << juce::String(drawnMs / 1000.0, 3) << " s, " << juce::String(waitMs / 1000.0, 3)
+           << " s of it waiting on " << numWriters << " writers";
+    
+    if (settings.format == Format::raw)
+        report << juce::newLine << "Raw frames are " << settings.width << "x" << settings.height
+               << " 8-bit BGRA, top row first";
+}
+
+bool SwarmFrameSequenceRenderer::run(SwarmShaderManager& shaders, juce::String& report)
+{
+    SwarmDroneRenderer droneRenderer(shaders);
+    SwarmTrailRenderer trailRenderer(shaders);
+    
+    if (!droneRenderer.isReady() || !trailRenderer.isReady())
+    {
+        report = "Frame render: the drone and trail programs did not build";
+        return false;
+    }
+    
+    SwarmSimulation simulation(settings.numDrones);
+    SwarmAutomationTrack automation;
+    
+    if (!prepare(simulation, automation, report))
+        return false;
+    
+    const int width = settings.width;
+    const int height = settings.height;
+    const auto frameBytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+    
+    // Draw multisampled, then resolve into a plain framebuffer to read from
+    GLint maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    const GLsizei samples = juce::jlimit(1, MAX_SAMPLES, static_cast<int>(maxSamples));
+    
+    std::array<GLuint, 2> framebuffers {};     // multisampled, resolved
+    std::array<GLuint, 3> renderbuffers {};    // multisampled colour and depth, resolved colour
+    glGenFramebuffers(2, framebuffers.data());
+    glGenRenderbuffers(3, renderbuffers.data());
+    
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[2]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[2]);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    
+    std::array<GLuint, READBACK_BUFFERS> pixelBuffers {};
+    std::array<GLsync, READBACK_BUFFERS> fences {};
+    glGenBuffers(READBACK_BUFFERS, pixelBuffers.data());
+    
+    for (auto buffer : pixelBuffers)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(frameBytes), nullptr, GL_STREAM_READ);
+    }
+    
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    FrameWriters writers(settings.outputDirectory, settings.format, width, height);
+    
+    // Copies a finished readback into a free image and queues it for writing
+    auto collect = [&](int frame)
+    {
+        const auto slot = static_cast<size_t>(frame % READBACK_BUFFERS);
+        glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+        
+        auto& image = writers.acquire();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        
+        if (auto* source = static_cast<const juce::uint8*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                                              static_cast<GLsizeiptr>(frameBytes),
+                                                                              GL_MAP_READ_BIT)))
+        {
+            // GL rows run bottom up; BGRA bytes are already JUCE's pixel layout
+            const juce::Image::BitmapData pixels(image, juce::Image::BitmapData::writeOnly);
+            const auto rowBytes = static_cast<size_t>(width) * 4;
+            
+            for (int y = 0; y < height; ++y)
+                std::memcpy(pixels.getLinePointer(y), source + static_cast<size_t>(height - 1 - y) * rowBytes, rowBytes);
+            
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        writers.write(image, frame);
+    };
+    
+    const int numFrames = complete ? getNumFrames() : 0;
+    SwarmSnapshot snapshot;
+    SwarmScenePainter::View view;
+    const juce::Rectangle<int> viewport(width, height);
+    auto startMs = juce::Time::getMillisecondCounterHiRes();
+    
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        simulation.step();
+        snapshot.capture(simulation, false);
+        
+        // Same slow turn as the app's view
+        view.rotationAngle = std::fmod(view.rotationAngle + 0.005f, juce::MathConstants<float>::twoPi);
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+        glViewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        
+        droneRenderer.cull(snapshot, view, viewport);
+        droneRenderer.render(1.0f);
+        trailRenderer.update(snapshot);
+        trailRenderer.render(droneRenderer.getCamera(), 1.0f);
+        
+        // Resolve, then start this frame's readback without waiting for it
+        const auto slot = static_cast<size_t>(frame % READBACK_BUFFERS);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[1]);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        
+        // The previous frame has had a whole frame of GPU time to arrive
+        if (frame > 0)
+            collect(frame - 1);
+    }
+    
+    if (numFrames > 0)
+        collect(numFrames - 1);
+    
+    auto drawnMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+    writers.waitForAll();
+    auto elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteBuffers(READBACK_BUFFERS, pixelBuffers.data());
+    glDeleteRenderbuffers(3, renderbuffers.data());
+    glDeleteFramebuffers(2, framebuffers.data());
+    droneRenderer.release();
+    trailRenderer.release();
+    
+    if (!complete)
+    {
+        report = "Frame render: could not create a " + juce::String(width) + "x" + juce::String(height)
+               + " framebuffer";
+        return false;
+    }
+    
+    report << "Rendered " << numFrames << " frames of " << settings.numDrones << " drones at " << width << "x"
+           << height << " (" << samples << "x MSAA) to " << settings.outputDirectory.getFullPathName();
+    addTimings(report, numFrames, elapsedSeconds, drawnMs, writers.getWaitMs(), writers.getNumWriters());
+    
+    if (writers.getNumFailedWrites() > 0)
+        report << juce::newLine << "Failed to write " << writers.getNumFailedWrites() << " frames";
+    
+    return writers.getNumFailedWrites() == 0;
+}
+    
+bool SwarmFrameSequenceRenderer::runSoftware(juce::String& report)
+{
+    SwarmSimulation simulation(settings.numDrones);
+    SwarmAutomationTrack automation;
+    
+    if (!prepare(simulation, automation, report))
+        return false;
+    
+    // Bands are rasterised on the worker pool while earlier frames are encoded
+    SwarmWorkerPool workers;
+    SwarmSoftwareRenderer softwareRenderer(workers);
+    FrameWriters writers(settings.outputDirectory, settings.format, settings.width, settings.height);
+    
+    // Same framing as the GL frames: the painter's sizes are logical pixels at 720 rows
+    constexpr float logicalHeight = 720.0f;
+    const float scale = static_cast<float>(settings.height) / logicalHeight;
+    
+    const int numFrames = getNumFrames();
+    SwarmSnapshot snapshot;
+    SwarmScenePainter::View view;
+    view.showTrails = settings.trailLength > 0;
+    auto startMs = juce::Time::getMillisecondCounterHiRes();
+    
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        simulation.step();
+        snapshot.capture(simulation, view.showTrails);
+        view.rotationAngle = std::fmod(view.rotationAngle + 0.005f, juce::MathConstants<float>::twoPi);
+        
+        auto& image = writers.acquire();
+        softwareRenderer.render(snapshot, view, 1.0f, scale, image);
+        writers.write(image, frame);
+    }
+    
+    auto drawnMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+    writers.waitForAll();
+    auto elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    
+    report << "Rendered " << numFrames << " frames of " << settings.numDrones << " drones at " << settings.width
+           << "x" << settings.height << " (software) to " << settings.outputDirectory.getFullPathName();
+    addTimings(report, numFrames, elapsedSeconds, drawnMs, writers.getWaitMs(), writers.getNumWriters());
+    
+    if (writers.getNumFailedWrites() > 0)
+        report << juce::newLine << "Failed to write " << writers.getNumFailedWrites() << " frames";
+    
+    return writers.getNumFailedWrites() == 0;
+}
+
+//==============================================================================
+// SwarmFrameSequenceHost Implementation
+//==============================================================================
+
+SwarmFrameSequenceHost::SwarmFrameSequenceHost(const SwarmFrameSequenceRenderer::Settings& settings,
+                                               const juce::File& shaderCacheDirectory,
+                                               std::function<void(bool)> finishedCallback)
+    : shaders(shaderCacheDirectory), renderer(settings), onFinished(std::move(finishedCallback))
+{
+    setSize(64, 64);
+    
+    openGLContext.setRenderer(this);
+    openGLContext.setOpenGLVersionRequired(juce::OpenGLContext::openGL3_2);
+    openGLContext.setComponentPaintingEnabled(false);
+    openGLContext.setContinuousRepainting(true);
+    openGLContext.attachTo(*this);
+}
+
+SwarmFrameSequenceHost::~SwarmFrameSequenceHost()
+{
+    openGLContext.detach();
+}
+
+void SwarmFrameSequenceHost::newOpenGLContextCreated()
+{
+    SwarmFrameSequenceRenderer::addPrograms(shaders);
+}
+
+void SwarmFrameSequenceHost::renderOpenGL()
+{
+    shaders.update();
+    
+    if (rendered || !shaders.isFinished())
+        return;
+    
+    rendered = true;
+    
+    juce::String report;
+    auto ok = renderer.run(shaders, report);
+    juce::Logger::writeToLog(report);
+    
+    juce::MessageManager::callAsync([safeThis = juce::Component::SafePointer<SwarmFrameSequenceHost>(this), ok]
+    {
+        if (safeThis != nullptr && safeThis->onFinished != nullptr)
+            safeThis->onFinished(ok);
+    });
+}
+
+void SwarmFrameSequenceHost::openGLContextClosing()
+{
+    shaders.release();
+}
@@ -0,0 +1,104 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+
+#include "SwarmShaders.h"
+
+class SwarmSimulation;
+class SwarmAutomationTrack;
+
+//==============================================================================
+/**
+ * Offline render of the swarm to an image sequence, one image per simulation
+ * step, for preview videos.
+ *
+ * Each frame is drawn by the app's own renderers into a multisampled
+ * framebuffer at the chosen size and resolved. Readback goes through two
+ * pixel-buffer objects: while frame N is read into one, frame N-1 is mapped
+ * from the other, so the GPU never waits on the CPU. Mapped pixels are copied
+ * into a small pool of images and encoded by a pool of writer threads. Nothing
+ * waits on a clock, so the render runs as fast as the GPU and the writers can
+ * go. Without a display, runSoftware() draws the same frames with
+ * SwarmSoftwareRenderer instead (no MSAA, but no GL context either).
+ */
+class SwarmFrameSequenceRenderer
+{
+public:
+    enum class Format { png, raw };
+    
+    struct Settings
+    {
+        juce::File outputDirectory;
+        int numDrones = 8;
+        int width = 1280;
+        int height = 720;
+        double seconds = 5.0;
+        int trailLength = 20;
+        Format format = Format::png;
+        
+        // Optional parameter automation to replay (see SwarmAutomationTrack)
+        juce::File automationFile;
+        
+        // Built-in choreography to play (index into SwarmChoreography::getChoreographyTypes())
+        int choreography = 0;
+    };
+    
+    explicit SwarmFrameSequenceRenderer(const Settings& settings);
+    
+    // Queues the programs run() draws with; call once per context
+    static void addPrograms(SwarmShaderManager& shaders);
+    
+    // Renders every frame and waits for the files; needs the GL context active and
+    // the programs built. Returns false if nothing could be rendered.
+    bool run(SwarmShaderManager& shaders, juce::String& report);
+    
+    // Renders every frame on the CPU and waits for the files; needs no display
+    bool runSoftware(juce::String& report);
+    
+    static constexpr int READBACK_BUFFERS = 2;
+    static constexpr int MAX_SAMPLES = 4;
+    
+private:
+    // Sets up the simulation from the settings and creates the output directory
+    bool prepare(SwarmSimulation& simulation, SwarmAutomationTrack& automation, juce::String& report) const;
+    int getNumFrames() const;
+    void addTimings(juce::String& report, int numFrames, double elapsedSeconds, double drawnMs, double waitMs,
+                    int numWriters) const;
+    
+    Settings settings;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmFrameSequenceRenderer)
+};
+
+//==============================================================================
+/**
+ * Holds the GL context for a SwarmFrameSequenceRenderer.
+ *
+ * JUCE only creates contexts for components on screen, so this sits in a
+ * small window; without a display the app uses runSoftware() instead. Once
+ * the programs are built it renders the whole sequence in one go and reports
+ * back on the message thread.
+ */
+class SwarmFrameSequenceHost : public juce::Component,
+                               private juce::OpenGLRenderer
+{
+public:
+    SwarmFrameSequenceHost(const SwarmFrameSequenceRenderer::Settings& settings, const juce::File& shaderCacheDirectory,
+                           std::function<void(bool)> onFinished);
+    ~SwarmFrameSequenceHost() override;
+    
+private:
+    void newOpenGLContextCreated() override;
+    void renderOpenGL() override;
+    void openGLContextClosing() override;
+    
+    juce::OpenGLContext openGLContext;
+    SwarmShaderManager shaders;
+    SwarmFrameSequenceRenderer renderer;
+    std::function<void(bool)> onFinished;
+    bool rendered = false;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmFrameSequenceHost)
+};
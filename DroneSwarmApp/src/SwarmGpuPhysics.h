@@ -0,0 +1,121 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <memory>
+#include <array>
+
+#include "SwarmSimulation.h"
+#include "SwarmShaders.h"
+
+//==============================================================================
+/**
+ * A prototype of GPU physics for very large swarms, on OpenGL 3.3 transform
+ * feedback (which Mesa's llvmpipe also runs). Only the parity check uses it:
+ * no mode steps the live swarm on the GPU, and its note candidates do not
+ * reach note generation or MIDI.
+ *
+ * Drone state lives in two GPU buffers that a vertex shader ping-pongs
+ * between each step, integrating exactly as SwarmDrone::update does: target
+ * attraction, chaos noise, damping, the speed limit and boundary reflection.
+ * Formation targets are still computed on the CPU and uploaded as a texture
+ * buffer. A second pass keeps only the drones that left their note cell, so
+ * what comes back to the CPU is a compact list of SwarmNoteCandidates, read
+ * through fenced slots so that polling never waits on the GPU.
+ *
+ * The CPU simulation is the one that plays: runParityCheck() steps both side
+ * by side and compares them. Everything here runs on the GL thread.
+ */
+class SwarmGpuPhysics
+{
+public:
+    explicit SwarmGpuPhysics(SwarmShaderManager& shaders);
+    ~SwarmGpuPhysics();
+    
+    // Queues the physics programs on the shader manager; call once per context
+    static void addPrograms(SwarmShaderManager& shaders);
+    
+    // True once the programs have linked
+    bool isReady() const;
+    
+    // Copies the drones' positions, velocities and note cells to the GPU, replacing its state
+    void upload(const SwarmSimulation& simulation);
+    
+    // Integrates one step towards the drones' current targets
+    void step(const SwarmSimulation& simulation, float chaosLevel, float formationStrength);
+    
+    // Non-blocking: moves the candidates of the oldest finished step into destination and
+    // returns true, or returns false if no step has finished since the last call
+    bool pollNoteCandidates(std::vector<SwarmNoteCandidate>& destination, int& stepFrame);
+    
+    // Blocking read of the current state, for checks and debugging
+    void readState(std::vector<juce::Vector3D<float>>& positions, std::vector<int>& noteCells);
+    
+    int getNumDrones() const { return numDrones; }
+    
+    // Frees every GL object; call before the context goes away
+    void release();
+    
+    // Steps a CPU and a GPU swarm side by side without chaos (noise can't match) and
+    // compares positions and note candidates; returns false if they diverge
+    static bool runParityCheck(SwarmShaderManager& shaders, int numDrones, int numSteps, juce::String& report);
+    
+    static constexpr int STATE_FLOATS = 8;      // per drone
+    static constexpr int CANDIDATE_FLOATS = 8;  // per candidate
+    static constexpr int READBACK_SLOTS = 3;    // steps in flight before unread candidates are overwritten
+    
+private:
+    struct CandidateSlot
+    {
+        GLuint buffer = 0;
+        GLuint query = 0;
+        GLsync fence = nullptr;
+        int frame = 0;
+        bool pending = false;
+    };
+    
+    // Uniform locations, looked up once for each program object: a rebuilt or cache-loaded
+    // program has a new id, which triggers the lookup again
+    struct PhysicsUniforms
+    {
+        GLuint program = 0;
+        GLint targets = -1, chaosLevel = -1, formationStrength = -1, frame = -1, stepSeconds = -1;
+        GLint numSubSteps = -1, numCells = -1, cellHysteresis = -1, reseatCells = -1;
+    };
+    
+    struct CandidateUniforms
+    {
+        GLuint program = 0;
+        GLint reseatCells = -1;
+    };
+    
+    void updateUniformLocations(GLuint physicsProgram, GLuint candidateProgram);
+    void allocate(int newNumDrones);
+    void bindStateAttributes(GLuint buffer, GLuint firstLocation, bool includeVelocity);
+    void readCandidates(CandidateSlot& slot, std::vector<SwarmNoteCandidate>& destination);
+    
+    SwarmShaderManager& shaders;
+    int numDrones = 0;
+    
+    // Ping-pong state: step() reads stateBuffers[current] and writes the other one
+    std::array<GLuint, 2> stateBuffers {};
+    std::array<GLuint, 2> physicsArrays {};     // reading from each buffer
+    std::array<GLuint, 2> candidateArrays {};   // previous = each buffer, current = the other
+    int current = 0;
+    
+    GLuint targetBuffer = 0;
+    GLuint targetTexture = 0;
+    std::vector<float> targetData;
+    
+    std::array<CandidateSlot, READBACK_SLOTS> slots;
+    int nextSlot = 0;
+    std::vector<float> readbackData;
+    
+    int scaleChangeCount = -1;
+    
+    PhysicsUniforms physicsUniforms;
+    CandidateUniforms candidateUniforms;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmGpuPhysics)
+};
@@ -0,0 +1,172 @@
+#include "SwarmHeapCounter.h"
+#include "SwarmInstrumentation.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if DRONESWARM_HEAP_CHECK
+
+// With glibc the C allocator and pthread_mutex_lock can be replaced from the
+// executable too, which catches the calls JUCE, the drivers and other libraries make
+#if JUCE_LINUX && defined (__GLIBC__)
+ #define SWARM_INTERPOSE_LIBC 1
+ #include <dlfcn.h>
+ #include <pthread.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void __libc_free(void*);
+}
+#else
+ #define SWARM_INTERPOSE_LIBC 0
+#endif
+
+namespace
+{
+    // Constant-initialised, so it is safe from the first allocation of any thread
+    thread_local juce::int64 threadHeapCalls = 0;
+
+    void noteAllocation(std::size_t size) noexcept
+    {
+        ++threadHeapCalls;
+        SwarmRealtimeCheck::noteCall(SwarmRealtimeCheck::allocation, size);
+    }
+
+    void noteFree() noexcept
+    {
+        ++threadHeapCalls;
+        SwarmRealtimeCheck::noteCall(SwarmRealtimeCheck::deallocation, 0);
+    }
+
+    void* countedAllocate(std::size_t size) noexcept
+    {
+        noteAllocation(size);
+
+       #if SWARM_INTERPOSE_LIBC
+        return __libc_malloc(size != 0 ? size : 1);
+       #else
+        return std::malloc(size != 0 ? size : 1);
+       #endif
+    }
+
+    void countedFree(void* pointer) noexcept
+    {
+        if (pointer == nullptr)
+            return;
+
+        noteFree();
+
+       #if SWARM_INTERPOSE_LIBC
+        __libc_free(pointer);
+       #else
+        std::free(pointer);
+       #endif
+    }
+}
+
+juce::int64 SwarmHeapCounter::getThreadCount() noexcept
+{
+    return threadHeapCalls;
+}
+
+//==============================================================================
+// Global replacements
+
+void* operator new (std::size_t size)
+{
+    if (auto* pointer = countedAllocate(size))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void operator delete (void* pointer) noexcept                               { countedFree(pointer); }
+void operator delete[] (void* pointer) noexcept                             { countedFree(pointer); }
+void operator delete (void* pointer, std::size_t) noexcept                  { countedFree(pointer); }
+void operator delete[] (void* pointer, std::size_t) noexcept                { countedFree(pointer); }
+void operator delete (void* pointer, const std::nothrow_t&) noexcept        { countedFree(pointer); }
+void operator delete[] (void* pointer, const std::nothrow_t&) noexcept      { countedFree(pointer); }
+
+#if SWARM_INTERPOSE_LIBC
+//==============================================================================
+// C replacements: glibc's own memalign and friends still allocate from the
+// heap these free into, so only the common four are needed
+
+extern "C" void* malloc(size_t size) noexcept
+{
+    return countedAllocate(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept
+{
+    noteAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) noexcept
+{
+    // Moving a block frees the old one and allocates a new one. Without a block to
+    // start from it is only an allocation, and with a size of 0 only a free
+    if (pointer == nullptr)
+        return countedAllocate(size);
+
+    if (size == 0)
+    {
+        countedFree(pointer);
+        return nullptr;
+    }
+
+    noteFree();
+    noteAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) noexcept
+{
+    countedFree(pointer);
+}
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+{
+    using LockFunction = int (*)(pthread_mutex_t*);
+    static std::atomic<LockFunction> realLock { nullptr };
+
+    auto function = realLock.load(std::memory_order_relaxed);
+
+    if (function == nullptr)
+    {
+        function = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        realLock.store(function, std::memory_order_relaxed);
+    }
+
+    SwarmRealtimeCheck::noteCall(SwarmRealtimeCheck::lock, 0);
+    return function(mutex);
+}
+#endif
+
+#else
+
+juce::int64 SwarmHeapCounter::getThreadCount() noexcept
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,39 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Set to 1 in the project's preprocessor definitions to build the heap counting
+#ifndef DRONESWARM_HEAP_CHECK
+ #define DRONESWARM_HEAP_CHECK 0
+#endif
+
+//==============================================================================
+/**
+ * Counts calls to the global heap, per thread.
+ *
+ * SwarmHeapCounter.cpp replaces the global operator new and delete (plain,
+ * array, sized and nothrow) with versions that count each call on the calling
+ * thread before going to malloc and free. On Linux with glibc it replaces
+ * malloc, calloc, realloc and free as well, so calls made inside JUCE and the
+ * system libraries count too (a realloc as a free and an allocation, unless it
+ * is given no block or a size of 0), and pthread_mutex_lock, which only reports to
+ * SwarmRealtimeCheck. Reading the count before and after a piece of work tells
+ * how many times that work touched the heap. Every call is also passed on to
+ * SwarmRealtimeCheck. Only the app links it: a plugin must not replace its
+ * host's allocator. Over-aligned new/delete is not counted, nor is malloc on
+ * other platforms.
+ *
+ * The replacements are a diagnostic and cost every allocation a few
+ * instructions, so they are only built with DRONESWARM_HEAP_CHECK=1 in the
+ * project's preprocessor definitions. Without it nothing is replaced and the
+ * count stays at 0.
+ */
+struct SwarmHeapCounter
+{
+    // True when this build replaces the allocator and counts
+    static constexpr bool isCounting = DRONESWARM_HEAP_CHECK != 0;
+    
+    // new and delete calls made on this thread so far (0 unless isCounting)
+    static juce::int64 getThreadCount() noexcept;
+};
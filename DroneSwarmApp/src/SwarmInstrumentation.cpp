@@ -0,0 +1,258 @@
+#include "SwarmInstrumentation.h"
+#include <atomic>
+#include <cstdlib>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <execinfo.h>
+ #define SWARM_HAS_BACKTRACE 1
+#else
+ #define SWARM_HAS_BACKTRACE 0
+#endif
+
+namespace
+{
+    // recordCallSite() itself; what is left of the check and the interposed function
+    // above the caller depends on what the compiler inlined, so it stays in
+    constexpr int SKIPPED_FRAMES = 1;
+
+    // Written once by the thread that claims it, then only counted
+    struct CallSite
+    {
+        std::atomic<bool> ready { false };
+        int subsystem = 0;
+        int call = 0;
+        size_t bytes = 0;
+        int numFrames = 0;
+        std::array<void*, SwarmRealtimeCheck::MAX_FRAMES> frames {};
+        std::atomic<juce::int64> count { 0 };
+    };
+
+    // All constant-initialised: the first heap call can come before any constructor runs
+    std::atomic<bool> checking { false };
+    std::atomic<bool> checkingLocks { false };
+    std::array<std::array<std::atomic<juce::int64>, SwarmRealtimeCheck::numCalls>,
+               SwarmRealtimeCheck::numSubsystems> counts {};
+    std::array<CallSite, SwarmRealtimeCheck::MAX_CALL_SITES> callSites;
+    std::atomic<int> numCallSites { 0 };
+
+    thread_local int threadSubsystem = -1;
+    thread_local bool insideCheck = false;
+
+    void recordCallSite(int subsystem, int call, size_t bytes) noexcept
+    {
+        std::array<void*, SwarmRealtimeCheck::MAX_FRAMES> frames {};
+        int numFrames = 0;
+
+       #if SWARM_HAS_BACKTRACE
+        numFrames = backtrace(frames.data(), static_cast<int>(frames.size()));
+       #endif
+
+        // The same site again only adds to its count
+        const int numClaimed = juce::jmin(numCallSites.load(), SwarmRealtimeCheck::MAX_CALL_SITES);
+
+        for (int i = 0; i < numClaimed; ++i)
+        {
+            auto& site = callSites[static_cast<size_t>(i)];
+
+            if (site.ready.load(std::memory_order_acquire) && site.subsystem == subsystem && site.call == call
+                && site.numFrames == numFrames && site.frames == frames)
+            {
+                ++site.count;
+                return;
+            }
+        }
+
+        const int index = numCallSites.fetch_add(1);
+
+        if (index >= SwarmRealtimeCheck::MAX_CALL_SITES)
+            return;
+
+        auto& site = callSites[static_cast<size_t>(index)];
+        site.subsystem = subsystem;
+        site.call = call;
+        site.bytes = bytes;
+        site.numFrames = numFrames;
+        site.frames = frames;
+        site.count = 1;
+        site.ready.store(true, std::memory_order_release);
+    }
+}
+
+//==============================================================================
+// SwarmRealtimeCheck implementation
+
+void SwarmRealtimeCheck::enable(bool checkLocks)
+{
+   #if SWARM_HAS_BACKTRACE
+    // The first backtrace loads the unwinder, which allocates; get that over with here
+    std::array<void*, MAX_FRAMES> frames {};
+    backtrace(frames.data(), static_cast<int>(frames.size()));
+   #endif
+
+    checkingLocks = checkLocks;
+    checking = true;
+}
+
+bool SwarmRealtimeCheck::isEnabled() noexcept
+{
+    return checking.load(std::memory_order_relaxed);
+}
+
+SwarmRealtimeCheck::ScopedRealtime::ScopedRealtime(Subsystem subsystem) noexcept
+    : previousSubsystem(threadSubsystem)
+{
+    threadSubsystem = subsystem;
+}
+
+SwarmRealtimeCheck::ScopedRealtime::~ScopedRealtime() noexcept
+{
+    threadSubsystem = previousSubsystem;
+}
+
+void SwarmRealtimeCheck::noteCall(Call call, size_t bytes) noexcept
+{
+    const int subsystem = threadSubsystem;
+
+    if (subsystem < 0 || insideCheck || !checking.load(std::memory_order_relaxed))
+        return;
+
+    if (call == lock && !checkingLocks.load(std::memory_order_relaxed))
+        return;
+
+    // Taking the backtrace can itself end up in here
+    insideCheck = true;
+    counts[static_cast<size_t>(subsystem)][static_cast<size_t>(call)].fetch_add(1, std::memory_order_relaxed);
+    recordCallSite(subsystem, call, bytes);
+    insideCheck = false;
+}
+
+juce::int64 SwarmRealtimeCheck::getNumViolations() noexcept
+{
+    juce::int64 total = 0;
+
+    for (auto& subsystemCounts : counts)
+        for (auto& count : subsystemCounts)
+            total += count.load(std::memory_order_relaxed);
+
+    return total;
+}
+
+juce::int64 SwarmRealtimeCheck::getNumViolations(Subsystem subsystem, Call call) noexcept
+{
+    return counts[static_cast<size_t>(subsystem)][static_cast<size_t>(call)].load(std::memory_order_relaxed);
+}
+
+juce::String SwarmRealtimeCheck::createReport(int maxCallSites)
+{
+    juce::String report;
+    report << "Real-time check: " << getNumViolations() << " heap calls"
+           << (checkingLocks ? " and locks" : "") << " on real-time threads";
+
+    for (int s = 0; s < numSubsystems; ++s)
+    {
+        auto subsystem = static_cast<Subsystem>(s);
+        report << juce::newLine << "  " << getName(subsystem) << ": "
+               << getNumViolations(subsystem, allocation) << " allocations, "
+               << getNumViolations(subsystem, deallocation) << " frees, "
+               << getNumViolations(subsystem, lock) << " locks";
+    }
+
+    const int numSites = juce::jmin(numCallSites.load(), MAX_CALL_SITES, maxCallSites);
+
+    for (int i = 0; i < numSites; ++i)
+    {
+        auto& site = callSites[static_cast<size_t>(i)];
+
+        if (!site.ready.load(std::memory_order_acquire))
+            continue;
+
+        report << juce::newLine << juce::newLine << site.count.load() << " x " << getName(static_cast<Call>(site.call))
+               << " in " << getName(static_cast<Subsystem>(site.subsystem));
+
+        if (site.call == allocation)
+            report << " (" << static_cast<juce::int64>(site.bytes) << " bytes the first time)";
+
+       #if SWARM_HAS_BACKTRACE
+        if (auto** symbols = backtrace_symbols(site.frames.data(), site.numFrames))
+        {
+            for (int f = SKIPPED_FRAMES; f < site.numFrames; ++f)
+                report << juce::newLine << "    " << symbols[f];
+
+            std::free(symbols);
+        }
+       #endif
+    }
+
+    if (numCallSites.load() > MAX_CALL_SITES)
+        report << juce::newLine << juce::newLine << "Only the first " << MAX_CALL_SITES << " call sites were kept";
+
+    return report;
+}
+
+const char* SwarmRealtimeCheck::getName(Subsystem subsystem)
+{
+    switch (subsystem)
+    {
+        case simulation:    return "simulation";
+        case output:        return "MIDI/synth/OSC output";
+        case audio:         return "audio";
+        case numSubsystems: break;
+    }
+
+    return "";
+}
+
+const char* SwarmRealtimeCheck::getName(Call call)
+{
+    switch (call)
+    {
+        case allocation:    return "allocation";
+        case deallocation:  return "free";
+        case lock:          return "mutex lock";
+        case numCalls:      break;
+    }
+
+    return "";
+}
+
+//==============================================================================
+// SwarmMemoryReport implementation
+
+size_t SwarmMemoryReport::getTotal() const
+{
+    size_t total = 0;
+
+    for (auto categoryBytes : bytes)
+        total += categoryBytes;
+
+    return total;
+}
+
+juce::String SwarmMemoryReport::toString() const
+{
+    auto kilobytes = [](size_t numBytes) { return juce::String(static_cast<double>(numBytes) / 1024.0, 1) + " KB"; };
+
+    juce::String text("Memory:");
+
+    for (int c = 0; c < numCategories; ++c)
+        text << " " << getName(static_cast<Category>(c)) << " " << kilobytes(get(static_cast<Category>(c))) << ",";
+
+    text << " total " << kilobytes(getTotal());
+    return text;
+}
+
+const char* SwarmMemoryReport::getName(Category category)
+{
+    switch (category)
+    {
+        case drones:        return "drones";
+        case trails:        return "trails";
+        case notes:         return "notes";
+        case snapshots:     return "snapshots";
+        case glBuffers:     return "GL buffers";
+        case midiBuffers:   return "MIDI/synth buffers";
+        case numCategories: break;
+    }
+
+    return "";
+}
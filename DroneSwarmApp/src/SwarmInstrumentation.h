@@ -0,0 +1,85 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+//==============================================================================
+/**
+ * Catches heap calls and blocking locks made on threads that must never make
+ * them.
+ *
+ * A ScopedRealtime marks the calling thread as doing real-time work for one
+ * subsystem until it goes out of scope. The functions SwarmHeapCounter.cpp
+ * puts in place of operator new/delete (and, on Linux, malloc, free and
+ * pthread_mutex_lock) in DRONESWARM_HEAP_CHECK builds report every call to
+ * noteCall(); once enable() has been called, each one made inside a scope is
+ * counted against its subsystem and its call site is kept as a raw backtrace. Backtraces are only turned into
+ * symbols by createReport(), on a thread that may allocate.
+ *
+ * Only the app links this: the plugin runs in a host whose allocator it must
+ * not replace.
+ */
+class SwarmRealtimeCheck
+{
+public:
+    enum Subsystem { simulation, output, audio, numSubsystems };
+    enum Call { allocation, deallocation, lock, numCalls };
+
+    // Starts recording; checkLocks adds pthread_mutex_lock, where it can be interposed
+    static void enable(bool checkLocks);
+    static bool isEnabled() noexcept;
+
+    // Marks the calling thread real-time, working for subsystem, while it exists
+    class ScopedRealtime
+    {
+    public:
+        explicit ScopedRealtime(Subsystem subsystem) noexcept;
+        ~ScopedRealtime() noexcept;
+
+    private:
+        int previousSubsystem;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtime)
+    };
+
+    // Called by the interposed functions; never allocates or locks
+    static void noteCall(Call call, size_t bytes) noexcept;
+
+    // Calls made inside scopes since enable(), in total and by subsystem
+    static juce::int64 getNumViolations() noexcept;
+    static juce::int64 getNumViolations(Subsystem subsystem, Call call) noexcept;
+
+    // Counts by subsystem, then each call site with its backtrace (up to maxCallSites of them)
+    static juce::String createReport(int maxCallSites = MAX_CALL_SITES);
+
+    static const char* getName(Subsystem subsystem);
+    static const char* getName(Call call);
+
+    static constexpr int MAX_CALL_SITES = 64;   // distinct backtraces kept
+    static constexpr int MAX_FRAMES = 24;       // per backtrace
+};
+
+//==============================================================================
+/**
+ * How much memory the app's big consumers hold, by what they hold it for.
+ *
+ * Each owner reports its own bytes (container capacity, GL storage) and this
+ * adds them up, so the figures are what the data structures have reserved
+ * rather than what the heap has handed out.
+ */
+struct SwarmMemoryReport
+{
+    enum Category { drones, trails, notes, snapshots, glBuffers, midiBuffers, numCategories };
+
+    void add(Category category, size_t numBytes) { bytes[static_cast<size_t>(category)] += numBytes; }
+    size_t get(Category category) const { return bytes[static_cast<size_t>(category)]; }
+    size_t getTotal() const;
+
+    // One line: each category and the total, in KB
+    juce::String toString() const;
+
+    static const char* getName(Category category);
+
+    std::array<size_t, numCategories> bytes {};
+};
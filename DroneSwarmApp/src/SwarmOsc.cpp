@@ -0,0 +1,609 @@
+#include "SwarmOsc.h"
+#include "SwarmSimulation.h"
+#include <cstring>
+#include <cstdio>
+
+//==============================================================================
+// OscWriter Implementation
+//==============================================================================
+
+void OscWriter::writeInt32(juce::int32 value)
+{
+    jassert(remaining() >= 4);
+    auto bigEndian = juce::ByteOrder::swapIfLittleEndian(static_cast<juce::uint32>(value));
+    std::memcpy(data + size, &bigEndian, 4);
+    size += 4;
+}
+
+void OscWriter::writeFloat32(float value)
+{
+    juce::uint32 bits;
+    std::memcpy(&bits, &value, 4);
+    writeInt32(static_cast<juce::int32>(bits));
+}
+
+void OscWriter::writeTimeTag(juce::uint64 ntpTime)
+{
+    writeInt32(static_cast<juce::int32>(ntpTime >> 32));
+    writeInt32(static_cast<juce::int32>(ntpTime & 0xffffffff));
+}
+
+void OscWriter::writePadded(const char* bytes, int numBytes)
+{
+    jassert(numBytes % 4 == 0 && remaining() >= numBytes);
+    std::memcpy(data + size, bytes, static_cast<size_t>(numBytes));
+    size += numBytes;
+}
+
+void OscWriter::writeBlob(const void* bytes, int numBytes)
+{
+    auto padded = paddedSize(numBytes);
+    jassert(remaining() >= 4 + padded);
+    
+    writeInt32(numBytes);
+    std::memcpy(data + size, bytes, static_cast<size_t>(numBytes));
+    std::memset(data + size + numBytes, 0, static_cast<size_t>(padded - numBytes));
+    size += padded;
+}
+
+//==============================================================================
+// OscStateSender Implementation
+//==============================================================================
+
+namespace
+{
+    // "#bundle" string plus time tag
+    constexpr int BUNDLE_HEADER_BYTES = 16;
+    
+    // ",ffffi" with terminator, padded
+    constexpr char DRONE_TYPE_TAGS[8] = { ',', 'f', 'f', 'f', 'f', 'i', 0, 0 };
+    constexpr int DRONE_ARGUMENT_BYTES = 4 * 4 + 4;
+    
+    constexpr char BLOB_ADDRESS[12] = "/swarm/blob";
+    constexpr char BLOB_TYPE_TAGS[8] = { ',', 'i', 'i', 'b', 0, 0, 0, 0 };
+    constexpr int BLOB_MESSAGE_OVERHEAD = 4 + sizeof(BLOB_ADDRESS) + sizeof(BLOB_TYPE_TAGS) + 4 + 4 + 4;
+    
+    juce::uint16 quantise(float value, float range)
+    {
+        auto scaled = juce::jlimit(-1.0f, 1.0f, value / range) * 32767.0f;
+        return static_cast<juce::uint16>(static_cast<juce::int16>(juce::roundToInt(scaled)));
+    }
+}
+
+OscStateSender::OscStateSender()
+    : juce::Thread("OSC state sender")
+{
+}
+
+OscStateSender::~OscStateSender()
+{
+    stop();
+}
+
+bool OscStateSender::start(const Settings& newSettings)
+{
+    stop();
+    settings = newSettings;
+    settings.maxPacketBytes = juce::jlimit(256, 65507, settings.maxPacketBytes);
+    settings.numPackets = juce::jmax(4, settings.numPackets);
+    
+    packets.clear();
+    packets.resize(static_cast<size_t>(settings.numPackets));
+    
+    for (auto& packet : packets)
+        packet.data.allocate(static_cast<size_t>(settings.maxPacketBytes), true);
+    
+    fifo = std::make_unique<juce::AbstractFifo>(settings.numPackets);
+    currentPacket = -1;
+    numDroppedPackets = 0;
+    numSentPackets = 0;
+    
+    if (!startThread())
+    {
+        juce::Logger::writeToLog("OSC: could not start the sender thread");
+        return false;
+    }
+    
+    juce::Logger::writeToLog("OSC: streaming drone state to " + settings.host + ":" + juce::String(settings.port)
+                             + (settings.mode == Mode::quantisedBlob ? " (quantised blobs)" : ""));
+    return true;
+}
+
+void OscStateSender::stop()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+        packetsQueued.signal();
+        stopThread(1000);
+    }
+}
+
+void OscStateSender::pushFrame(const std::vector<std::unique_ptr<SwarmDrone>>& drones, int frameNumber)
+{
+    if (!isThreadRunning() || drones.empty())
+        return;
+    
+    if (settings.mode == Mode::quantisedBlob)
+    {
+        packBlobs(drones, frameNumber);
+    }
+    else
+    {
+        prepareAddresses(static_cast<int>(drones.size()));
+        packMessages(drones);
+    }
+    
+    packetsQueued.signal();
+}
+
+void OscStateSender::prepareAddresses(int numDrones)
+{
+    // Only allocates when the swarm grows beyond anything seen before
+    auto numCached = static_cast<int>(addressSizes.size());
+    
+    if (numDrones <= numCached)
+        return;
+    
+    addresses.resize(static_cast<size_t>(numDrones * ADDRESS_STRIDE), 0);
+    addressSizes.resize(static_cast<size_t>(numDrones));
+    
+    for (int i = numCached; i < numDrones; ++i)
+    {
+        auto* address = addresses.data() + i * ADDRESS_STRIDE;
+        auto length = std::snprintf(address, ADDRESS_STRIDE, "/swarm/drone/%d", i);
+        addressSizes[static_cast<size_t>(i)] = OscWriter::paddedStringSize(length);
+    }
+}
+
+bool OscStateSender::beginPacket()
+{
+    int start1, size1, start2, size2;
+    fifo->prepareToWrite(1, start1, size1, start2, size2);
+    
+    if (size1 == 0)
+    {
+        // Sender thread has fallen behind; drop rather than block the frame loop
+        ++numDroppedPackets;
+        return false;
+    }
+    
+    currentPacket = start1;
+    auto& packet = packets[static_cast<size_t>(currentPacket)];
+    
+    writer = { packet.data.get(), settings.maxPacketBytes, 0 };
+    writer.writePadded("#bundle\0", 8);
+    writer.writeTimeTag(OscWriter::TIME_TAG_IMMEDIATELY);
+    return true;
+}
+
+void OscStateSender::finishPacket()
+{
+    if (currentPacket < 0)
+        return;
+    
+    if (writer.size > BUNDLE_HEADER_BYTES)
+    {
+        packets[static_cast<size_t>(currentPacket)].size = writer.size;
+        fifo->finishedWrite(1);
+    }
+    
+    currentPacket = -1;
+}
+
+void OscStateSender::packMessages(const std::vector<std::unique_ptr<SwarmDrone>>& drones)
+{
+    for (size_t i = 0; i < drones.size(); ++i)
+    {
+        auto& drone = *drones[i];
+        auto addressSize = addressSizes[i];
+        auto messageSize = addressSize + static_cast<int>(sizeof(DRONE_TYPE_TAGS)) + DRONE_ARGUMENT_BYTES;
+        
+        if (currentPacket >= 0 && writer.remaining() < 4 + messageSize)
+            finishPacket();
+        
+        if (currentPacket < 0 && !beginPacket())
+            return;
+        
+        writer.writeInt32(messageSize);
+        writer.writePadded(addresses.data() + i * ADDRESS_STRIDE, addressSize);
+        writer.writePadded(DRONE_TYPE_TAGS, sizeof(DRONE_TYPE_TAGS));
+        writer.writeFloat32(drone.position.x);
+        writer.writeFloat32(drone.position.y);
+        writer.writeFloat32(drone.position.z);
+        writer.writeFloat32(drone.velocity.length());
+        writer.writeInt32(drone.noteActive ? drone.currentNote : 0);
+    }
+    
+    finishPacket();
+}
+
+void OscStateSender::packBlobs(const std::vector<std::unique_ptr<SwarmDrone>>& drones, int frameNumber)
+{
+    const int numDrones = static_cast<int>(drones.size());
+    const int dronesPerPacket = (settings.maxPacketBytes - BUNDLE_HEADER_BYTES - BLOB_MESSAGE_OVERHEAD) / BLOB_RECORD_BYTES;
+    
+    for (int first = 0; first < numDrones; first += dronesPerPacket)
+    {
+        if (!beginPacket())
+            return;
+        
+        const int count = juce::jmin(dronesPerPacket, numDrones - first);
+        const int blobBytes = count * BLOB_RECORD_BYTES;
+        
+        writer.writeInt32(BLOB_MESSAGE_OVERHEAD - 4 + blobBytes);
+        writer.writePadded(BLOB_ADDRESS, sizeof(BLOB_ADDRESS));
+        writer.writePadded(BLOB_TYPE_TAGS, sizeof(BLOB_TYPE_TAGS));
+        writer.writeInt32(frameNumber);
+        writer.writeInt32(first);
+        writer.writeInt32(blobBytes);
+        
+        // Records are written in place, straight into the packet
+        auto* record = reinterpret_cast<juce::uint8*>(writer.data + writer.size);
+        
+        for (int i = first; i < first + count; ++i, record += BLOB_RECORD_BYTES)
+        {
+            auto& drone = *drones[static_cast<size_t>(i)];
+            const juce::uint16 xyz[] = { quantise(drone.position.x, BLOB_RANGE),
+                                         quantise(drone.position.y, BLOB_RANGE),
+                                         quantise(drone.position.z, BLOB_RANGE) };
+            
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                record[axis * 2]     = static_cast<juce::uint8>(xyz[axis] >> 8);
+                record[axis * 2 + 1] = static_cast<juce::uint8>(xyz[axis] & 0xff);
+            }
+            
+            record[6] = static_cast<juce::uint8>(juce::jlimit(0, 255, juce::roundToInt(drone.velocity.length() / BLOB_MAX_SPEED * 255.0f)));
+            record[7] = static_cast<juce::uint8>(drone.noteActive ? drone.currentNote : 0);
+        }
+        
+        // Records are a multiple of four bytes, so no padding is needed
+        writer.size += blobBytes;
+        finishPacket();
+    }
+}
+
+void OscStateSender::run()
+{
+    while (!threadShouldExit())
+    {
+        packetsQueued.wait(100);
+        
+        int start1, size1, start2, size2;
+        fifo->prepareToRead(fifo->getNumReady(), start1, size1, start2, size2);
+        
+        auto sendRange = [this](int start, int count)
+        {
+            for (int i = start; i < start + count; ++i)
+            {
+                auto& packet = packets[static_cast<size_t>(i)];
+                
+                if (socket.write(settings.host, settings.port, packet.data.get(), packet.size) == packet.size)
+                    ++numSentPackets;
+                else
+                    ++numDroppedPackets;
+            }
+        };
+        
+        sendRange(start1, size1);
+        sendRange(start2, size2);
+        fifo->finishedRead(size1 + size2);
+    }
+}
+
+//==============================================================================
+// OscReader Implementation
+//==============================================================================
+
+const char* OscReader::skipString(const char* p, const char* end)
+{
+    auto* terminator = static_cast<const char*>(std::memchr(p, 0, static_cast<size_t>(end - p)));
+    
+    if (terminator == nullptr)
+        return nullptr;
+    
+    auto* next = p + OscWriter::paddedStringSize(static_cast<int>(terminator - p));
+    return next <= end ? next : nullptr;
+}
+
+juce::int32 OscReader::readInt32(const char* p)
+{
+    juce::uint32 bigEndian;
+    std::memcpy(&bigEndian, p, 4);
+    return static_cast<juce::int32>(juce::ByteOrder::swapIfLittleEndian(bigEndian));
+}
+
+float OscReader::readFloat32(const char* p)
+{
+    auto bits = readInt32(p);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+//==============================================================================
+// OscControlReceiver Implementation
+//==============================================================================
+
+OscControlReceiver::OscControlReceiver(SwarmCommandQueue& commandQueue, TargetOverridePool& targetOverrides)
+    : juce::Thread("OSC control receiver"), commands(commandQueue), overrides(targetOverrides)
+{
+}
+
+OscControlReceiver::~OscControlReceiver()
+{
+    stop();
+}
+
+bool OscControlReceiver::start(int port)
+{
+    stop();
+    
+    socket = std::make_unique<juce::DatagramSocket>(false);
+    
+    if (!socket->bindToPort(port))
+    {
+        juce::Logger::writeToLog("OSC: could not listen on UDP port " + juce::String(port));
+        socket.reset();
+        return false;
+    }
+    
+    buffer.allocate(MAX_DATAGRAM_BYTES, true);
+    
+    // Resolved here so names can be matched on the receiver thread without allocating
+    for (auto& name : Formation::getFormationTypes())
+        formationNames.add(name);
+    
+    for (auto& name : SwarmChoreography::getChoreographyTypes())
+        choreographyNames.add(name);
+    
+    if (!startThread())
+        return false;
+    
+    juce::Logger::writeToLog("OSC: listening for control messages on UDP port " + juce::String(port));
+    return true;
+}
+
+void OscControlReceiver::stop()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+        
+        // Unblocks the pending read
+        if (socket != nullptr)
+            socket->shutdown();
+        
+        stopThread(1000);
+    }
+    
+    socket.reset();
+}
+
+void OscControlReceiver::run()
+{
+    while (!threadShouldExit())
+    {
+        if (socket->waitUntilReady(true, 100) != 1)
+            continue;
+        
+        auto numBytes = socket->read(buffer.get(), MAX_DATAGRAM_BYTES, false);
+        
+        if (numBytes > 0)
+            handleDatagram(buffer.get(), numBytes);
+    }
+}
+
+void OscControlReceiver::handleDatagram(const char* data, int size)
+{
+    // Make sure every string inside the datagram is terminated before parsing in place
+    if (size < 4 || size >= MAX_DATAGRAM_BYTES || size % 4 != 0)
+        return;
+    
+    OscReader::parsePacket(data, size, [this](const OscMessageView& message) { handleMessage(message); });
+    
+    // One command per datagram, however many overrides it carried
+    if (currentBatch >= 0)
+    {
+        if (overrides.getBatch(currentBatch).count > 0)
+        {
+            SwarmCommand command;
+            command.type = SwarmCommand::Type::applyTargetOverrides;
+            command.intValue = currentBatch;
+            
+            if (!commands.push(command))
+            {
+                ++numDroppedCommands;
+                overrides.release(currentBatch);
+            }
+        }
+        else
+        {
+            overrides.release(currentBatch);
+        }
+        
+        currentBatch = -1;
+    }
+}
+
+void OscControlReceiver::handleMessage(const OscMessageView& message)
+{
+    SwarmCommand command;
+    float value = 0.0f;
+    
+    if (message.addressIs("/swarm/chaos") && getNumber(message, 0, value))
+    {
+        command.type = SwarmCommand::Type::setChaos;
+        command.values[0] = juce::jlimit(0.0f, 1.0f, value);
+        post(command);
+    }
+    else if (message.addressIs("/swarm/strength") && getNumber(message, 0, value))
+    {
+        command.type = SwarmCommand::Type::setFormationStrength;
+        command.values[0] = juce::jlimit(0.0f, 1.0f, value);
+        post(command);
+    }
+    else if (message.addressIs("/swarm/formation"))
+    {
+        auto index = getChoice(message, formationNames);
+        
+        if (index >= 0)
+        {
+            command.type = SwarmCommand::Type::setFormation;
+            command.intValue = index;
+            post(command);
+        }
+    }
+    else if (message.addressIs("/swarm/choreography"))
+    {
+        auto index = getChoice(message, choreographyNames);
+        
+        if (index >= 0)
+        {
+            command.type = SwarmCommand::Type::playChoreography;
+            command.intValue = index;
+            post(command);
+        }
+    }
+    else if (message.addressIs("/swarm/cue") && getNumber(message, 0, value))
+    {
+        command.type = SwarmCommand::Type::cue;
+        command.intValue = static_cast<int>(value);
+        post(command);
+    }
+    else if (message.addressIs("/swarm/attractor"))
+    {
+        if (message.getNumArguments() >= 3)
+        {
+            command.type = SwarmCommand::Type::setAttractor;
+            command.values[3] = 0.5f;
+            
+            for (int i = 0; i < 4; ++i)
+                getNumber(message, i, command.values[i]);
+            
+            post(command);
+        }
+        else
+        {
+            command.type = SwarmCommand::Type::clearAttractor;
+            post(command);
+        }
+    }
+    else if (message.addressIs("/swarm/attractor/off"))
+    {
+        command.type = SwarmCommand::Type::clearAttractor;
+        post(command);
+    }
+    else if (message.addressIs("/swarm/target"))
+    {
+        float index, x, y, z;
+        
+        if (getNumber(message, 0, index) && getNumber(message, 1, x)
+             && getNumber(message, 2, y) && getNumber(message, 3, z))
+            addTargetOverride(static_cast<int>(index), x, y, z);
+    }
+    else if (message.addressIs("/swarm/targets"))
+    {
+        // First drone index followed by a blob of float32 x/y/z triplets
+        if (std::strncmp(message.typeTags, "ib", 2) != 0 || message.end - message.arguments < 8)
+            return;
+        
+        auto firstIndex = OscReader::readInt32(message.arguments);
+        auto blobSize = OscReader::readInt32(message.arguments + 4);
+        const char* blob = message.arguments + 8;
+        
+        if (blobSize < 0 || blobSize > message.end - blob)
+            return;
+        
+        for (int i = 0; i < blobSize / 12; ++i, blob += 12)
+            addTargetOverride(firstIndex + i,
+                              OscReader::readFloat32(blob),
+                              OscReader::readFloat32(blob + 4),
+                              OscReader::readFloat32(blob + 8));
+    }
+    else if (message.addressIs("/swarm/target/clear"))
+    {
+        command.type = SwarmCommand::Type::clearTargetOverrides;
+        post(command);
+    }
+}
+
+void OscControlReceiver::addTargetOverride(int droneIndex, float x, float y, float z)
+{
+    if (droneIndex < 0)
+        return;
+    
+    if (currentBatch < 0)
+    {
+        currentBatch = overrides.acquire();
+        
+        // Every batch is still waiting for the simulation
+        if (currentBatch < 0)
+        {
+            ++numDroppedCommands;
+            return;
+        }
+    }
+    
+    overrides.getBatch(currentBatch).add(droneIndex, x, y, z);
+}
+
+void OscControlReceiver::post(const SwarmCommand& command)
+{
+    if (!commands.push(command))
+        ++numDroppedCommands;
+}
+
+bool OscControlReceiver::getNumber(const OscMessageView& message, int argumentIndex, float& result)
+{
+    const char* p = message.arguments;
+    
+    for (int i = 0; i <= argumentIndex; ++i)
+    {
+        auto tag = message.typeTags[i];
+        
+        if (tag == 0 || message.end - p < 4)
+            return false;
+        
+        if (i == argumentIndex)
+        {
+            if (tag == 'f')      result = OscReader::readFloat32(p);
+            else if (tag == 'i') result = static_cast<float>(OscReader::readInt32(p));
+            else                 return false;
+            
+            return true;
+        }
+        
+        // Skip the preceding argument
+        if (tag == 'f' || tag == 'i')
+            p += 4;
+        else if (tag == 's')
+            p = OscReader::skipString(p, message.end);
+        else if (tag == 'b')
+            p += 4 + OscWriter::paddedSize(juce::jmax(0, OscReader::readInt32(p)));
+        else if (tag == 'd' || tag == 'h' || tag == 't')
+            p += 8;
+        
+        if (p == nullptr || p > message.end)
+            return false;
+    }
+    
+    return false;
+}
+
+int OscControlReceiver::getChoice(const OscMessageView& message, const juce::StringArray& names)
+{
+    int index = -1;
+    float value = 0.0f;
+    
+    if (message.getNumArguments() == 0)
+        return -1;
+    
+    if (message.typeTags[0] == 's' && OscReader::skipString(message.arguments, message.end) != nullptr)
+        index = names.indexOf(juce::StringRef(message.arguments), true);
+    else if (getNumber(message, 0, value))
+        index = static_cast<int>(value);
+    
+    return juce::isPositiveAndBelow(index, names.size()) ? index : -1;
+}
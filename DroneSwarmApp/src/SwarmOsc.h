@@ -0,0 +1,265 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstring>
+
+#include "SwarmCommands.h"
+
+class SwarmDrone;
+
+//==============================================================================
+/**
+ * Big-endian OSC 1.0 encoding into caller-owned buffers.
+ *
+ * Nothing here allocates: callers reserve the space up front and the writer
+ * only advances an offset, so it can be used from the frame loop.
+ */
+struct OscWriter
+{
+    char* data = nullptr;
+    int capacity = 0;
+    int size = 0;
+    
+    int remaining() const { return capacity - size; }
+    
+    void writeInt32(juce::int32 value);
+    void writeFloat32(float value);
+    void writeTimeTag(juce::uint64 ntpTime);
+    
+    // Copies bytes that are already null-terminated and padded to four bytes
+    void writePadded(const char* bytes, int numBytes);
+    void writeBlob(const void* bytes, int numBytes);
+    
+    static int paddedSize(int numBytes) { return (numBytes + 3) & ~3; }
+    
+    // Size of an OSC string including its terminator and padding
+    static int paddedStringSize(int length) { return paddedSize(length + 1); }
+    
+    static constexpr juce::uint64 TIME_TAG_IMMEDIATELY = 1;
+};
+
+//==============================================================================
+/**
+ * Streams the state of every drone over UDP as OSC bundles.
+ *
+ * pushFrame() runs on the frame loop and packs each drone as
+ * /swarm/drone/{id} x y z vel note (or, in blob mode, as 8-byte quantised
+ * records inside /swarm/blob messages) into size-capped bundles. Packets come
+ * from a preallocated pool and are handed to a sender thread through a
+ * lock-free FIFO, so the frame loop never formats strings, allocates or blocks
+ * on the socket. Addresses are built once when the swarm grows.
+ */
+class OscStateSender : private juce::Thread
+{
+public:
+    enum class Mode
+    {
+        messages,       // one /swarm/drone/{id} message per drone
+        quantisedBlob   // /swarm/blob frame firstIndex blob, 8 bytes per drone
+    };
+    
+    struct Settings
+    {
+        juce::String host = "127.0.0.1";
+        int port = 9000;
+        Mode mode = Mode::messages;
+        
+        // Keep bundles inside a single Ethernet frame by default
+        int maxPacketBytes = 1472;
+        int numPackets = 256;
+    };
+    
+    OscStateSender();
+    ~OscStateSender() override;
+    
+    // Preallocates the packet pool and starts the sender thread
+    bool start(const Settings& settings);
+    void stop();
+    bool isStreaming() const { return isThreadRunning(); }
+    
+    // Packs one frame of drone state and queues it for sending
+    void pushFrame(const std::vector<std::unique_ptr<SwarmDrone>>& drones, int frameNumber);
+    
+    int getNumDroppedPackets() const { return numDroppedPackets.load(); }
+    int getNumSentPackets() const { return numSentPackets.load(); }
+    
+    // Blob records: int16 x/y/z scaled to +-BLOB_RANGE, uint8 speed, uint8 note
+    static constexpr int BLOB_RECORD_BYTES = 8;
+    static constexpr float BLOB_RANGE = 16.0f;
+    static constexpr float BLOB_MAX_SPEED = 25.0f;     // units per second
+    
+private:
+    void run() override;
+    
+    void prepareAddresses(int numDrones);
+    bool beginPacket();
+    void finishPacket();
+    void packMessages(const std::vector<std::unique_ptr<SwarmDrone>>& drones);
+    void packBlobs(const std::vector<std::unique_ptr<SwarmDrone>>& drones, int frameNumber);
+    
+    struct Packet
+    {
+        juce::HeapBlock<char> data;
+        int size = 0;
+    };
+    
+    Settings settings;
+    juce::DatagramSocket socket { false };
+    
+    // Packet pool shared with the sender thread; the FIFO hands over indices
+    std::vector<Packet> packets;
+    std::unique_ptr<juce::AbstractFifo> fifo;
+    juce::WaitableEvent packetsQueued;
+    
+    // Packet currently being filled by pushFrame
+    int currentPacket = -1;
+    OscWriter writer;
+    
+    // Per drone "/swarm/drone/{id}" padded to ADDRESS_STRIDE bytes
+    static constexpr int ADDRESS_STRIDE = 32;
+    std::vector<char> addresses;
+    std::vector<int> addressSizes;
+    
+    std::atomic<int> numDroppedPackets { 0 };
+    std::atomic<int> numSentPackets { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OscStateSender)
+};
+
+//==============================================================================
+/**
+ * Zero-copy view of one OSC message inside a received datagram.
+ *
+ * All pointers point into the receive buffer; arguments are decoded on demand.
+ */
+struct OscMessageView
+{
+    const char* address = nullptr;
+    const char* typeTags = nullptr;  // first tag, after the leading ','
+    const char* arguments = nullptr;
+    const char* end = nullptr;
+    
+    int getNumArguments() const { return static_cast<int>(std::strlen(typeTags)); }
+    bool addressIs(const char* other) const { return std::strcmp(address, other) == 0; }
+};
+
+//==============================================================================
+/**
+ * Decoding helpers for OSC packets, working in place on the received bytes
+ */
+struct OscReader
+{
+    // Returns the position after a padded string, or nullptr if it runs past end
+    static const char* skipString(const char* p, const char* end);
+    
+    static juce::int32 readInt32(const char* p);
+    static float readFloat32(const char* p);
+    
+    // Calls handler(const OscMessageView&) for every message, descending into bundles.
+    // Returns false if the packet is malformed (messages before the fault are still delivered).
+    template <typename Handler>
+    static bool parsePacket(const char* data, int size, Handler&& handler)
+    {
+        const char* end = data + size;
+        
+        if (size >= 16 && std::memcmp(data, "#bundle", 8) == 0)
+        {
+            for (const char* p = data + 16; p < end;)
+            {
+                if (end - p < 4)
+                    return false;
+                
+                auto elementSize = readInt32(p);
+                p += 4;
+                
+                if (elementSize < 0 || elementSize > end - p || !parsePacket(p, elementSize, handler))
+                    return false;
+                
+                p += elementSize;
+            }
+            
+            return true;
+        }
+        
+        OscMessageView message;
+        message.address = data;
+        message.end = end;
+        
+        auto* tags = skipString(data, end);
+        
+        if (tags == nullptr || *data != '/' || *tags != ',')
+            return false;
+        
+        message.typeTags = tags + 1;
+        message.arguments = skipString(tags, end);
+        
+        if (message.arguments == nullptr)
+            return false;
+        
+        handler(message);
+        return true;
+    }
+};
+
+//==============================================================================
+/**
+ * Receives OSC control messages over UDP on a dedicated thread.
+ *
+ * Understands:
+ *   /swarm/chaos f                 /swarm/strength f
+ *   /swarm/formation s|i           /swarm/attractor f f f [strength]
+ *   /swarm/attractor/off           /swarm/target i f f f
+ *   /swarm/targets i b             (first drone index, big-endian float32 x/y/z triplets)
+ *   /swarm/target/clear            /swarm/choreography s|i
+ *   /swarm/cue i
+ *
+ * Datagrams are parsed in place in a preallocated buffer and turned into
+ * SwarmCommands. All target overrides in one datagram, whether single
+ * messages in a bundle or a /swarm/targets blob, are collected into one
+ * TargetOverridePool batch and posted as a single command.
+ */
+class OscControlReceiver : private juce::Thread
+{
+public:
+    OscControlReceiver(SwarmCommandQueue& commandQueue, TargetOverridePool& targetOverrides);
+    ~OscControlReceiver() override;
+    
+    bool start(int port);
+    void stop();
+    
+    int getNumDroppedCommands() const { return numDroppedCommands.load(); }
+    
+    static constexpr int MAX_DATAGRAM_BYTES = 65536;
+    
+private:
+    void run() override;
+    
+    void handleDatagram(const char* data, int size);
+    void handleMessage(const OscMessageView& message);
+    void addTargetOverride(int droneIndex, float x, float y, float z);
+    void post(const SwarmCommand& command);
+    
+    // Numeric argument of type f or i at the given position, if present
+    static bool getNumber(const OscMessageView& message, int argumentIndex, float& result);
+    
+    // First argument as a name from names or an index into it; -1 if it is neither
+    static int getChoice(const OscMessageView& message, const juce::StringArray& names);
+    
+    SwarmCommandQueue& commands;
+    TargetOverridePool& overrides;
+    
+    std::unique_ptr<juce::DatagramSocket> socket;
+    juce::HeapBlock<char> buffer;
+    juce::StringArray formationNames, choreographyNames;
+    
+    // Override batch being filled for the current datagram
+    int currentBatch = -1;
+    
+    std::atomic<int> numDroppedCommands { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OscControlReceiver)
+};
@@ -0,0 +1,124 @@
+#include "SwarmParameters.h"
+#include <algorithm>
+
+//==============================================================================
+// SwarmParameterStore Implementation
+//==============================================================================
+
+SwarmParameterStore::SwarmParameterStore()
+{
+    reset();
+}
+
+void SwarmParameterStore::reset()
+{
+    for (int i = 0; i < numParameters; ++i)
+        set(static_cast<Id>(i), getDefaultValue(static_cast<Id>(i)));
+}
+
+float SwarmParameterStore::getDefaultValue(Id id)
+{
+    // Circle formation, continuous rhythm and C major
+    switch (id)
+    {
+        case chaos:             return 0.3f;
+        case formationStrength: return 0.7f;
+        case formation:         return 1.0f;
+        case rhythm:            return 0.0f;
+        case scale:             return 1.0f;
+        case rootNote:          return 60.0f;
+        case numParameters:     break;
+    }
+    
+    return 0.0f;
+}
+
+const char* SwarmParameterStore::getName(Id id)
+{
+    switch (id)
+    {
+        case chaos:             return "chaos";
+        case formationStrength: return "strength";
+        case formation:         return "formation";
+        case rhythm:            return "rhythm";
+        case scale:             return "scale";
+        case rootNote:          return "rootNote";
+        case numParameters:     break;
+    }
+    
+    return "";
+}
+
+SwarmParameterStore::Id SwarmParameterStore::findId(const juce::String& name)
+{
+    for (int i = 0; i < numParameters; ++i)
+        if (name == getName(static_cast<Id>(i)))
+            return static_cast<Id>(i);
+    
+    return numParameters;
+}
+
+//==============================================================================
+// SwarmAutomationTrack Implementation
+//==============================================================================
+
+void SwarmAutomationTrack::replay(int frame, SwarmParameterStore& parameters)
+{
+    while (nextEvent < events.size() && events[nextEvent].frame <= frame)
+    {
+        auto& event = events[nextEvent++];
+        parameters.set(event.parameter, event.value);
+    }
+}
+
+bool SwarmAutomationTrack::saveToFile(const juce::File& file) const
+{
+    juce::String text;
+    text << "# frame,parameter,value\n";
+    
+    for (auto& event : events)
+        text << event.frame << "," << SwarmParameterStore::getName(event.parameter) << ","
+             << juce::String(event.value, 6) << "\n";
+    
+    return file.replaceWithText(text);
+}
+
+bool SwarmAutomationTrack::loadFromFile(const juce::File& file, juce::String& error)
+{
+    clear();
+    
+    if (!file.existsAsFile())
+    {
+        error = "Automation file not found: " + file.getFullPathName();
+        return false;
+    }
+    
+    juce::StringArray lines;
+    file.readLines(lines);
+    
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        auto line = lines[i].trim();
+        
+        if (line.isEmpty() || line.startsWithChar('#'))
+            continue;
+        
+        auto fields = juce::StringArray::fromTokens(line, ",", "");
+        auto parameter = fields.size() == 3 ? SwarmParameterStore::findId(fields[1].trim())
+                                            : SwarmParameterStore::numParameters;
+        
+        if (parameter == SwarmParameterStore::numParameters || !fields[0].trim().containsOnly("0123456789"))
+        {
+            error = file.getFileName() + " line " + juce::String(i + 1) + ": expected frame,parameter,value";
+            clear();
+            return false;
+        }
+        
+        events.push_back({ fields[0].getIntValue(), parameter, fields[2].getFloatValue() });
+    }
+    
+    // Hand-edited files may be out of order; events on the same frame keep theirs
+    std::stable_sort(events.begin(), events.end(),
+                     [](const SwarmAutomationEvent& a, const SwarmAutomationEvent& b) { return a.frame < b.frame; });
+    return true;
+}
@@ -0,0 +1,156 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+#include <atomic>
+
+//==============================================================================
+/**
+ * The swarm's user-facing settings as lock-free atomics.
+ *
+ * Any thread (UI, OSC, MIDI, a plugin host) writes targets with set(); the
+ * simulation reads them once at the start of each step and smooths the
+ * continuous ones itself, so nothing on the simulation's hot path ever
+ * touches a widget or waits on a lock. Choice parameters hold an index into
+ * the matching getXxxTypes() list, the root note a MIDI note number.
+ */
+class SwarmParameterStore
+{
+public:
+    enum Id
+    {
+        chaos,
+        formationStrength,
+        formation,      // index into Formation::getFormationTypes()
+        rhythm,         // index into RhythmPattern::getRhythmTypes()
+        scale,          // index into MusicScales::getScaleTypes()
+        rootNote,
+        numParameters
+    };
+    
+    SwarmParameterStore();
+    
+    void set(Id id, float value) { values[static_cast<size_t>(id)].store(value, std::memory_order_relaxed); }
+    float get(Id id) const { return values[static_cast<size_t>(id)].load(std::memory_order_relaxed); }
+    int getInt(Id id) const { return juce::roundToInt(get(id)); }
+    
+    // Restores every parameter to its default
+    void reset();
+    
+    static float getDefaultValue(Id id);
+    static const char* getName(Id id);
+    
+    // Returns numParameters if the name is unknown
+    static Id findId(const juce::String& name);
+    
+private:
+    std::array<std::atomic<float>, numParameters> values;
+    
+    JUCE_DECLARE_NON_COPYABLE(SwarmParameterStore)
+};
+
+//==============================================================================
+/**
+ * A parameter value as the simulation saw it, stamped with the frame that
+ * first used it. Frames are the simulation's ticks, so a take replays the
+ * same at any step rate.
+ */
+struct SwarmAutomationEvent
+{
+    int frame = 0;
+    SwarmParameterStore::Id parameter = SwarmParameterStore::chaos;
+    float value = 0.0f;
+};
+
+//==============================================================================
+/**
+ * Captures parameter changes as the simulation applies them.
+ *
+ * The simulation records into a fixed ring buffer without allocating or
+ * locking; another thread drains it at its own pace (into a
+ * SwarmAutomationTrack, usually). When the reader falls behind by a whole
+ * buffer, new events are dropped and counted.
+ */
+class SwarmAutomationRecorder
+{
+public:
+    SwarmAutomationRecorder() = default;
+    
+    // Simulation thread: returns false if the buffer was full and the event was dropped
+    bool record(const SwarmAutomationEvent& event)
+    {
+        auto scope = fifo.write(1);
+        
+        if (scope.blockSize1 == 0)
+        {
+            numDroppedEvents.fetch_add(1);
+            return false;
+        }
+        
+        events[static_cast<size_t>(scope.startIndex1)] = event;
+        return true;
+    }
+    
+    // Reader thread: calls handler for every recorded event, oldest first
+    template <typename Handler>
+    void drain(Handler&& handler)
+    {
+        auto scope = fifo.read(fifo.getNumReady());
+        
+        for (int i = 0; i < scope.blockSize1; ++i)
+            handler(events[static_cast<size_t>(scope.startIndex1 + i)]);
+        
+        for (int i = 0; i < scope.blockSize2; ++i)
+            handler(events[static_cast<size_t>(scope.startIndex2 + i)]);
+    }
+    
+    int getNumDroppedEvents() const { return numDroppedEvents.load(); }
+    
+    static constexpr int CAPACITY = 4096;
+    
+private:
+    std::array<SwarmAutomationEvent, CAPACITY> events;
+    juce::AbstractFifo fifo { CAPACITY };
+    std::atomic<int> numDroppedEvents { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE(SwarmAutomationRecorder)
+};
+
+//==============================================================================
+/**
+ * A recorded automation pass that can be saved, loaded and replayed.
+ *
+ * Replaying writes each event into the parameter store at the start of the
+ * frame it was recorded on, so a replayed run sees the same values on the
+ * same frames as the original. Files are plain text, one
+ * "frame,parameter,value" line per event.
+ */
+class SwarmAutomationTrack
+{
+public:
+    SwarmAutomationTrack() = default;
+    
+    void add(const SwarmAutomationEvent& event) { events.push_back(event); }
+    void clear() { events.clear(); nextEvent = 0; }
+    
+    const std::vector<SwarmAutomationEvent>& getEvents() const { return events; }
+    
+    // Simulation thread: applies every event due at or before frame, then moves past them
+    void replay(int frame, SwarmParameterStore& parameters);
+    
+    // Starts replaying from the beginning again
+    void rewind() { nextEvent = 0; }
+    
+    bool saveToFile(const juce::File& file) const;
+    
+    // Replaces the current events; on failure leaves the track empty and describes why
+    bool loadFromFile(const juce::File& file, juce::String& error);
+    
+private:
+    std::vector<SwarmAutomationEvent> events;
+    size_t nextEvent = 0;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmAutomationTrack)
+};
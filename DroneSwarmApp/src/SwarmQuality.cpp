@@ -0,0 +1,128 @@
+#include "SwarmQuality.h"
+#include <cmath>
+
+namespace
+{
+    constexpr int noteCheck = SwarmSimulation::NOTE_CHECK_INTERVAL;
+    
+    // Each level keeps the cuts of the ones above it and adds one more:
+    // trails, LOD distances, note check interval, neighbour radius, resolution
+    const std::array<SwarmQualitySettings, 11> ladder {{
+        { 1.0f,  1.0f,  noteCheck,     1.0f, 1.0f  },
+        { 0.5f,  1.0f,  noteCheck,     1.0f, 1.0f  },
+        { 0.25f, 1.0f,  noteCheck,     1.0f, 1.0f  },
+        { 0.25f, 0.6f,  noteCheck,     1.0f, 1.0f  },
+        { 0.25f, 0.35f, noteCheck,     1.0f, 1.0f  },
+        { 0.25f, 0.35f, noteCheck * 2, 1.0f, 1.0f  },
+        { 0.25f, 0.35f, noteCheck * 4, 1.0f, 1.0f  },
+        { 0.25f, 0.35f, noteCheck * 4, 0.7f, 1.0f  },
+        { 0.25f, 0.35f, noteCheck * 4, 0.5f, 1.0f  },
+        { 0.25f, 0.35f, noteCheck * 4, 0.5f, 0.75f },
+        { 0.25f, 0.35f, noteCheck * 4, 0.5f, 0.5f  }
+    }};
+}
+
+//==============================================================================
+// SwarmQualitySettings implementation
+
+juce::String SwarmQualitySettings::toString() const
+{
+    juce::String text;
+    text << "trails x" << juce::String(trailScale, 2)
+         << ", LOD distances x" << juce::String(lodScale, 2)
+         << ", note check every " << noteCheckInterval << " ticks"
+         << ", flock radius x" << juce::String(neighbourRadiusScale, 2)
+         << ", resolution x" << juce::String(resolutionScale, 2);
+    return text;
+}
+
+//==============================================================================
+// SwarmQualityController implementation
+
+SwarmQualityController::SwarmQualityController(double stepMs)
+    : budgetMs(stepMs)
+{
+}
+
+SwarmQualitySettings SwarmQualityController::getSettingsForLevel(int newLevel)
+{
+    return ladder[static_cast<size_t>(juce::jlimit(0, getNumLevels() - 1, newLevel))];
+}
+
+int SwarmQualityController::getNumLevels()
+{
+    return static_cast<int>(ladder.size());
+}
+
+void SwarmQualityController::addPhaseTime(Phase phase, double milliseconds)
+{
+    pendingMicroseconds[static_cast<size_t>(phase)] += static_cast<juce::int64>(milliseconds * 1000.0);
+}
+
+void SwarmQualityController::setEnabled(bool shouldBeEnabled)
+{
+    if (enabled == shouldBeEnabled)
+        return;
+    
+    enabled = shouldBeEnabled;
+    
+    if (!enabled && level != 0)
+        changeLevel(0, "adaptation turned off");
+}
+
+bool SwarmQualityController::endStep()
+{
+    // Weight of the newest step in the smoothed times
+    const double smoothing = 1.0 - std::exp(-budgetMs / SMOOTHING_MS);
+    
+    for (size_t i = 0; i < numPhases; ++i)
+    {
+        auto ms = static_cast<double>(pendingMicroseconds[i].exchange(0)) / 1000.0;
+        smoothedMs[i] += (ms - smoothedMs[i]) * smoothing;
+    }
+    
+    // Each thread, and the GPU, has one step's worth of time for its share
+    auto messageThreadMs = smoothedMs[graphWait] + smoothedMs[output];
+    auto renderThreadMs = smoothedMs[render];
+    
+    if (renderOnMessageThread)
+    {
+        messageThreadMs += renderThreadMs;
+        renderThreadMs = 0.0;
+    }
+    
+    smoothedLoad = juce::jmax(messageThreadMs, renderThreadMs, smoothedMs[gpu]) / budgetMs;
+    msSinceChange += budgetMs;
+    
+    if (!enabled)
+        return false;
+    
+    if (smoothedLoad > DEGRADE_LOAD && msSinceChange >= DEGRADE_HOLD_MS && level < getNumLevels() - 1)
+    {
+        changeLevel(level + 1, "over budget");
+        return true;
+    }
+    
+    if (smoothedLoad < RESTORE_LOAD && msSinceChange >= RESTORE_HOLD_MS && level > 0)
+    {
+        changeLevel(level - 1, "headroom");
+        return true;
+    }
+    
+    return false;
+}
+
+void SwarmQualityController::changeLevel(int newLevel, const juce::String& reason)
+{
+    level = newLevel;
+    settings = getSettingsForLevel(level);
+    msSinceChange = 0.0;
+    
+    juce::String message;
+    message << "Quality: level " << level << " of " << (getNumLevels() - 1) << " (" << reason << ", "
+            << juce::String(smoothedLoad * 100.0, 0) << "% of " << juce::String(budgetMs, 0) << " ms; graph wait "
+            << juce::String(smoothedMs[graphWait], 1) << " ms, output " << juce::String(smoothedMs[output], 1)
+            << " ms, render " << juce::String(smoothedMs[render], 1) << " ms, GPU "
+            << juce::String(smoothedMs[gpu], 1) << " ms): " << settings.toString();
+    juce::Logger::writeToLog(message);
+}
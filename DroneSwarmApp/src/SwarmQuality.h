@@ -0,0 +1,98 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+#include "SwarmSimulation.h"
+
+//==============================================================================
+/**
+ * What the app may give up to stay inside its frame budget. Each value is a
+ * factor on, or a replacement for, the setting it would use at full quality.
+ */
+struct SwarmQualitySettings
+{
+    float trailScale = 1.0f;                                        // of the trail length asked for
+    float lodScale = 1.0f;                                          // of the LOD switch distances
+    int noteCheckInterval = SwarmSimulation::NOTE_CHECK_INTERVAL;   // ticks
+    float neighbourRadiusScale = 1.0f;                              // of the flock's radii
+    float resolutionScale = 1.0f;                                   // of the display's pixels
+    
+    juce::String toString() const;
+};
+
+//==============================================================================
+/**
+ * Keeps each frame inside the step budget by trading quality for time.
+ *
+ * The app reports how long each phase of a step took, from whichever thread
+ * ran it. Once per step the controller turns that into a load per thread:
+ * the message thread waits on the step graph and sends what is left, the GL
+ * thread draws and the GPU rasterises, and each of them has one step's worth
+ * of time to do its share. The graph counts as wall time, so work the pool
+ * overlaps or takes off the message thread does not count against it.
+ * The highest load is smoothed over SMOOTHING_MS, whatever the step rate.
+ *
+ * While it stays above DEGRADE_LOAD the controller moves one level down a
+ * fixed ladder of cuts, cheapest to notice first: trail length, then LOD
+ * distances, the rhythm gate's check interval, the flock's neighbour radius
+ * and finally render resolution. Once the load has stayed below RESTORE_LOAD
+ * for a while it climbs back up one level at a time. Every move is logged
+ * with the times that caused it and the settings it leads to.
+ */
+class SwarmQualityController
+{
+public:
+    enum Phase { graphWait, output, render, gpu, numPhases };
+    
+    explicit SwarmQualityController(double stepMs = SwarmSimulation::UPDATE_INTERVAL_MS);
+    
+    // The budget: one simulation step
+    void setStepMilliseconds(double newStepMs) { budgetMs = juce::jmax(1.0, newStepMs); }
+    
+    // Adds time spent in a phase since the last endStep(); safe from any thread
+    void addPhaseTime(Phase phase, double milliseconds);
+    
+    // Whether the render phase runs on the message thread (software drawing) or its own
+    void setRenderOnMessageThread(bool shouldShareThread) { renderOnMessageThread = shouldShareThread; }
+    
+    // Turns off adaptation and goes back to full quality
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled; }
+    
+    // Call once per simulation step on the message thread; true if the settings changed
+    bool endStep();
+    
+    int getLevel() const { return level; }
+    const SwarmQualitySettings& getSettings() const { return settings; }
+    
+    // Settings at a level of the ladder, 0 being full quality
+    static SwarmQualitySettings getSettingsForLevel(int level);
+    static int getNumLevels();
+    
+    static constexpr double DEGRADE_LOAD = 0.85;      // of the budget
+    static constexpr double RESTORE_LOAD = 0.5;
+    static constexpr double DEGRADE_HOLD_MS = 400.0;      // between moves down
+    static constexpr double RESTORE_HOLD_MS = 3000.0;     // of headroom before each move up
+    static constexpr double SMOOTHING_MS = 200.0;
+    
+private:
+    void changeLevel(int newLevel, const juce::String& reason);
+    
+    double budgetMs;
+    bool enabled = true;
+    bool renderOnMessageThread = false;
+    
+    // Microseconds per phase since the last step, and their smoothed values in milliseconds
+    std::array<std::atomic<juce::int64>, numPhases> pendingMicroseconds {};
+    std::array<double, numPhases> smoothedMs {};
+    double smoothedLoad = 0.0;
+    
+    int level = 0;
+    double msSinceChange = 0.0;
+    SwarmQualitySettings settings;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmQualityController)
+};
@@ -0,0 +1,991 @@
+#include "SwarmRenderer.h"
+#include <cmath>
+#include <map>
+
+using namespace juce::gl;
+
+namespace
+{
+    // Unit icosahedron subdivided once: 42 vertices, 80 triangles. Vertices are
+    // position + normal, which on a unit sphere are the same thing.
+    void buildIcosphere(std::vector<float>& vertices, std::vector<GLushort>& indices)
+    {
+        const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+        
+        std::vector<juce::Vector3D<float>> points {
+            { -1,  t,  0 }, {  1,  t,  0 }, { -1, -t,  0 }, {  1, -t,  0 },
+            {  0, -1,  t }, {  0,  1,  t }, {  0, -1, -t }, {  0,  1, -t },
+            {  t,  0, -1 }, {  t,  0,  1 }, { -t,  0, -1 }, { -t,  0,  1 }
+        };
+        
+        std::vector<GLushort> faces {
+            0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+            1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+            3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+            4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+        };
+        
+        // Each edge is split once, shared by the two faces on either side
+        std::map<std::pair<GLushort, GLushort>, GLushort> midpoints;
+        
+        auto midpoint = [&](GLushort a, GLushort b)
+        {
+            auto key = std::make_pair(juce::jmin(a, b), juce::jmax(a, b));
+            auto found = midpoints.find(key);
+            
+            if (found != midpoints.end())
+                return found->second;
+            
+            points.push_back((points[a] + points[b]) * 0.5f);
+            auto index = static_cast<GLushort>(points.size() - 1);
+            midpoints[key] = index;
+            return index;
+        };
+        
+        indices.clear();
+        
+        for (size_t i = 0; i < faces.size(); i += 3)
+        {
+            auto a = faces[i], b = faces[i + 1], c = faces[i + 2];
+            auto ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            
+            indices.insert(indices.end(), { a, ab, ca,   b, bc, ab,   c, ca, bc,   ab, bc, ca });
+        }
+        
+        vertices.clear();
+        
+        for (auto& point : points)
+        {
+            auto normal = point.normalised();
+            vertices.insert(vertices.end(), { normal.x, normal.y, normal.z, normal.x, normal.y, normal.z });
+        }
+    }
+    
+    // Unit octahedron with smooth normals
+    void buildOctahedron(std::vector<float>& vertices, std::vector<GLushort>& indices)
+    {
+        vertices = {
+             1,  0,  0,   1,  0,  0,
+            -1,  0,  0,  -1,  0,  0,
+             0,  1,  0,   0,  1,  0,
+             0, -1,  0,   0, -1,  0,
+             0,  0,  1,   0,  0,  1,
+             0,  0, -1,   0,  0, -1
+        };
+        
+        indices = {
+            0, 2, 4,   2, 1, 4,   1, 3, 4,   3, 0, 4,
+            2, 0, 5,   1, 2, 5,   3, 1, 5,   0, 3, 5
+        };
+    }
+}
+
+//==============================================================================
+// SwarmCamera Implementation
+//==============================================================================
+
+void SwarmCamera::update(const SwarmScenePainter::View& view, juce::Rectangle<int> viewport)
+{
+    // SwarmScenePainter's projection: rotate about y, push the swarm CAMERA_DISTANCE
+    // away and flip y, since screen y grows downwards there
+    const float c = std::cos(view.rotationAngle);
+    const float s = std::sin(view.rotationAngle);
+    const float distance = SwarmScenePainter::CAMERA_DISTANCE;
+    
+    viewMatrix = {    c,  0.0f,    -s, 0.0f,
+                   0.0f, -1.0f,  0.0f, 0.0f,
+                     -s,  0.0f,    -c, 0.0f,
+                   0.0f,  0.0f, -distance, 1.0f };
+    
+    // The eye sits where the rotated frame puts the origin CAMERA_DISTANCE in front of it
+    position = { -distance * s, 0.0f, -distance * c };
+    
+    focalLength = SwarmScenePainter::FOCAL_LENGTH * view.zoomLevel;
+    
+    const float width = static_cast<float>(viewport.getWidth());
+    const float height = static_cast<float>(viewport.getHeight());
+    const float depthScale = (FAR_PLANE + NEAR_PLANE) / (NEAR_PLANE - FAR_PLANE);
+    const float depthOffset = 2.0f * FAR_PLANE * NEAR_PLANE / (NEAR_PLANE - FAR_PLANE);
+    
+    projectionMatrix = { 2.0f * focalLength / width, 0.0f, 0.0f, 0.0f,
+                         0.0f, 2.0f * focalLength / height, 0.0f, 0.0f,
+                         0.0f, 0.0f, depthScale, -1.0f,
+                         0.0f, 0.0f, depthOffset, 0.0f };
+}
+
+//==============================================================================
+// SwarmDroneRenderer Implementation
+//==============================================================================
+
+SwarmDroneRenderer::SwarmDroneRenderer(SwarmShaderManager& shaderManager)
+    : shaders(shaderManager)
+{
+}
+
+SwarmDroneRenderer::~SwarmDroneRenderer()
+{
+    // GL objects belong to the context, so they must have been released with it
+    jassert(!objectsCreated);
+}
+
+void SwarmDroneRenderer::addPrograms(SwarmShaderManager& shaders)
+{
+    auto resource = [](const char* data, int size) { return juce::String::createStringFromData(data, size); };
+    
+    shaders.add({ "drone",
+                  resource(BinaryData::drone_vertex_glsl, BinaryData::drone_vertex_glslSize),
+                  resource(BinaryData::drone_fragment_glsl, BinaryData::drone_fragment_glslSize) });
+    shaders.add({ "droneSprite",
+                  resource(BinaryData::drone_sprite_vertex_glsl, BinaryData::drone_sprite_vertex_glslSize),
+                  resource(BinaryData::drone_sprite_fragment_glsl, BinaryData::drone_sprite_fragment_glslSize) });
+}
+
+bool SwarmDroneRenderer::isReady() const
+{
+    return shaders.getProgram("drone") != 0 && shaders.getProgram("droneSprite") != 0;
+}
+
+void SwarmDroneRenderer::setLodDistances(float newIcosphereDistance, float newOctahedronDistance)
+{
+    icosphereDistance = newIcosphereDistance;
+    octahedronDistance = juce::jmax(newIcosphereDistance, newOctahedronDistance);
+}
+
+void SwarmDroneRenderer::cull(const SwarmSnapshot& snapshot, const SwarmScenePainter::View& view,
+                              juce::Rectangle<int> viewport)
+{
+    for (auto& bucket : buckets)
+        bucket.clear();
+    
+    const auto numDrones = snapshot.drones.size();
+    
+    if (viewport.isEmpty() || numDrones == 0)
+    {
+        for (auto& count : numDrawn)
+            count = 0;
+        
+        return;
+    }
+    
+    camera.update(view, viewport);
+    
+    // Gather into lanes; lanes past the last drone are never read back
+    const auto numGroups = (numDrones + LANES - 1) / LANES;
+    xs.resize(numGroups);
+    ys.resize(numGroups);
+    zs.resize(numGroups);
+    radii.resize(numGroups);
+    
+    for (size_t i = 0; i < numDrones; ++i)
+    {
+        auto& drone = snapshot.drones[i];
+        setLane(xs, i, drone.position.x);
+        setLane(ys, i, drone.position.y);
+        setLane(zs, i, drone.position.z);
+        setLane(radii, i, drone.size * 0.5f / SwarmScenePainter::FOCAL_LENGTH);
+    }
+    
+    // Side planes pass through the eye, tilted by half the field of view on each axis
+    const float halfWidth = static_cast<float>(viewport.getWidth()) * 0.5f;
+    const float halfHeight = static_cast<float>(viewport.getHeight()) * 0.5f;
+    const float focalLength = camera.focalLength;
+    const float sideScaleX = 1.0f / std::sqrt(focalLength * focalLength + halfWidth * halfWidth);
+    const float sideScaleY = 1.0f / std::sqrt(focalLength * focalLength + halfHeight * halfHeight);
+    
+    const auto cosAngle = FloatVec::expand(std::cos(view.rotationAngle));
+    const auto sinAngle = FloatVec::expand(std::sin(view.rotationAngle));
+    const auto cameraDistance = FloatVec::expand(SwarmScenePainter::CAMERA_DISTANCE);
+    const auto nearPlane = FloatVec::expand(SwarmCamera::NEAR_PLANE);
+    const auto farPlane = FloatVec::expand(SwarmCamera::FAR_PLANE);
+    const auto sideCosX = FloatVec::expand(focalLength * sideScaleX);
+    const auto sideSinX = FloatVec::expand(halfWidth * sideScaleX);
+    const auto sideCosY = FloatVec::expand(focalLength * sideScaleY);
+    const auto sideSinY = FloatVec::expand(halfHeight * sideScaleY);
+    
+    // Zooming in brings everything closer, as far as detail goes
+    const auto icosphereLimit = FloatVec::expand(icosphereDistance * view.zoomLevel);
+    const auto octahedronLimit = FloatVec::expand(octahedronDistance * view.zoomLevel);
+    const auto one = FloatVec::expand(1.0f);
+    
+    for (size_t g = 0; g < numGroups; ++g)
+    {
+        auto rotatedX = xs[g] * cosAngle - zs[g] * sinAngle;
+        auto depth = xs[g] * sinAngle + zs[g] * cosAngle + cameraDistance;
+        auto radius = radii[g];
+        
+        // A sphere is out only once it is entirely behind one plane
+        auto visible = FloatVec::greaterThan(depth + radius, nearPlane)
+                     & FloatVec::lessThan(depth - radius, farPlane)
+                     & FloatVec::lessThan(FloatVec::abs(rotatedX) * sideCosX - depth * sideSinX, radius)
+                     & FloatVec::lessThan(FloatVec::abs(ys[g]) * sideCosY - depth * sideSinY, radius);
+        
+        auto lod = (one & FloatVec::greaterThanOrEqual(depth, icosphereLimit))
+                 + (one & FloatVec::greaterThanOrEqual(depth, octahedronLimit));
+        
+        for (size_t lane = 0; lane < static_cast<size_t>(LANES); ++lane)
+        {
+            auto index = g * LANES + lane;
+            
+            if (index >= numDrones || visible.get(lane) == 0)
+                continue;
+            
+            auto& drone = snapshot.drones[index];
+            buckets[static_cast<size_t>(lod.get(lane))].push_back({ drone.position.x, drone.position.y,
+                                                                     drone.position.z, radius.get(lane),
+                                                                     drone.colour.getFloatRed(),
+                                                                     drone.colour.getFloatGreen(),
+                                                                     drone.colour.getFloatBlue(),
+                                                                     drone.noteActive ? 1.0f : 0.0f });
+        }
+    }
+    
+    for (size_t i = 0; i < buckets.size(); ++i)
+        numDrawn[i] = static_cast<int>(buckets[i].size());
+}
+
+SwarmDroneRenderer::Mesh SwarmDroneRenderer::createMesh(const std::vector<float>& vertices,
+                                                        const std::vector<GLushort>& indices)
+{
+    Mesh mesh;
+    mesh.numIndices = static_cast<GLsizei>(indices.size());
+    
+    glGenBuffers(1, &mesh.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(float)), vertices.data(),
+                 GL_STATIC_DRAW);
+    
+    glGenBuffers(1, &mesh.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(GLushort)),
+                 indices.data(), GL_STATIC_DRAW);
+    meshBytes += vertices.size() * sizeof(float) + indices.size() * sizeof(GLushort);
+    
+    // Position and normal, interleaved
+    constexpr auto stride = static_cast<GLsizei>(6 * sizeof(float));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(3 * sizeof(float)));
+    
+    return mesh;
+}
+
+void SwarmDroneRenderer::bindInstanceAttributes(GLuint buffer, GLuint divisor)
+{
+    constexpr auto stride = static_cast<GLsizei>(sizeof(Instance));
+    
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, nullptr);
+    glVertexAttribDivisor(2, divisor);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(4 * sizeof(float)));
+    glVertexAttribDivisor(3, divisor);
+}
+
+void SwarmDroneRenderer::createObjects()
+{
+    objectsCreated = true;
+    
+    glGenBuffers(numLods, instanceBuffers.data());
+    glGenVertexArrays(numLods, vertexArrays.data());
+    
+    std::vector<float> vertices;
+    std::vector<GLushort> indices;
+    
+    // Mesh levels: their own vertices plus one instance per drone
+    glBindVertexArray(vertexArrays[icosphere]);
+    buildIcosphere(vertices, indices);
+    meshes[icosphere] = createMesh(vertices, indices);
+    bindInstanceAttributes(instanceBuffers[icosphere], 1);
+    
+    glBindVertexArray(vertexArrays[octahedron]);
+    buildOctahedron(vertices, indices);
+    meshes[octahedron] = createMesh(vertices, indices);
+    bindInstanceAttributes(instanceBuffers[octahedron], 1);
+    
+    // Sprites: one point per drone, straight from its instance data
+    glBindVertexArray(vertexArrays[pointSprite]);
+    bindInstanceAttributes(instanceBuffers[pointSprite], 0);
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SwarmDroneRenderer::render(float renderingScale)
+{
+    if (!isReady())
+        return;
+    
+    if (!objectsCreated)
+        createObjects();
+    
+    // Orphan and refill each bucket's buffer, so the driver never waits on last frame's draw
+    size_t instanceBytes = 0;
+    
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(buckets[i].size() * sizeof(Instance)),
+                     buckets[i].data(), GL_STREAM_DRAW);
+        instanceBytes += buckets[i].size() * sizeof(Instance);
+    }
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gpuBytes = meshBytes + instanceBytes;
+    
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    // Meshes, lit from just above the camera
+    const auto meshProgram = shaders.getProgram("drone");
+    glUseProgram(meshProgram);
+    glUniformMatrix4fv(glGetUniformLocation(meshProgram, "projectionMatrix"), 1, GL_FALSE,
+                       camera.projectionMatrix.data());
+    glUniformMatrix4fv(glGetUniformLocation(meshProgram, "viewMatrix"), 1, GL_FALSE, camera.viewMatrix.data());
+    glUniform3f(glGetUniformLocation(meshProgram, "lightPosition"), camera.position.x, camera.position.y - 20.0f,
+                camera.position.z);
+    glUniform3f(glGetUniformLocation(meshProgram, "cameraPosition"), camera.position.x, camera.position.y,
+                camera.position.z);
+    glUniform1i(glGetUniformLocation(meshProgram, "useTexture"), 0);
+    
+    for (auto lod : { icosphere, octahedron })
+    {
+        auto count = static_cast<GLsizei>(buckets[lod].size());
+        
+        if (count == 0)
+            continue;
+        
+        glBindVertexArray(vertexArrays[lod]);
+        glDrawElementsInstanced(GL_TRIANGLES, meshes[lod].numIndices, GL_UNSIGNED_SHORT, nullptr, count);
+    }
+    
+    // Sprites
+    if (!buckets[pointSprite].empty())
+    {
+        const auto spriteProgram = shaders.getProgram("droneSprite");
+        glUseProgram(spriteProgram);
+        glUniformMatrix4fv(glGetUniformLocation(spriteProgram, "projectionMatrix"), 1, GL_FALSE,
+                           camera.projectionMatrix.data());
+        glUniformMatrix4fv(glGetUniformLocation(spriteProgram, "viewMatrix"), 1, GL_FALSE,
+                           camera.viewMatrix.data());
+        glUniform1f(glGetUniformLocation(spriteProgram, "pixelsPerUnit"), camera.focalLength * renderingScale);
+        
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glBindVertexArray(vertexArrays[pointSprite]);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(buckets[pointSprite].size()));
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+    
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_DEPTH_TEST);
+}
+
+void SwarmDroneRenderer::release()
+{
+    if (!objectsCreated)
+        return;
+    
+    for (auto& mesh : meshes)
+    {
+        glDeleteBuffers(1, &mesh.vertexBuffer);
+        glDeleteBuffers(1, &mesh.indexBuffer);
+        mesh = {};
+    }
+    
+    glDeleteVertexArrays(numLods, vertexArrays.data());
+    glDeleteBuffers(numLods, instanceBuffers.data());
+    vertexArrays = {};
+    instanceBuffers = {};
+    objectsCreated = false;
+    meshBytes = 0;
+    gpuBytes = 0;
+}
+
+//==============================================================================
+// SwarmTrailRenderer Implementation
+//==============================================================================
+
+SwarmTrailRenderer::SwarmTrailRenderer(SwarmShaderManager& shaderManager)
+    : shaders(shaderManager)
+{
+}
+
+SwarmTrailRenderer::~SwarmTrailRenderer()
+{
+    // GL objects belong to the context, so they must have been released with it
+    jassert(numDrones == 0);
+}
+
+void SwarmTrailRenderer::addPrograms(SwarmShaderManager& shaders)
+{
+    auto resource = [](const char* data, int size) { return juce::String::createStringFromData(data, size); };
+    
+    shaders.add({ "trail",
+                  resource(BinaryData::trail_vertex_glsl, BinaryData::trail_vertex_glslSize),
+                  resource(BinaryData::trail_fragment_glsl, BinaryData::trail_fragment_glslSize) });
+}
+
+bool SwarmTrailRenderer::isReady() const
+{
+    return shaders.getProgram("trail") != 0;
+}
+
+void SwarmTrailRenderer::allocate(int newNumDrones, int newHistoryLength)
+{
+    release();
+    numDrones = newNumDrones;
+    historyLength = newHistoryLength;
+    
+    // RGBA32F texels: buffer textures only take three-component formats from GL 4.0
+    glGenBuffers(1, &historyBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, historyBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(numDrones * historyLength * 4 * sizeof(float)),
+                 nullptr, GL_DYNAMIC_DRAW);
+    
+    glGenBuffers(1, &colourBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, colourBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(numDrones * 4 * sizeof(float)), nullptr,
+                 GL_DYNAMIC_DRAW);
+    gpuBytes = static_cast<size_t>(numDrones) * static_cast<size_t>(historyLength + 1) * 4 * sizeof(float);
+    
+    glGenTextures(1, &historyTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, historyTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, historyBuffer);
+    
+    glGenTextures(1, &colourTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, colourTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, colourBuffer);
+    
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    
+    // Core profiles won't draw without a vertex array, even one with no attributes
+    glGenVertexArrays(1, &vertexArray);
+    
+    uploadData.resize(static_cast<size_t>(numDrones) * 4);
+    newestSlot = 0;
+    numPoints = 0;
+    lastFrame = -1;
+    lastTrailFrame = -1;
+    
+    const auto kilobytes = static_cast<double>(numDrones) * (historyLength + 1) * 4 * sizeof(float) / 1024.0;
+    juce::Logger::writeToLog("GPU trail history: " + juce::String(numDrones) + " drones x "
+                             + juce::String(historyLength) + " points, " + juce::String(kilobytes, 1) + " KB");
+}
+
+void SwarmTrailRenderer::update(const SwarmSnapshot& snapshot)
+{
+    const auto numSnapshotDrones = static_cast<int>(snapshot.drones.size());
+    
+    if (numSnapshotDrones == 0 || snapshot.trailCapacity == 0)
+    {
+        release();
+        return;
+    }
+    
+    if (numSnapshotDrones != numDrones || snapshot.trailCapacity != historyLength)
+        allocate(numSnapshotDrones, snapshot.trailCapacity);
+    
+    if (snapshot.frameNumber == lastFrame)
+        return;
+    
+    // A restarted simulation starts a new history; ticks the renderer missed become a straight segment
+    const bool restarted = snapshot.frameNumber < lastFrame || snapshot.trailFrame < lastTrailFrame;
+    
+    if (restarted)
+        numPoints = 0;
+    
+    // Later steps of the same tick only overwrite the newest point
+    const int numNewSlots = lastTrailFrame < 0 || restarted || numPoints == 0
+                                ? 1
+                                : juce::jmin(snapshot.trailFrame - lastTrailFrame, historyLength);
+    lastFrame = snapshot.frameNumber;
+    lastTrailFrame = snapshot.trailFrame;
+    
+    for (size_t i = 0; i < snapshot.drones.size(); ++i)
+    {
+        auto& position = snapshot.drones[i].position;
+        uploadData[i * 4] = position.x;
+        uploadData[i * 4 + 1] = position.y;
+        uploadData[i * 4 + 2] = position.z;
+        uploadData[i * 4 + 3] = 1.0f;
+    }
+    
+    const auto slotBytes = static_cast<GLsizeiptr>(uploadData.size() * sizeof(float));
+    glBindBuffer(GL_TEXTURE_BUFFER, historyBuffer);
+    
+    for (int n = 0; n < numNewSlots; ++n)
+    {
+        newestSlot = (newestSlot + 1) % historyLength;
+        numPoints = juce::jmin(numPoints + 1, historyLength);
+        glBufferSubData(GL_TEXTURE_BUFFER, newestSlot * slotBytes, slotBytes, uploadData.data());
+    }
+    
+    if (numNewSlots == 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, newestSlot * slotBytes, slotBytes, uploadData.data());
+    
+    // Colours follow the drones (they flash on notes)
+    for (size_t i = 0; i < snapshot.drones.size(); ++i)
+    {
+        auto& colour = snapshot.drones[i].colour;
+        uploadData[i * 4] = colour.getFloatRed();
+        uploadData[i * 4 + 1] = colour.getFloatGreen();
+        uploadData[i * 4 + 2] = colour.getFloatBlue();
+        uploadData[i * 4 + 3] = 1.0f;
+    }
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, colourBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, slotBytes, uploadData.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void SwarmTrailRenderer::render(const SwarmCamera& camera, float interpolation)
+{
+    if (!isReady() || numDrones == 0 || numPoints < 2)
+        return;
+    
+    const auto program = shaders.getProgram("trail");
+    
+    // Trails are see-through, so they are tested against the drones' depth but don't write it
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    glUseProgram(program);
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, historyTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, colourTexture);
+    glActiveTexture(GL_TEXTURE0);
+    
+    glUniform1i(glGetUniformLocation(program, "history"), 0);
+    glUniform1i(glGetUniformLocation(program, "colors"), 1);
+    glUniform1i(glGetUniformLocation(program, "numDrones"), numDrones);
+    glUniform1i(glGetUniformLocation(program, "historyLength"), historyLength);
+    glUniform1i(glGetUniformLocation(program, "newestSlot"), newestSlot);
+    glUniform1i(glGetUniformLocation(program, "numPoints"), numPoints);
+    glUniformMatrix4fv(glGetUniformLocation(program, "projectionMatrix"), 1, GL_FALSE,
+                       camera.projectionMatrix.data());
+    glUniformMatrix4fv(glGetUniformLocation(program, "viewMatrix"), 1, GL_FALSE, camera.viewMatrix.data());
+    glUniform1f(glGetUniformLocation(program, "ribbonWidth"), RIBBON_WIDTH);
+    glUniform1f(glGetUniformLocation(program, "fadeVal"), TRAIL_ALPHA);
+    glUniform1f(glGetUniformLocation(program, "interpolation"), interpolation);
+    
+    // Two vertices per trail point, one instance per drone
+    glBindVertexArray(vertexArray);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * historyLength, numDrones);
+    
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glUseProgram(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_DEPTH_TEST);
+}
+
+void SwarmTrailRenderer::release()
+{
+    if (numDrones == 0)
+        return;
+    
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteTextures(1, &historyTexture);
+    glDeleteTextures(1, &colourTexture);
+    glDeleteBuffers(1, &historyBuffer);
+    glDeleteBuffers(1, &colourBuffer);
+    
+    vertexArray = 0;
+    historyTexture = 0;
+    colourTexture = 0;
+    historyBuffer = 0;
+    colourBuffer = 0;
+    numDrones = 0;
+    gpuBytes = 0;
+}
+
+//==============================================================================
+// SwarmHudRenderer Implementation
+//==============================================================================
+
+SwarmHudRenderer::SwarmHudRenderer(SwarmShaderManager& shaderManager)
+    : shaders(shaderManager)
+{
+    laidOutText.reserve(MAX_TEXT_LENGTH);
+    vertices.reserve(MAX_TEXT_LENGTH * 6 * 4);
+}
+
+SwarmHudRenderer::~SwarmHudRenderer()
+{
+    // GL objects belong to the context, so they must have been released with it
+    jassert(atlasTexture == 0);
+}
+
+void SwarmHudRenderer::addPrograms(SwarmShaderManager& shaders)
+{
+    auto resource = [](const char* data, int size) { return juce::String::createStringFromData(data, size); };
+    
+    shaders.add({ "hud",
+                  resource(BinaryData::hud_vertex_glsl, BinaryData::hud_vertex_glslSize),
+                  resource(BinaryData::hud_fragment_glsl, BinaryData::hud_fragment_glslSize) });
+}
+
+bool SwarmHudRenderer::isReady() const
+{
+    return shaders.getProgram("hud") != 0;
+}
+
+void SwarmHudRenderer::buildAtlas(float renderingScale)
+{
+    release();
+    atlasScale = renderingScale;
+    
+    // Rasterise at framebuffer resolution so the text is as sharp as the component's was
+    juce::Font font(juce::FontOptions(FONT_HEIGHT * renderingScale));
+    std::array<float, NUM_GLYPHS> advances {};
+    float widest = 0.0f;
+    
+    for (int i = 0; i < NUM_GLYPHS; ++i)
+    {
+        juce::GlyphArrangement arrangement;
+        arrangement.addLineOfText(font, juce::String::charToString(FIRST_GLYPH + i), 0.0f, 0.0f);
+        
+        if (arrangement.getNumGlyphs() > 0)
+            advances[static_cast<size_t>(i)] = arrangement.getGlyph(0).getRight();
+        
+        widest = juce::jmax(widest, advances[static_cast<size_t>(i)]);
+    }
+    
+    // One pixel of padding round each cell keeps neighbours out of the filtering
+    cellWidth = std::ceil(widest) + 2.0f;
+    cellHeight = std::ceil(font.getHeight()) + 2.0f;
+    
+    const int rows = (NUM_GLYPHS + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    const int atlasWidth = static_cast<int>(cellWidth) * ATLAS_COLUMNS;
+    const int atlasHeight = static_cast<int>(cellHeight) * rows;
+    
+    juce::Image image(juce::Image::ARGB, atlasWidth, atlasHeight, true, juce::SoftwareImageType());
+    
+    {
+        juce::Graphics g(image);
+        g.setColour(juce::Colours::white);
+        g.setFont(font);
+        
+        for (int i = 0; i < NUM_GLYPHS; ++i)
+        {
+            auto x = static_cast<float>(i % ATLAS_COLUMNS) * cellWidth;
+            auto y = static_cast<float>(i / ATLAS_COLUMNS) * cellHeight;
+            g.drawSingleLineText(juce::String::charToString(FIRST_GLYPH + i),
+                                 juce::roundToInt(x + 1.0f), juce::roundToInt(y + 1.0f + font.getAscent()));
+            
+            auto& glyph = glyphs[static_cast<size_t>(i)];
+            glyph.left = x / static_cast<float>(atlasWidth);
+            glyph.top = y / static_cast<float>(atlasHeight);
+            glyph.right = (x + cellWidth) / static_cast<float>(atlasWidth);
+            glyph.bottom = (y + cellHeight) / static_cast<float>(atlasHeight);
+            glyph.advance = advances[static_cast<size_t>(i)];
+        }
+    }
+    
+    // Only coverage is needed, and white text leaves it in the alpha channel
+    std::vector<juce::uint8> coverage(static_cast<size_t>(atlasWidth * atlasHeight));
+    const juce::Image::BitmapData pixels(image, juce::Image::BitmapData::readOnly);
+    
+    for (int y = 0; y < atlasHeight; ++y)
+        for (int x = 0; x < atlasWidth; ++x)
+            coverage[static_cast<size_t>(y * atlasWidth + x)] = pixels.getPixelColour(x, y).getAlpha();
+    
+    glGenTextures(1, &atlasTexture);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, coverage.data());
+    atlasBytes = coverage.size();
+    gpuBytes = atlasBytes;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenBuffers(1, &vertexBuffer);
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    // The old quads were measured with the old font
+    laidOutText.clear();
+}
+
+void SwarmHudRenderer::layOut(std::string_view text, juce::Rectangle<int> viewport)
+{
+    laidOutText.assign(text);
+    laidOutViewport = viewport;
+    vertices.clear();
+    
+    auto glyphFor = [this](char character) -> const Glyph&
+    {
+        auto c = static_cast<juce::juce_wchar>(static_cast<unsigned char>(character));
+        
+        if (c < FIRST_GLYPH || c > LAST_GLYPH)
+            c = '?';
+        
+        return glyphs[static_cast<size_t>(c - FIRST_GLYPH)];
+    };
+    
+    float width = 0.0f;
+    
+    for (auto c : text)
+        width += glyphFor(c).advance;
+    
+    // Centred in the top line, in framebuffer pixels, as the component drew it
+    auto x = std::round((static_cast<float>(viewport.getWidth()) * atlasScale - width) * 0.5f) - 1.0f;
+    auto y = std::round((static_cast<float>(LINE_HEIGHT) * atlasScale - cellHeight) * 0.5f);
+    
+    for (auto c : text)
+    {
+        auto& glyph = glyphFor(c);
+        
+        if (c != ' ')
+        {
+            const float quad[6][4] = {
+                { x,             y,              glyph.left,  glyph.top },
+                { x + cellWidth, y,              glyph.right, glyph.top },
+                { x,             y + cellHeight, glyph.left,  glyph.bottom },
+                { x + cellWidth, y,              glyph.right, glyph.top },
+                { x + cellWidth, y + cellHeight, glyph.right, glyph.bottom },
+                { x,             y + cellHeight, glyph.left,  glyph.bottom }
+            };
+            
+            for (auto& vertex : quad)
+                vertices.insert(vertices.end(), vertex, vertex + 4);
+        }
+        
+        x += glyph.advance;
+    }
+    
+    numVertices = static_cast<GLsizei>(vertices.size() / 4);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(float)),
+                 vertices.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gpuBytes = atlasBytes + vertices.size() * sizeof(float);
+}
+
+void SwarmHudRenderer::render(std::string_view text, juce::Rectangle<int> viewport, float renderingScale)
+{
+    if (!isReady())
+        return;
+    
+    if (atlasTexture == 0 || renderingScale != atlasScale)
+        buildAtlas(renderingScale);
+    
+    if (text != laidOutText || viewport != laidOutViewport)
+        layOut(text, viewport);
+    
+    if (numVertices == 0)
+        return;
+    
+    const auto program = shaders.getProgram("hud");
+    
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    
+    glUniform1i(glGetUniformLocation(program, "glyphAtlas"), 0);
+    glUniform2f(glGetUniformLocation(program, "viewportSize"),
+                static_cast<float>(viewport.getWidth()) * renderingScale,
+                static_cast<float>(viewport.getHeight()) * renderingScale);
+    glUniform4f(glGetUniformLocation(program, "textColor"), 1.0f, 1.0f, 1.0f, 1.0f);
+    
+    glBindVertexArray(vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, numVertices);
+    
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+void SwarmHudRenderer::release()
+{
+    if (atlasTexture == 0)
+        return;
+    
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteTextures(1, &atlasTexture);
+    
+    vertexArray = 0;
+    vertexBuffer = 0;
+    atlasTexture = 0;
+    atlasScale = 0.0f;
+    numVertices = 0;
+    atlasBytes = 0;
+    gpuBytes = 0;
+}
+
+//==============================================================================
+// SwarmRenderTarget Implementation
+//==============================================================================
+
+SwarmRenderTarget::~SwarmRenderTarget()
+{
+    // GL objects belong to the context, so they must have been released with it
+    jassert(framebuffer == 0);
+}
+
+bool SwarmRenderTarget::begin(int width, int height)
+{
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    
+    if (width != bufferWidth || height != bufferHeight)
+    {
+        release();
+        
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &colourBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        
+        glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+            release();
+            return false;
+        }
+        
+        bufferWidth = width;
+        bufferHeight = height;
+        gpuBytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 8;   // RGBA8 and a 24-bit depth padded to 32
+    }
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+void SwarmRenderTarget::end(int destWidth, int destHeight)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+    glBlitFramebuffer(0, 0, bufferWidth, bufferHeight, 0, 0, destWidth, destHeight,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+    glViewport(0, 0, destWidth, destHeight);
+}
+
+void SwarmRenderTarget::release()
+{
+    if (framebuffer == 0)
+        return;
+    
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colourBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    
+    framebuffer = 0;
+    colourBuffer = 0;
+    depthBuffer = 0;
+    bufferWidth = 0;
+    bufferHeight = 0;
+    gpuBytes = 0;
+}
+
+//==============================================================================
+// SwarmGpuTimer Implementation
+//==============================================================================
+
+SwarmGpuTimer::~SwarmGpuTimer()
+{
+    // GL objects belong to the context, so they must have been released with it
+    jassert(queries[0] == 0);
+}
+
+void SwarmGpuTimer::begin()
+{
+    if (queries[0] == 0)
+        glGenQueries(NUM_QUERIES, queries.data());
+    
+    // Every query is still in flight; skip this measurement rather than wait
+    if (pending[static_cast<size_t>(nextQuery)])
+        return;
+    
+    glBeginQuery(GL_TIME_ELAPSED, queries[static_cast<size_t>(nextQuery)]);
+    running = true;
+}
+
+void SwarmGpuTimer::end()
+{
+    if (!running)
+        return;
+    
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[static_cast<size_t>(nextQuery)] = true;
+    nextQuery = (nextQuery + 1) % NUM_QUERIES;
+    running = false;
+}
+
+double SwarmGpuTimer::collect()
+{
+    double milliseconds = 0.0;
+    
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        if (!pending[i])
+            continue;
+        
+        GLint available = 0;
+        glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        
+        if (available == 0)
+            continue;
+        
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+        milliseconds += static_cast<double>(nanoseconds) / 1.0e6;
+        pending[i] = false;
+    }
+    
+    return milliseconds;
+}
+
+void SwarmGpuTimer::release()
+{
+    if (queries[0] == 0)
+        return;
+    
+    if (running)
+        glEndQuery(GL_TIME_ELAPSED);
+    
+    glDeleteQueries(NUM_QUERIES, queries.data());
+    queries.fill(0);
+    pending.fill(false);
+    nextQuery = 0;
+    running = false;
+}
@@ -0,0 +1,349 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <string>
+#include <string_view>
+
+#include "SwarmScene.h"
+#include "SwarmShaders.h"
+
+//==============================================================================
+/**
+ * The GL version of SwarmScenePainter's camera, shared by the drone and trail
+ * renderers.
+ */
+struct SwarmCamera
+{
+    // Column-major, as GL wants them
+    std::array<float, 16> viewMatrix {};
+    std::array<float, 16> projectionMatrix {};
+    juce::Vector3D<float> position;
+    float focalLength = SwarmScenePainter::FOCAL_LENGTH;    // logical pixels
+    
+    // Matches SwarmScenePainter for this view and viewport (in logical pixels)
+    void update(const SwarmScenePainter::View& view, juce::Rectangle<int> viewport);
+    
+    static constexpr float NEAR_PLANE = 0.5f;
+    static constexpr float FAR_PLANE = 200.0f;
+};
+
+//==============================================================================
+/**
+ * Instanced OpenGL renderer for the drones of a SwarmSnapshot, with frustum
+ * culling and distance-based level of detail.
+ *
+ * Every frame the drones are tested against the view frustum several at a time
+ * in SIMD registers. The ones that survive are sorted by distance from the
+ * camera into three buckets: an icosphere close up, an octahedron at mid range
+ * and a point sprite beyond that. Each bucket is packed into its own instance
+ * buffer, so each level of detail is a single draw sized to what is actually
+ * on screen.
+ *
+ * The camera matches SwarmScenePainter's, so the picture is the same as the
+ * 2D view's. cull() makes no GL calls; everything else runs on the GL thread.
+ */
+class SwarmDroneRenderer
+{
+public:
+    enum Lod { icosphere, octahedron, pointSprite, numLods };
+    
+    explicit SwarmDroneRenderer(SwarmShaderManager& shaders);
+    ~SwarmDroneRenderer();
+    
+    // Queues the drone programs on the shader manager; call once per context
+    static void addPrograms(SwarmShaderManager& shaders);
+    
+    // True once the programs have linked
+    bool isReady() const;
+    
+    // Picks the visible drones for this view and viewport (in logical pixels) and
+    // buckets them by level of detail
+    void cull(const SwarmSnapshot& snapshot, const SwarmScenePainter::View& view, juce::Rectangle<int> viewport);
+    
+    // Uploads the buckets from the last cull() and draws them; the caller sets the viewport
+    void render(float renderingScale);
+    
+    // Frees every GL object; call before the context goes away
+    void release();
+    
+    // Distances from the camera, at zoom 1, where the icosphere and the octahedron give way
+    void setLodDistances(float icosphereDistance, float octahedronDistance);
+    
+    static constexpr float DEFAULT_ICOSPHERE_DISTANCE = 20.0f;
+    static constexpr float DEFAULT_OCTAHEDRON_DISTANCE = 32.0f;
+    
+    // Drones drawn at a level of detail in the last frame; safe from any thread
+    int getNumDrawn(Lod lod) const { return numDrawn[static_cast<size_t>(lod)].load(); }
+    
+    // The camera of the last cull()
+    const SwarmCamera& getCamera() const { return camera; }
+    
+    // Bytes of GL storage it holds; safe from any thread
+    size_t getGpuBytes() const { return gpuBytes.load(); }
+    
+private:
+    using FloatVec = juce::dsp::SIMDRegister<float>;
+    static constexpr int LANES = static_cast<int>(FloatVec::SIMDNumElements);
+    
+    // What the shaders get per drone
+    struct Instance
+    {
+        float x, y, z, radius;
+        float red, green, blue, noteActive;
+    };
+    
+    struct Mesh
+    {
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        GLsizei numIndices = 0;
+    };
+    
+    void setLane(std::vector<FloatVec>& registers, size_t index, float value)
+    {
+        registers[index / LANES].set(index % LANES, value);
+    }
+    
+    void createObjects();
+    Mesh createMesh(const std::vector<float>& vertices, const std::vector<GLushort>& indices);
+    void bindInstanceAttributes(GLuint buffer, GLuint divisor);
+    
+    SwarmShaderManager& shaders;
+    
+    float icosphereDistance = DEFAULT_ICOSPHERE_DISTANCE;
+    float octahedronDistance = DEFAULT_OCTAHEDRON_DISTANCE;
+    
+    SwarmCamera camera;
+    
+    // Culling input in SIMD lanes, and its output
+    std::vector<FloatVec> xs, ys, zs, radii;
+    std::array<std::vector<Instance>, numLods> buckets;
+    std::array<std::atomic<int>, numLods> numDrawn {};
+    
+    // GL objects, created on the first render()
+    bool objectsCreated = false;
+    std::array<Mesh, 2> meshes;                 // icosphere, octahedron
+    std::array<GLuint, numLods> instanceBuffers {};
+    std::array<GLuint, numLods> vertexArrays {};
+    size_t meshBytes = 0;
+    std::atomic<size_t> gpuBytes { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmDroneRenderer)
+};
+
+//==============================================================================
+/**
+ * Draws every drone's trail as a camera-facing ribbon in one instanced draw.
+ *
+ * Trail history lives on the GPU in a ring of position slots, one slot per
+ * simulation frame with a texel per drone, so each new frame costs a single
+ * contiguous write of the drones' positions and nothing else. The vertex
+ * shader reads the points back by vertex and instance ID, turns them into a
+ * ribbon facing the camera and fades it out along its length, so there is no
+ * per-frame trail geometry on the CPU. Everything here runs on the GL thread.
+ */
+class SwarmTrailRenderer
+{
+public:
+    explicit SwarmTrailRenderer(SwarmShaderManager& shaders);
+    ~SwarmTrailRenderer();
+    
+    // Queues the trail program on the shader manager; call once per context
+    static void addPrograms(SwarmShaderManager& shaders);
+    
+    // True once the program has linked
+    bool isReady() const;
+    
+    // Adds the snapshot's positions to the history, once per simulation tick, and moves the
+    // newest point along with the drones on the other steps of the tick; call every render
+    // so the history has no gaps while trails are hidden. The history is as long as the
+    // simulation's and starts over when that or the swarm size changes.
+    void update(const SwarmSnapshot& snapshot);
+    
+    // Draws the trails, hidden behind drones drawn before them. interpolation is the
+    // blend factor the drones were drawn with, so the trails follow them between frames.
+    void render(const SwarmCamera& camera, float interpolation);
+    
+    // Frees every GL object; call before the context goes away
+    void release();
+    
+    static constexpr float RIBBON_WIDTH = 0.08f;   // world units, at the drone end
+    static constexpr float TRAIL_ALPHA = 0.3f;     // as SwarmScenePainter's trails
+    
+    // Bytes of GL storage it holds; safe from any thread
+    size_t getGpuBytes() const { return gpuBytes.load(); }
+    
+private:
+    void allocate(int newNumDrones, int newHistoryLength);
+    
+    SwarmShaderManager& shaders;
+    int numDrones = 0;
+    
+    // Ring of historyLength slots of numDrones positions each
+    int historyLength = 0;
+    int newestSlot = 0;
+    int numPoints = 0;
+    int lastFrame = -1;
+    int lastTrailFrame = -1;
+    
+    GLuint historyBuffer = 0;
+    GLuint historyTexture = 0;
+    GLuint colourBuffer = 0;
+    GLuint colourTexture = 0;
+    GLuint vertexArray = 0;     // empty: the shader fetches everything itself
+    std::vector<float> uploadData;
+    std::atomic<size_t> gpuBytes { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmTrailRenderer)
+};
+
+//==============================================================================
+/**
+ * Draws the status line straight into the GL frame from a glyph atlas, so no
+ * component painting has to be composited over the scene.
+ *
+ * The printable ASCII glyphs are rasterised once into a single-channel texture
+ * at the display's scale. A line of text is then a quad per character, rebuilt
+ * only when the text or the viewport changes. Everything here runs on the GL
+ * thread.
+ */
+class SwarmHudRenderer
+{
+public:
+    explicit SwarmHudRenderer(SwarmShaderManager& shaders);
+    ~SwarmHudRenderer();
+    
+    // Queues the text program on the shader manager; call once per context
+    static void addPrograms(SwarmShaderManager& shaders);
+    
+    // True once the program has linked
+    bool isReady() const;
+    
+    // Draws a line of ASCII text centred along the top of the viewport (in logical pixels)
+    void render(std::string_view text, juce::Rectangle<int> viewport, float renderingScale);
+    
+    // Frees every GL object; call before the context goes away
+    void release();
+    
+    static constexpr float FONT_HEIGHT = 14.0f;    // logical pixels, as the component used
+    static constexpr int LINE_HEIGHT = 20;
+    static constexpr int MAX_TEXT_LENGTH = 256;    // characters laid out without allocating
+    
+    // Bytes of GL storage it holds; safe from any thread
+    size_t getGpuBytes() const { return gpuBytes.load(); }
+    
+private:
+    static constexpr juce::juce_wchar FIRST_GLYPH = ' ';
+    static constexpr juce::juce_wchar LAST_GLYPH = '~';
+    static constexpr int NUM_GLYPHS = LAST_GLYPH - FIRST_GLYPH + 1;
+    static constexpr int ATLAS_COLUMNS = 16;
+    
+    // Atlas cell of a glyph, in texture coordinates, and how far it advances the pen in pixels
+    struct Glyph
+    {
+        float left = 0.0f, top = 0.0f, right = 0.0f, bottom = 0.0f;
+        float advance = 0.0f;
+    };
+    
+    void buildAtlas(float renderingScale);
+    void layOut(std::string_view text, juce::Rectangle<int> viewport);
+    
+    SwarmShaderManager& shaders;
+    
+    std::array<Glyph, NUM_GLYPHS> glyphs {};
+    float atlasScale = 0.0f;
+    float cellWidth = 0.0f, cellHeight = 0.0f;     // pixels
+    
+    // Quads of the current text: x, y, u, v per vertex, six vertices per glyph. Both keep
+    // their storage, so a new line of text of a familiar length costs no allocation
+    std::string laidOutText;
+    juce::Rectangle<int> laidOutViewport;
+    std::vector<float> vertices;
+    GLsizei numVertices = 0;
+    
+    GLuint atlasTexture = 0;
+    GLuint vertexBuffer = 0;
+    GLuint vertexArray = 0;
+    size_t atlasBytes = 0;
+    std::atomic<size_t> gpuBytes { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmHudRenderer)
+};
+
+//==============================================================================
+/**
+ * An offscreen colour and depth buffer for drawing the scene at fewer pixels
+ * than the display has, then stretching it over the whole viewport.
+ *
+ * begin() redirects drawing into it, reallocating only when the size changes;
+ * end() blits it with linear filtering into whatever framebuffer was bound
+ * before. Everything here runs on the GL thread.
+ */
+class SwarmRenderTarget
+{
+public:
+    SwarmRenderTarget() = default;
+    ~SwarmRenderTarget();
+    
+    // Starts drawing into a width x height buffer; false (and nothing bound) if it can't be made
+    bool begin(int width, int height);
+    
+    // Stretches what was drawn over a destWidth x destHeight viewport of the previous framebuffer
+    void end(int destWidth, int destHeight);
+    
+    // Frees every GL object; call before the context goes away
+    void release();
+    
+    // Bytes of GL storage it holds; safe from any thread
+    size_t getGpuBytes() const { return gpuBytes.load(); }
+    
+private:
+    GLuint framebuffer = 0;
+    GLuint colourBuffer = 0;
+    GLuint depthBuffer = 0;
+    int bufferWidth = 0, bufferHeight = 0;
+    GLint previousFramebuffer = 0;
+    std::atomic<size_t> gpuBytes { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmRenderTarget)
+};
+
+//==============================================================================
+/**
+ * Measures how long the GPU spends on a stretch of GL commands, without ever
+ * waiting for it.
+ *
+ * Each begin()/end() pair records into the next of a few GL_TIME_ELAPSED
+ * queries. collect() picks up the results the GPU has already delivered and
+ * leaves the rest for later, so the figures arrive a frame or two late but
+ * the pipeline never stalls. Everything here runs on the GL thread.
+ */
+class SwarmGpuTimer
+{
+public:
+    SwarmGpuTimer() = default;
+    ~SwarmGpuTimer();
+    
+    void begin();
+    void end();
+    
+    // Milliseconds of GPU time measured by every query that finished since the last call
+    double collect();
+    
+    // Frees every GL object; call before the context goes away
+    void release();
+    
+private:
+    static constexpr int NUM_QUERIES = 4;
+    
+    std::array<GLuint, NUM_QUERIES> queries {};
+    std::array<bool, NUM_QUERIES> pending {};
+    int nextQuery = 0;
+    bool running = false;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmGpuTimer)
+};
@@ -0,0 +1,205 @@
+#include "SwarmScene.h"
+#include "SwarmSimulation.h"
+#include <cmath>
+
+//==============================================================================
+// SwarmSnapshot Implementation
+//==============================================================================
+
+void SwarmSnapshot::capture(const SwarmSimulation& simulation, bool includeTrails)
+{
+    auto& source = simulation.getDrones();
+    auto& trails = simulation.getTrails();
+    const int trailLength = includeTrails ? trails.getNumPoints() : 0;
+    
+    drones.resize(source.size());
+    trailPoints.resize(source.size() * static_cast<size_t>(trailLength));
+    frameNumber = simulation.getFrameCount();
+    trailCapacity = trails.getLength();
+    trailFrame = simulation.getTick();
+    newTrailPoint = simulation.didStepStartTick();
+    
+    for (size_t i = 0; i < source.size(); ++i)
+    {
+        auto& drone = *source[i];
+        auto& copy = drones[i];
+        
+        copy.position = drone.position;
+        copy.colour = drone.colour;
+        copy.size = drone.size;
+        copy.noteActive = drone.noteActive;
+        copy.trailStart = static_cast<int>(i) * trailLength;
+        copy.trailLength = trailLength;
+        
+        for (int age = 0; age < trailLength; ++age)
+            trailPoints[static_cast<size_t>(copy.trailStart + age)] = trails.getPoint(static_cast<int>(i), age);
+    }
+}
+
+//==============================================================================
+// SwarmScenePainter Implementation
+//==============================================================================
+
+void SwarmScenePainter::paint(juce::Graphics& g, juce::Rectangle<int> area, const SwarmSnapshot& snapshot, const View& view)
+{
+    // In a real implementation, we would use OpenGL to render the 3D scene
+    // For simplicity, here we use a basic 2D approximation
+    
+    // Center of the view
+    int centerX = area.getCentreX();
+    int centerY = area.getCentreY();
+    
+    // Render perspective
+    float fov = FOCAL_LENGTH * view.zoomLevel;
+    float cosAngle = std::cos(view.rotationAngle);
+    float sinAngle = std::sin(view.rotationAngle);
+    
+    // First render trails if enabled
+    if (view.showTrails)
+        paintTrails(g, area, snapshot, view);
+    
+    if (!view.showDrones)
+        return;
+    
+    // Render drones as circles
+    for (auto& drone : snapshot.drones)
+    {
+        // Apply rotation
+        float rotatedX = drone.position.x * cosAngle - drone.position.z * sinAngle;
+        float rotatedZ = drone.position.x * sinAngle + drone.position.z * cosAngle;
+        
+        // Perspective projection
+        float depth = CAMERA_DISTANCE + rotatedZ;
+        if (depth <= 0.0f) depth = 0.1f;
+        
+        float screenX = centerX + (rotatedX * fov) / depth;
+        float screenY = centerY + (drone.position.y * fov) / depth;
+        
+        // Size based on depth
+        float size = (drone.size / depth) * view.zoomLevel;
+        
+        // Draw the drone
+        g.setColour(drone.colour);
+        g.fillEllipse(screenX - size/2, screenY - size/2, size, size);
+        
+        // Draw outline if note is active
+        if (drone.noteActive)
+        {
+            g.setColour(juce::Colours::white);
+            g.drawEllipse(screenX - size/2, screenY - size/2, size, size, 2.0f);
+        }
+    }
+}
+
+void SwarmScenePainter::paintTrails(juce::Graphics& g, juce::Rectangle<int> area, const SwarmSnapshot& snapshot, const View& view)
+{
+    // Center of the view
+    int centerX = area.getCentreX();
+    int centerY = area.getCentreY();
+    
+    // Render perspective
+    float fov = FOCAL_LENGTH * view.zoomLevel;
+    float cosAngle = std::cos(view.rotationAngle);
+    float sinAngle = std::sin(view.rotationAngle);
+    
+    trailPath.preallocateSpace(snapshot.drones.empty() ? 0 : 3 * snapshot.drones.front().trailLength);
+    
+    // Render each drone's trail
+    for (auto& drone : snapshot.drones)
+    {
+        if (drone.trailLength < 2)
+            continue;
+        
+        // Set trail color (semi-transparent version of drone color)
+        g.setColour(drone.colour.withAlpha(0.3f));
+        
+        // Create path for the trail
+        trailPath.clear();
+        
+        for (int i = 0; i < drone.trailLength; ++i)
+        {
+            auto& pos = snapshot.trailPoints[static_cast<size_t>(drone.trailStart + i)];
+            
+            // Apply rotation
+            float rotatedX = pos.x * cosAngle - pos.z * sinAngle;
+            float rotatedZ = pos.x * sinAngle + pos.z * cosAngle;
+            
+            // Perspective projection
+            float depth = CAMERA_DISTANCE + rotatedZ;
+            if (depth <= 0.0f) depth = 0.1f;
+            
+            float screenX = centerX + (rotatedX * fov) / depth;
+            float screenY = centerY + (pos.y * fov) / depth;
+            
+            if (i == 0)
+                trailPath.startNewSubPath(screenX, screenY);
+            else
+                trailPath.lineTo(screenX, screenY);
+        }
+        
+        // Draw the trail
+        g.strokePath(trailPath, juce::PathStrokeType(1.0f));
+    }
+}
+
+//==============================================================================
+// SwarmSnapshotInterpolator Implementation
+//==============================================================================
+
+void SwarmSnapshotInterpolator::push(SwarmSnapshot& snapshot, const SwarmScenePainter::View& view, double timeMs)
+{
+    if (snapshot.frameNumber == newest.frameNumber && !newest.drones.empty())
+    {
+        std::swap(newest, snapshot);
+        newestView = view;
+        return;
+    }
+    
+    // Blend only between consecutive captures of the same swarm, and only forward in time
+    canBlend = snapshot.frameNumber > newest.frameNumber
+            && snapshot.drones.size() == newest.drones.size()
+            && timeMs > newestTimeMs
+            && timeMs - newestTimeMs <= MAX_STEP_MS;
+    
+    std::swap(older, newest);
+    std::swap(newest, snapshot);
+    olderRotation = newestView.rotationAngle;
+    olderTimeMs = newestTimeMs;
+    newestView = view;
+    newestTimeMs = timeMs;
+}
+
+float SwarmSnapshotInterpolator::getAlpha(double renderTimeMs) const
+{
+    if (!canBlend)
+        return 1.0f;
+    
+    auto stepMs = newestTimeMs - olderTimeMs;
+    return static_cast<float>(juce::jlimit(0.0, 1.0, (renderTimeMs - newestTimeMs) / stepMs));
+}
+
+void SwarmSnapshotInterpolator::interpolate(float alpha, SwarmSnapshot& result, SwarmScenePainter::View& resultView) const
+{
+    // Assigning into reused storage doesn't allocate once it has grown
+    result = newest;
+    resultView = newestView;
+    
+    if (!canBlend || alpha >= 1.0f)
+        return;
+    
+    for (size_t i = 0; i < result.drones.size(); ++i)
+    {
+        auto from = older.drones[i].position;
+        auto to = newest.drones[i].position;
+        result.drones[i].position = from + (to - from) * alpha;
+    }
+    
+    // Take the short way round when the angle wraps
+    auto turn = newestView.rotationAngle - olderRotation;
+    if (turn > juce::MathConstants<float>::pi)
+        turn -= juce::MathConstants<float>::twoPi;
+    else if (turn < -juce::MathConstants<float>::pi)
+        turn += juce::MathConstants<float>::twoPi;
+    
+    resultView.rotationAngle = olderRotation + turn * alpha;
+}
@@ -0,0 +1,130 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+class SwarmSimulation;
+
+//==============================================================================
+/**
+ * Everything needed to draw one frame of the swarm, copied out of the
+ * simulation so it can be drawn on another thread or at another rate.
+ *
+ * Storage is reused between captures, so once it has grown to the swarm's
+ * size capturing does not allocate.
+ */
+struct SwarmSnapshot
+{
+    struct Drone
+    {
+        juce::Vector3D<float> position;
+        juce::Colour colour;
+        float size = 100.0f;
+        bool noteActive = false;
+        
+        // Range of this drone's trail in trailPoints, newest first
+        int trailStart = 0;
+        int trailLength = 0;
+    };
+    
+    std::vector<Drone> drones;
+    std::vector<juce::Vector3D<float>> trailPoints;
+    int frameNumber = 0;
+    int trailCapacity = 0;      // trail points the simulation keeps per drone, captured or not
+    
+    // The newest trail point's tick, and whether this step started it; later steps
+    // in the same tick only move it along with the drones
+    int trailFrame = 0;
+    bool newTrailPoint = true;
+    
+    // Copies the simulation's last step. Within the storage reserve() set aside it
+    // never allocates, so it is safe on the audio thread.
+    void capture(const SwarmSimulation& simulation, bool includeTrails);
+    
+    // Sets aside storage for this many drones and trail points per drone
+    void reserve(int numDrones, int trailLength)
+    {
+        drones.reserve(static_cast<size_t>(numDrones));
+        trailPoints.reserve(static_cast<size_t>(numDrones * trailLength));
+    }
+    
+    size_t getMemoryBytes() const
+    {
+        return drones.capacity() * sizeof(Drone) + trailPoints.capacity() * sizeof(juce::Vector3D<float>);
+    }
+};
+
+//==============================================================================
+/**
+ * Draws a SwarmSnapshot with a simple rotating perspective projection.
+ *
+ * Used by the plugin editor. Keep one painter for as long as you draw: the
+ * trail path keeps its storage from paint to paint.
+ */
+class SwarmScenePainter
+{
+public:
+    struct View
+    {
+        float rotationAngle = 0.0f;
+        float zoomLevel = 1.0f;
+        bool showTrails = true;
+        bool showDrones = true;     // off when SwarmDroneRenderer draws them in OpenGL
+    };
+    
+    // The camera sits this far from the origin and projects with this focal length in
+    // pixels at zoom 1; a drone's size is its diameter in pixels at unit depth
+    static constexpr float CAMERA_DISTANCE = 30.0f;
+    static constexpr float FOCAL_LENGTH = 500.0f;
+    
+    void paint(juce::Graphics& g, juce::Rectangle<int> area, const SwarmSnapshot& snapshot, const View& view);
+    
+private:
+    void paintTrails(juce::Graphics& g, juce::Rectangle<int> area, const SwarmSnapshot& snapshot, const View& view);
+    
+    // One path serves every trail; clear() keeps its storage, so it only grows on the first paints
+    juce::Path trailPath;
+};
+
+//==============================================================================
+/**
+ * Keeps the two latest snapshots and blends between them, so the swarm can be
+ * drawn smoothly at display rate while the simulation steps far less often.
+ *
+ * Each frame is stamped with the time it stands for. Drawing runs one step
+ * behind: at render time t the picture is the older frame moved towards the
+ * newer one by how far t is past the newer frame's time, in steps. The step
+ * length is measured from the stamps, so any simulation rate works, and the
+ * newest frame is simply held when no new one arrives.
+ */
+class SwarmSnapshotInterpolator
+{
+public:
+    // Takes over a newly published frame, swapping storage with the caller's snapshot so
+    // nothing is copied. The same simulation frame published again (say after a zoom)
+    // only replaces the newest frame; one that doesn't follow on restarts the blending.
+    void push(SwarmSnapshot& snapshot, const SwarmScenePainter::View& view, double timeMs);
+    
+    // The blend factor for a render time, from 0 at the older frame to 1 at the newest
+    float getAlpha(double renderTimeMs) const;
+    
+    // Fills result with the frames blended by alpha: drone positions and the view's
+    // rotation move, everything else is the newest frame's
+    void interpolate(float alpha, SwarmSnapshot& result, SwarmScenePainter::View& resultView) const;
+    
+    const SwarmSnapshot& getNewest() const { return newest; }
+    
+    size_t getMemoryBytes() const { return older.getMemoryBytes() + newest.getMemoryBytes(); }
+    
+    // Frames further apart than this (a pause, a stall) are jumped to rather than crawled towards
+    static constexpr double MAX_STEP_MS = 250.0;
+    
+private:
+    SwarmSnapshot older, newest;
+    SwarmScenePainter::View newestView;
+    float olderRotation = 0.0f;
+    double olderTimeMs = 0.0;
+    double newestTimeMs = 0.0;
+    bool canBlend = false;
+};
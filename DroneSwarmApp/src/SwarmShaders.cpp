@@ -0,0 +1,359 @@
+#include "SwarmShaders.h"
+#include <algorithm>
+
+using namespace juce::gl;
+
+namespace
+{
+    juce::String getGLString(GLenum name)
+    {
+        auto* text = glGetString(name);
+        return text != nullptr ? juce::String(reinterpret_cast<const char*>(text)) : juce::String();
+    }
+    
+    juce::String getShaderLog(GLuint shader)
+    {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        
+        juce::HeapBlock<GLchar> log(static_cast<size_t>(juce::jmax(1, length)), true);
+        glGetShaderInfoLog(shader, juce::jmax(1, length), nullptr, log.get());
+        return juce::String(log.get()).trim();
+    }
+    
+    juce::String getProgramLog(GLuint program)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        
+        juce::HeapBlock<GLchar> log(static_cast<size_t>(juce::jmax(1, length)), true);
+        glGetProgramInfoLog(program, juce::jmax(1, length), nullptr, log.get());
+        return juce::String(log.get()).trim();
+    }
+    
+    GLuint createShader(GLenum type, const juce::String& source)
+    {
+        auto shader = glCreateShader(type);
+        const GLchar* text = source.toRawUTF8();
+        glShaderSource(shader, 1, &text, nullptr);
+        glCompileShader(shader);
+        return shader;
+    }
+}
+
+//==============================================================================
+// SwarmShaderManager Implementation
+//==============================================================================
+
+SwarmShaderManager::SwarmShaderManager(const juce::File& directory)
+    : cacheDirectory(directory)
+{
+}
+
+SwarmShaderManager::~SwarmShaderManager()
+{
+    // Programs belong to the context, so they must have been released with it
+    jassert(programs.empty());
+}
+
+juce::File SwarmShaderManager::getDefaultCacheDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("DroneSwarmApp")
+               .getChildFile("ShaderCache");
+}
+
+void SwarmShaderManager::detectCapabilities()
+{
+    capabilitiesKnown = true;
+    
+    driverDescription << getGLString(GL_VENDOR) << " | " << getGLString(GL_RENDERER) << " | "
+                      << getGLString(GL_VERSION);
+    
+    // Drivers may implement the entry points yet offer no binary formats (Mesa without its disk cache)
+    GLint numFormats = 0;
+    
+    if (glGetProgramBinary != nullptr && glProgramBinary != nullptr)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    
+    binaryCacheSupported = numFormats > 0 && cacheDirectory != juce::File()
+                               && cacheDirectory.createDirectory().wasOk();
+    
+    if (juce::OpenGLHelpers::isExtensionSupported("GL_KHR_parallel_shader_compile")
+            && glMaxShaderCompilerThreadsKHR != nullptr)
+    {
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+        parallelCompileSupported = true;
+    }
+    else if (juce::OpenGLHelpers::isExtensionSupported("GL_ARB_parallel_shader_compile")
+                 && glMaxShaderCompilerThreadsARB != nullptr)
+    {
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+        parallelCompileSupported = true;
+    }
+}
+
+void SwarmShaderManager::add(const ProgramSource& source)
+{
+    if (!capabilitiesKnown)
+        detectCapabilities();
+    
+    // Timing restarts with the first program of each batch
+    if (programs.empty() || finishMs >= startMs)
+        startMs = juce::Time::getMillisecondCounterHiRes();
+    
+    Program program;
+    program.source = source;
+    
+    if (binaryCacheSupported)
+    {
+        // Anything that changes the binary changes the key
+        juce::String key;
+        key << driverDescription << "\n" << source.vertexShader << "\n" << source.fragmentShader << "\n"
+            << source.geometryShader << "\n" << source.feedbackVaryings.joinIntoString(",");
+        
+        program.cacheFile = cacheDirectory.getChildFile(source.name + "-"
+                                                        + juce::String::toHexString(key.hashCode64()) + ".bin");
+    }
+    
+    if (!loadFromCache(program))
+        startCompiling(program);
+    
+    programs.push_back(std::move(program));
+}
+
+bool SwarmShaderManager::loadFromCache(Program& program)
+{
+    if (!program.cacheFile.existsAsFile())
+        return false;
+    
+    juce::MemoryBlock data;
+    
+    if (program.cacheFile.loadFileAsData(data) && data.getSize() > sizeof(juce::uint32))
+    {
+        auto format = static_cast<GLenum>(juce::ByteOrder::littleEndianInt(data.getData()));
+        
+        program.id = glCreateProgram();
+        glProgramBinary(program.id, format, static_cast<const char*>(data.getData()) + sizeof(juce::uint32),
+                        static_cast<GLsizei>(data.getSize() - sizeof(juce::uint32)));
+        
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program.id, GL_LINK_STATUS, &linked);
+        
+        if (linked == GL_TRUE)
+        {
+            program.state = Program::State::ready;
+            program.fromCache = true;
+            return true;
+        }
+        
+        glDeleteProgram(program.id);
+        program.id = 0;
+    }
+    
+    // The driver no longer accepts this binary, so it gets replaced by a fresh build
+    program.cacheFile.deleteFile();
+    return false;
+}
+
+void SwarmShaderManager::startCompiling(Program& program)
+{
+    auto& source = program.source;
+    program.id = glCreateProgram();
+    
+    program.vertexShader = createShader(GL_VERTEX_SHADER, source.vertexShader);
+    glAttachShader(program.id, program.vertexShader);
+
+    if (source.geometryShader.isNotEmpty())
+    {
+        program.geometryShader = createShader(GL_GEOMETRY_SHADER, source.geometryShader);
+        glAttachShader(program.id, program.geometryShader);
+    }
+
+    if (source.fragmentShader.isNotEmpty())
+    {
+        program.fragmentShader = createShader(GL_FRAGMENT_SHADER, source.fragmentShader);
+        glAttachShader(program.id, program.fragmentShader);
+    }
+
+    // Captured outputs are part of the link, and of the saved binary
+    if (!source.feedbackVaryings.isEmpty())
+    {
+        std::vector<const GLchar*> names;
+
+        for (auto& varying : source.feedbackVaryings)
+            names.push_back(varying.toRawUTF8());
+
+        glTransformFeedbackVaryings(program.id, static_cast<GLsizei>(names.size()), names.data(),
+                                    GL_INTERLEAVED_ATTRIBS);
+    }
+    
+    if (binaryCacheSupported)
+        glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    
+    // With parallel compile this returns at once and the driver's threads do the work
+    glLinkProgram(program.id);
+    program.state = Program::State::compiling;
+}
+
+bool SwarmShaderManager::isBuildComplete(const Program& program) const
+{
+    if (!parallelCompileSupported)
+        return true;
+    
+    GLint complete = GL_FALSE;
+    glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void SwarmShaderManager::finishCompiling(Program& program)
+{
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program.id, GL_LINK_STATUS, &linked);
+    
+    if (linked == GL_TRUE)
+    {
+        program.state = Program::State::ready;
+        
+        if (binaryCacheSupported)
+            saveToCache(program);
+    }
+    else
+    {
+        juce::String log;
+
+        for (auto shader : { program.vertexShader, program.geometryShader, program.fragmentShader })
+            if (shader != 0)
+                log << getShaderLog(shader) << "\n";
+
+        juce::Logger::writeToLog("Shader program " + program.source.name + " failed to build:\n"
+                                 + log + getProgramLog(program.id));
+        
+        glDeleteProgram(program.id);
+        program.id = 0;
+        program.state = Program::State::failed;
+    }
+    
+    deleteShaders(program);
+}
+
+void SwarmShaderManager::deleteShaders(Program& program)
+{
+    for (auto* shader : { &program.vertexShader, &program.geometryShader, &program.fragmentShader })
+    {
+        if (*shader != 0)
+            glDeleteShader(*shader);
+
+        *shader = 0;
+    }
+}
+
+void SwarmShaderManager::saveToCache(const Program& program)
+{
+    GLint length = 0;
+    glGetProgramiv(program.id, GL_PROGRAM_BINARY_LENGTH, &length);
+    
+    if (length <= 0)
+        return;
+    
+    juce::MemoryBlock data(sizeof(juce::uint32) + static_cast<size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program.id, length, nullptr, &format,
+                       static_cast<char*>(data.getData()) + sizeof(juce::uint32));
+    
+    auto formatBytes = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint32>(format));
+    data.copyFrom(&formatBytes, 0, sizeof(formatBytes));
+    
+    // Binaries from older drivers or sources for this program will never match again
+    for (auto& stale : cacheDirectory.findChildFiles(juce::File::findFiles, false, program.source.name + "-*.bin"))
+        stale.deleteFile();
+    
+    program.cacheFile.replaceWithData(data.getData(), data.getSize());
+}
+
+void SwarmShaderManager::update()
+{
+    if (programs.empty() || finishMs >= startMs)
+        return;
+    
+    bool allFinished = true;
+    
+    for (auto& program : programs)
+    {
+        if (program.state != Program::State::compiling)
+            continue;
+        
+        if (isBuildComplete(program))
+            finishCompiling(program);
+        else
+            allFinished = false;
+    }
+    
+    if (allFinished)
+    {
+        finishMs = juce::Time::getMillisecondCounterHiRes();
+        juce::Logger::writeToLog(getReport());
+    }
+}
+
+GLuint SwarmShaderManager::getProgram(const juce::String& name) const
+{
+    for (auto& program : programs)
+        if (program.source.name == name)
+            return program.state == Program::State::ready ? program.id : 0;
+    
+    return 0;
+}
+
+bool SwarmShaderManager::isFinished() const
+{
+    return std::none_of(programs.begin(), programs.end(),
+                        [](const Program& program) { return program.state == Program::State::compiling; });
+}
+
+void SwarmShaderManager::release()
+{
+    for (auto& program : programs)
+    {
+        deleteShaders(program);
+        
+        if (program.id != 0)
+            glDeleteProgram(program.id);
+    }
+    
+    programs.clear();
+    
+    // A new context may come from a different driver
+    capabilitiesKnown = false;
+    driverDescription.clear();
+    binaryCacheSupported = false;
+    parallelCompileSupported = false;
+    startMs = 0.0;
+    finishMs = -1.0;
+}
+
+juce::String SwarmShaderManager::getReport() const
+{
+    int numCached = 0, numCompiled = 0, numFailed = 0;
+    
+    for (auto& program : programs)
+    {
+        if (program.state == Program::State::failed)
+            ++numFailed;
+        else if (program.fromCache)
+            ++numCached;
+        else
+            ++numCompiled;
+    }
+    
+    juce::String report;
+    report << "Shaders: " << numCached << " from cache, " << numCompiled << " compiled";
+    
+    if (numFailed > 0)
+        report << ", " << numFailed << " failed";
+    
+    report << " in " << juce::String(juce::jmax(0.0, finishMs - startMs), 1) << " ms"
+           << (parallelCompileSupported ? " (parallel compile)" : "")
+           << (binaryCacheSupported ? "" : " (no binary cache)") << " on " << driverDescription;
+    return report;
+}
@@ -0,0 +1,96 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//==============================================================================
+/**
+ * Builds and owns the app's GLSL programs, with a persistent cache of linked
+ * program binaries.
+ *
+ * A program is loaded from the binary an earlier run saved when one matches,
+ * and compiled from source otherwise. Cache files are keyed by the driver's
+ * vendor, renderer and version strings and a hash of the sources, so a driver
+ * update or an edited shader just misses the cache; a binary the driver
+ * rejects is deleted and the program rebuilt from source. Where the driver
+ * supports KHR/ARB_parallel_shader_compile, source builds run on its compiler
+ * threads and are polled from update() instead of stalling context creation.
+ *
+ * Everything here runs on the GL thread with the context active.
+ */
+class SwarmShaderManager
+{
+public:
+    struct ProgramSource
+    {
+        juce::String name;
+        juce::String vertexShader;
+        juce::String fragmentShader;        // may be empty for transform-feedback-only programs
+        juce::String geometryShader;        // optional
+        juce::StringArray feedbackVaryings; // captured interleaved, in this order
+    };
+    
+    // An empty directory disables the binary cache
+    explicit SwarmShaderManager(const juce::File& cacheDirectory = getDefaultCacheDirectory());
+    ~SwarmShaderManager();
+    
+    // Starts building a program; it can be used once getProgram() returns non-zero
+    void add(const ProgramSource& source);
+    
+    // Finishes programs that are still building and logs the report once they all have;
+    // call once per frame
+    void update();
+    
+    // 0 while the program is still building or if it failed
+    GLuint getProgram(const juce::String& name) const;
+    
+    // True once every added program has either linked or failed
+    bool isFinished() const;
+    
+    // Deletes every program; call from openGLContextClosing()
+    void release();
+    
+    // One line on where the programs came from and how long building took
+    juce::String getReport() const;
+    
+    static juce::File getDefaultCacheDirectory();
+    
+private:
+    struct Program
+    {
+        enum class State { compiling, ready, failed };
+        
+        ProgramSource source;
+        juce::File cacheFile;
+        GLuint id = 0;
+        GLuint vertexShader = 0;
+        GLuint geometryShader = 0;
+        GLuint fragmentShader = 0;
+        State state = State::compiling;
+        bool fromCache = false;
+    };
+    
+    void detectCapabilities();
+    bool loadFromCache(Program& program);
+    void startCompiling(Program& program);
+    bool isBuildComplete(const Program& program) const;
+    void finishCompiling(Program& program);
+    void deleteShaders(Program& program);
+    void saveToCache(const Program& program);
+    
+    juce::File cacheDirectory;
+    std::vector<Program> programs;
+    
+    // What the current context offers, read on the first add()
+    bool capabilitiesKnown = false;
+    juce::String driverDescription;
+    bool binaryCacheSupported = false;
+    bool parallelCompileSupported = false;
+    
+    // Build timing; finishMs stays behind startMs until every program is done
+    double startMs = 0.0;
+    double finishMs = -1.0;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmShaderManager)
+};
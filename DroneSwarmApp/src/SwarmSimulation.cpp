@@ -0,0 +1,1419 @@
+#include "SwarmSimulation.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <limits>
+
+//==============================================================================
+// SwarmNoteEvent implementation
+
+juce::MidiMessage SwarmNoteEvent::toMidiMessage() const
+{
+    switch (type)
+    {
+        case Type::noteOn:
+            return juce::MidiMessage::noteOn(channel + 1, data1, static_cast<float>(data2) / 127.0f);
+            
+        case Type::noteOff:
+            return juce::MidiMessage::noteOff(channel + 1, data1, 0.0f);
+            
+        case Type::controller:
+            break;
+    }
+    
+    return juce::MidiMessage::controllerEvent(channel + 1, data1, data2);
+}
+
+//==============================================================================
+// SwarmTrailHistory implementation
+
+void SwarmTrailHistory::resize(int newNumDrones, int newLength)
+{
+    numDrones = juce::jmax(0, newNumDrones);
+    length = juce::jlimit(0, MAX_LENGTH, newLength);
+    head = 0;
+    numPoints = 0;
+    
+    // Shrinking should give the memory back too
+    for (auto* values : { &xs, &ys, &zs })
+    {
+        values->assign(static_cast<size_t>(numDrones * length), 0.0f);
+        values->shrink_to_fit();
+    }
+}
+
+void SwarmTrailHistory::push(const std::vector<std::unique_ptr<SwarmDrone>>& drones)
+{
+    startPoint(false);
+    writeNewest(drones, 0, static_cast<int>(drones.size()));
+}
+
+void SwarmTrailHistory::replaceNewest(const std::vector<std::unique_ptr<SwarmDrone>>& drones)
+{
+    startPoint(true);
+    writeNewest(drones, 0, static_cast<int>(drones.size()));
+}
+
+void SwarmTrailHistory::startPoint(bool reuseNewest)
+{
+    if (length == 0 || (reuseNewest && numPoints > 0))
+        return;
+    
+    head = (head + 1) % length;
+    numPoints = juce::jmin(numPoints + 1, length);
+}
+
+void SwarmTrailHistory::writeNewest(const std::vector<std::unique_ptr<SwarmDrone>>& drones, int start, int end)
+{
+    if (length == 0)
+        return;
+    
+    jassert(static_cast<int>(drones.size()) == numDrones && numPoints > 0);
+    
+    // Same slot in every drone's row
+    auto index = static_cast<size_t>(start * length + head);
+    
+    for (int i = start; i < end; ++i)
+    {
+        auto& drone = drones[static_cast<size_t>(i)];
+        xs[index] = drone->position.x;
+        ys[index] = drone->position.y;
+        zs[index] = drone->position.z;
+        index += static_cast<size_t>(length);
+    }
+}
+
+//==============================================================================
+// SwarmSimulation implementation
+
+SwarmSimulation::SwarmSimulation(int numDrones)
+{
+    numDrones = juce::jmax(1, numDrones);
+    
+    // Create drones
+    for (int i = 0; i < numDrones; ++i)
+    {
+        auto colour = juce::Colour::fromHSV(static_cast<float>(i) / numDrones, 1.0f, 1.0f, 1.0f);
+        drones.push_back(std::make_unique<SwarmDrone>(i, colour));
+    }
+    
+    // Continuous settings glide over a fixed time whatever the step rate
+    chaosLevel.reset(stepRate, PARAMETER_SMOOTHING_SECONDS);
+    formationStrength.reset(stepRate, PARAMETER_SMOOTHING_SECONDS);
+    
+    // Nothing applied yet, so the first pass picks up every parameter's default
+    formationNames = Formation::getFormationTypes();
+    rhythmNames = RhythmPattern::getRhythmTypes();
+    scaleNames = MusicScales::getScaleTypes();
+    scaleNotes.reserve(MusicScales::MAX_NOTES);
+    activePattern.reserve(static_cast<size_t>(numDrones));
+    appliedValues.fill(std::numeric_limits<float>::quiet_NaN());
+    applyParameters(tick);
+    
+    trails.resize(numDrones, DEFAULT_TRAIL_LENGTH);
+}
+
+SwarmSimulation::~SwarmSimulation() = default;
+
+void SwarmSimulation::setTrailLength(int newLength)
+{
+    trails.resize(static_cast<int>(drones.size()), newLength);
+}
+
+void SwarmSimulation::setNeighbourRadiusScale(float newScale)
+{
+    neighbourRadiusScale = juce::jlimit(0.1f, 1.0f, newScale);
+    currentFormation->setNeighbourRadiusScale(neighbourRadiusScale);
+}
+
+size_t SwarmSimulation::getDroneBytes() const
+{
+    return drones.capacity() * sizeof(std::unique_ptr<SwarmDrone>) + drones.size() * sizeof(SwarmDrone);
+}
+
+size_t SwarmSimulation::getNoteBytes() const
+{
+    return scaleNotes.capacity() * sizeof(int) + activePattern.capacity() / 8 + stepArena.getCapacity();
+}
+
+void SwarmSimulation::setStepRate(double stepsPerSecond)
+{
+    stepRate = juce::jlimit(MIN_STEP_RATE, MAX_STEP_RATE, stepsPerSecond);
+    
+    // Glides keep their length in seconds
+    chaosLevel.reset(stepRate, PARAMETER_SMOOTHING_SECONDS);
+    formationStrength.reset(stepRate, PARAMETER_SMOOTHING_SECONDS);
+}
+
+void SwarmSimulation::step()
+{
+    // The choreography moves on whenever a step starts in a new tick; at the lowest
+    // step rate that is every step
+    tick = static_cast<int>(std::floor(simulatedSeconds / TICK_SECONDS + 1.0e-6));
+    tickStarted = tick != lastTick;
+    lastTick = tick;
+    
+    // Apply control changes that arrived since the last step, then let the choreography
+    // run; both may write the store, so settings are picked up after them
+    drainCommands();
+    
+    if (tickStarted)
+        choreography.advance();
+    
+    applyParameters(tick);
+    
+    beginNotes(tickStarted);
+    updateSwarm(tickStarted);
+    mergeNoteEvents();
+    frameCount++;
+    simulatedSeconds += getStepSeconds();
+}
+
+void SwarmSimulation::applyParameters(int frame)
+{
+    if (automationReplay != nullptr)
+        automationReplay->replay(frame, parameters);
+    
+    bool scaleChanged = false;
+    
+    for (int i = 0; i < SwarmParameterStore::numParameters; ++i)
+    {
+        auto id = static_cast<SwarmParameterStore::Id>(i);
+        auto value = parameters.get(id);
+        auto& applied = appliedValues[static_cast<size_t>(i)];
+        
+        // Untouched parameters cost one atomic load; the first pass always applies (NaN never compares equal)
+        if (value == applied)
+            continue;
+        
+        const bool firstTime = std::isnan(applied);
+        applied = value;
+        externalChanges = true;
+        
+        switch (id)
+        {
+            case SwarmParameterStore::chaos:
+                if (firstTime)
+                    chaosLevel.setCurrentAndTargetValue(juce::jlimit(0.0f, 1.0f, value));
+                else
+                    chaosLevel.setTargetValue(juce::jlimit(0.0f, 1.0f, value));
+                break;
+                
+            case SwarmParameterStore::formationStrength:
+                if (firstTime)
+                    formationStrength.setCurrentAndTargetValue(juce::jlimit(0.0f, 1.0f, value));
+                else
+                    formationStrength.setTargetValue(juce::jlimit(0.0f, 1.0f, value));
+                break;
+                
+            case SwarmParameterStore::formation:
+                currentFormation = Formation::create(formationNames[static_cast<size_t>(
+                    juce::jlimit(0, static_cast<int>(formationNames.size()) - 1, juce::roundToInt(value)))]);
+                currentFormation->setNeighbourRadiusScale(neighbourRadiusScale);
+                formationName = currentFormation->getName();
+                break;
+                
+            case SwarmParameterStore::rhythm:
+                currentRhythm = RhythmPattern::create(rhythmNames[static_cast<size_t>(
+                    juce::jlimit(0, static_cast<int>(rhythmNames.size()) - 1, juce::roundToInt(value)))]);
+                rhythmName = currentRhythm->getName();
+                break;
+                
+            case SwarmParameterStore::scale:
+            case SwarmParameterStore::rootNote:
+                scaleChanged = true;
+                break;
+                
+            case SwarmParameterStore::numParameters:
+                break;
+        }
+        
+        if (automationRecorder != nullptr)
+            automationRecorder->record({ frame, id, value });
+    }
+    
+    // Scale and root note make one scale, rebuilt once however many of them moved
+    if (scaleChanged)
+        updateScaleNotes();
+}
+
+void SwarmSimulation::updateScaleNotes()
+{
+    auto scaleIndex = juce::jlimit(0, static_cast<int>(scaleNames.size()) - 1,
+                                   juce::roundToInt(appliedValues[SwarmParameterStore::scale]));
+    auto rootNote = juce::jlimit(0, 127, juce::roundToInt(appliedValues[SwarmParameterStore::rootNote]));
+    
+    musicScales.getScaleNotes(scaleNames[static_cast<size_t>(scaleIndex)], rootNote, scaleNotes);
+    ++scaleChangeCount;
+    
+    // Cells change meaning with the scale, so re-seat every drone without triggering
+    for (auto& drone : drones)
+        drone->noteCell = -1;
+}
+
+void SwarmSimulation::processCommands()
+{
+    // Between steps the tick is still the last step's; what changes now is first used,
+    // and on replay applied, by the next step, so it carries that step's tick
+    const auto nextTick = static_cast<int>(std::floor(simulatedSeconds / TICK_SECONDS + 1.0e-6));
+    
+    drainCommands();
+    applyParameters(nextTick);
+}
+
+bool SwarmSimulation::runAutomationCheck(juce::String& report)
+{
+    constexpr int numSteps = 50;
+    constexpr int changeStep = 17;
+    const auto numFormations = static_cast<int>(Formation::getFormationTypes().size());
+    const auto defaultFormation = juce::roundToInt(SwarmParameterStore::getDefaultValue(SwarmParameterStore::formation));
+    const auto newFormation = static_cast<float>((defaultFormation + 1) % numFormations);
+    
+    // The tick of the first step that ran with the new formation
+    auto findChangeTick = [&](SwarmSimulation& simulation, bool changeLive)
+    {
+        const auto oldName = simulation.getFormationName();
+        
+        for (int i = 0; i < numSteps; ++i)
+        {
+            // As the app does: the setting moves between steps and is picked up before the next
+            if (changeLive && i == changeStep)
+            {
+                simulation.getParameters().set(SwarmParameterStore::formation, newFormation);
+                simulation.processCommands();
+            }
+            
+            simulation.step();
+            
+            if (simulation.getFormationName() != oldName)
+                return simulation.getTick();
+        }
+        
+        return -1;
+    };
+    
+    // The recorder's ring buffer is too big for the stack
+    auto recorder = std::make_unique<SwarmAutomationRecorder>();
+    SwarmAutomationTrack track;
+    
+    SwarmSimulation live;
+    live.setAutomationRecorder(recorder.get());
+    const auto liveTick = findChangeTick(live, true);
+    recorder->drain([&track](const SwarmAutomationEvent& event) { track.add(event); });
+    
+    SwarmSimulation replayed;
+    replayed.setAutomationReplay(&track);
+    const auto replayedTick = findChangeTick(replayed, false);
+    
+    const auto recordedTick = track.getEvents().empty() ? -1 : track.getEvents().front().frame;
+    const bool passed = liveTick >= 0 && replayedTick == liveTick && recordedTick == liveTick;
+    
+    report << "Automation replay " << (passed ? "passed" : "FAILED") << ": formation changed live on tick "
+           << liveTick << ", recorded on tick " << recordedTick << ", replayed on tick " << replayedTick;
+    return passed;
+}
+
+void SwarmSimulation::drainCommands()
+{
+    commandQueue.drain([this](const SwarmCommand& command) { applyCommand(command); });
+}
+
+void SwarmSimulation::applyCommand(const SwarmCommand& command)
+{
+    switch (command.type)
+    {
+        case SwarmCommand::Type::setChaos:
+            parameters.set(SwarmParameterStore::chaos, command.values[0]);
+            break;
+                
+        case SwarmCommand::Type::setFormationStrength:
+            parameters.set(SwarmParameterStore::formationStrength, command.values[0]);
+            break;
+                
+        case SwarmCommand::Type::setFormation:
+            if (juce::isPositiveAndBelow(command.intValue, static_cast<int>(formationNames.size())))
+                parameters.set(SwarmParameterStore::formation, static_cast<float>(command.intValue));
+            break;
+                
+        case SwarmCommand::Type::setAttractor:
+            attractorActive = true;
+            attractorPosition = { command.values[0], command.values[1], command.values[2] };
+            attractorStrength = juce::jlimit(0.0f, 1.0f, command.values[3]);
+            break;
+                
+        case SwarmCommand::Type::clearAttractor:
+            attractorActive = false;
+            break;
+                
+        case SwarmCommand::Type::applyTargetOverrides:
+        {
+            // The whole batch is applied in one pass, then handed back to the producer
+            auto& batch = targetOverrides.getBatch(command.intValue);
+            const int numDrones = static_cast<int>(drones.size());
+                
+            for (int i = 0; i < batch.count; ++i)
+            {
+                auto droneIndex = batch.droneIndices[static_cast<size_t>(i)];
+                    
+                if (droneIndex < numDrones)
+                {
+                    auto& drone = drones[static_cast<size_t>(droneIndex)];
+                    drone->targetOverride = { batch.x[static_cast<size_t>(i)],
+                                              batch.y[static_cast<size_t>(i)],
+                                              batch.z[static_cast<size_t>(i)] };
+                    drone->hasTargetOverride = true;
+                }
+            }
+                
+            targetOverrides.release(command.intValue);
+            break;
+        }
+                
+        case SwarmCommand::Type::clearTargetOverrides:
+            for (auto& drone : drones)
+                drone->hasTargetOverride = false;
+            break;
+            
+        case SwarmCommand::Type::playChoreography:
+            choreography.play(command.intValue);
+            break;
+            
+        case SwarmCommand::Type::cue:
+            choreography.cue(command.intValue);
+            break;
+    }
+}
+    
+void SwarmSimulation::setTargetOverride(int droneIndex, juce::Vector3D<float> target)
+{
+    if (juce::isPositiveAndBelow(droneIndex, static_cast<int>(drones.size())))
+    {
+        auto& drone = drones[static_cast<size_t>(droneIndex)];
+        drone->targetOverride = target;
+        drone->hasTargetOverride = true;
+    }
+}
+
+void SwarmSimulation::clearTargetOverride(int droneIndex)
+{
+    if (juce::isPositiveAndBelow(droneIndex, static_cast<int>(drones.size())))
+        drones[static_cast<size_t>(droneIndex)]->hasTargetOverride = false;
+}
+
+void SwarmSimulation::updateSwarm(bool newTick)
+{
+    jassert(currentFormation != nullptr);
+    
+    // Smoothed settings advance once per step and every drone sees the same values
+    SwarmFormationStep formationStep;
+    formationStep.newTick = newTick;
+    formationStep.timeFactor = tick * 0.01f;
+    formationStep.attractorActive = attractorActive;
+    formationStep.attractorPosition = attractorPosition;
+    formationStep.attractorStrength = attractorStrength;
+    formationStep.setPhysics(chaosLevel.getNextValue(), formationStrength.getNextValue(),
+                             static_cast<float>(getStepSeconds() / numSubSteps), numSubSteps);
+    formationStep.blockProcessor = this;
+    
+    // One trail point per tick, its newest point following the drones until the next one
+    trails.startPoint(!newTick);
+    
+    // The whole step in one pass over the swarm, through one virtual call: each block
+    // of drones is moved, then recorded and checked for notes by processDroneBlock()
+    currentFormation->advance(drones, formationStep);
+}
+
+void SwarmSimulation::processDroneBlock(std::vector<std::unique_ptr<SwarmDrone>>& blockDrones, int start, int end)
+{
+    trails.writeNewest(blockDrones, start, end);
+    
+    for (auto i = static_cast<size_t>(start); i < static_cast<size_t>(end); ++i)
+    {
+        if (checkRhythmGate)
+            updateRhythmGate(i);
+        
+        // Notes are triggered as soon as a drone crosses into a new cell
+        if (findNoteCandidate(i))
+            triggerNote(noteCandidates.back());
+    }
+}
+
+void SwarmSimulation::beginNotes(bool newTick)
+{
+    // Last step's notes have been read by now, so the arena starts over. The vectors
+    // let go of their storage first: clearing them would keep it, and it is about to
+    // be handed out again
+    noteEvents = SwarmArenaVector<SwarmNoteEvent>(SwarmArenaAllocator<SwarmNoteEvent>(stepArena));
+    noteCandidates = SwarmArenaVector<SwarmNoteCandidate>(SwarmArenaAllocator<SwarmNoteCandidate>(stepArena));
+    stepArena.reset();
+    noteEvents.reserve(drones.size() * 4);
+    noteCandidates.reserve(drones.size());
+    
+    // The rhythm gate only changes at the slower check rate
+    checkRhythmGate = newTick && tick % noteCheckInterval == 0;
+    
+    // Get the active rhythm pattern; the drones themselves are gated as they move
+    if (checkRhythmGate)
+        currentRhythm->calculateActiveNotes(static_cast<int>(drones.size()), tick, activePattern);
+    
+    notesPossible = !scaleNotes.empty() && activePattern.size() == drones.size();
+}
+
+void SwarmSimulation::mergeNoteEvents()
+{
+    // Events were emitted drone by drone; playback wants them in time order, with each
+    // drone's note-off still ahead of its next note-on. A bottom-up merge sort is stable
+    // and O(n log n), and its scratch space comes from the step arena, not the heap.
+    const auto numEvents = noteEvents.size();
+    
+    if (numEvents < 2)
+        return;
+    
+    SwarmArenaVector<SwarmNoteEvent> scratch(numEvents, SwarmArenaAllocator<SwarmNoteEvent>(stepArena));
+    auto* source = noteEvents.data();
+    auto* destination = scratch.data();
+    
+    auto isEarlier = [](const SwarmNoteEvent& a, const SwarmNoteEvent& b) { return a.stepFraction < b.stepFraction; };
+    
+    for (size_t runLength = 1; runLength < numEvents; runLength *= 2)
+    {
+        for (size_t start = 0; start < numEvents; start += 2 * runLength)
+        {
+            const auto middle = juce::jmin(start + runLength, numEvents);
+            const auto end = juce::jmin(start + 2 * runLength, numEvents);
+            std::merge(source + start, source + middle, source + middle, source + end, destination + start, isEarlier);
+        }
+        
+        std::swap(source, destination);
+    }
+    
+    if (source != noteEvents.data())
+        std::copy(source, source + numEvents, noteEvents.data());
+}
+
+void SwarmSimulation::updateRhythmGate(size_t i)
+{
+    if (i >= activePattern.size())
+        return;
+    
+    auto& drone = drones[i];
+    
+    // Turn off note when drone stops or rhythm pattern doesn't include it
+    bool gateOpen = activePattern[i] && drone->velocity.length() > MIN_NOTE_SPEED;
+    
+    if (!gateOpen && drone->noteActive && drone->currentNote > 0)
+    {
+        noteEvents.push_back({ SwarmNoteEvent::Type::noteOff, 0.0f, static_cast<int>(i),
+                               drone->midiChannel, drone->currentNote, 0 });
+        drone->noteActive = false;
+        drone->currentNote = 0;
+    }
+    
+    // Visual feedback decays once the trigger is a check interval old
+    if (tick - drone->lastTriggerTick >= noteCheckInterval)
+        drone->size = 100.0f;
+}
+
+bool SwarmSimulation::findNoteCandidate(size_t i)
+{
+    if (!notesPossible)
+        return false;
+    
+    const int numCells = static_cast<int>(scaleNotes.size());
+    const float cellWidth = 30.0f / numCells;
+    const float hysteresis = cellWidth * NOTE_CELL_HYSTERESIS;
+    
+    auto cellForX = [&](float x)
+    {
+        return juce::jlimit(0, numCells - 1, static_cast<int>(std::floor((x + 15.0f) / cellWidth)));
+    };
+    
+    auto& drone = drones[i];
+    const float x = drone->position.x;
+    
+    if (drone->noteCell < 0)
+    {
+        drone->noteCell = cellForX(x);
+        return false;
+    }
+    
+    // Most drones stay inside their cell (plus a small hysteresis band) and cost nothing more
+    const float cellLow = -15.0f + drone->noteCell * cellWidth;
+    
+    if (x >= cellLow - hysteresis && x < cellLow + cellWidth + hysteresis)
+        return false;
+    
+    const int newCell = cellForX(x);
+    const int oldCell = drone->noteCell;
+    drone->noteCell = newCell;
+    
+    if (newCell == oldCell)
+        return false;
+    
+    noteCandidates.push_back({ static_cast<int>(i), oldCell, newCell, drone->previousPosition.x,
+                               drone->position, drone->velocity.length() });
+    return true;
+}
+
+void SwarmSimulation::triggerNote(const SwarmNoteCandidate& candidate)
+{
+    if (!notesPossible)
+        return;
+    
+    const int numCells = static_cast<int>(scaleNotes.size());
+    const float cellWidth = 30.0f / numCells;
+    const int oldCell = candidate.oldCell;
+    const int newCell = candidate.newCell;
+    
+    // Candidates are checked before they index anything
+    if (!juce::isPositiveAndBelow(candidate.droneIndex, static_cast<int>(drones.size()))
+            || !juce::isPositiveAndBelow(oldCell, numCells) || !juce::isPositiveAndBelow(newCell, numCells)
+            || oldCell == newCell)
+        return;
+    
+    const auto i = static_cast<size_t>(candidate.droneIndex);
+    auto& drone = drones[i];
+    
+    if (!activePattern[i] || candidate.speed <= MIN_NOTE_SPEED)
+        return;
+    
+    // Map Y position to velocity
+    int velocity = juce::jlimit(30, 100,
+        static_cast<int>((candidate.position.y + 15.0f) / 30.0f * 70.0f + 30.0f));
+    
+    // Map Z position to control parameters
+    int ccValue = juce::jlimit(0, 127,
+        static_cast<int>((candidate.position.z + 15.0f) / 30.0f * 127.0f));
+    
+    const int channel = drone->midiChannel;
+    const float x0 = candidate.previousX;
+    const float dx = candidate.position.x - x0;
+    const int direction = newCell > oldCell ? 1 : -1;
+    
+    // Fast drones may cross several cells in one step; each boundary gets its own onset
+    for (int cell = oldCell + direction; ; cell += direction)
+    {
+        float boundary = -15.0f + (direction > 0 ? cell : cell + 1) * cellWidth;
+        float fraction = std::abs(dx) > 1.0e-6f ? juce::jlimit(0.0f, 1.0f, (boundary - x0) / dx) : 1.0f;
+        int note = scaleNotes[static_cast<size_t>(cell)];
+        
+        // Send note off for previous note first
+        if (drone->noteActive && drone->currentNote > 0)
+            noteEvents.push_back({ SwarmNoteEvent::Type::noteOff, fraction, static_cast<int>(i),
+                                   channel, drone->currentNote, 0 });
+        
+        noteEvents.push_back({ SwarmNoteEvent::Type::noteOn, fraction, static_cast<int>(i),
+                               channel, note, velocity });
+        drone->noteActive = true;
+        drone->currentNote = note;
+        
+        // Occasional controller messages
+        if (noteRandom.nextFloat() < 0.3f)
+            noteEvents.push_back({ SwarmNoteEvent::Type::controller, fraction, static_cast<int>(i),
+                                   channel, 1, ccValue });
+        
+        if (cell == newCell)
+            break;
+    }
+    
+    // Visual feedback - increase size when note triggers
+    drone->size = 150.0f;
+    drone->lastTriggerTick = tick;
+}
+
+//==============================================================================
+// SwarmStepClock implementation
+
+void SwarmStepClock::reset(double clockRate, double stepSeconds, juce::int64 newOrigin)
+{
+    origin = newOrigin;
+    stepIndex = 0;
+    stepLength = juce::jmax(1.0, clockRate * stepSeconds);
+}
+
+void SwarmStepClock::resync(juce::int64 now)
+{
+    auto currentStep = static_cast<juce::int64>(std::floor(static_cast<double>(now - origin) / stepLength));
+    stepIndex = juce::jmax(stepIndex, currentStep);
+}
+
+//==============================================================================
+// SwarmDrone Implementation
+//==============================================================================
+
+SwarmDrone::SwarmDrone(int id, const juce::Colour& colour)
+    : droneId(id), colour(colour)
+{
+    // Initialize with random position, from one generator per thread rather than one per drone
+    thread_local std::mt19937 placement { std::random_device()() };
+    std::uniform_real_distribution<float> posDist(-10.0f, 10.0f);
+    position = juce::Vector3D<float>(posDist(placement), posDist(placement), posDist(placement));
+    
+    // Initialize with zero velocity
+    velocity = juce::Vector3D<float>(0.0f, 0.0f, 0.0f);
+    
+    // Set initial target to current position
+    targetPosition = position;
+    previousPosition = position;
+    
+    // Assign MIDI channel (distribute across 1-16)
+    midiChannel = id % 16;
+}
+
+SwarmDrone::~SwarmDrone() = default;
+
+void SwarmDrone::copyStateFrom(const SwarmDrone& other)
+{
+    position = other.position;
+    previousPosition = other.previousPosition;
+    velocity = other.velocity;
+    targetPosition = other.targetPosition;
+    droneId = other.droneId;
+    colour = other.colour;
+    size = other.size;
+    noteActive = other.noteActive;
+    currentNote = other.currentNote;
+    midiChannel = other.midiChannel;
+    noteCell = other.noteCell;
+    targetOverride = other.targetOverride;
+    hasTargetOverride = other.hasTargetOverride;
+    lastTriggerTick = other.lastTriggerTick;
+}
+
+void SwarmDrone::update(float formationStrength, float dampingFactor, juce::Vector3D<float> noise, float deltaSeconds)
+{
+    // Calculate vector to target
+    juce::Vector3D<float> toTarget = targetPosition - position;
+    float distanceToTarget = toTarget.length();
+    
+    // Normalize the direction if not zero
+    if (distanceToTarget > 0.001f)
+        toTarget = toTarget / distanceToTarget;
+    
+    // Apply force towards target based on formation strength
+    velocity += toTarget * (TARGET_ACCELERATION * formationStrength * deltaSeconds);
+    
+    // Add random movement (chaos), a random walk whose spread grows with sqrt(time)
+    velocity += noise;
+    
+    // Apply damping to prevent excessive speeds
+    velocity *= dampingFactor;
+    
+    // Limit maximum velocity
+    float currentSpeed = velocity.length();
+    if (currentSpeed > MAX_SPEED)
+        velocity = velocity * (MAX_SPEED / currentSpeed);
+    
+    // Update position with the new velocity
+    position += velocity * deltaSeconds;
+    
+    // Enforce boundaries
+    enforceBoundaries();
+}
+
+//==============================================================================
+// SwarmStepOutput Implementation
+//==============================================================================
+
+void SwarmStepOutput::capture(const SwarmSimulation& simulation)
+{
+    auto& source = simulation.getDrones();
+    
+    if (drones.size() > source.size())
+        drones.resize(source.size());
+    
+    while (drones.size() < source.size())
+    {
+        auto& drone = *source[drones.size()];
+        drones.push_back(std::make_unique<SwarmDrone>(drone.droneId, drone.colour));
+    }
+    
+    for (size_t i = 0; i < source.size(); ++i)
+        drones[i]->copyStateFrom(*source[i]);
+    
+    // As in SwarmSimulation::beginNotes(), the vector lets go before the arena starts over
+    noteEvents = SwarmArenaVector<SwarmNoteEvent>(SwarmArenaAllocator<SwarmNoteEvent>(arena));
+    arena.reset();
+    noteEvents.reserve(simulation.getNoteEvents().size());
+    noteEvents.insert(noteEvents.end(), simulation.getNoteEvents().begin(), simulation.getNoteEvents().end());
+    
+    frameNumber = simulation.getFrameCount();
+    stepSeconds = simulation.getStepSeconds();
+}
+
+//==============================================================================
+// Formation Implementation
+//==============================================================================
+
+// The integrator every formation kernel is compiled with: SwarmDrone::update over the step's sub-steps
+struct SemiImplicitEuler
+{
+    static void integrate(SwarmDrone& drone, const SwarmFormationStep& step, SwarmNoiseSource& noiseSource)
+    {
+        drone.previousPosition = drone.position;
+        
+        for (int i = 0; i < step.numSubSteps; ++i)
+        {
+            // Without chaos there is nothing to draw
+            auto noise = step.noiseSpread > 0.0f ? noiseSource.draw(step.noiseSpread) : juce::Vector3D<float>();
+            drone.update(step.formationStrength, step.dampingFactor, noise, step.subStepSeconds);
+        }
+    }
+};
+
+/**
+ * Formations are written as kernels: prepare() does whatever a formation needs
+ * once per tick for the whole swarm, and targetFor() gives one drone's target.
+ * This base stitches a kernel to the integrator, so advance() is the only
+ * virtual call in a step. It works through the swarm a block at a time, giving
+ * each drone its target, moving it and handing the block on to the step's
+ * block processor while it is still in cache; targetFor() and the integrator
+ * are inlined into the loop rather than called through the vtable per drone.
+ */
+template <typename Derived, typename Integrator = SemiImplicitEuler>
+class FormationKernel : public Formation
+{
+public:
+    void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor) override
+    {
+        auto& kernel = static_cast<Derived&>(*this);
+        numDrones = static_cast<int>(drones.size());
+        kernel.prepare(drones, timeFactor);
+        
+        for (int i = 0; i < numDrones; ++i)
+            drones[i]->targetPosition = kernel.targetFor(i, *drones[i], timeFactor);
+    }
+    
+    void advance(std::vector<std::unique_ptr<SwarmDrone>>& drones, const SwarmFormationStep& step) override
+    {
+        auto& kernel = static_cast<Derived&>(*this);
+        numDrones = static_cast<int>(drones.size());
+        
+        if (step.newTick)
+            kernel.prepare(drones, step.timeFactor);
+        
+        for (int blockStart = 0; blockStart < numDrones; blockStart += BLOCK_SIZE)
+        {
+            const int blockEnd = juce::jmin(numDrones, blockStart + BLOCK_SIZE);
+            
+            if (step.newTick)
+            {
+                for (int i = blockStart; i < blockEnd; ++i)
+                {
+                    auto& drone = *drones[i];
+                    drone.targetPosition = step.adjustTarget(drone, kernel.targetFor(i, drone, step.timeFactor));
+                }
+            }
+            
+            for (int i = blockStart; i < blockEnd; ++i)
+                Integrator::integrate(*drones[i], step, noiseSource);
+            
+            if (step.blockProcessor != nullptr)
+                step.blockProcessor->processDroneBlock(drones, blockStart, blockEnd);
+        }
+    }
+    
+    // Formations without per-tick set-up use this one
+    void prepare(const std::vector<std::unique_ptr<SwarmDrone>>& /*drones*/, float /*timeFactor*/) {}
+    
+    static constexpr int BLOCK_SIZE = 64; // drones
+    
+protected:
+    int numDrones = 0;
+    
+private:
+    SwarmNoiseSource noiseSource;
+};
+
+// Define concrete formation classes
+
+// Free formation - drones move randomly
+class FreeFormation : public FormationKernel<FreeFormation>
+{
+    std::mt19937 gen { std::random_device()() };
+    std::uniform_real_distribution<float> dist { -15.0f, 15.0f };
+    
+public:
+    juce::Vector3D<float> targetFor(int /*index*/, const SwarmDrone& drone, float /*timeFactor*/)
+    {
+        // Occasionally change target to a new random position
+        if (std::rand() % 100 < 5)
+            return { dist(gen), dist(gen), dist(gen) };
+        
+        return drone.targetPosition;
+    }
+    
+    juce::String getName() const override { return "Free"; }
+};
+
+// Circle formation
+class CircleFormation : public FormationKernel<CircleFormation>
+{
+public:
+    juce::Vector3D<float> targetFor(int i, const SwarmDrone& /*drone*/, float /*timeFactor*/) const
+    {
+        float radius = 10.0f;
+        float angle = (static_cast<float>(i) / numDrones) * juce::MathConstants<float>::twoPi;
+        
+        // Calculate position on the circle
+        float x = std::cos(angle) * radius;
+        float z = std::sin(angle) * radius;
+        
+        // Set the target with a slight Y offset based on index
+        return juce::Vector3D<float>(
+            x,
+            (i % 2 == 0) ? 2.0f : -2.0f, // Alternate up/down
+            z
+        );
+    }
+    
+    juce::String getName() const override { return "Circle"; }
+};
+
+// Spiral formation
+class SpiralFormation : public FormationKernel<SpiralFormation>
+{
+public:
+    juce::Vector3D<float> targetFor(int i, const SwarmDrone& /*drone*/, float timeFactor) const
+    {
+        float baseRadius = 5.0f;
+        float height = 12.0f;
+        
+        float t = static_cast<float>(i) / numDrones;
+        float angle = t * 4.0f * juce::MathConstants<float>::twoPi + timeFactor;
+        
+        // Calculate position on the spiral
+        float radius = baseRadius + t * 5.0f;
+        float x = std::cos(angle) * radius;
+        float y = height * (0.5f - t);
+        float z = std::sin(angle) * radius;
+        
+        return juce::Vector3D<float>(x, y, z);
+    }
+    
+    juce::String getName() const override { return "Spiral"; }
+};
+
+// Grid formation
+class GridFormation : public FormationKernel<GridFormation>
+{
+    int gridSize = 1;
+    float offset = 0.0f;
+    static constexpr float spacing = 5.0f;
+    
+public:
+    void prepare(const std::vector<std::unique_ptr<SwarmDrone>>& drones, float /*timeFactor*/)
+    {
+        // Calculate grid dimensions
+        gridSize = juce::jmax(1, static_cast<int>(std::ceil(std::sqrt(drones.size()))));
+        offset = spacing * (gridSize - 1) * 0.5f;
+    }
+    
+    juce::Vector3D<float> targetFor(int i, const SwarmDrone& /*drone*/, float timeFactor) const
+    {
+        int row = i / gridSize;
+        int col = i % gridSize;
+        
+        // Calculate grid position
+        float x = spacing * col - offset;
+        float z = spacing * row - offset;
+        
+        // Add some sinusoidal vertical movement
+        float y = 2.0f * std::sin(timeFactor + static_cast<float>(i) * 0.2f);
+        
+        return juce::Vector3D<float>(x, y, z);
+    }
+    
+    juce::String getName() const override { return "Grid"; }
+};
+
+// Wave formation
+class WaveFormation : public FormationKernel<WaveFormation>
+{
+public:
+    juce::Vector3D<float> targetFor(int i, const SwarmDrone& /*drone*/, float timeFactor) const
+    {
+        float width = 15.0f;
+        float depth = 10.0f;
+        
+        // Distribute drones evenly across the width
+        float t = static_cast<float>(i) / std::max(1, numDrones - 1);
+        float x = width * (t - 0.5f);
+        
+        // Create a wave pattern
+        float phase = timeFactor * 0.5f + t * juce::MathConstants<float>::twoPi;
+        float y = 3.0f * std::sin(phase);
+        float z = depth * (0.5f - t) * std::cos(phase * 0.5f);
+        
+        return juce::Vector3D<float>(x, y, z);
+    }
+    
+    juce::String getName() const override { return "Wave"; }
+};
+
+// Flock formation with boids-like behavior
+class FlockFormation : public FormationKernel<FlockFormation>
+{
+    std::vector<juce::Vector3D<float>> velocities;
+    std::vector<juce::Vector3D<float>> targets;
+    float radiusScale = 1.0f;
+    
+public:
+    FlockFormation() = default;
+    
+    void setNeighbourRadiusScale(float newScale) override { radiusScale = newScale; }
+    
+    // Every drone steers by its neighbours as they were at the start of the tick,
+    // so the whole flock is worked out here, before any of it moves
+    void prepare(const std::vector<std::unique_ptr<SwarmDrone>>& drones, float timeFactor)
+    {
+        // Initialize velocities if needed
+        if (velocities.size() != static_cast<size_t>(numDrones))
+        {
+            velocities.clear();
+            velocities.reserve(static_cast<size_t>(numDrones));
+            
+            for (int i = 0; i < numDrones; ++i)
+            {
+                velocities.push_back(juce::Vector3D<float>(
+                    std::sin(i * 0.1f) * 0.1f,
+                    std::cos(i * 0.2f) * 0.1f,
+                    std::sin(i * 0.3f + 0.5f) * 0.1f
+                ));
+            }
+        }
+        
+        targets.resize(static_cast<size_t>(numDrones));
+        
+        // Neighbour radii; pairs beyond the widest one are skipped before the square root
+        const float cohesionRadius = 10.0f * radiusScale;
+        const float separationRadius = 5.0f * radiusScale;
+        const float alignmentRadius = 7.0f * radiusScale;
+        const float cohesionRadiusSquared = cohesionRadius * cohesionRadius;
+        
+        // Update flock behavior
+        for (int i = 0; i < numDrones; ++i)
+        {
+            // Calculate cohesion, separation, and alignment
+            juce::Vector3D<float> cohesion(0, 0, 0);
+            juce::Vector3D<float> separation(0, 0, 0);
+            juce::Vector3D<float> alignment(0, 0, 0);
+            
+            int cohesionCount = 0;
+            int separationCount = 0;
+            int alignmentCount = 0;
+            
+            for (int j = 0; j < numDrones; ++j)
+            {
+                if (i == j) continue;
+                
+                auto offset = drones[i]->position - drones[j]->position;
+                float distanceSquared = offset.lengthSquared();
+                
+                if (distanceSquared >= cohesionRadiusSquared)
+                    continue;
+                
+                float distance = std::sqrt(distanceSquared);
+                
+                // Cohesion: steer towards center of neighbors
+                if (distance < cohesionRadius)
+                {
+                    cohesion += drones[j]->position;
+                    cohesionCount++;
+                }
+                
+                // Separation: avoid crowding neighbors
+                if (distance < separationRadius)
+                {
+                    separation += offset / std::max(0.1f, distance);
+                    separationCount++;
+                }
+                
+                // Alignment: match velocity of neighbors
+                if (distance < alignmentRadius)
+                {
+                    alignment += velocities[j];
+                    alignmentCount++;
+                }
+            }
+            
+            // Combine all forces
+            juce::Vector3D<float> force(0, 0, 0);
+            
+            // Apply cohesion
+            if (cohesionCount > 0)
+            {
+                cohesion = cohesion / static_cast<float>(cohesionCount) - drones[i]->position;
+                force += cohesion * 0.01f;
+            }
+            
+            // Apply separation
+            if (separationCount > 0)
+            {
+                separation = separation / static_cast<float>(separationCount);
+                force += separation * 0.04f;
+            }
+            
+            // Apply alignment
+            if (alignmentCount > 0)
+            {
+                alignment = alignment / static_cast<float>(alignmentCount);
+                force += alignment * 0.02f;
+            }
+            
+            // Add some wandering behavior
+            float t = timeFactor + i * 0.1f;
+            juce::Vector3D<float> wander(
+                std::sin(t) * 0.02f,
+                std::cos(t * 1.3f) * 0.01f,
+                std::sin(t * 0.7f) * 0.02f
+            );
+            force += wander;
+            
+            // Add boundary avoidance
+            const float boundary = 14.0f;
+            const float avoidStrength = 0.1f;
+            
+            if (drones[i]->position.x > boundary)
+                force.x -= avoidStrength;
+            else if (drones[i]->position.x < -boundary)
+                force.x += avoidStrength;
+                
+            if (drones[i]->position.y > boundary)
+                force.y -= avoidStrength;
+            else if (drones[i]->position.y < -boundary)
+                force.y += avoidStrength;
+                
+            if (drones[i]->position.z > boundary)
+                force.z -= avoidStrength;
+            else if (drones[i]->position.z < -boundary)
+                force.z += avoidStrength;
+            
+            // Update velocity
+            velocities[i] += force;
+            
+            // Limit velocity
+            float maxSpeed = 0.3f;
+            float speed = velocities[i].length();
+            if (speed > maxSpeed)
+                velocities[i] = velocities[i] * (maxSpeed / speed);
+            
+            // Set target just ahead of current position
+            targets[i] = drones[i]->position + velocities[i] * 5.0f;
+        }
+    }
+    
+    juce::Vector3D<float> targetFor(int i, const SwarmDrone& /*drone*/, float /*timeFactor*/) const
+    {
+        return targets[static_cast<size_t>(i)];
+    }
+    
+    juce::String getName() const override { return "Flock"; }
+};
+
+// Custom formation (can be modified for special patterns)
+class CustomFormation : public FormationKernel<CustomFormation>
+{
+public:
+    juce::Vector3D<float> targetFor(int i, const SwarmDrone& /*drone*/, float timeFactor) const
+    {
+        // Create a double helix pattern
+        float t = static_cast<float>(i) / numDrones;
+        float height = 15.0f * (0.5f - t);
+        
+        // First half for one helix, second half for the other
+        bool firstHelix = (i < numDrones / 2);
+        float offset = firstHelix ? 0.0f : juce::MathConstants<float>::pi;
+        int index = firstHelix ? i : (i - numDrones / 2);
+        float normalizedIndex = firstHelix ?
+            static_cast<float>(index) / (numDrones / 2) :
+            static_cast<float>(index) / (numDrones - numDrones / 2);
+        
+        // Calculate position on helix
+        float angle = normalizedIndex * 4.0f * juce::MathConstants<float>::twoPi + timeFactor + offset;
+        float radius = 8.0f;
+        float x = std::cos(angle) * radius;
+        float z = std::sin(angle) * radius;
+        
+        return juce::Vector3D<float>(x, height, z);
+    }
+    
+    juce::String getName() const override { return "Custom"; }
+};
+
+// Factory method to create formations
+std::unique_ptr<Formation> Formation::create(const juce::String& name)
+{
+    if (name == "Free")
+        return std::make_unique<FreeFormation>();
+    else if (name == "Circle")
+        return std::make_unique<CircleFormation>();
+    else if (name == "Spiral")
+        return std::make_unique<SpiralFormation>();
+    else if (name == "Grid")
+        return std::make_unique<GridFormation>();
+    else if (name == "Wave")
+        return std::make_unique<WaveFormation>();
+    else if (name == "Flock")
+        return std::make_unique<FlockFormation>();
+    else if (name == "Custom")
+        return std::make_unique<CustomFormation>();
+    
+    // Default to circle if not found
+    return std::make_unique<CircleFormation>();
+}
+
+// Available formation types
+std::vector<juce::String> Formation::getFormationTypes()
+{
+    return {
+        "Free",
+        "Circle",
+        "Spiral",
+        "Grid",
+        "Wave",
+        "Flock",
+        "Custom"
+    };
+}
+
+//==============================================================================
+// RhythmPattern Implementation
+//==============================================================================
+
+// Define concrete rhythm pattern classes
+
+// Continuous rhythm - all drones active
+class ContinuousRhythm : public RhythmPattern
+{
+public:
+    void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) override
+    {
+        // All drones are active
+        active.assign(static_cast<size_t>(numDrones), true);
+    }
+    
+    juce::String getName() const override { return "Continuous"; }
+};
+
+// Alternating rhythm - every other drone
+class AlternatingRhythm : public RhythmPattern
+{
+public:
+    void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) override
+    {
+        active.assign(static_cast<size_t>(numDrones), false);
+        
+        // Switch pattern every 30 frames
+        bool evenActive = (frameCount / 30) % 2 == 0;
+        
+        for (int i = 0; i < numDrones; ++i)
+        {
+            active[i] = (i % 2 == 0) ? evenActive : !evenActive;
+        }
+    }
+    
+    juce::String getName() const override { return "Alternating"; }
+};
+
+// Sequential rhythm - one drone at a time
+class SequentialRhythm : public RhythmPattern
+{
+public:
+    void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) override
+    {
+        active.assign(static_cast<size_t>(numDrones), false);
+        
+        // Activate one drone at a time, cycling through
+        int activeIndex = (frameCount / 10) % numDrones;
+        active[activeIndex] = true;
+    }
+    
+    juce::String getName() const override { return "Sequential"; }
+};
+
+// Wave rhythm - activation moves like a wave
+class WaveRhythm : public RhythmPattern
+{
+public:
+    void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) override
+    {
+        active.assign(static_cast<size_t>(numDrones), false);
+        
+        // Create a wave of activation
+        for (int i = 0; i < numDrones; ++i)
+        {
+            float phase = static_cast<float>(frameCount) * 0.05f +
+                          static_cast<float>(i) / numDrones * juce::MathConstants<float>::twoPi;
+            
+            active[i] = std::sin(phase) > 0.0f;
+        }
+    }
+    
+    juce::String getName() const override { return "Wave"; }
+};
+
+// Random rhythm - random activation
+class RandomRhythm : public RhythmPattern
+{
+public:
+    void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) override
+    {
+        active.assign(static_cast<size_t>(numDrones), false);
+        
+        // Update pattern every 20 frames
+        if (frameCount / 20 != lastUpdateFrame / 20 || pattern.size() != active.size())
+        {
+            lastUpdateFrame = frameCount;
+            pattern.resize(numDrones);
+            
+            // Generate new random pattern
+            for (int i = 0; i < numDrones; ++i)
+            {
+                pattern[i] = (std::rand() % 100) < 30; // 30% chance of being active
+            }
+        }
+        
+        active = pattern;
+    }
+    
+    juce::String getName() const override { return "Random"; }
+    
+private:
+    int lastUpdateFrame = -1;
+    std::vector<bool> pattern;
+};
+
+// Polyrhythm - different patterns for different drones
+class PolyrhythmRhythm : public RhythmPattern
+{
+public:
+    void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) override
+    {
+        active.assign(static_cast<size_t>(numDrones), false);
+        
+        // Divide drones into groups with different rhythms
+        for (int i = 0; i < numDrones; ++i)
+        {
+            int group = i % 3; // Three different groups
+            
+            switch (group)
+            {
+                case 0: // Group 1: Every 8 frames
+                    active[i] = (frameCount % 8) == 0;
+                    break;
+                    
+                case 1: // Group 2: Every 12 frames
+                    active[i] = (frameCount % 12) == 0;
+                    break;
+                    
+                case 2: // Group 3: Every 16 frames
+                    active[i] = (frameCount % 16) == 0;
+                    break;
+            }
+        }
+    }
+    
+    juce::String getName() const override { return "Polyrhythm"; }
+};
+
+// Factory method to create rhythm patterns
+std::unique_ptr<RhythmPattern> RhythmPattern::create(const juce::String& name)
+{
+    if (name == "Continuous")
+        return std::make_unique<ContinuousRhythm>();
+    else if (name == "Alternating")
+        return std::make_unique<AlternatingRhythm>();
+    else if (name == "Sequential")
+        return std::make_unique<SequentialRhythm>();
+    else if (name == "Wave")
+        return std::make_unique<WaveRhythm>();
+    else if (name == "Random")
+        return std::make_unique<RandomRhythm>();
+    else if (name == "Polyrhythm")
+        return std::make_unique<PolyrhythmRhythm>();
+    
+    // Default to continuous if not found
+    return std::make_unique<ContinuousRhythm>();
+}
+
+// Available rhythm types
+std::vector<juce::String> RhythmPattern::getRhythmTypes()
+{
+    return {
+        "Continuous",
+        "Alternating",
+        "Sequential",
+        "Wave",
+        "Random",
+        "Polyrhythm"
+    };
+}
+
+//==============================================================================
+// MusicScales Implementation
+//==============================================================================
+
+MusicScales::MusicScales()
+{
+    // Define common scales by their intervals
+    scales["Chromatic"] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    scales["Major"] = {0, 2, 4, 5, 7, 9, 11};
+    scales["Minor"] = {0, 2, 3, 5, 7, 8, 10};
+    scales["Pentatonic"] = {0, 2, 4, 7, 9};
+    scales["Blues"] = {0, 3, 5, 6, 7, 10};
+    scales["Dorian"] = {0, 2, 3, 5, 7, 9, 10};
+    scales["Phrygian"] = {0, 1, 3, 5, 7, 8, 10};
+    scales["Mixolydian"] = {0, 2, 4, 5, 7, 9, 10};
+    scales["Lydian"] = {0, 2, 4, 6, 7, 9, 11};
+    scales["Locrian"] = {0, 1, 3, 5, 6, 8, 10};
+}
+
+std::vector<int> MusicScales::getScaleNotes(const juce::String& scaleName, int rootNote) const
+{
+    std::vector<int> result;
+    getScaleNotes(scaleName, rootNote, result);
+    return result;
+}
+
+void MusicScales::getScaleNotes(const juce::String& scaleName, int rootNote, std::vector<int>& result) const
+{
+    result.clear();
+    
+    // Find the scale
+    auto scaleIt = scales.find(scaleName);
+    if (scaleIt == scales.end())
+    {
+        // Default to chromatic if scale not found
+        scaleIt = scales.find("Chromatic");
+    }
+    
+    const auto& intervals = scaleIt->second;
+    
+    // Generate 3 octaves worth of notes
+    for (int octave = 0; octave < 3; ++octave)
+    {
+        for (int interval : intervals)
+        {
+            int note = rootNote + octave * 12 + interval;
+            if (note >= 0 && note < 128) // Stay within MIDI note range
+                result.push_back(note);
+        }
+    }
+}
+
+std::vector<juce::String> MusicScales::getScaleTypes()
+{
+    return {
+        "Chromatic",
+        "Major",
+        "Minor",
+        "Pentatonic",
+        "Blues",
+        "Dorian",
+        "Phrygian",
+        "Mixolydian",
+        "Lydian",
+        "Locrian"
+    };
+}
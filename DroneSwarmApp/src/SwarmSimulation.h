@@ -0,0 +1,636 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <memory>
+#include <random>
+#include <map>
+#include <array>
+#include <utility>
+#include <cmath>
+
+#include "SwarmArena.h"
+#include "SwarmChoreography.h"
+#include "SwarmCommands.h"
+#include "SwarmParameters.h"
+
+//==============================================================================
+// Forward declarations
+class SwarmDrone;
+class Formation;
+class RhythmPattern;
+
+//==============================================================================
+/**
+ * A MIDI event produced by the swarm, timed within the simulation step that
+ * produced it so it can be played back with sub-frame accuracy
+ */
+struct SwarmNoteEvent
+{
+    enum class Type { noteOn, noteOff, controller };
+    
+    Type type = Type::noteOn;
+    float stepFraction = 0.0f;  // 0 = start of the step, 1 = end of it
+    int droneIndex = 0;
+    int channel = 0;            // 0-based MIDI channel
+    int data1 = 0;              // note or controller number
+    int data2 = 0;              // velocity or controller value
+    
+    juce::MidiMessage toMidiMessage() const;
+};
+
+//==============================================================================
+/**
+ * A drone that left its note cell during a step, before the rhythm gate and
+ * speed threshold decide whether it plays. Produced from the drones' own
+ * motion; the GPU physics prototype produces the same for its parity check.
+ */
+struct SwarmNoteCandidate
+{
+    int droneIndex = 0;
+    int oldCell = 0;
+    int newCell = 0;
+    float previousX = 0.0f;             // x at the start of the step
+    juce::Vector3D<float> position;     // at the end of the step
+    float speed = 0.0f;
+};
+
+//==============================================================================
+/**
+ * Trail history for the whole swarm in one fixed block.
+ *
+ * Positions are kept structure-of-arrays, each drone owning a row of
+ * getLength() slots, and all rows share one head index: recording a step is
+ * one strided store per drone and never allocates. Only resize() allocates,
+ * and it starts the history over.
+ */
+class SwarmTrailHistory
+{
+public:
+    // Room for length points per drone (0 turns trails off)
+    void resize(int numDrones, int length);
+    
+    // Forgets every recorded point
+    void clear() { numPoints = 0; }
+    
+    // Records the drones' current positions as the newest point
+    void push(const std::vector<std::unique_ptr<SwarmDrone>>& drones);
+    
+    // Moves the newest point to the drones' current positions (pushes if there is none yet)
+    void replaceNewest(const std::vector<std::unique_ptr<SwarmDrone>>& drones);
+    
+    int getLength() const { return length; }
+    
+    // Points recorded per drone so far, up to getLength()
+    int getNumPoints() const { return numPoints; }
+    
+    // age 0 is the newest point, and must be below getNumPoints()
+    juce::Vector3D<float> getPoint(int drone, int age) const
+    {
+        jassert(age >= 0 && age < numPoints);
+        auto index = static_cast<size_t>(drone * length + (head - age + length) % length);
+        return { xs[index], ys[index], zs[index] };
+    }
+    
+    // For filling in the newest point a block of drones at a time: start it (a new
+    // point, or the newest one again when reusing it), then write each block
+    void startPoint(bool reuseNewest);
+    void writeNewest(const std::vector<std::unique_ptr<SwarmDrone>>& drones, int start, int end);
+    
+    size_t getMemoryBytes() const { return (xs.capacity() + ys.capacity() + zs.capacity()) * sizeof(float); }
+    
+    static constexpr int MAX_LENGTH = 500;
+    
+private:
+    int numDrones = 0;
+    int length = 0;
+    int head = 0;
+    int numPoints = 0;
+    std::vector<float> xs, ys, zs;     // [drone][slot]
+};
+
+//==============================================================================
+/**
+ * Handles musical scales and note mapping
+ */
+class MusicScales
+{
+public:
+    MusicScales();
+    ~MusicScales() = default;
+    
+    // Get notes for a particular scale
+    std::vector<int> getScaleNotes(const juce::String& scaleName, int rootNote = 60) const;
+    
+    // The same, into a vector whose storage is reused
+    void getScaleNotes(const juce::String& scaleName, int rootNote, std::vector<int>& result) const;
+    
+    // Available scale types
+    static std::vector<juce::String> getScaleTypes();
+    
+    static constexpr int MAX_NOTES = 36; // three octaves of the chromatic scale
+    
+private:
+    // Scale definitions (intervals)
+    std::map<juce::String, std::vector<int>> scales;
+};
+
+//==============================================================================
+/**
+ * Told about each block of drones as soon as a formation has moved it, so
+ * the rest of the step's per-drone work runs while the block is in cache
+ */
+class SwarmDroneBlockProcessor
+{
+public:
+    virtual ~SwarmDroneBlockProcessor() = default;
+    
+    // Drones [start, end) have their new positions and velocities for this step
+    virtual void processDroneBlock(std::vector<std::unique_ptr<SwarmDrone>>& drones, int start, int end) = 0;
+};
+
+//==============================================================================
+/**
+ * The swarm itself: drones, formation, rhythm and note generation.
+ *
+ * Has no dependency on the UI so it can be stepped by the app's timer or
+ * headless (offline rendering, benchmarks). Other threads change it only
+ * through the parameter store and the command queue, both read at the start
+ * of each step.
+ */
+class SwarmSimulation : private SwarmDroneBlockProcessor
+{
+public:
+    explicit SwarmSimulation(int numDrones = DEFAULT_NUM_DRONES);
+    ~SwarmSimulation();
+    
+    // Advances one step: applies queued commands, updates targets and physics
+    // and collects the note events the step produced
+    void step();
+    
+    // Steps per second, MIN_STEP_RATE to MAX_STEP_RATE. Physics integrates over the
+    // step's length, and formations, rhythms and trails follow simulated time, so the
+    // swarm moves and plays the same at any rate; a higher rate only places notes
+    // more finely. Call between steps.
+    void setStepRate(double stepsPerSecond);
+    double getStepRate() const { return stepRate; }
+    double getStepSeconds() const { return 1.0 / stepRate; }
+    
+    // Physics passes per step, for stiff settings that need a shorter time step than the step rate's
+    void setNumSubSteps(int newNumSubSteps) { numSubSteps = juce::jlimit(1, MAX_SUB_STEPS, newNumSubSteps); }
+    int getNumSubSteps() const { return numSubSteps; }
+    
+    // Applies queued commands and parameter changes between steps (the app does so before
+    // each step and while paused). They are recorded and replayed with the tick of the
+    // step that follows, the first to use them.
+    void processCommands();
+    
+    // Applies one command straight away. Only on the thread that steps the simulation,
+    // between steps or from a choreography script; other threads use getCommandQueue().
+    void applyCommand(const SwarmCommand& command);
+    
+    // One drone's target instead of its formation's; same threading as applyCommand()
+    void setTargetOverride(int droneIndex, juce::Vector3D<float> target);
+    void clearTargetOverride(int droneIndex);
+    
+    // Scripted sequences of formations, settings and targets, run at the start of each tick
+    SwarmChoreography& getChoreography() { return choreography; }
+    const SwarmChoreography& getChoreography() const { return choreography; }
+    
+    // Settings, written from any thread; continuous values glide to their targets
+    SwarmParameterStore& getParameters() { return parameters; }
+    const SwarmParameterStore& getParameters() const { return parameters; }
+    
+    // Optional automation: applied values are recorded, and a track replays into the store.
+    // Both must outlive the simulation or be detached first.
+    void setAutomationRecorder(SwarmAutomationRecorder* newRecorder) { automationRecorder = newRecorder; }
+    void setAutomationReplay(SwarmAutomationTrack* newTrack) { automationReplay = newTrack; }
+    
+    const juce::String& getFormationName() const { return formationName; }
+    const juce::String& getRhythmName() const { return rhythmName; }
+    int getFrameCount() const { return frameCount; }
+    
+    // Choreography frames: TICK_SECONDS of simulated time each, whatever the step rate.
+    // Formations, rhythm patterns, trail points and automation run on these.
+    int getTick() const { return tick; }
+    
+    // True if the last step was the first in its tick
+    bool didStepStartTick() const { return tickStarted; }
+    
+    const std::vector<std::unique_ptr<SwarmDrone>>& getDrones() const { return drones; }
+    
+    // Where each drone has been over the last steps, newest first
+    const SwarmTrailHistory& getTrails() const { return trails; }
+    
+    // Points kept per drone, up to SwarmTrailHistory::MAX_LENGTH; clears the trails
+    void setTrailLength(int newLength);
+    
+    // Ticks between rhythm gate refreshes (NOTE_CHECK_INTERVAL by default)
+    void setNoteCheckInterval(int newInterval) { noteCheckInterval = juce::jmax(1, newInterval); }
+    int getNoteCheckInterval() const { return noteCheckInterval; }
+    
+    // Scales the neighbour radii of formations that look at their neighbours (the flock)
+    void setNeighbourRadiusScale(float newScale);
+    float getNeighbourRadiusScale() const { return neighbourRadiusScale; }
+    
+    // Note events produced by the last step, ordered as they were detected
+    const SwarmArenaVector<SwarmNoteEvent>& getNoteEvents() const { return noteEvents; }
+    
+    // Cell crossings the last step's notes were triggered from, in drone order
+    const SwarmArenaVector<SwarmNoteCandidate>& getNoteCandidates() const { return noteCandidates; }
+    
+    // The memory both of those come from; its high-water mark is the busiest step's
+    const SwarmFrameArena& getStepArena() const { return stepArena; }
+    
+    // Bytes held for the drones themselves, and for note generation (scale, rhythm gate, step arena)
+    size_t getDroneBytes() const;
+    size_t getNoteBytes() const;
+
+    // Notes are cells across x in [-15, 15], one per scale note; the count changes with every rebuild
+    int getNumNoteCells() const { return static_cast<int>(scaleNotes.size()); }
+    int getScaleChangeCount() const { return scaleChangeCount; }
+
+    // True once after a command or automation changed a setting the UI shows
+    bool consumeExternalChanges() { return std::exchange(externalChanges, false); }
+    
+    // Control input from other threads
+    SwarmCommandQueue& getCommandQueue() { return commandQueue; }
+    TargetOverridePool& getTargetOverrides() { return targetOverrides; }
+    
+    // Records a run with a setting changed between steps, replays it into a fresh
+    // simulation and checks the change lands on the same tick in both
+    static bool runAutomationCheck(juce::String& report);
+    
+    // Swarm parameters
+    static constexpr int DEFAULT_NUM_DRONES = 8;
+    static constexpr int UPDATE_INTERVAL_MS = 40; // 25 fps, the default step and the tick length
+    static constexpr double TICK_SECONDS = UPDATE_INTERVAL_MS / 1000.0;
+    static constexpr double MIN_STEP_RATE = 25.0;
+    static constexpr double MAX_STEP_RATE = 500.0;
+    static constexpr int MAX_SUB_STEPS = 16;
+    static constexpr int NOTE_CHECK_INTERVAL = 3; // ticks between rhythm gate refreshes
+    static constexpr float MIN_NOTE_SPEED = 7.5f; // units per second
+    static constexpr float NOTE_CELL_HYSTERESIS = 0.1f; // fraction of a cell width
+    
+    // Most note events one drone can produce in a step: the rhythm gate's note-off, then a
+    // note-off, note-on and controller for every cell boundary it crosses
+    static constexpr int MAX_EVENTS_PER_DRONE = 1 + 3 * (MusicScales::MAX_NOTES - 1);
+    static constexpr double PARAMETER_SMOOTHING_SECONDS = 0.2;
+    static constexpr int DEFAULT_TRAIL_LENGTH = 20;
+    static constexpr juce::int64 NOTE_RANDOM_SEED = 0x5eed;
+    
+private:
+    void drainCommands();
+    void applyParameters(int frame);
+    void updateScaleNotes();
+    void updateSwarm(bool newTick);
+    void beginNotes(bool newTick);
+    void processDroneBlock(std::vector<std::unique_ptr<SwarmDrone>>& blockDrones, int start, int end) override;
+    void updateRhythmGate(size_t droneIndex);
+    bool findNoteCandidate(size_t droneIndex);
+    void triggerNote(const SwarmNoteCandidate& candidate);
+    void mergeNoteEvents();
+    
+    std::vector<std::unique_ptr<SwarmDrone>> drones;
+    SwarmTrailHistory trails;
+    std::unique_ptr<Formation> currentFormation;
+    std::unique_ptr<RhythmPattern> currentRhythm;
+    int frameCount = 0;
+    
+    // Simulated time, and the tick it is in
+    double stepRate = 1000.0 / UPDATE_INTERVAL_MS;
+    int numSubSteps = 1;
+    double simulatedSeconds = 0.0;
+    int tick = 0;
+    int lastTick = -1;
+    bool tickStarted = false;
+    
+    int noteCheckInterval = NOTE_CHECK_INTERVAL;
+    float neighbourRadiusScale = 1.0f;
+    
+    // Settings: targets in the store, the values last applied, and the glides towards them
+    SwarmParameterStore parameters;
+    std::array<float, SwarmParameterStore::numParameters> appliedValues;
+    juce::SmoothedValue<float> chaosLevel, formationStrength;
+    std::vector<juce::String> formationNames, rhythmNames, scaleNames;
+    juce::String formationName, rhythmName;
+    SwarmAutomationRecorder* automationRecorder = nullptr;
+    SwarmAutomationTrack* automationReplay = nullptr;
+    
+    // Optional point that pulls every formation target towards it
+    bool attractorActive = false;
+    juce::Vector3D<float> attractorPosition;
+    float attractorStrength = 0.5f;
+    
+    // Note generation state
+    std::vector<int> scaleNotes;
+    MusicScales musicScales;
+    std::vector<bool> activePattern;
+    int scaleChangeCount = 0;
+    
+    // Rolls for the occasional controller messages. The simulation's own generator, not
+    // the shared system one, so it is only touched by the thread that steps it and the
+    // same notes give the same controllers from run to run
+    juce::Random noteRandom { NOTE_RANDOM_SEED };
+    
+    // A step's notes only live until the next step, so they come from memory reset each step
+    SwarmFrameArena stepArena;
+    SwarmArenaVector<SwarmNoteEvent> noteEvents { SwarmArenaAllocator<SwarmNoteEvent>(stepArena) };
+    SwarmArenaVector<SwarmNoteCandidate> noteCandidates { SwarmArenaAllocator<SwarmNoteCandidate>(stepArena) };
+    bool checkRhythmGate = false;   // this step refreshes the gate
+    bool notesPossible = false;     // there are cells and a pattern for every drone
+    
+    // Control input from other threads, applied at the start of each step
+    SwarmCommandQueue commandQueue;
+    TargetOverridePool targetOverrides;
+    bool externalChanges = false;
+    
+    // Last, so its scripts are destroyed while everything they use is still there
+    SwarmChoreography choreography { *this };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmSimulation)
+};
+
+//==============================================================================
+/**
+ * Schedules simulation steps against a sample clock rather than wall time.
+ *
+ * Step k starts at origin + k * stepLength on the clock and is simulated as
+ * soon as the clock gets there; its events play back over the following step.
+ * Step starts are computed from the step index rather than accumulated, so
+ * the schedule cannot drift however long the clock runs.
+ */
+class SwarmStepClock
+{
+public:
+    // Steps of stepSeconds on a clock counting clockRate ticks per second
+    void reset(double clockRate, double stepSeconds, juce::int64 origin);
+    
+    // Drops steps that are already overdue, e.g. after a pause or a stall
+    void resync(juce::int64 now);
+    
+    // True once the clock has reached the start of the next step
+    bool isStepDue(juce::int64 now) const { return now >= getStepStart(stepIndex); }
+    
+    // Clock position at which the next step's events start playing
+    juce::int64 getPlaybackStart() const { return getStepStart(stepIndex + 1); }
+    double getStepLength() const { return stepLength; }
+    
+    void advance() { ++stepIndex; }
+    
+private:
+    juce::int64 getStepStart(juce::int64 step) const
+    {
+        return origin + static_cast<juce::int64>(std::floor(static_cast<double>(step) * stepLength));
+    }
+    
+    juce::int64 origin = 0;
+    juce::int64 stepIndex = 0;
+    double stepLength = 1.0;
+};
+
+//==============================================================================
+/**
+ * Represents a single drone in the swarm
+ */
+class SwarmDrone
+{
+public:
+    SwarmDrone(int id, const juce::Colour& colour);
+    ~SwarmDrone();
+    
+    // Position and movement
+    juce::Vector3D<float> position;
+    juce::Vector3D<float> previousPosition;  // position at the start of the last step
+    juce::Vector3D<float> velocity;
+    juce::Vector3D<float> targetPosition;
+    
+    // State
+    int droneId;
+    juce::Colour colour;
+    float size = 100.0f;
+    bool noteActive = false;
+    int currentNote = 0;
+    int midiChannel = 0;
+    int noteCell = -1;          // scale cell the drone was last seen in
+    
+    // Externally supplied target that replaces the formation's
+    juce::Vector3D<float> targetOverride;
+    bool hasTargetOverride = false;
+    int lastTriggerTick = 0;
+    
+    // Copies the drone's state
+    void copyStateFrom(const SwarmDrone& other);
+    
+    // Integrates deltaSeconds of motion (semi-implicit Euler): steering and noise change
+    // the velocity, then the new velocity moves the drone. Velocity is in units per second.
+    // dampingFactor is for deltaSeconds (see SwarmFormationStep), and noise is the random
+    // change in velocity over it.
+    void update(float formationStrength, float dampingFactor, juce::Vector3D<float> noise, float deltaSeconds);
+    
+    // Physics constants, per second. At 25 steps per second they give the per-step
+    // values the swarm was designed with (0.1 units/step towards the target, x0.95
+    // damping per step, 0.5 units/step at most, 0.05 noise per step).
+    static constexpr float TARGET_ACCELERATION = 62.5f;     // units/s^2 at full formation strength
+    static constexpr float DAMPING_PER_SECOND = 1.2823f;    // velocity decays by exp(-this * dt)
+    static constexpr float MAX_SPEED = 12.5f;               // units/s
+    static constexpr float NOISE_DENSITY = 6.25f;           // units/s^1.5 at full chaos
+    
+    // Keep drone within bounds
+    void enforceBoundaries()
+    {
+        // Boundary checking - bounce off edges of the space
+        constexpr float boundary = 15.0f;
+        constexpr float bounceFactor = -0.7f;
+        
+        // X boundaries
+        if (position.x > boundary)
+        {
+            position.x = boundary - (position.x - boundary);
+            velocity.x *= bounceFactor;
+        }
+        else if (position.x < -boundary)
+        {
+            position.x = -boundary - (position.x + boundary);
+            velocity.x *= bounceFactor;
+        }
+        
+        // Y boundaries
+        if (position.y > boundary)
+        {
+            position.y = boundary - (position.y - boundary);
+            velocity.y *= bounceFactor;
+        }
+        else if (position.y < -boundary)
+        {
+            position.y = -boundary - (position.y + boundary);
+            velocity.y *= bounceFactor;
+        }
+        
+        // Z boundaries
+        if (position.z > boundary)
+        {
+            position.z = boundary - (position.z - boundary);
+            velocity.z *= bounceFactor;
+        }
+        else if (position.z < -boundary)
+        {
+            position.z = -boundary - (position.z + boundary);
+            velocity.z *= bounceFactor;
+        }
+    };
+};
+
+//==============================================================================
+/**
+ * The random part of the drones' motion. A generator's state runs to a few
+ * kilobytes, so the swarm shares one per formation rather than carrying one
+ * in every drone, which kept a block of drones from fitting in cache.
+ */
+class SwarmNoiseSource
+{
+public:
+    SwarmNoiseSource() : engine(std::random_device()()) {}
+    
+    // A change in velocity with this spread on each axis
+    juce::Vector3D<float> draw(float spread)
+    {
+        return { unitNoise(engine) * spread, unitNoise(engine) * spread, unitNoise(engine) * spread };
+    }
+    
+private:
+    std::mt19937 engine;
+    std::normal_distribution<float> unitNoise;
+};
+
+//==============================================================================
+/**
+ * One step's drone states and note events, copied out of the simulation so
+ * that they can be sent on while it works on the next step.
+ *
+ * Storage is kept from capture to capture: drones are only allocated when the
+ * swarm grows, and the note events live on the output's own frame arena.
+ */
+class SwarmStepOutput
+{
+public:
+    void capture(const SwarmSimulation& simulation);
+    
+    const std::vector<std::unique_ptr<SwarmDrone>>& getDrones() const { return drones; }
+    const SwarmArenaVector<SwarmNoteEvent>& getNoteEvents() const { return noteEvents; }
+    int getFrameNumber() const { return frameNumber; }
+    double getStepSeconds() const { return stepSeconds; }
+    
+private:
+    std::vector<std::unique_ptr<SwarmDrone>> drones;
+    SwarmFrameArena arena { 16 * 1024 };
+    SwarmArenaVector<SwarmNoteEvent> noteEvents { SwarmArenaAllocator<SwarmNoteEvent>(arena) };
+    int frameNumber = 0;
+    double stepSeconds = 0.0;
+};
+
+//==============================================================================
+/**
+ * Everything a formation needs to move the swarm through one step
+ */
+struct SwarmFormationStep
+{
+    // Formations are written for one update per tick, so targets only move when one starts
+    bool newTick = false;
+    float timeFactor = 0.0f;
+    
+    // Optional point that pulls every formation target towards it
+    bool attractorActive = false;
+    juce::Vector3D<float> attractorPosition;
+    float attractorStrength = 0.0f;
+    
+    // Physics, the same for every drone in the step
+    float formationStrength = 0.0f;
+    float subStepSeconds = 0.0f;
+    int numSubSteps = 1;
+    
+    // Worked out once per step from the above: the velocity kept over a sub-step,
+    // and the spread of the chaos noise added in one (0 when there is no chaos)
+    float dampingFactor = 1.0f;
+    float noiseSpread = 0.0f;
+    
+    void setPhysics(float chaosLevel, float strength, float newSubStepSeconds, int newNumSubSteps)
+    {
+        formationStrength = strength;
+        subStepSeconds = newSubStepSeconds;
+        numSubSteps = newNumSubSteps;
+        dampingFactor = std::exp(-SwarmDrone::DAMPING_PER_SECOND * subStepSeconds);
+        noiseSpread = chaosLevel * SwarmDrone::NOISE_DENSITY * std::sqrt(subStepSeconds);
+    }
+    
+    // Gets each block of drones once it has moved, if set
+    SwarmDroneBlockProcessor* blockProcessor = nullptr;
+    
+    // External control takes precedence over the formation, then the attractor pulls
+    juce::Vector3D<float> adjustTarget(const SwarmDrone& drone, juce::Vector3D<float> target) const
+    {
+        if (drone.hasTargetOverride)
+            return drone.targetOverride;
+        
+        if (attractorActive)
+            return target + (attractorPosition - target) * attractorStrength;
+        
+        return target;
+    }
+};
+
+//==============================================================================
+/**
+ * Base class for different formation patterns
+ */
+class Formation
+{
+public:
+    Formation() = default;
+    virtual ~Formation() = default;
+    
+    // Calculate target positions for all drones
+    virtual void calculateTargets(std::vector<std::unique_ptr<SwarmDrone>>& drones, 
+                                  float timeFactor) = 0;
+    
+    // Moves the swarm one step: targets on a new tick, then the drones' physics.
+    // The one virtual call per step; the work for each drone is compiled into it.
+    virtual void advance(std::vector<std::unique_ptr<SwarmDrone>>& drones, const SwarmFormationStep& step) = 0;
+    
+    // Get name of the formation
+    virtual juce::String getName() const = 0;
+    
+    // How far formations that look at their neighbours look, relative to their own radii
+    virtual void setNeighbourRadiusScale(float /*newScale*/) {}
+    
+    // Factory method to create formations
+    static std::unique_ptr<Formation> create(const juce::String& name);
+    
+    // Available formation types
+    static std::vector<juce::String> getFormationTypes();
+};
+
+//==============================================================================
+/**
+ * Base class for different rhythm patterns
+ */
+class RhythmPattern
+{
+public:
+    RhythmPattern() = default;
+    virtual ~RhythmPattern() = default;
+    
+    // Calculate which drones should be active for a given tick (SwarmSimulation::getTick).
+    // Fills active, one entry per drone, reusing its storage.
+    virtual void calculateActiveNotes(int numDrones, int frameCount, std::vector<bool>& active) = 0;
+    
+    // Get name of the rhythm pattern
+    virtual juce::String getName() const = 0;
+    
+    // Factory method to create rhythm patterns
+    static std::unique_ptr<RhythmPattern> create(const juce::String& name);
+    
+    // Available rhythm types
+    static std::vector<juce::String> getRhythmTypes();
+};
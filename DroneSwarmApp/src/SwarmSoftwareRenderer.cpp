@@ -0,0 +1,312 @@
+#include "SwarmSoftwareRenderer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Blends a premultiplied colour into a pixel with partial coverage
+    inline void blendPixel(juce::PixelARGB& destination, juce::PixelARGB colour, float coverage)
+    {
+        if (coverage >= 1.0f && colour.getAlpha() == 255)
+        {
+            destination = colour;
+            return;
+        }
+        
+        colour.multiplyAlpha(coverage);
+        destination.blend(colour);
+    }
+}
+
+//==============================================================================
+// SwarmSoftwareRenderer Implementation
+//==============================================================================
+
+SwarmSoftwareRenderer::SwarmSoftwareRenderer(SwarmWorkerPool& workerPool)
+    : workers(workerPool)
+{
+}
+
+void SwarmSoftwareRenderer::render(const SwarmSnapshot& snapshot, const SwarmScenePainter::View& view,
+                                   float trailInterpolation, float scale, juce::Image& image)
+{
+    jassert(image.getFormat() == juce::Image::ARGB);
+    
+    const int width = image.getWidth();
+    const int height = image.getHeight();
+    
+    if (width <= 0 || height <= 0)
+        return;
+    
+    const juce::Point<float> centre(static_cast<float>(width / 2), static_cast<float>(height / 2));
+    outlineHalfWidth = scale;   // the painter's outline is 2 logical pixels wide
+    trailHalfWidth = 0.5f * scale;  // and its trails 1
+    const auto numBands = static_cast<size_t>((height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+    bandDiscs.resize(numBands);
+    bandSegments.resize(numBands);
+    
+    for (size_t band = 0; band < numBands; ++band)
+    {
+        bandDiscs[band].clear();
+        bandSegments[band].clear();
+    }
+    
+    // Trails go under the drones, as in SwarmScenePainter
+    if (view.showTrails)
+        binSegments(snapshot, trailInterpolation, view, scale, centre, height);
+    else
+        segments.clear();
+    
+    if (view.showDrones)
+    {
+        const auto numDrones = snapshot.drones.size();
+        const auto numGroups = (numDrones + LANES - 1) / LANES;
+        xs.resize(numGroups);
+        ys.resize(numGroups);
+        zs.resize(numGroups);
+        
+        for (size_t i = 0; i < numDrones; ++i)
+        {
+            auto& position = snapshot.drones[i].position;
+            setLane(xs, i, position.x);
+            setLane(ys, i, position.y);
+            setLane(zs, i, position.z);
+        }
+        
+        projectPoints(numDrones, view, scale, centre);
+        binDiscs(snapshot, view, scale, height);
+    }
+    else
+    {
+        discs.clear();
+    }
+    
+    // Bands own disjoint rows, so they can all write at once
+    const juce::Image::BitmapData pixels(image, juce::Image::BitmapData::writeOnly);
+    workers.parallelFor(static_cast<int>(numBands), [this, &pixels](int band) { rasteriseBand(band, pixels); });
+}
+
+void SwarmSoftwareRenderer::projectPoints(size_t numPoints, const SwarmScenePainter::View& view, float scale,
+                                          juce::Point<float> centre)
+{
+    screenXs.resize(numPoints);
+    screenYs.resize(numPoints);
+    depths.resize(numPoints);
+    
+    // The view is the same for every point, so it is worked out once
+    const auto cosAngle = FloatVec::expand(std::cos(view.rotationAngle));
+    const auto sinAngle = FloatVec::expand(std::sin(view.rotationAngle));
+    const auto cameraDistance = FloatVec::expand(SwarmScenePainter::CAMERA_DISTANCE);
+    const auto minDepth = FloatVec::expand(0.1f);
+    const float focalLength = SwarmScenePainter::FOCAL_LENGTH * view.zoomLevel * scale;
+    
+    const auto numGroups = (numPoints + LANES - 1) / LANES;
+    
+    for (size_t g = 0; g < numGroups; ++g)
+    {
+        auto rotatedX = xs[g] * cosAngle - zs[g] * sinAngle;
+        auto depth = FloatVec::max(xs[g] * sinAngle + zs[g] * cosAngle + cameraDistance, minDepth);
+        
+        for (size_t lane = 0; lane < static_cast<size_t>(LANES); ++lane)
+        {
+            const auto i = g * LANES + lane;
+            
+            if (i >= numPoints)
+                break;
+            
+            const float pointDepth = depth.get(lane);
+            const float perspective = focalLength / pointDepth;
+            screenXs[i] = centre.x + rotatedX.get(lane) * perspective;
+            screenYs[i] = centre.y + ys[g].get(lane) * perspective;
+            depths[i] = pointDepth;
+        }
+    }
+}
+
+void SwarmSoftwareRenderer::binDiscs(const SwarmSnapshot& snapshot, const SwarmScenePainter::View& view,
+                                     float scale, int height)
+{
+    const auto numDrones = snapshot.drones.size();
+    discs.resize(numDrones);
+    
+    for (size_t i = 0; i < numDrones; ++i)
+    {
+        auto& drone = snapshot.drones[i];
+        discs[i] = { screenXs[i], screenYs[i], drone.size / depths[i] * view.zoomLevel * 0.5f * scale, depths[i],
+                     drone.colour.getPixelARGB(), drone.noteActive };
+    }
+    
+    // Back to front, so nearer drones cover further ones
+    std::sort(discs.begin(), discs.end(), [](const Disc& a, const Disc& b) { return a.depth > b.depth; });
+    
+    // Leave room for the anti-aliased edge and the note outline
+    const float margin = outlineHalfWidth + 1.5f;
+    const int lastBand = static_cast<int>(bandDiscs.size()) - 1;
+    
+    for (size_t i = 0; i < discs.size(); ++i)
+    {
+        auto& disc = discs[i];
+        auto top = static_cast<int>(std::floor((disc.y - disc.radius - margin) / BAND_HEIGHT));
+        auto bottom = static_cast<int>(std::floor((disc.y + disc.radius + margin) / BAND_HEIGHT));
+        
+        if (bottom < 0 || disc.y - disc.radius - margin >= static_cast<float>(height))
+            continue;
+        
+        for (int band = juce::jmax(0, top); band <= juce::jmin(lastBand, bottom); ++band)
+            bandDiscs[static_cast<size_t>(band)].push_back(static_cast<int>(i));
+    }
+}
+
+void SwarmSoftwareRenderer::binSegments(const SwarmSnapshot& snapshot, float trailInterpolation,
+                                        const SwarmScenePainter::View& view, float scale, juce::Point<float> centre,
+                                        int height)
+{
+    segments.clear();
+    
+    // Gather every trail point, slid towards the newer one as the drones are
+    const auto numPoints = snapshot.trailPoints.size();
+    const auto numGroups = (numPoints + LANES - 1) / LANES;
+    xs.resize(numGroups);
+    ys.resize(numGroups);
+    zs.resize(numGroups);
+    
+    for (auto& drone : snapshot.drones)
+    {
+        for (int age = 0; age < drone.trailLength; ++age)
+        {
+            auto& newer = snapshot.trailPoints[static_cast<size_t>(drone.trailStart + age)];
+            auto& older = snapshot.trailPoints[static_cast<size_t>(drone.trailStart
+                                                                   + juce::jmin(age + 1, drone.trailLength - 1))];
+            auto point = older + (newer - older) * trailInterpolation;
+            
+            const auto i = static_cast<size_t>(drone.trailStart + age);
+            setLane(xs, i, point.x);
+            setLane(ys, i, point.y);
+            setLane(zs, i, point.z);
+        }
+    }
+    
+    projectPoints(numPoints, view, scale, centre);
+    
+    const int lastBand = static_cast<int>(bandSegments.size()) - 1;
+    
+    for (auto& drone : snapshot.drones)
+    {
+        if (drone.trailLength < 2)
+            continue;
+        
+        const auto colour = drone.colour.withAlpha(0.3f).getPixelARGB();
+        
+        for (int age = 0; age + 1 < drone.trailLength; ++age)
+        {
+            const auto a = static_cast<size_t>(drone.trailStart + age);
+            const Segment segment { screenXs[a], screenYs[a], screenXs[a + 1], screenYs[a + 1], colour };
+            
+            // Pixels within the line's half width, plus one for the anti-aliased edge
+            auto minY = juce::jmin(segment.y0, segment.y1) - trailHalfWidth - 1.0f;
+            auto maxY = juce::jmax(segment.y0, segment.y1) + trailHalfWidth + 1.0f;
+            
+            if (maxY < 0.0f || minY >= static_cast<float>(height))
+                continue;
+            
+            const auto index = static_cast<int>(segments.size());
+            segments.push_back(segment);
+            
+            for (int band = juce::jmax(0, static_cast<int>(std::floor(minY / BAND_HEIGHT)));
+                 band <= juce::jmin(lastBand, static_cast<int>(std::floor(maxY / BAND_HEIGHT))); ++band)
+                bandSegments[static_cast<size_t>(band)].push_back(index);
+        }
+    }
+}
+
+void SwarmSoftwareRenderer::rasteriseBand(int band, const juce::Image::BitmapData& pixels) const
+{
+    const int top = band * BAND_HEIGHT;
+    const int bottom = juce::jmin(top + BAND_HEIGHT, pixels.height);
+    const int width = pixels.width;
+    const auto black = juce::PixelARGB(255, 0, 0, 0);
+    
+    auto row = [&pixels](int y) { return reinterpret_cast<juce::PixelARGB*>(pixels.getLinePointer(y)); };
+    
+    for (int y = top; y < bottom; ++y)
+        std::fill(row(y), row(y) + width, black);
+    
+    // Trails, with coverage from the distance to the segment, limited to this band's rows
+    for (auto index : bandSegments[static_cast<size_t>(band)])
+    {
+        auto& segment = segments[static_cast<size_t>(index)];
+        const float dx = segment.x1 - segment.x0;
+        const float dy = segment.y1 - segment.y0;
+        const float lengthSquared = dx * dx + dy * dy;
+        const float reach = trailHalfWidth + 1.0f;
+        
+        const auto minX = juce::jmin(segment.x0, segment.x1), maxX = juce::jmax(segment.x0, segment.x1);
+        const auto minY = juce::jmin(segment.y0, segment.y1), maxY = juce::jmax(segment.y0, segment.y1);
+        
+        const int firstY = juce::jmax(top, static_cast<int>(std::floor(minY - reach)));
+        const int lastY = juce::jmin(bottom - 1, static_cast<int>(std::ceil(maxY + reach)));
+        const int firstX = juce::jmax(0, static_cast<int>(std::floor(minX - reach)));
+        const int lastX = juce::jmin(width - 1, static_cast<int>(std::ceil(maxX + reach)));
+        
+        for (int y = firstY; y <= lastY; ++y)
+        {
+            auto* line = row(y);
+            const float offsetY = static_cast<float>(y) + 0.5f - segment.y0;
+            
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                // Nearest point of the segment to the pixel's centre
+                const float offsetX = static_cast<float>(x) + 0.5f - segment.x0;
+                const float along = lengthSquared > 0.0f ? (offsetX * dx + offsetY * dy) / lengthSquared : 0.0f;
+                const float t = juce::jlimit(0.0f, 1.0f, along);
+                const float awayX = offsetX - dx * t;
+                const float awayY = offsetY - dy * t;
+                const float coverage = juce::jlimit(0.0f, 1.0f, trailHalfWidth + 0.5f
+                                                                - std::sqrt(awayX * awayX + awayY * awayY));
+                
+                if (coverage > 0.0f)
+                    blendPixel(line[x], segment.colour, coverage);
+            }
+        }
+    }
+    
+    // Drones, back to front, with coverage from the distance to the edge
+    const auto white = juce::PixelARGB(255, 255, 255, 255);
+    
+    for (auto index : bandDiscs[static_cast<size_t>(band)])
+    {
+        auto& disc = discs[static_cast<size_t>(index)];
+        const float reach = disc.radius + (disc.noteActive ? outlineHalfWidth : 0.0f) + 1.0f;
+        
+        const int firstY = juce::jmax(top, static_cast<int>(std::floor(disc.y - reach)));
+        const int lastY = juce::jmin(bottom - 1, static_cast<int>(std::ceil(disc.y + reach)));
+        const int firstX = juce::jmax(0, static_cast<int>(std::floor(disc.x - reach)));
+        const int lastX = juce::jmin(width - 1, static_cast<int>(std::ceil(disc.x + reach)));
+        
+        for (int y = firstY; y <= lastY; ++y)
+        {
+            auto* line = row(y);
+            const float offsetY = static_cast<float>(y) + 0.5f - disc.y;
+            
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                const float offsetX = static_cast<float>(x) + 0.5f - disc.x;
+                const float distance = std::sqrt(offsetX * offsetX + offsetY * offsetY);
+                const float fill = juce::jlimit(0.0f, 1.0f, disc.radius + 0.5f - distance);
+                
+                if (fill > 0.0f)
+                    blendPixel(line[x], disc.colour, fill);
+                
+                // White outline while a note plays, as in the 2D view
+                if (disc.noteActive)
+                {
+                    const float outline = juce::jlimit(0.0f, 1.0f, outlineHalfWidth + 0.5f
+                                                                   - std::abs(distance - disc.radius));
+                    
+                    if (outline > 0.0f)
+                        blendPixel(line[x], white, outline);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+#include "SwarmScene.h"
+#include "SwarmWorkers.h"
+
+//==============================================================================
+/**
+ * CPU rasteriser for drawing large swarms without a GPU.
+ *
+ * Draws the same picture as SwarmScenePainter, but built for thousands of
+ * drones: the rotation is worked out once per frame and every drone and trail
+ * point is projected several at a time in SIMD registers. Drones are sorted
+ * back to front and binned, with the trail segments, into horizontal bands of
+ * the image. The bands are then rasterised in parallel on the worker pool,
+ * each one writing anti-aliased discs and lines straight into its own rows of
+ * the image's pixels. All working storage is reused from frame to frame.
+ */
+class SwarmSoftwareRenderer
+{
+public:
+    explicit SwarmSoftwareRenderer(SwarmWorkerPool& workers);
+    
+    // Draws the snapshot over the whole of an ARGB software image. scale is the image's
+    // pixels per logical pixel; trailInterpolation slides the trails as SwarmTrailRenderer's does.
+    void render(const SwarmSnapshot& snapshot, const SwarmScenePainter::View& view,
+                float trailInterpolation, float scale, juce::Image& image);
+    
+    static constexpr int BAND_HEIGHT = 32;     // image rows per parallel task
+    
+private:
+    using FloatVec = juce::dsp::SIMDRegister<float>;
+    static constexpr int LANES = static_cast<int>(FloatVec::SIMDNumElements);
+    
+    struct Disc
+    {
+        float x, y, radius, depth;
+        juce::PixelARGB colour;
+        bool noteActive;
+    };
+    
+    struct Segment
+    {
+        float x0, y0, x1, y1;
+        juce::PixelARGB colour;     // premultiplied, with the trail's alpha
+    };
+    
+    void setLane(std::vector<FloatVec>& registers, size_t index, float value)
+    {
+        registers[index / LANES].set(index % LANES, value);
+    }
+    
+    // Projects the points gathered into xs/ys/zs into screenXs/screenYs/depths
+    void projectPoints(size_t numPoints, const SwarmScenePainter::View& view, float scale, juce::Point<float> centre);
+    
+    void binDiscs(const SwarmSnapshot& snapshot, const SwarmScenePainter::View& view, float scale, int height);
+    void binSegments(const SwarmSnapshot& snapshot, float trailInterpolation, const SwarmScenePainter::View& view,
+                     float scale, juce::Point<float> centre, int height);
+    void rasteriseBand(int band, const juce::Image::BitmapData& pixels) const;
+    
+    SwarmWorkerPool& workers;
+    float outlineHalfWidth = 1.0f;     // image pixels
+    float trailHalfWidth = 0.5f;
+    
+    // Projection input in SIMD lanes, and its output
+    std::vector<FloatVec> xs, ys, zs;
+    std::vector<float> screenXs, screenYs, depths;
+    
+    std::vector<Disc> discs;
+    std::vector<Segment> segments;
+    std::vector<std::vector<int>> bandDiscs, bandSegments;
+};
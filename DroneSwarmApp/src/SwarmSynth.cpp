@@ -0,0 +1,486 @@
+#include "SwarmSynth.h"
+#include "SwarmSimulation.h"
+#include "SwarmInstrumentation.h"
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+// SwarmSynth Implementation
+//==============================================================================
+
+SwarmSynth::SwarmSynth(int voices)
+    : numVoices(juce::jmax(1, voices)),
+      numGroups((juce::jmax(1, voices) + LANES - 1) / LANES)
+{
+    for (auto* registers : { &phase, &increment, &shape, &lowpass, &cutoff,
+                             &envelope, &envelopeTarget, &envelopeRate, &gainLeft, &gainRight })
+        registers->resize(static_cast<size_t>(numGroups));
+    
+    groupActive.resize(static_cast<size_t>(numGroups));
+    fifoEvents.resize(EVENT_CAPACITY);
+    pending.resize(EVENT_CAPACITY);
+    
+    prepare(sampleRate.load(), blockSize.load());
+}
+
+SwarmSynth::~SwarmSynth() = default;
+
+void SwarmSynth::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    blockSize = juce::jmax(1, maximumBlockSize);
+    
+    // One-pole coefficients for a 5 ms attack and a 300 ms release
+    attackRate = 1.0f - std::exp(-1.0f / (0.005f * static_cast<float>(newSampleRate)));
+    releaseRate = 1.0f - std::exp(-1.0f / (0.3f * static_cast<float>(newSampleRate)));
+    
+    // Keeps a full swarm playing at once out of clipping
+    masterGain = 0.7f / std::sqrt(static_cast<float>(juce::jmax(4, numVoices)));
+    
+    const auto zero = FloatVec::expand(0.0f);
+    const auto centre = FloatVec::expand(std::sqrt(0.5f));
+    
+    std::fill(phase.begin(), phase.end(), zero);
+    std::fill(increment.begin(), increment.end(), zero);
+    std::fill(shape.begin(), shape.end(), FloatVec::expand(0.25f));
+    std::fill(lowpass.begin(), lowpass.end(), zero);
+    std::fill(cutoff.begin(), cutoff.end(), FloatVec::expand(cutoffForBrightness(0.5f)));
+    std::fill(envelope.begin(), envelope.end(), zero);
+    std::fill(envelopeTarget.begin(), envelopeTarget.end(), zero);
+    std::fill(envelopeRate.begin(), envelopeRate.end(), FloatVec::expand(releaseRate));
+    std::fill(gainLeft.begin(), gainLeft.end(), centre);
+    std::fill(gainRight.begin(), gainRight.end(), centre);
+    
+    // Read and dropped rather than reset, which would race the producer's write index
+    fifo.read(fifo.getNumReady());
+    numPending = 0;
+    samplePosition = 0;
+    setLastCallback(0, juce::Time::getMillisecondCounterHiRes());
+    ++clockGeneration;
+}
+
+bool SwarmSynth::postEvent(SynthEvent event)
+{
+    auto scope = fifo.write(1);
+    
+    if (scope.blockSize1 == 0)
+    {
+        ++numDroppedEvents;
+        return false;
+    }
+    
+    event.order = nextOrder++;
+    fifoEvents[static_cast<size_t>(scope.startIndex1)] = event;
+    return true;
+}
+
+void SwarmSynth::postNoteEvents(const SwarmArenaVector<SwarmNoteEvent>& noteEvents,
+                                const std::vector<std::unique_ptr<SwarmDrone>>& drones,
+                                juce::int64 stepStartSample, double stepSamples)
+{
+    for (auto& noteEvent : noteEvents)
+    {
+        if (!juce::isPositiveAndBelow(noteEvent.droneIndex, numVoices)
+            || noteEvent.droneIndex >= static_cast<int>(drones.size()))
+            continue;
+        
+        SynthEvent event;
+        event.voice = noteEvent.droneIndex;
+        event.sampleTime = stepStartSample + static_cast<juce::int64>(noteEvent.stepFraction * stepSamples);
+        
+        switch (noteEvent.type)
+        {
+            case SwarmNoteEvent::Type::noteOn:
+                event.type = SynthEvent::Type::noteOn;
+                event.note = noteEvent.data1;
+                event.value = static_cast<float>(noteEvent.data2) / 127.0f;
+                event.pan = juce::jlimit(-1.0f, 1.0f, drones[static_cast<size_t>(noteEvent.droneIndex)]->position.x / 15.0f);
+                break;
+            
+            case SwarmNoteEvent::Type::noteOff:
+                event.type = SynthEvent::Type::noteOff;
+                event.note = noteEvent.data1;
+                break;
+            
+            case SwarmNoteEvent::Type::controller:
+                event.type = SynthEvent::Type::brightness;
+                event.value = static_cast<float>(noteEvent.data2) / 127.0f;
+                break;
+        }
+        
+        postEvent(event);
+    }
+}
+
+void SwarmSynth::setLastCallback(juce::int64 sample, double milliseconds)
+{
+    auto sequence = lastCallbackSequence.load(std::memory_order_relaxed);
+    lastCallbackSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    lastCallbackSample.store(sample, std::memory_order_relaxed);
+    lastCallbackMs.store(milliseconds, std::memory_order_relaxed);
+    lastCallbackSequence.store(sequence + 2, std::memory_order_release);
+}
+
+SwarmSynth::CallbackTime SwarmSynth::getLastCallback() const
+{
+    for (;;)
+    {
+        auto before = lastCallbackSequence.load(std::memory_order_acquire);
+        
+        CallbackTime time;
+        time.sample = lastCallbackSample.load(std::memory_order_relaxed);
+        time.milliseconds = lastCallbackMs.load(std::memory_order_relaxed);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        if ((before & 1) == 0 && lastCallbackSequence.load(std::memory_order_relaxed) == before)
+            return time;
+        
+        juce::Thread::yield();
+    }
+}
+
+juce::int64 SwarmSynth::getSampleTimeForMillisecondCounter(double milliseconds) const
+{
+    const auto lastCallback = getLastCallback();
+    auto elapsedMs = milliseconds - lastCallback.milliseconds;
+    
+    return lastCallback.sample
+         + static_cast<juce::int64>(elapsedMs * 0.001 * sampleRate.load())
+         + blockSize.load();
+}
+
+double SwarmSynth::getMillisecondCounterForSampleTime(juce::int64 sampleTime) const
+{
+    const auto lastCallback = getLastCallback();
+    auto samplesAhead = sampleTime - lastCallback.sample - blockSize.load();
+    
+    return lastCallback.milliseconds + static_cast<double>(samplesAhead) * 1000.0 / sampleRate.load();
+}
+
+float SwarmSynth::cutoffForBrightness(float brightness) const
+{
+    // 200 Hz to 8 kHz, exponentially
+    auto frequency = 200.0f * std::pow(40.0f, juce::jlimit(0.0f, 1.0f, brightness));
+    return 1.0f - std::exp(-juce::MathConstants<float>::twoPi * frequency / static_cast<float>(sampleRate.load()));
+}
+
+void SwarmSynth::collectEvents()
+{
+    auto scope = fifo.read(juce::jmin(fifo.getNumReady(), EVENT_CAPACITY - numPending));
+    
+    if (scope.blockSize1 + scope.blockSize2 == 0)
+        return;
+    
+    auto* destination = pending.data() + numPending;
+    destination = std::copy_n(fifoEvents.data() + scope.startIndex1, scope.blockSize1, destination);
+    std::copy_n(fifoEvents.data() + scope.startIndex2, scope.blockSize2, destination);
+    numPending += scope.blockSize1 + scope.blockSize2;
+    
+    // Producers post in detection order, not time order; sorting in place never allocates
+    std::sort(pending.begin(), pending.begin() + numPending, [](const SynthEvent& a, const SynthEvent& b)
+    {
+        return a.sampleTime != b.sampleTime ? a.sampleTime < b.sampleTime
+                                            : static_cast<juce::int32>(a.order - b.order) < 0;
+    });
+}
+
+void SwarmSynth::applyEvent(const SynthEvent& event)
+{
+    const int v = event.voice;
+    
+    if (!juce::isPositiveAndBelow(v, numVoices))
+        return;
+    
+    switch (event.type)
+    {
+        case SynthEvent::Type::noteOn:
+        {
+            // Mono voice per drone: glide straight to the new pitch without resetting the phase
+            auto frequency = static_cast<float>(juce::MidiMessage::getMidiNoteInHertz(event.note));
+            auto angle = (event.pan + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+            
+            setLane(increment, v, juce::jmin(1.0f, 2.0f * frequency / static_cast<float>(sampleRate.load())));
+            setLane(envelopeTarget, v, event.value);
+            setLane(envelopeRate, v, attackRate);
+            setLane(gainLeft, v, std::cos(angle));
+            setLane(gainRight, v, std::sin(angle));
+            break;
+        }
+        
+        case SynthEvent::Type::noteOff:
+            setLane(envelopeTarget, v, 0.0f);
+            setLane(envelopeRate, v, releaseRate);
+            break;
+        
+        case SynthEvent::Type::brightness:
+            setLane(cutoff, v, cutoffForBrightness(event.value));
+            setLane(shape, v, event.value * 0.5f);
+            break;
+    }
+}
+
+void SwarmSynth::render(float* left, float* right, int numSamples)
+{
+    juce::ScopedNoDenormals noDenormals;
+    
+    collectEvents();
+    
+    const auto blockEnd = samplePosition + numSamples;
+    int eventIndex = 0;
+    int offset = 0;
+    
+    // Split the block at every event so each one lands on its exact sample
+    while (offset < numSamples)
+    {
+        while (eventIndex < numPending && pending[static_cast<size_t>(eventIndex)].sampleTime <= samplePosition + offset)
+            applyEvent(pending[static_cast<size_t>(eventIndex++)]);
+        
+        auto subBlockEnd = eventIndex < numPending
+                         ? juce::jmin(blockEnd, pending[static_cast<size_t>(eventIndex)].sampleTime)
+                         : blockEnd;
+        auto length = static_cast<int>(subBlockEnd - (samplePosition + offset));
+        
+        renderVoices(left + offset, right + offset, length);
+        offset += length;
+    }
+    
+    // Keep the events that belong to later blocks
+    std::copy(pending.begin() + eventIndex, pending.begin() + numPending, pending.begin());
+    numPending -= eventIndex;
+    
+    samplePosition = blockEnd;
+}
+
+void SwarmSynth::renderVoices(float* left, float* right, int numSamples)
+{
+    // Groups whose envelopes are at rest contribute nothing and are skipped entirely
+    bool anyActive = false;
+    
+    for (size_t g = 0; g < groupActive.size(); ++g)
+    {
+        groupActive[g] = (envelope[g] + envelopeTarget[g]).sum() > 1.0e-5f;
+        anyActive = anyActive || groupActive[g] != 0;
+    }
+    
+    if (!anyActive)
+    {
+        std::fill_n(left, numSamples, 0.0f);
+        std::fill_n(right, numSamples, 0.0f);
+        return;
+    }
+    
+    const auto one = FloatVec::expand(1.0f);
+    const auto two = FloatVec::expand(2.0f);
+    const auto four = FloatVec::expand(4.0f);
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        auto mixLeft = FloatVec::expand(0.0f);
+        auto mixRight = FloatVec::expand(0.0f);
+        
+        for (size_t g = 0; g < groupActive.size(); ++g)
+        {
+            if (groupActive[g] == 0)
+                continue;
+            
+            // Phase runs over [-1, 1)
+            auto p = phase[g] + increment[g];
+            p = p - (two & FloatVec::greaterThanOrEqual(p, one));
+            phase[g] = p;
+            
+            // Parabolic sine, blended towards the raw saw by the voice's shape
+            auto sine = four * p * (one - FloatVec::abs(p));
+            auto oscillator = sine + shape[g] * (p - sine);
+            
+            lowpass[g] = lowpass[g] + cutoff[g] * (oscillator - lowpass[g]);
+            envelope[g] = envelope[g] + envelopeRate[g] * (envelopeTarget[g] - envelope[g]);
+            
+            auto output = lowpass[g] * envelope[g];
+            mixLeft = FloatVec::multiplyAdd(mixLeft, output, gainLeft[g]);
+            mixRight = FloatVec::multiplyAdd(mixRight, output, gainRight[g]);
+        }
+        
+        left[i] = mixLeft.sum() * masterGain;
+        right[i] = mixRight.sum() * masterGain;
+    }
+}
+
+void SwarmSynth::audioDeviceIOCallbackWithContext(const float* const*, int,
+                                                  float* const* outputChannelData, int numOutputChannels,
+                                                  int numSamples,
+                                                  const juce::AudioIODeviceCallbackContext&)
+{
+    const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::audio);
+    setLastCallback(samplePosition, juce::Time::getMillisecondCounterHiRes());
+    
+    if (numOutputChannels >= 2 && outputChannelData[0] != nullptr && outputChannelData[1] != nullptr)
+    {
+        render(outputChannelData[0], outputChannelData[1], numSamples);
+        
+        for (int channel = 2; channel < numOutputChannels; ++channel)
+            if (outputChannelData[channel] != nullptr)
+                juce::FloatVectorOperations::clear(outputChannelData[channel], numSamples);
+        
+        return;
+    }
+    
+    // Mono devices get the left channel, rendered in pieces if the block is oversized
+    for (int offset = 0; offset < numSamples;)
+    {
+        auto length = juce::jmin(numSamples - offset, deviceBuffer.getNumSamples());
+        render(deviceBuffer.getWritePointer(0), deviceBuffer.getWritePointer(1), length);
+        
+        for (int channel = 0; channel < numOutputChannels; ++channel)
+            if (outputChannelData[channel] != nullptr)
+                juce::FloatVectorOperations::copy(outputChannelData[channel] + offset,
+                                                  deviceBuffer.getReadPointer(juce::jmin(channel, 1)), length);
+        
+        offset += length;
+    }
+}
+
+void SwarmSynth::audioDeviceAboutToStart(juce::AudioIODevice* device)
+{
+    auto bufferSize = device->getCurrentBufferSizeSamples();
+    
+    deviceBuffer.setSize(2, juce::jmax(1, bufferSize));
+    prepare(device->getCurrentSampleRate(), bufferSize);
+}
+
+void SwarmSynth::audioDeviceStopped()
+{
+}
+
+//==============================================================================
+// SwarmOfflineRenderer Implementation
+//==============================================================================
+
+SwarmOfflineRenderer::SwarmOfflineRenderer(const Settings& s)
+    : settings(s)
+{
+}
+
+bool SwarmOfflineRenderer::run(juce::String& report)
+{
+    settings.outputFile.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream = settings.outputFile.createOutputStream();
+    
+    if (stream == nullptr)
+    {
+        report = "Could not create " + settings.outputFile.getFullPathName();
+        return false;
+    }
+    
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), settings.sampleRate,
+                                                                              2, 24, juce::StringPairArray(), 0));
+    
+    if (writer == nullptr)
+    {
+        report = "Could not write WAV at " + juce::String(settings.sampleRate) + " Hz";
+        return false;
+    }
+    
+    stream.release(); // now owned by the writer
+    
+    SwarmSimulation simulation(settings.numDrones);
+    simulation.setStepRate(settings.stepRate);
+    simulation.setNumSubSteps(settings.numSubSteps);
+    SwarmSynth synth(settings.numDrones);
+    SwarmAutomationTrack automation;
+    
+    if (settings.automationFile != juce::File())
+    {
+        juce::String error;
+        
+        if (!automation.loadFromFile(settings.automationFile, error))
+        {
+            report = error;
+            return false;
+        }
+        
+        simulation.setAutomationReplay(&automation);
+    }
+    
+    if (settings.choreography > 0)
+        simulation.getChoreography().play(settings.choreography);
+    
+    synth.prepare(settings.sampleRate, settings.blockSize);
+    
+    SwarmStepClock stepClock;
+    stepClock.reset(settings.sampleRate, simulation.getStepSeconds(), 0);
+    
+    juce::AudioBuffer<float> buffer(2, settings.blockSize);
+    const auto totalSamples = static_cast<juce::int64>(settings.seconds * settings.sampleRate);
+    
+    int numSteps = 0;
+    int numNotes = 0;
+    float peak = 0.0f;
+    auto startMs = juce::Time::getMillisecondCounterHiRes();
+    
+    for (juce::int64 position = 0; position < totalSamples; position += settings.blockSize)
+    {
+        auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(settings.blockSize),
+                                                      totalSamples - position));
+        
+        // Step the swarm on sample time; like the MIDI output, each step plays one step late
+        while (stepClock.isStepDue(position + numSamples))
+        {
+            {
+                const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::simulation);
+                simulation.step();
+            }
+            
+            for (auto& event : simulation.getNoteEvents())
+                if (event.type == SwarmNoteEvent::Type::noteOn)
+                    ++numNotes;
+            
+            {
+                const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::output);
+                synth.postNoteEvents(simulation.getNoteEvents(), simulation.getDrones(),
+                                     stepClock.getPlaybackStart(), stepClock.getStepLength());
+            }
+            
+            stepClock.advance();
+            ++numSteps;
+        }
+        
+        {
+            const SwarmRealtimeCheck::ScopedRealtime realtime(SwarmRealtimeCheck::audio);
+            synth.render(buffer.getWritePointer(0), buffer.getWritePointer(1), numSamples);
+        }
+        
+        peak = juce::jmax(peak, buffer.getMagnitude(0, numSamples));
+        writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+    }
+    
+    writer.reset();
+    
+    auto elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    
+    report << "Rendered " << settings.seconds << " s of " << settings.numDrones << " drones ("
+           << numSteps << " steps, " << numNotes << " notes) to "
+           << settings.outputFile.getFullPathName() << juce::newLine
+           << "Wall time " << juce::String(elapsedSeconds, 3) << " s ("
+           << juce::String(settings.seconds / juce::jmax(1.0e-6, elapsedSeconds), 1) << "x real time), peak "
+           << juce::String(juce::Decibels::gainToDecibels(peak), 1) << " dBFS";
+    
+    if (synth.getNumDroppedEvents() > 0)
+        report << juce::newLine << "Dropped " << synth.getNumDroppedEvents() << " synth events";
+    
+    if (SwarmRealtimeCheck::isEnabled())
+    {
+        SwarmMemoryReport memory;
+        memory.add(SwarmMemoryReport::drones, simulation.getDroneBytes());
+        memory.add(SwarmMemoryReport::trails, simulation.getTrails().getMemoryBytes());
+        memory.add(SwarmMemoryReport::notes, simulation.getNoteBytes());
+        memory.add(SwarmMemoryReport::midiBuffers, synth.getQueueBytes());
+        
+        report << juce::newLine << memory.toString() << juce::newLine << SwarmRealtimeCheck::createReport();
+    }
+    
+    return true;
+}
@@ -0,0 +1,202 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "SwarmArena.h"
+
+class SwarmDrone;
+struct SwarmNoteEvent;
+
+//==============================================================================
+/**
+ * A voice change for the built-in synth, stamped with the absolute sample
+ * position on the synth's clock at which it takes effect
+ */
+struct SynthEvent
+{
+    enum class Type
+    {
+        noteOn,     // note, value = velocity 0..1, pan -1..1
+        noteOff,
+        brightness  // value = 0..1, opens the filter and blends in the saw
+    };
+    
+    Type type = Type::noteOn;
+    int voice = 0;
+    juce::int64 sampleTime = 0;
+    juce::uint32 order = 0;     // keeps events at the same sample in posting order
+    int note = 0;
+    float value = 0.0f;
+    float pan = 0.0f;
+};
+
+//==============================================================================
+/**
+ * Polyphonic synth with one monophonic voice per drone.
+ *
+ * Voice state is kept as structure-of-arrays in SIMD registers, so each
+ * oscillator, filter and envelope update handles a whole group of voices in
+ * one instruction, and groups that are silent are skipped. Events arrive
+ * through a lock-free FIFO and are applied at their exact sample by splitting
+ * the block around them.
+ *
+ * Plays on an audio device as an AudioIODeviceCallback, or renders offline by
+ * calling render() directly.
+ */
+class SwarmSynth : public juce::AudioIODeviceCallback
+{
+public:
+    explicit SwarmSynth(int numVoices);
+    ~SwarmSynth() override;
+    
+    // Resets voices and the sample clock and drops queued events. Consumer side: called
+    // from audioDeviceAboutToStart() or before an offline render, never while rendering;
+    // the producer may keep posting meanwhile.
+    void prepare(double sampleRate, int maximumBlockSize);
+    
+    // Producer side (one thread): returns false if the FIFO is full and the event was dropped
+    bool postEvent(SynthEvent event);
+    
+    // Turns one simulation step's note events into synth events. The step occupies
+    // stepSamples starting at stepStartSample and each drone pans by its x position.
+    void postNoteEvents(const SwarmArenaVector<SwarmNoteEvent>& noteEvents,
+                        const std::vector<std::unique_ptr<SwarmDrone>>& drones,
+                        juce::int64 stepStartSample, double stepSamples);
+    
+    // Renders the next numSamples and advances the sample clock
+    void render(float* left, float* right, int numSamples);
+    
+    double getSampleRate() const { return sampleRate.load(); }
+    juce::int64 getSamplePosition() const { return samplePosition; }
+    
+    // Bytes of the event queues, which are sized once up front
+    size_t getQueueBytes() const { return (fifoEvents.capacity() + pending.capacity()) * sizeof(SynthEvent); }
+    
+    // Estimates the synth clock position at a Time::getMillisecondCounterHiRes() time, plus
+    // one block so that events posted now are never late
+    juce::int64 getSampleTimeForMillisecondCounter(double milliseconds) const;
+    
+    // The inverse: when a sample position will be heard, on the millisecond counter
+    double getMillisecondCounterForSampleTime(juce::int64 sampleTime) const;
+    
+    // Changes whenever prepare() restarts the sample clock (device restarts, rate changes)
+    int getClockGeneration() const { return clockGeneration.load(); }
+    
+    int getNumDroppedEvents() const { return numDroppedEvents.load(); }
+    
+    // AudioIODeviceCallback
+    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData, int numInputChannels,
+                                          float* const* outputChannelData, int numOutputChannels,
+                                          int numSamples,
+                                          const juce::AudioIODeviceCallbackContext& context) override;
+    void audioDeviceAboutToStart(juce::AudioIODevice* device) override;
+    void audioDeviceStopped() override;
+    
+    static constexpr int EVENT_CAPACITY = 16384;
+    
+private:
+    using FloatVec = juce::dsp::SIMDRegister<float>;
+    static constexpr int LANES = static_cast<int>(FloatVec::SIMDNumElements);
+    
+    // Where the last callback started, in samples and on the millisecond counter
+    struct CallbackTime
+    {
+        juce::int64 sample = 0;
+        double milliseconds = 0.0;
+    };
+    
+    // Audio side writes both halves under a sequence count; readers retry until
+    // they get one callback's pair rather than one half from each of two
+    void setLastCallback(juce::int64 sample, double milliseconds);
+    CallbackTime getLastCallback() const;
+    
+    void collectEvents();
+    void applyEvent(const SynthEvent& event);
+    void renderVoices(float* left, float* right, int numSamples);
+    
+    void setLane(std::vector<FloatVec>& registers, int voice, float value)
+    {
+        registers[static_cast<size_t>(voice / LANES)].set(static_cast<size_t>(voice % LANES), value);
+    }
+    
+    float cutoffForBrightness(float brightness) const;
+    
+    const int numVoices;
+    const int numGroups;
+    
+    // Voice state, LANES voices per register
+    std::vector<FloatVec> phase, increment, shape;
+    std::vector<FloatVec> lowpass, cutoff;
+    std::vector<FloatVec> envelope, envelopeTarget, envelopeRate;
+    std::vector<FloatVec> gainLeft, gainRight;
+    std::vector<char> groupActive;
+    
+    float attackRate = 0.0f;
+    float releaseRate = 0.0f;
+    float masterGain = 0.0f;
+    
+    // Events handed over from the producer
+    std::vector<SynthEvent> fifoEvents;
+    juce::AbstractFifo fifo { EVENT_CAPACITY };
+    juce::uint32 nextOrder = 0;
+    
+    // Events waiting for their sample, sorted by time
+    std::vector<SynthEvent> pending;
+    int numPending = 0;
+    
+    // Scratch output for devices without a stereo pair
+    juce::AudioBuffer<float> deviceBuffer;
+    
+    juce::int64 samplePosition = 0;
+    std::atomic<double> sampleRate { 44100.0 };
+    std::atomic<int> blockSize { 512 };
+    std::atomic<juce::uint32> lastCallbackSequence { 0 };    // odd while a write is under way
+    std::atomic<juce::int64> lastCallbackSample { 0 };
+    std::atomic<double> lastCallbackMs { 0.0 };
+    std::atomic<int> numDroppedEvents { 0 };
+    std::atomic<int> clockGeneration { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmSynth)
+};
+
+//==============================================================================
+/**
+ * Runs the simulation against the synth on sample time and writes the result
+ * to a WAV file, without an audio device or a window.
+ */
+class SwarmOfflineRenderer
+{
+public:
+    struct Settings
+    {
+        juce::File outputFile;
+        int numDrones = 8;
+        double sampleRate = 48000.0;
+        double seconds = 5.0;
+        int blockSize = 512;
+        
+        // Simulation steps per second (SwarmSimulation's default) and physics passes per step
+        double stepRate = 25.0;
+        int numSubSteps = 1;
+        
+        // Optional parameter automation to replay (see SwarmAutomationTrack)
+        juce::File automationFile;
+        
+        // Built-in choreography to play (index into SwarmChoreography::getChoreographyTypes())
+        int choreography = 0;
+    };
+    
+    explicit SwarmOfflineRenderer(const Settings& settings);
+    
+    // Blocks until the file is written; returns false if it could not be created
+    bool run(juce::String& report);
+    
+private:
+    Settings settings;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmOfflineRenderer)
+};
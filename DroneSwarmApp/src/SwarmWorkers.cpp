@@ -0,0 +1,211 @@
+#include "SwarmWorkers.h"
+
+//==============================================================================
+// SwarmWorkerPool Implementation
+//==============================================================================
+
+SwarmWorkerPool::Worker::Worker(SwarmWorkerPool& owner)
+    : juce::Thread("Swarm worker"), pool(owner)
+{
+}
+
+void SwarmWorkerPool::Worker::run()
+{
+    while (!threadShouldExit())
+    {
+        // notify() before this wait isn't lost: the event stays signalled until taken
+        if (!wait(-1) || threadShouldExit())
+            break;
+        
+        pool.runTasks();
+        
+        if (--pool.busyWorkers == 0)
+            pool.jobFinished.signal();
+    }
+}
+
+SwarmWorkerPool::SwarmWorkerPool(int numWorkers)
+{
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto* worker = workers.add(new Worker(*this));
+        worker->startThread(juce::Thread::Priority::high);
+    }
+}
+
+SwarmWorkerPool::~SwarmWorkerPool()
+{
+    for (auto* worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->notify();
+    }
+    
+    for (auto* worker : workers)
+        worker->stopThread(1000);
+}
+
+void SwarmWorkerPool::runTasks()
+{
+    for (int i = nextTask++; i < numJobTasks; i = nextTask++)
+        (*job)(i);
+}
+
+void SwarmWorkerPool::parallelFor(int numTasks, const std::function<void(int)>& task)
+{
+    if (numTasks <= 0)
+        return;
+    
+    // Not worth waking anyone for
+    if (workers.isEmpty() || numTasks == 1)
+    {
+        for (int i = 0; i < numTasks; ++i)
+            task(i);
+        
+        return;
+    }
+    
+    const juce::ScopedLock lock(jobLock);
+    
+    // The caller takes tasks too, so any more workers than this would find none left
+    const auto numToWake = juce::jmin(numTasks - 1, workers.size());
+    
+    job = &task;
+    numJobTasks = numTasks;
+    nextTask = 0;
+    busyWorkers = numToWake;
+    jobFinished.reset();
+    
+    for (int i = 0; i < numToWake; ++i)
+        workers.getUnchecked(i)->notify();
+    
+    runTasks();
+    jobFinished.wait(-1);
+    job = nullptr;
+}
+
+//==============================================================================
+// SwarmJobGraph Implementation
+//==============================================================================
+
+int SwarmJobGraph::addJob(const juce::String& name, std::function<void()> work)
+{
+    auto* job = jobs.add(new Job());
+    job->name = name;
+    job->work = std::move(work);
+    
+    readyJobs.malloc(jobs.size());
+    updateWidth();
+    return jobs.size() - 1;
+}
+
+void SwarmJobGraph::addDependency(int job, int prerequisite)
+{
+    jassert(juce::isPositiveAndBelow(job, jobs.size()) && juce::isPositiveAndBelow(prerequisite, job));
+    
+    jobs.getUnchecked(prerequisite)->dependents.add(job);
+    ++jobs.getUnchecked(job)->numPrerequisites;
+    updateWidth();
+}
+
+void SwarmJobGraph::clear()
+{
+    jobs.clear();
+    readyJobs.free();
+    width = 0;
+}
+
+void SwarmJobGraph::updateWidth()
+{
+    // Prerequisites come before their dependents, so one pass in order settles every depth
+    for (auto* job : jobs)
+        job->depth = 0;
+    
+    for (auto* job : jobs)
+        for (auto dependent : job->dependents)
+            jobs.getUnchecked(dependent)->depth = juce::jmax(jobs.getUnchecked(dependent)->depth, job->depth + 1);
+    
+    juce::Array<int> jobsAtDepth;
+    jobsAtDepth.insertMultiple(0, 0, jobs.size());
+    width = 0;
+    
+    for (auto* job : jobs)
+    {
+        jobsAtDepth.getReference(job->depth) += 1;
+        width = juce::jmax(width, jobsAtDepth[job->depth]);
+    }
+}
+
+void SwarmJobGraph::run(SwarmWorkerPool& pool)
+{
+    if (jobs.isEmpty())
+        return;
+    
+    numQueued = 0;
+    nextQueued = 0;
+    numFinished = 0;
+    
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        auto* job = jobs.getUnchecked(i);
+        job->waitingFor = job->numPrerequisites;
+        
+        if (job->numPrerequisites == 0)
+            queue(i);
+    }
+    
+    // Every thread runs jobs until the whole graph is done; the pool's join makes
+    // all of their work visible to the caller
+    const auto numThreads = juce::jmin(pool.getConcurrency(), width);
+    running.store(true, std::memory_order_relaxed);
+    pool.parallelFor(numThreads, [this](int) { runReadyJobs(); });
+    running.store(false, std::memory_order_relaxed);
+}
+
+void SwarmJobGraph::queue(int index)
+{
+    {
+        const std::lock_guard<std::mutex> lock(readyLock);
+        readyJobs[numQueued++] = index;
+    }
+    
+    readyCondition.notify_one();
+}
+
+int SwarmJobGraph::takeReadyJob()
+{
+    std::unique_lock<std::mutex> lock(readyLock);
+    readyCondition.wait(lock, [this] { return nextQueued < numQueued || numFinished == jobs.size(); });
+    
+    return nextQueued < numQueued ? readyJobs[nextQueued++] : -1;
+}
+
+void SwarmJobGraph::runReadyJobs()
+{
+    for (int index = takeReadyJob(); index >= 0; index = takeReadyJob())
+        runJob(index);
+}
+
+void SwarmJobGraph::runJob(int index)
+{
+    auto* job = jobs.getUnchecked(index);
+    auto startMs = juce::Time::getMillisecondCounterHiRes();
+    
+    job->work();
+    job->milliseconds = juce::Time::getMillisecondCounterHiRes() - startMs;
+    
+    for (auto dependent : job->dependents)
+        if (--jobs.getUnchecked(dependent)->waitingFor == 0)
+            queue(dependent);
+    
+    bool graphDone;
+    
+    {
+        const std::lock_guard<std::mutex> lock(readyLock);
+        graphDone = ++numFinished == jobs.size();
+    }
+    
+    // The threads still waiting for a job can stop
+    if (graphDone)
+        readyCondition.notify_all();
+}
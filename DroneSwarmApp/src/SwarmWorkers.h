@@ -0,0 +1,129 @@
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+//==============================================================================
+/**
+ * A fixed set of worker threads for splitting one piece of frame work into
+ * independent tasks.
+ *
+ * parallelFor() hands out task indices from a shared counter to the workers
+ * and the calling thread, and returns once every task has run. The threads
+ * are started once and sleep between jobs. A job only wakes as many workers
+ * as it has tasks besides the caller's, costs two wake-ups for each of them
+ * and allocates nothing.
+ */
+class SwarmWorkerPool
+{
+public:
+    // By default one worker per core besides the calling thread's
+    explicit SwarmWorkerPool(int numWorkers = juce::SystemStats::getNumCpus() - 1);
+    ~SwarmWorkerPool();
+    
+    // Runs task(i) for every i in [0, numTasks) and waits for all of them; one job at a time
+    void parallelFor(int numTasks, const std::function<void(int)>& task);
+    
+    // Threads that take part in a job, the caller included
+    int getConcurrency() const { return workers.size() + 1; }
+    
+private:
+    class Worker : public juce::Thread
+    {
+    public:
+        explicit Worker(SwarmWorkerPool& owner);
+        void run() override;
+    
+    private:
+        SwarmWorkerPool& pool;
+    };
+    
+    void runTasks();
+    
+    juce::OwnedArray<Worker> workers;
+    juce::CriticalSection jobLock;
+    juce::WaitableEvent jobFinished;
+    
+    const std::function<void(int)>* job = nullptr;
+    int numJobTasks = 0;
+    std::atomic<int> nextTask { 0 };
+    std::atomic<int> busyWorkers { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SwarmWorkerPool)
+};
+
+//==============================================================================
+/**
+ * A fixed set of jobs with explicit dependencies, run on a SwarmWorkerPool.
+ *
+ * Jobs and dependencies are declared once; run() then executes every job once,
+ * each only after the jobs it depends on, on as many of the pool's threads as
+ * can be kept busy. A thread that finishes a job queues any job that was only
+ * waiting for it, and threads with nothing ready sleep until a job is queued
+ * or the graph is done, so a run allocates nothing. The graph's width, which
+ * bounds the threads a run asks for, is worked out as the graph is built. A
+ * job must depend only on jobs added before it, which also rules out cycles,
+ * and must not use the pool itself.
+ */
+class SwarmJobGraph
+{
+public:
+    // Adds a job and returns its index
+    int addJob(const juce::String& name, std::function<void()> work);
+    
+    // Keeps job from starting before prerequisite has finished
+    void addDependency(int job, int prerequisite);
+    
+    void clear();
+    
+    // Runs every job once, in dependency order, and returns when all have finished
+    void run(SwarmWorkerPool& pool);
+    
+    // True from the start of run() until it returns; lets jobs check they are inside one
+    bool isRunning() const noexcept { return running.load(std::memory_order_relaxed); }
+    
+    int getNumJobs() const { return jobs.size(); }
+    const juce::String& getName(int job) const { return jobs.getUnchecked(job)->name; }
+    
+    // How long a job took in the last run
+    double getMilliseconds(int job) const { return jobs.getUnchecked(job)->milliseconds; }
+    
+    // Most jobs at the same depth: the threads a run can use at once
+    int getWidth() const { return width; }
+    
+private:
+    struct Job
+    {
+        juce::String name;
+        std::function<void()> work;
+        juce::Array<int> dependents;
+        int numPrerequisites = 0;
+        int depth = 0;
+        std::atomic<int> waitingFor { 0 };
+        double milliseconds = 0.0;
+    };
+    
+    void updateWidth();
+    void runReadyJobs();
+    void runJob(int index);
+    void queue(int index);
+    
+    // The next ready job, or -1 once the graph is done; sleeps while there is neither
+    int takeReadyJob();
+    
+    juce::OwnedArray<Job> jobs;
+    int width = 0;
+    std::atomic<bool> running { false };
+    
+    // Each job is queued exactly once per run, so the queue never wraps
+    juce::HeapBlock<int> readyJobs;
+    std::mutex readyLock;
+    std::condition_variable readyCondition;
+    int numQueued = 0;
+    int nextQueued = 0;
+    int numFinished = 0;
+};